@@ -16,8 +16,8 @@
                 Includes
 -------------------------------------------*/
 #include "rknn_api.h"
+#include "rknn_topk.h"
 
-#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,73 +38,6 @@ static inline int64_t getCurrentTimeUs()
   return tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-static int rknn_GetTopN(float *pfProb, float *pfMaxProb, uint32_t *pMaxClass, uint32_t outputCount, uint32_t topNum)
-{
-  uint32_t i, j;
-  uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-  for (i = 0; i < topNum; ++i)
-  {
-    pfMaxProb[i] = -FLT_MAX;
-    pMaxClass[i] = -1;
-  }
-
-  for (j = 0; j < top_count; j++)
-  {
-    for (i = 0; i < outputCount; i++)
-    {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4)))
-      {
-        continue;
-      }
-
-      float prob = pfProb[i];
-      if (prob > *(pfMaxProb + j))
-      {
-        *(pfMaxProb + j) = prob;
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
-
-  return 1;
-}
-
-static int rknn_GetTopN_int8(int8_t *pProb, float scale, int zp, float *pfMaxProb, uint32_t *pMaxClass,
-                             uint32_t outputCount, uint32_t topNum)
-{
-  uint32_t i, j;
-  uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-  for (i = 0; i < topNum; ++i)
-  {
-    pfMaxProb[i] = -FLT_MAX;
-    pMaxClass[i] = -1;
-  }
-
-  for (j = 0; j < top_count; j++)
-  {
-    for (i = 0; i < outputCount; i++)
-    {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4)))
-      {
-        continue;
-      }
-
-      float prob = (pProb[i] - zp) * scale;
-      if (prob > *(pfMaxProb + j))
-      {
-        *(pfMaxProb + j) = prob;
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
-
-  return 1;
-}
-
 static void dump_tensor_attr(rknn_tensor_attr *attr)
 {
   char dims[128] = {0};
@@ -211,36 +144,6 @@ static unsigned char *load_image(const char *image_path, rknn_tensor_attr *input
   return image_data;
 }
 
-// 量化模型的npu输出结果为int8数据类型，后处理要按照int8数据类型处理
-// 如下提供了int8排布的NC1HWC2转换成float的nchw转换代码
-int NC1HWC2_int8_to_NCHW_float(const int8_t *src, float *dst, int *dims, int channel, int h, int w, int zp, float scale)
-{
-  int batch = dims[0];
-  int C1 = dims[1];
-  int C2 = dims[4];
-  int hw_src = dims[2] * dims[3];
-  int hw_dst = h * w;
-  for (int i = 0; i < batch; i++)
-  {
-    src = src + i * C1 * hw_src * C2;
-    dst = dst + i * channel * hw_dst;
-    for (int c = 0; c < channel; ++c)
-    {
-      int plane = c / C2;
-      const int8_t *src_c = plane * hw_src * C2 + src;
-      int offset = c % C2;
-      for (int cur_h = 0; cur_h < h; ++cur_h)
-        for (int cur_w = 0; cur_w < w; ++cur_w)
-        {
-          int cur_hw = cur_h * w + cur_w;
-          dst[c * hw_dst + cur_h * w + cur_w] = (src_c[C2 * cur_hw + offset] - zp) * scale; // int8-->float
-        }
-    }
-  }
-
-  return 0;
-}
-
 /*-------------------------------------------
                   Main Functions
 -------------------------------------------*/
@@ -452,54 +355,19 @@ int main(int argc, char *argv[])
     dump_tensor_attr(&orig_output_attrs[i]);
   }
 
-  float *output_mems_nchw[io_num.n_output];
-  for (uint32_t i = 0; i < io_num.n_output; ++i)
-  {
-    int size = orig_output_attrs[i].size_with_stride * sizeof(float);
-    output_mems_nchw[i] = (float *)malloc(size);
-  }
-
-  for (uint32_t i = 0; i < io_num.n_output; i++)
-  {
-    if (output_attrs[i].fmt == RKNN_TENSOR_NC1HWC2)
-    {
-      int channel = orig_output_attrs[i].dims[1];
-      int h = orig_output_attrs[i].n_dims > 2 ? orig_output_attrs[i].dims[2] : 1;
-      int w = orig_output_attrs[i].n_dims > 3 ? orig_output_attrs[i].dims[3] : 1;
-      int zp = output_attrs[i].zp;
-      float scale = output_attrs[i].scale;
-      NC1HWC2_int8_to_NCHW_float((int8_t *)output_mems[i]->virt_addr, (float *)output_mems_nchw[i], (int *)output_attrs[i].dims,
-                                 channel, h, w, zp, scale);
-    }
-    else
-    {
-      int8_t *src = (int8_t *)output_mems[i]->virt_addr;
-      float *dst = output_mems_nchw[i];
-      for (int index = 0; index < output_attrs[i].n_elems; index++)
-      {
-        dst[index] = (src[index] - output_attrs[i].zp) * output_attrs[i].scale;
-      }
-    }
-  }
-
+  // 量化模型的npu输出结果为int8数据类型，top5直接在int8的NC1HWC2输出上计算，只对前5个结果反量化
   // Get top 5
   uint32_t topNum = 5;
   for (uint32_t i = 0; i < io_num.n_output; i++)
   {
-    uint32_t MaxClass[topNum];
-    float fMaxProb[topNum];
-
-    uint32_t sz = orig_output_attrs[i].n_elems;
-    int top_count = sz > topNum ? topNum : sz;
-
-    float *buffer = (float *)output_mems_nchw[i];
-
-    rknn_GetTopN(buffer, fMaxProb, MaxClass, sz, topNum);
+    rknn_topk_result results[topNum];
+    int top_count = rknn_GetTopK(&output_attrs[i], output_mems[i]->virt_addr, orig_output_attrs[i].dims[1], topNum,
+                                 results);
 
     printf("---- Top%d ----\n", top_count);
     for (int j = 0; j < top_count; j++)
     {
-      printf("%8.6f - %d\n", fMaxProb[j], MaxClass[j]);
+      printf("%8.6f - %d\n", results[j].prob, results[j].index);
     }
   }
 
@@ -508,7 +376,6 @@ int main(int argc, char *argv[])
   for (uint32_t i = 0; i < io_num.n_output; ++i)
   {
     rknn_destroy_mem(ctx, output_mems[i]);
-    free(output_mems_nchw[i]);
   }
 
   // destroy
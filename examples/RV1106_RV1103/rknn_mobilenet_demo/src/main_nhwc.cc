@@ -16,8 +16,8 @@
                 Includes
 -------------------------------------------*/
 #include "rknn_api.h"
+#include "rknn_topk.h"
 
-#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,73 +38,6 @@ static inline int64_t getCurrentTimeUs()
   return tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-static int rknn_GetTopN(float *pfProb, float *pfMaxProb, uint32_t *pMaxClass, uint32_t outputCount, uint32_t topNum)
-{
-  uint32_t i, j;
-  uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-  for (i = 0; i < topNum; ++i)
-  {
-    pfMaxProb[i] = -FLT_MAX;
-    pMaxClass[i] = -1;
-  }
-
-  for (j = 0; j < top_count; j++)
-  {
-    for (i = 0; i < outputCount; i++)
-    {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4)))
-      {
-        continue;
-      }
-
-      float prob = pfProb[i];
-      if (prob > *(pfMaxProb + j))
-      {
-        *(pfMaxProb + j) = prob;
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
-
-  return 1;
-}
-
-static int rknn_GetTopN_int8(int8_t *pProb, float scale, int zp, float *pfMaxProb, uint32_t *pMaxClass,
-                             uint32_t outputCount, uint32_t topNum)
-{
-  uint32_t i, j;
-  uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-  for (i = 0; i < topNum; ++i)
-  {
-    pfMaxProb[i] = -FLT_MAX;
-    pMaxClass[i] = -1;
-  }
-
-  for (j = 0; j < top_count; j++)
-  {
-    for (i = 0; i < outputCount; i++)
-    {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4)))
-      {
-        continue;
-      }
-
-      float prob = (pProb[i] - zp) * scale;
-      if (prob > *(pfMaxProb + j))
-      {
-        *(pfMaxProb + j) = prob;
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
-
-  return 1;
-}
-
 static void dump_tensor_attr(rknn_tensor_attr *attr)
 {
   char dims[128] = {0};
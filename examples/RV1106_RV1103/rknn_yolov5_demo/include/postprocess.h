@@ -2,6 +2,7 @@
 #define _RKNN_ZERO_COPY_DEMO_POSTPROCESS_H_
 
 #include <stdint.h>
+#include "rknn_api.h"
 
 #define OBJ_NAME_MAX_SIZE 16
 #define OBJ_NUMB_MAX_SIZE 64
@@ -32,9 +33,9 @@ typedef struct _detect_result_group_t
     detect_result_t results[OBJ_NUMB_MAX_SIZE];
 } detect_result_group_t;
 
-int post_process(int8_t *input0, int8_t *input1, int8_t *input2, int model_in_h, int model_in_w,
+// outputs are the buffers described by output_attrs (e.g. native NHWC / NC1HWC2 zero-copy outputs)
+int post_process(rknn_tensor_attr *output_attrs, void *outputs[3], int model_in_h, int model_in_w,
                  float conf_threshold, float nms_threshold, float scale_w, float scale_h,
-                 std::vector<int32_t> &qnt_zps, std::vector<float> &qnt_scales,
                  detect_result_group_t *group);
 
 #endif //_RKNN_ZERO_COPY_DEMO_POSTPROCESS_H_
@@ -368,16 +368,9 @@ int main(int argc, char *argv[])
   float scale_h = (float)model_height / img_height;
 
   detect_result_group_t detect_result_group;
-  std::vector<float> out_scales;
-  std::vector<int32_t> out_zps;
-  for (int i = 0; i < io_num.n_output; ++i)
-  {
-    out_scales.push_back(output_attrs[i].scale);
-    out_zps.push_back(output_attrs[i].zp);
-  }
-
-  post_process((int8_t *)output_mems[0]->virt_addr, (int8_t *)output_mems[1]->virt_addr, (int8_t *)output_mems[2]->virt_addr, 640, 640,
-               box_conf_threshold, nms_threshold, scale_w, scale_h, out_zps, out_scales, &detect_result_group);
+  void *outputs[3] = {output_mems[0]->virt_addr, output_mems[1]->virt_addr, output_mems[2]->virt_addr};
+  post_process(output_attrs, outputs, 640, 640, box_conf_threshold, nms_threshold, scale_w, scale_h,
+               &detect_result_group);
 
   char text[256];
   for (int i = 0; i < detect_result_group.count; i++)
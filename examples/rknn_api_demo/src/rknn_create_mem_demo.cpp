@@ -16,8 +16,9 @@
                 Includes
 -------------------------------------------*/
 #include "rknn_api.h"
+#include "rknn_input_pack.h"
+#include "rknn_topk.h"
 
-#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,33 +39,6 @@ static inline int64_t getCurrentTimeUs()
   return tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-static int rknn_GetTopN(float* pfProb, float* pfMaxProb, uint32_t* pMaxClass, uint32_t outputCount, uint32_t topNum)
-{
-  uint32_t i, j;
-  uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-  for (i = 0; i < topNum; ++i) {
-    pfMaxProb[i] = -FLT_MAX;
-    pMaxClass[i] = -1;
-  }
-
-  for (j = 0; j < top_count; j++) {
-    for (i = 0; i < outputCount; i++) {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4))) {
-        continue;
-      }
-
-      if (pfProb[i] > *(pfMaxProb + j)) {
-        *(pfMaxProb + j) = pfProb[i];
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
-
-  return 1;
-}
-
 static void dump_tensor_attr(rknn_tensor_attr* attr)
 {
   printf("  index=%d, name=%s, n_dims=%d, dims=[%d, %d, %d, %d], n_elems=%d, size=%d, fmt=%s, type=%s, qnt_type=%s, "
@@ -154,7 +128,9 @@ static unsigned char* load_model(const char* filename, int* model_size)
 int main(int argc, char* argv[])
 {
   if (argc < 3) {
-    printf("Usage:%s model_path input_path [loop_count]\n", argv[0]);
+    printf("Usage:%s model_path input_path [loop_count] [mean std]\n", argv[0]);
+    printf("  mean / std (e.g. 0,0,0 255,255,255): mean_values / std_values of the model, pack the image into the "
+           "native input in pass through mode\n");
     return -1;
   }
 
@@ -166,6 +142,18 @@ int main(int argc, char* argv[])
     loop_count = atoi(argv[3]);
   }
 
+  bool  pass_through   = false;
+  float mean_values[3] = {0.f, 0.f, 0.f};
+  float std_values[3]  = {1.f, 1.f, 1.f};
+  if (argc > 5) {
+    if (sscanf(argv[4], "%f,%f,%f", &mean_values[0], &mean_values[1], &mean_values[2]) != 3 ||
+        sscanf(argv[5], "%f,%f,%f", &std_values[0], &std_values[1], &std_values[2]) != 3) {
+      printf("bad mean / std: %s %s\n", argv[4], argv[5]);
+      return -1;
+    }
+    pass_through = true;
+  }
+
   rknn_context ctx = 0;
 
   // Load RKNN Model
@@ -243,46 +231,82 @@ int main(int argc, char* argv[])
   if (!input_data) {
     return -1;
   }
+  // load_image() gave an NHWC image of the size of the model input, whatever the layout of its attr
+  int in_height  = input_attrs[0].fmt == RKNN_TENSOR_NCHW ? input_attrs[0].dims[2] : input_attrs[0].dims[1];
+  int in_width   = input_attrs[0].fmt == RKNN_TENSOR_NCHW ? input_attrs[0].dims[3] : input_attrs[0].dims[2];
+  int in_channel = input_attrs[0].fmt == RKNN_TENSOR_NCHW ? input_attrs[0].dims[1] : input_attrs[0].dims[3];
 
   // Create input tensor memory
   rknn_tensor_mem* input_mems[1];
-  // default input type is int8 (normalize and quantize need compute in outside)
-  // if set uint8, will fuse normalize and quantize to npu
-  input_attrs[0].type = input_type;
-  // default fmt is NHWC, npu only support NHWC in zero copy mode
-  input_attrs[0].fmt = input_layout;
-
-  input_mems[0] = rknn_create_mem(ctx, input_attrs[0].size_with_stride);
-
-  // Copy input data to input tensor memory
-  int width  = input_attrs[0].dims[2];
-  int stride = input_attrs[0].w_stride;
-
-  if (width == stride) {
-    memcpy(input_mems[0]->virt_addr, input_data, width * input_attrs[0].dims[1] * input_attrs[0].dims[3]);
+  if (pass_through) {
+    // native input in its own type (int8 by default): normalize, quantize and lay out the image on the cpu,
+    // the runtime takes the buffer as is
+    rknn_tensor_attr native_attr;
+    memset(&native_attr, 0, sizeof(native_attr));
+    native_attr.index = 0;
+    ret               = rknn_query(ctx, RKNN_QUERY_NATIVE_INPUT_ATTR, &native_attr, sizeof(native_attr));
+    if (ret != RKNN_SUCC) {
+      printf("rknn_query fail! ret=%d\n", ret);
+      return -1;
+    }
+    dump_tensor_attr(&native_attr);
+
+    rknn_pack_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.fmt    = RKNN_PACK_RGB888;
+    frame.width  = in_width;
+    frame.height = in_height;
+    frame.data   = input_data;
+
+    input_attrs[0]              = native_attr;
+    input_attrs[0].pass_through = 1;
+    input_mems[0]               = rknn_create_mem(ctx, input_attrs[0].size_with_stride);
+    rknn_packer* packer = NULL;
+    if (rknn_packer_create(1, &packer) != 0) {
+      return -1;
+    }
+    ret = rknn_pack_input(packer, &input_attrs[0], &frame, mean_values, std_values, input_mems[0]);
+    rknn_packer_destroy(packer);
+    if (ret != 0) {
+      return -1;
+    }
   } else {
-    int height  = input_attrs[0].dims[1];
-    int channel = input_attrs[0].dims[3];
-    // copy from src to dst with stride
-    uint8_t* src_ptr = input_data;
-    uint8_t* dst_ptr = (uint8_t*)input_mems[0]->virt_addr;
-    // width-channel elements
-    int src_wc_elems = width * channel;
-    int dst_wc_elems = stride * channel;
-    for (int h = 0; h < height; ++h) {
-      memcpy(dst_ptr, src_ptr, src_wc_elems);
-      src_ptr += src_wc_elems;
-      dst_ptr += dst_wc_elems;
+    // default input type is int8 (normalize and quantize need compute in outside)
+    // if set uint8, will fuse normalize and quantize to npu
+    input_attrs[0].type = input_type;
+    // default fmt is NHWC, npu only support NHWC in zero copy mode
+    input_attrs[0].fmt = input_layout;
+
+    input_mems[0] = rknn_create_mem(ctx, input_attrs[0].size_with_stride);
+
+    // Copy input data to input tensor memory
+    int width  = in_width;
+    int stride = input_attrs[0].w_stride;
+
+    if (width == stride) {
+      memcpy(input_mems[0]->virt_addr, input_data, width * in_height * in_channel);
+    } else {
+      int height  = in_height;
+      int channel = in_channel;
+      // copy from src to dst with stride
+      uint8_t* src_ptr = input_data;
+      uint8_t* dst_ptr = (uint8_t*)input_mems[0]->virt_addr;
+      // width-channel elements
+      int src_wc_elems = width * channel;
+      int dst_wc_elems = stride * channel;
+      for (int h = 0; h < height; ++h) {
+        memcpy(dst_ptr, src_ptr, src_wc_elems);
+        src_ptr += src_wc_elems;
+        dst_ptr += dst_wc_elems;
+      }
     }
   }
 
   // Create output tensor memory
   rknn_tensor_mem* output_mems[io_num.n_output];
   for (uint32_t i = 0; i < io_num.n_output; ++i) {
-    // default output type is depend on model, this require float32 to compute top5
-    // allocate float32 output tensor
-    int output_size = output_attrs[i].n_elems * sizeof(float);
-    output_mems[i]  = rknn_create_mem(ctx, output_size);
+    // keep the output type of the model, top5 is computed on the quantized values
+    output_mems[i] = rknn_create_mem(ctx, output_attrs[i].size_with_stride);
   }
 
   // Set input tensor memory
@@ -294,8 +318,6 @@ int main(int argc, char* argv[])
 
   // Set output tensor memory
   for (uint32_t i = 0; i < io_num.n_output; ++i) {
-    // default output type is depend on model, this require float32 to compute top5
-    output_attrs[i].type = RKNN_TENSOR_FLOAT32;
     // set output memory and attribute
     ret = rknn_set_io_mem(ctx, output_mems[i], &output_attrs[i]);
     if (ret < 0) {
@@ -320,17 +342,12 @@ int main(int argc, char* argv[])
   // Get top 5
   uint32_t topNum = 5;
   for (uint32_t i = 0; i < io_num.n_output; i++) {
-    uint32_t MaxClass[topNum];
-    float    fMaxProb[topNum];
-    float*   buffer    = (float*)output_mems[i]->virt_addr;
-    uint32_t sz        = output_attrs[i].n_elems;
-    int      top_count = sz > topNum ? topNum : sz;
-
-    rknn_GetTopN(buffer, fMaxProb, MaxClass, sz, topNum);
+    rknn_topk_result results[topNum];
+    int top_count = rknn_GetTopK(&output_attrs[i], output_mems[i]->virt_addr, 0, topNum, results);
 
     printf("---- Top%d ----\n", top_count);
     for (int j = 0; j < top_count; j++) {
-      printf("%8.6f - %d\n", fMaxProb[j], MaxClass[j]);
+      printf("%8.6f - %d\n", results[j].prob, results[j].index);
     }
   }
 
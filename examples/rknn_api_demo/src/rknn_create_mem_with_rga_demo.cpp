@@ -16,7 +16,6 @@
                 Includes
 -------------------------------------------*/
 
-#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,6 +25,7 @@
 #include "im2d.h"
 #include "rga.h"
 #include "rknn_api.h"
+#include "rknn_topk.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
@@ -44,33 +44,6 @@ static inline int64_t getCurrentTimeUs()
   return tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-static int rknn_GetTopN(float* pfProb, float* pfMaxProb, uint32_t* pMaxClass, uint32_t outputCount, uint32_t topNum)
-{
-  uint32_t i, j;
-  uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-  for (i = 0; i < topNum; ++i) {
-    pfMaxProb[i] = -FLT_MAX;
-    pMaxClass[i] = -1;
-  }
-
-  for (j = 0; j < top_count; j++) {
-    for (i = 0; i < outputCount; i++) {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4))) {
-        continue;
-      }
-
-      if (pfProb[i] > *(pfMaxProb + j)) {
-        *(pfMaxProb + j) = pfProb[i];
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
-
-  return 1;
-}
-
 static void dump_tensor_attr(rknn_tensor_attr* attr)
 {
   printf("  index=%d, name=%s, n_dims=%d, dims=[%d, %d, %d, %d], n_elems=%d, size=%d, fmt=%s, type=%s, qnt_type=%s, "
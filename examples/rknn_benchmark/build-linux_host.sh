@@ -0,0 +1,21 @@
+#!/bin/bash
+set -e
+
+TARGET_SOC="rk3588"
+
+ROOT_PWD=$( cd "$( dirname $0 )" && cd -P "$( dirname "$SOURCE" )" && pwd )
+
+# build with the host librknnrt stand-in, see ../rknn_host_stub
+BUILD_DIR=${ROOT_PWD}/build/build_linux_host
+
+if [[ ! -d "${BUILD_DIR}" ]]; then
+  mkdir -p ${BUILD_DIR}
+fi
+
+cd ${BUILD_DIR}
+cmake ../.. \
+    -DTARGET_SOC=${TARGET_SOC} \
+    -DRKNN_HOST_STUB=ON
+make -j4
+make install
+cd -
@@ -0,0 +1,126 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "latency_histogram.h"
+
+#include <math.h>
+
+// 2^SUB_BITS exact values, then 2^(SUB_BITS - 1) buckets per power of two up to 2^MAX_BITS us (12 days)
+#define SUB_BITS 10
+#define MAX_BITS 40
+#define SUB_COUNT (1 << SUB_BITS)
+#define HALF_COUNT (1 << (SUB_BITS - 1))
+#define BUCKET_COUNT (SUB_COUNT + (MAX_BITS - SUB_BITS) * HALF_COUNT)
+
+static int bucket_index(int64_t us)
+{
+  if (us < SUB_COUNT) {
+    return (int)us;
+  }
+  int top   = 63 - __builtin_clzll((unsigned long long)us);
+  int shift = top - (SUB_BITS - 1);
+  return SUB_COUNT + (shift - 1) * HALF_COUNT + (int)((us >> shift) - HALF_COUNT);
+}
+
+// highest value counted in the bucket
+static int64_t bucket_value(int index)
+{
+  if (index < SUB_COUNT) {
+    return index;
+  }
+  int     shift = (index - SUB_COUNT) / HALF_COUNT + 1;
+  int64_t sub   = (index - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+  return ((sub + 1) << shift) - 1;
+}
+
+LatencyHistogram::LatencyHistogram() : counts(BUCKET_COUNT, 0) { Reset(); }
+
+void LatencyHistogram::Reset()
+{
+  for (size_t i = 0; i < counts.size(); ++i) {
+    counts[i] = 0;
+  }
+  count  = 0;
+  min_us = 0;
+  max_us = 0;
+  mean   = 0;
+  m2     = 0;
+}
+
+void LatencyHistogram::Record(int64_t us)
+{
+  if (us < 0) {
+    us = 0;
+  } else if (us >= ((int64_t)1 << MAX_BITS)) {
+    us = ((int64_t)1 << MAX_BITS) - 1;
+  }
+  counts[bucket_index(us)]++;
+  min_us = count == 0 || us < min_us ? us : min_us;
+  max_us = count == 0 || us > max_us ? us : max_us;
+  count++;
+  // Welford, the sum of squares loses the spread of long runs of similar values
+  double delta = us - mean;
+  mean += delta / count;
+  m2 += delta * (us - mean);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+  if (other.count == 0) {
+    return;
+  }
+  for (int i = 0; i < BUCKET_COUNT; ++i) {
+    counts[i] += other.counts[i];
+  }
+  min_us        = count == 0 || other.min_us < min_us ? other.min_us : min_us;
+  max_us        = count == 0 || other.max_us > max_us ? other.max_us : max_us;
+  int64_t n     = count + other.count;
+  double  delta = other.mean - mean;
+  mean += delta * other.count / n;
+  m2 += other.m2 + delta * delta * count * other.count / n;
+  count = n;
+}
+
+int64_t LatencyHistogram::Percentile(double p) const
+{
+  if (count == 0) {
+    return 0;
+  }
+  int64_t rank = (int64_t)ceil(p / 100 * count);
+  rank         = rank < 1 ? 1 : (rank > count ? count : rank);
+  int64_t seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      int64_t value = bucket_value(i);
+      return value < min_us ? min_us : (value > max_us ? max_us : value);
+    }
+  }
+  return max_us;
+}
+
+latency_summary LatencyHistogram::Summarize() const
+{
+  latency_summary s;
+  s.count     = count;
+  s.mean_us   = mean;
+  s.stddev_us = count > 1 ? sqrt(m2 / (count - 1)) : 0;
+  s.min_us    = min_us;
+  s.p50_us    = Percentile(50);
+  s.p90_us    = Percentile(90);
+  s.p99_us    = Percentile(99);
+  s.p999_us   = Percentile(99.9);
+  s.max_us    = max_us;
+  return s;
+}
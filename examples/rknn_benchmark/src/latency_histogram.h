@@ -0,0 +1,65 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_BENCHMARK_LATENCY_HISTOGRAM_H_
+#define _RKNN_BENCHMARK_LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+typedef struct _latency_summary
+{
+  int64_t count;
+  double  mean_us;
+  double  stddev_us;
+  int64_t min_us;
+  int64_t p50_us;
+  int64_t p90_us;
+  int64_t p99_us;
+  int64_t p999_us;
+  int64_t max_us;
+} latency_summary;
+
+/*
+  latencies in microseconds, counted in log-linear buckets as HDR histograms do: exact up to 1024 us, then 512
+  buckets per power of two, so that a percentile is off by less than 0.2% whatever the range, in a fixed array
+  of 16 K counters. mean, standard deviation, min and max are exact. Record() does not allocate, it is cheap enough to
+  stay inside the timed loop.
+*/
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void Record(int64_t us);
+  // adds the runs of other, as if they had been recorded here
+  void Merge(const LatencyHistogram& other);
+  void Reset();
+
+  int64_t Count() const { return count; }
+  // p in [0, 100], the highest value of the bucket holding it, within [min, max]
+  int64_t         Percentile(double p) const;
+  latency_summary Summarize() const;
+
+private:
+  std::vector<int64_t> counts;
+  int64_t              count;
+  int64_t              min_us;
+  int64_t              max_us;
+  double               mean;
+  double               m2;
+};
+
+#endif //_RKNN_BENCHMARK_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,413 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "perf_detail.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+/*-------------------------------------------
+            Per-op table parsing
+-------------------------------------------*/
+enum perf_column
+{
+  COL_ID = 0,
+  COL_TYPE,
+  COL_DATA_TYPE,
+  COL_TARGET,
+  COL_TIME,
+  COL_NAME,
+  COL_NUM
+};
+
+static const char* column_names[COL_NUM] = {"ID", "OpType", "DataType", "Target", "Time(us)", "FullName"};
+
+// start offsets of the words of the header line, every column of the table and the words of names such as "DDR Cycles"
+static std::vector<int> header_words(const std::string& header)
+{
+  std::vector<int> starts;
+  for (size_t pos = 0; pos < header.size(); ++pos) {
+    if (!isspace((unsigned char)header[pos]) && (pos == 0 || isspace((unsigned char)header[pos - 1]))) {
+      starts.push_back((int)pos);
+    }
+  }
+  return starts;
+}
+
+// index of the header word of a column name, -1 if missing
+static int find_column(const std::string& header, const std::vector<int>& starts, const char* name)
+{
+  size_t len = strlen(name);
+  for (size_t i = 0; i < starts.size(); ++i) {
+    size_t pos = starts[i];
+    if (header.compare(pos, len, name) == 0 && (pos + len == header.size() || isspace((unsigned char)header[pos + len]))) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/* the values of a row, one per header word. the columns are as wide as printf made them, a value longer than its
+   column pushes all the ones after it to the right. the tokens of the row are walked in order with the drift of
+   the row so far:
+   - a token at the start of a column (plus the drift) is the value of that column
+   - a token after one that ran past the start of the next column is the value of that next column, pushed: the
+     drift grows, for all the columns after it, parsed or not (the InputShape of a Concat, for one)
+   - any other token belongs to the column it falls in, such as the words of "0.0%/0.0%/0.0% - Up:0.0%"
+   a header word without a value of its own ("Cycles" of "DDR Cycles") is left empty. the value of the last column
+   is the rest of the line. values running into the next one without a space can not be told apart. */
+static void split_row(const std::string& line, const std::vector<int>& starts, std::vector<std::string>* values)
+{
+  int              num = (int)starts.size();
+  std::vector<int> begin(num, -1), end(num, -1);
+  int              drift    = 0;
+  int              prev_col = -1;
+  int              prev_end = 0;
+  for (int pos = 0; pos < (int)line.size();) {
+    if (isspace((unsigned char)line[pos])) {
+      ++pos;
+      continue;
+    }
+    int s = pos;
+    while (pos < (int)line.size() && !isspace((unsigned char)line[pos])) {
+      ++pos;
+    }
+    int col = -1;
+    for (int c = prev_col + 1; c < num && col < 0; ++c) {
+      col = starts[c] + drift == s ? c : -1;
+    }
+    if (col < 0 && prev_col + 1 < num && prev_end > starts[prev_col + 1] + drift) {
+      col   = prev_col + 1;
+      drift = s - starts[col];
+    }
+    if (col < 0) {
+      col = prev_col < 0 ? 0 : prev_col;
+      while (col + 1 < num && starts[col + 1] + drift <= s) {
+        ++col;
+      }
+    }
+    if (begin[col] < 0) {
+      begin[col] = s;
+    }
+    end[col] = pos;
+    if (col == num - 1) {
+      end[col] = (int)line.size();
+      while (end[col] > s && isspace((unsigned char)line[end[col] - 1])) {
+        --end[col];
+      }
+      break;
+    }
+    prev_col = col;
+    prev_end = pos;
+  }
+  values->assign(num, std::string());
+  for (int c = 0; c < num; ++c) {
+    if (begin[c] >= 0) {
+      (*values)[c] = line.substr(begin[c], end[c] - begin[c]);
+    }
+  }
+}
+
+int parse_perf_detail(const char* text, uint64_t len, std::vector<perf_op>* ops)
+{
+  ops->clear();
+  if (text == NULL) {
+    return -1;
+  }
+  std::vector<int>         starts;
+  std::vector<std::string> values;
+  int                      cols[COL_NUM];
+  bool                     header = false;
+  for (uint64_t begin = 0; begin < len && text[begin] != '\0';) {
+    uint64_t end = begin;
+    while (end < len && text[end] != '\0' && text[end] != '\n') {
+      ++end;
+    }
+    std::string line(text + begin, end - begin);
+    begin = end + 1;
+
+    if (!header) {
+      starts = header_words(line);
+      for (int c = 0; c < COL_NUM; ++c) {
+        cols[c] = find_column(line, starts, column_names[c]);
+      }
+      // the name may be missing from old tables, the others are needed
+      header = cols[COL_ID] >= 0 && cols[COL_TYPE] >= 0 && cols[COL_TARGET] >= 0 && cols[COL_TIME] >= 0;
+      continue;
+    }
+    // rows start with the op id, separators and totals do not
+    split_row(line, starts, &values);
+    const std::string& id = values[cols[COL_ID]];
+    if (id.empty() || !isdigit((unsigned char)id[0])) {
+      continue;
+    }
+    perf_op op;
+    op.id        = atoi(id.c_str());
+    op.type      = values[cols[COL_TYPE]];
+    op.data_type = cols[COL_DATA_TYPE] >= 0 ? values[cols[COL_DATA_TYPE]] : "";
+    op.target    = values[cols[COL_TARGET]];
+    op.time_us   = atoll(values[cols[COL_TIME]].c_str());
+    op.name      = cols[COL_NAME] >= 0 ? values[cols[COL_NAME]] : "";
+    if (op.name.empty()) {
+      op.name = op.type;
+    }
+    ops->push_back(op);
+  }
+  return header ? 0 : -1;
+}
+
+/*-------------------------------------------
+              Aggregation of runs
+-------------------------------------------*/
+// nearest rank, as LatencyHistogram::Percentile()
+static int64_t percentile(const std::vector<int64_t>& sorted, double p)
+{
+  if (sorted.empty()) {
+    return 0;
+  }
+  int64_t n    = sorted.size();
+  int64_t rank = (int64_t)ceil(p / 100 * n);
+  rank         = rank < 1 ? 1 : (rank > n ? n : rank);
+  return sorted[rank - 1];
+}
+
+int PerfProfile::Add(const std::vector<perf_op>& run)
+{
+  if (totals.empty()) {
+    ops = run;
+    samples.assign(run.size(), std::vector<int64_t>());
+  } else if (run.size() != ops.size()) {
+    return -1;
+  }
+  for (size_t i = 0; i < run.size(); ++i) {
+    if (run[i].id != ops[i].id) {
+      return -1;
+    }
+  }
+  int64_t total = 0;
+  for (size_t i = 0; i < run.size(); ++i) {
+    samples[i].push_back(run[i].time_us);
+    total += run[i].time_us;
+  }
+  totals.push_back(total);
+  return 0;
+}
+
+void PerfProfile::Summarize(std::vector<perf_op_summary>* summary, perf_profile_info* info) const
+{
+  summary->clear();
+  std::vector<int64_t> sorted;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    sorted = samples[i];
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (size_t j = 0; j < sorted.size(); ++j) {
+      sum += sorted[j];
+    }
+    perf_op_summary s;
+    s.op         = ops[i];
+    s.op.time_us = percentile(sorted, 50);
+    s.runs       = sorted.size();
+    s.mean_us    = sorted.empty() ? 0 : sum / sorted.size();
+    s.p99_us     = percentile(sorted, 99);
+    s.max_us     = sorted.empty() ? 0 : sorted.back();
+    summary->push_back(s);
+  }
+  sorted = totals;
+  std::sort(sorted.begin(), sorted.end());
+  info->runs            = sorted.size();
+  info->total_median_us = percentile(sorted, 50);
+  info->total_p99_us    = percentile(sorted, 99);
+}
+
+/*-------------------------------------------
+               Profile files
+-------------------------------------------*/
+static void write_json_string(FILE* fp, const char* s)
+{
+  fputc('"', fp);
+  for (; *s != '\0'; ++s) {
+    if (*s == '"' || *s == '\\') {
+      fputc('\\', fp);
+      fputc(*s, fp);
+    } else if ((unsigned char)*s < 0x20) {
+      fprintf(fp, "\\u%04x", *s);
+    } else {
+      fputc(*s, fp);
+    }
+  }
+  fputc('"', fp);
+}
+
+void write_perf_profile_json(FILE* fp, const perf_profile_info* info, const std::vector<perf_op_summary>& ops)
+{
+  fprintf(fp, "{\n  \"model\": ");
+  write_json_string(fp, info->model.c_str());
+  fprintf(fp, ",\n  \"mode\": \"profile\",\n  \"sdk_version\": ");
+  write_json_string(fp, info->sdk_version.c_str());
+  fprintf(fp, ",\n  \"driver_version\": ");
+  write_json_string(fp, info->driver_version.c_str());
+  fprintf(fp, ",\n  \"core_mask\": %u,\n  \"runs\": %lld,\n", info->core_mask, (long long)info->runs);
+  fprintf(fp, "  \"total_median_us\": %lld,\n  \"total_p99_us\": %lld,\n", (long long)info->total_median_us,
+          (long long)info->total_p99_us);
+  fprintf(fp, "  \"ops\": [\n");
+  for (size_t i = 0; i < ops.size(); ++i) {
+    const perf_op_summary& s = ops[i];
+    fprintf(fp, "    {\"id\": %d, \"type\": ", s.op.id);
+    write_json_string(fp, s.op.type.c_str());
+    fprintf(fp, ", \"data_type\": ");
+    write_json_string(fp, s.op.data_type.c_str());
+    fprintf(fp, ", \"target\": ");
+    write_json_string(fp, s.op.target.c_str());
+    fprintf(fp, ", \"name\": ");
+    write_json_string(fp, s.op.name.c_str());
+    fprintf(fp, ", \"runs\": %lld, \"median_us\": %lld, \"p99_us\": %lld, \"max_us\": %lld, \"mean_us\": %.2f}%s\n",
+            (long long)s.runs, (long long)s.op.time_us, (long long)s.p99_us, (long long)s.max_us, s.mean_us,
+            i + 1 < ops.size() ? "," : "");
+  }
+  fprintf(fp, "  ]\n}\n");
+}
+
+void write_perf_profile_csv(FILE* fp, const std::vector<perf_op_summary>& ops)
+{
+  fprintf(fp, "id,type,data_type,target,name,runs,median_us,p99_us,max_us,mean_us\n");
+  for (size_t i = 0; i < ops.size(); ++i) {
+    const perf_op_summary& s = ops[i];
+    fprintf(fp, "%d,%s,%s,%s,\"%s\",%lld,%lld,%lld,%lld,%.2f\n", s.op.id, s.op.type.c_str(), s.op.data_type.c_str(),
+            s.op.target.c_str(), s.op.name.c_str(), (long long)s.runs, (long long)s.op.time_us, (long long)s.p99_us,
+            (long long)s.max_us, s.mean_us);
+  }
+}
+
+// the value of "key": in a line as written by write_perf_profile_json(), false if missing
+static bool find_key(const std::string& line, const char* key, size_t* pos)
+{
+  std::string quoted = std::string("\"") + key + "\":";
+  size_t      found  = line.find(quoted);
+  if (found == std::string::npos) {
+    return false;
+  }
+  *pos = found + quoted.size();
+  while (*pos < line.size() && line[*pos] == ' ') {
+    ++*pos;
+  }
+  return true;
+}
+
+static bool read_string(const std::string& line, const char* key, std::string* value)
+{
+  size_t pos;
+  if (!find_key(line, key, &pos) || pos >= line.size() || line[pos] != '"') {
+    return false;
+  }
+  value->clear();
+  for (++pos; pos < line.size() && line[pos] != '"'; ++pos) {
+    if (line[pos] == '\\' && pos + 1 < line.size()) {
+      ++pos;
+      if (line[pos] == 'u') {
+        value->push_back((char)strtol(line.substr(pos + 1, 4).c_str(), NULL, 16));
+        pos += 4;
+        continue;
+      }
+    }
+    value->push_back(line[pos]);
+  }
+  return true;
+}
+
+static bool read_number(const std::string& line, const char* key, double* value)
+{
+  size_t pos;
+  if (!find_key(line, key, &pos)) {
+    return false;
+  }
+  *value = atof(line.c_str() + pos);
+  return true;
+}
+
+int read_perf_profile(const char* path, perf_profile_info* info, std::vector<perf_op_summary>* ops)
+{
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    printf("fopen %s fail!\n", path);
+    return -1;
+  }
+  info->model.clear();
+  info->sdk_version.clear();
+  info->driver_version.clear();
+  info->core_mask       = 0;
+  info->runs            = 0;
+  info->total_median_us = 0;
+  info->total_p99_us    = 0;
+  ops->clear();
+
+  bool        profile = false;
+  std::string line;
+  char        buf[1024];
+  while (fgets(buf, sizeof(buf), fp) != NULL) {
+    line += buf;
+    if (line.empty() || line[line.size() - 1] != '\n') {
+      if (!feof(fp)) {
+        continue;
+      }
+    }
+    size_t first = line.find_first_not_of(' ');
+    double value;
+    if (first != std::string::npos && line[first] == '{' && line.find("\"id\":") != std::string::npos) {
+      perf_op_summary s;
+      s.op.id = read_number(line, "id", &value) ? (int32_t)value : 0;
+      read_string(line, "type", &s.op.type);
+      read_string(line, "data_type", &s.op.data_type);
+      read_string(line, "target", &s.op.target);
+      read_string(line, "name", &s.op.name);
+      s.op.time_us = read_number(line, "median_us", &value) ? (int64_t)value : 0;
+      s.runs       = read_number(line, "runs", &value) ? (int64_t)value : 0;
+      s.p99_us     = read_number(line, "p99_us", &value) ? (int64_t)value : 0;
+      s.max_us     = read_number(line, "max_us", &value) ? (int64_t)value : 0;
+      s.mean_us    = read_number(line, "mean_us", &value) ? value : 0;
+      ops->push_back(s);
+    } else {
+      std::string mode;
+      if (read_string(line, "mode", &mode)) {
+        profile = mode == "profile";
+      }
+      read_string(line, "model", &info->model);
+      read_string(line, "sdk_version", &info->sdk_version);
+      read_string(line, "driver_version", &info->driver_version);
+      if (read_number(line, "core_mask", &value)) {
+        info->core_mask = (uint32_t)value;
+      }
+      if (read_number(line, "runs", &value)) {
+        info->runs = (int64_t)value;
+      }
+      if (read_number(line, "total_median_us", &value)) {
+        info->total_median_us = (int64_t)value;
+      }
+      if (read_number(line, "total_p99_us", &value)) {
+        info->total_p99_us = (int64_t)value;
+      }
+    }
+    line.clear();
+  }
+  fclose(fp);
+  if (!profile) {
+    printf("%s is not a profile of rknn_benchmark --mode=profile --format=json\n", path);
+    return -1;
+  }
+  return 0;
+}
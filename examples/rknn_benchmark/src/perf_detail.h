@@ -0,0 +1,82 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_BENCHMARK_PERF_DETAIL_H_
+#define _RKNN_BENCHMARK_PERF_DETAIL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+/*
+  the per-op table of RKNN_QUERY_PERF_DETAIL (contexts made with RKNN_FLAG_COLLECT_PERF_MASK) as records, their
+  median / p99 over many runs, and profiles saved as json to be compared by rknn_perf_diff.
+*/
+
+typedef struct _perf_op
+{
+  int32_t     id;
+  std::string type;
+  std::string data_type;
+  std::string target; // NPU, CPU, GPU ...
+  std::string name;   // FullName, such as Conv:model.0
+  int64_t     time_us;
+} perf_op;
+
+typedef struct _perf_op_summary
+{
+  perf_op op; // time_us is the median
+  int64_t runs;
+  double  mean_us;
+  int64_t p99_us;
+  int64_t max_us;
+} perf_op_summary;
+
+typedef struct _perf_profile_info
+{
+  std::string model;
+  std::string sdk_version;
+  std::string driver_version;
+  uint32_t    core_mask;
+  int64_t     runs;
+  int64_t     total_median_us; // sum of the ops of a run
+  int64_t     total_p99_us;
+} perf_profile_info;
+
+/* rows of the table in text: the columns are found by the names of the header line (ID, OpType, DataType, Target,
+   Time(us), FullName), so extra columns of other SDK versions are skipped. returns 0, or -1 when no table is found. */
+int parse_perf_detail(const char* text, uint64_t len, std::vector<perf_op>* ops);
+
+// the ops of many runs of one model, matched by id
+class PerfProfile
+{
+public:
+  // the ops of one run, -1 when the table does not match the previous runs
+  int  Add(const std::vector<perf_op>& ops);
+  void Summarize(std::vector<perf_op_summary>* ops, perf_profile_info* info) const;
+
+private:
+  std::vector<perf_op>              ops;
+  std::vector<std::vector<int64_t>> samples; // per op, one per run
+  std::vector<int64_t>              totals;
+};
+
+// json: the info, then one op per line, read back by read_perf_profile()
+void write_perf_profile_json(FILE* fp, const perf_profile_info* info, const std::vector<perf_op_summary>& ops);
+void write_perf_profile_csv(FILE* fp, const std::vector<perf_op_summary>& ops);
+int  read_perf_profile(const char* path, perf_profile_info* info, std::vector<perf_op_summary>* ops);
+
+#endif //_RKNN_BENCHMARK_PERF_DETAIL_H_
@@ -15,13 +15,19 @@
 /*-------------------------------------------
                 Includes
 -------------------------------------------*/
+#include "latency_histogram.h"
+#include "perf_detail.h"
 #include "rknn_api.h"
+#include "rknn_input_pack.h"
+#include "rknn_layout.h"
+#include "rknn_topk.h"
 
-#include <float.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
@@ -31,42 +37,115 @@
 #include "cnpy/cnpy.h"
 using namespace cnpy;
 
+#include <algorithm>
+#include <deque>
 
-/*-------------------------------------------
-                  Functions
--------------------------------------------*/
-static inline int64_t getCurrentTimeUs()
+typedef enum _bench_mode
 {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return tv.tv_sec * 1000000 + tv.tv_usec;
-}
-
-static int rknn_GetTopN(float* pfProb, float* pfMaxProb, uint32_t* pMaxClass, uint32_t outputCount, uint32_t topNum)
+  BENCH_LATENCY = 0, // one context, one run at a time
+  BENCH_THROUGHPUT,  // contexts duplicated from the first one, each driven by its own thread
+  BENCH_ASYNC,       // one thread keeping runs in flight on several contexts without blocking in rknn_run
+  BENCH_IO,          // the whole input / run / output cycle of the copy and the zero-copy paths
+  BENCH_PROFILE,     // per-op times of RKNN_QUERY_PERF_DETAIL after every run, median / p99 of each op
+} bench_mode;
+
+typedef enum _async_api
 {
-  uint32_t i, j;
-  uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-  for (i = 0; i < topNum; ++i) {
-    pfMaxProb[i] = -FLT_MAX;
-    pMaxClass[i] = -1;
-  }
+  ASYNC_WAIT = 0, // rknn_run_extend.non_block, rknn_wait on the frame_id, then rknn_outputs_get
+  ASYNC_FLAG,     // contexts made with RKNN_FLAG_ASYNC_MASK, rknn_outputs_get returns the previous frame
+} async_api;
 
-  for (j = 0; j < top_count; j++) {
-    for (i = 0; i < outputCount; i++) {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4))) {
-        continue;
-      }
+typedef enum _report_format
+{
+  REPORT_TEXT = 0,
+  REPORT_JSON,
+  REPORT_CSV,
+} report_format;
 
-      if (pfProb[i] > *(pfMaxProb + j)) {
-        *(pfMaxProb + j) = pfProb[i];
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
+typedef struct _bench_options
+{
+  bench_mode    mode;
+  int           contexts;    // throughput mode
+  const char*   core_masks;  // throughput / async mode, one per context, reused in turn, NULL: the core_mask argument
+  int           inflight;    // async mode, contexts kept busy
+  async_api     api;         // async mode
+  int           cpu_work_us; // async mode, busy CPU time per frame between submit and completion
+  int           warmup;      // untimed runs before the measured ones
+  double        duration_s;  // > 0: run for that long instead of loop_count runs
+  report_format format;
+  const char*   output;  // json / csv report file, NULL: stdout, with the other prints moved to stderr
+  int           verbose; // print every run
+} bench_options;
+
+typedef struct _bench_result
+{
+  std::string      name;
+  uint32_t         core_mask;
+  int64_t          wall_us;
+  LatencyHistogram hist;
+} bench_result;
+
+// throughput workers warm up, then wait for the others so that the measured runs overlap
+typedef struct _bench_gate
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  int             ready;
+  int             open;
+  int64_t         open_us;
+} bench_gate;
+
+typedef struct _bench_worker
+{
+  rknn_context         ctx;
+  int                  loop_count;
+  const bench_options* opts;
+  bench_gate*          gate;
+  bench_result         warmup;
+  bench_result         steady;
+  int                  ret;
+} bench_worker;
+
+typedef enum _io_path
+{
+  IO_NORMAL = 0, // rknn_inputs_set, rknn_outputs_get
+  IO_NHWC,       // NHWC uint8 input and NHWC outputs (RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR) bound with rknn_set_io_mem
+  IO_NATIVE,     // native input packed on the CPU (pass through) and native outputs bound with rknn_set_io_mem
+  IO_PATH_NUM,
+} io_path;
+
+// the context of an io path, its memory bound with rknn_set_io_mem and the layouts to read the outputs as float
+typedef struct _io_binding
+{
+  io_path                         path;
+  rknn_context                    ctx;
+  std::vector<rknn_tensor_attr>   in_attrs;
+  std::vector<rknn_tensor_mem*>   in_mems;
+  rknn_packer*                    packer; // packs the inputs of the native path
+  std::vector<rknn_tensor_mem*>   out_mems;
+  std::vector<rknn_layout>        out_src;
+  std::vector<rknn_layout>        out_dst;
+  std::vector<std::vector<float>> out_float;
+} io_binding;
+
+// an async context and its submitted frames not read back yet, oldest first
+typedef struct _async_slot
+{
+  rknn_context         ctx;
+  std::deque<uint64_t> frame_ids;
+  std::deque<int64_t>  submit_us;
+  std::deque<bool>     warmup; // submitted among the first opts->warmup frames
+} async_slot;
 
-  return 1;
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+// monotonic, so that a clock adjustment during a long run does not show up as a latency
+static inline int64_t getCurrentTimeUs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
 static void dump_tensor_attr(rknn_tensor_attr* attr)
@@ -242,40 +321,993 @@ static std::vector<std::string> split(const std::string& str, const std::string&
   return res;
 }
 
+static void print_usage(char* argv[])
+{
+  printf("Usage:%s model_path [input_path] [loop_count] [core_mask] [--key=value ...]\n", argv[0]);
+  printf("  --mode=latency  latency: one context, one run at a time\n");
+  printf("                  throughput: --contexts contexts, each run by its own thread\n");
+  printf("                  async: --inflight contexts kept busy by one thread\n");
+  printf("                  io: input / run / output time of the normal, zero-copy NHWC and native paths\n");
+  printf("                  profile: per-op times of every run, json / csv is a profile for rknn_perf_diff\n");
+  printf("  --contexts=3    throughput mode, contexts sharing the weights of the first one\n");
+  printf("  --core_masks=   throughput / async mode, core mask of each context, such as 1,2,4\n");
+  printf("  --inflight=2    async mode, runs in flight, one context each\n");
+  printf("  --async_api=wait  async mode, wait: rknn_run non_block + rknn_wait, flag: RKNN_FLAG_ASYNC_MASK\n");
+  printf("  --cpu_work=0    async mode, us of CPU work per frame between submit and completion\n");
+  printf("  --warmup=5      runs before the measured ones, reported apart\n");
+  printf("  --duration=0    seconds to run for instead of loop_count runs\n");
+  printf("  --format=text   report format: text, json or csv\n");
+  printf("  --output=FILE   write the json / csv report to FILE instead of stdout, without it the other prints go to "
+         "stderr\n");
+  printf("  --verbose=0     1: print the time of every run\n");
+}
+
+// --key=value, 0 when taken
+static int parse_option(const char* arg, bench_options* opts)
+{
+  const char* eq = strchr(arg, '=');
+  if (eq == NULL) {
+    return -1;
+  }
+  std::string key(arg + 2, eq - arg - 2);
+  const char* value = eq + 1;
+  if (key == "mode") {
+    if (!strcmp(value, "latency")) {
+      opts->mode = BENCH_LATENCY;
+    } else if (!strcmp(value, "throughput")) {
+      opts->mode = BENCH_THROUGHPUT;
+    } else if (!strcmp(value, "async")) {
+      opts->mode = BENCH_ASYNC;
+    } else if (!strcmp(value, "io")) {
+      opts->mode = BENCH_IO;
+    } else if (!strcmp(value, "profile")) {
+      opts->mode = BENCH_PROFILE;
+    } else {
+      printf("unknown mode %s, ref value: latency, throughput, async, io or profile\n", value);
+      return -1;
+    }
+  } else if (key == "contexts") {
+    opts->contexts = atoi(value);
+  } else if (key == "core_masks") {
+    opts->core_masks = value;
+  } else if (key == "inflight") {
+    opts->inflight = atoi(value);
+  } else if (key == "async_api") {
+    if (!strcmp(value, "wait")) {
+      opts->api = ASYNC_WAIT;
+    } else if (!strcmp(value, "flag")) {
+      opts->api = ASYNC_FLAG;
+    } else {
+      printf("unknown async api %s, ref value: wait or flag\n", value);
+      return -1;
+    }
+  } else if (key == "cpu_work") {
+    opts->cpu_work_us = atoi(value);
+  } else if (key == "warmup") {
+    opts->warmup = atoi(value);
+  } else if (key == "duration") {
+    opts->duration_s = atof(value);
+  } else if (key == "format") {
+    if (!strcmp(value, "text")) {
+      opts->format = REPORT_TEXT;
+    } else if (!strcmp(value, "json")) {
+      opts->format = REPORT_JSON;
+    } else if (!strcmp(value, "csv")) {
+      opts->format = REPORT_CSV;
+    } else {
+      printf("unknown format %s, ref value: text, json or csv\n", value);
+      return -1;
+    }
+  } else if (key == "output") {
+    opts->output = value;
+  } else if (key == "verbose") {
+    opts->verbose = atoi(value);
+  } else {
+    printf("unknown option %s\n", arg);
+    return -1;
+  }
+  return 0;
+}
+
+// count runs, or as many as fit in duration_s when it is set, timed one by one into hist
+static int run_loop(rknn_context ctx, int count, double duration_s, int verbose, bench_result* result)
+{
+  int64_t begin_us = getCurrentTimeUs();
+  int64_t end_us   = begin_us + (int64_t)(duration_s * 1000000);
+  int64_t now_us   = begin_us;
+  for (int i = 0; duration_s > 0 ? now_us < end_us : i < count; ++i) {
+    int64_t start_us = getCurrentTimeUs();
+    int     ret      = rknn_run(ctx, NULL);
+    now_us           = getCurrentTimeUs();
+    if (ret < 0) {
+      printf("rknn run error %d\n", ret);
+      return ret;
+    }
+    int64_t elapse_us = now_us - start_us;
+    result->hist.Record(elapse_us);
+    if (verbose) {
+      printf("%4d: Elapse Time = %.2fms, FPS = %.2f\n", i, elapse_us / 1000.f, 1000.f * 1000.f / elapse_us);
+    }
+  }
+  result->wall_us = getCurrentTimeUs() - begin_us;
+  return 0;
+}
+
+// warmup into (*results)[0], then the measured runs into (*results)[1]
+static int run_latency(rknn_context ctx, int loop_count, const bench_options* opts, std::vector<bench_result>* results)
+{
+  // first runs pay for the lazy allocations and cold caches, so they are kept out of the percentiles
+  printf("Warmup ...\n");
+  int ret = run_loop(ctx, opts->warmup, 0, opts->verbose, &(*results)[0]);
+  if (ret < 0) {
+    return ret;
+  }
+
+  if (opts->duration_s > 0) {
+    printf("Begin perf for %.1f s ...\n", opts->duration_s);
+  } else {
+    printf("Begin perf ...\n");
+  }
+  ret = run_loop(ctx, loop_count, opts->duration_s, opts->verbose, &(*results)[1]);
+  if (ret < 0) {
+    return ret;
+  }
+  if ((*results)[1].hist.Count() > 0) {
+    latency_summary s = (*results)[1].hist.Summarize();
+    printf("\nAvg Time %.2fms, Avg FPS = %.3f\n\n", s.mean_us / 1000, 1000000 / s.mean_us);
+  }
+  return 0;
+}
+
+// all but the first one, which belongs to the caller
+static void destroy_contexts(std::vector<rknn_context>* ctxs)
+{
+  for (size_t i = 1; i < ctxs->size(); ++i) {
+    rknn_destroy((*ctxs)[i]);
+  }
+  ctxs->resize(1);
+}
+
+/* ctx and num - 1 duplicates of it sharing its weights, each with the inputs and the next core mask of
+   opts->core_masks, or core_mask when not given. on an error the duplicates made so far are destroyed. */
+static int create_contexts(rknn_context ctx, int num, uint32_t n_input, rknn_input* inputs, uint32_t core_mask,
+                           const bench_options* opts, std::vector<rknn_context>* ctxs, std::vector<uint32_t>* masks)
+{
+  std::vector<uint32_t> list;
+  if (opts->core_masks != NULL) {
+    std::vector<std::string> items = split(opts->core_masks, ",");
+    for (size_t i = 0; i < items.size(); ++i) {
+      list.push_back(strtoul(items[i].c_str(), NULL, 10));
+    }
+  }
+  if (list.empty()) {
+    list.push_back(core_mask);
+  }
+
+  ctxs->assign(1, ctx);
+  masks->clear();
+  for (int i = 0; i < num; ++i) {
+    if (i > 0) {
+      rknn_context dup = 0;
+      int          ret = rknn_dup_context(&ctx, &dup);
+      if (ret < 0) {
+        printf("rknn_dup_context fail! ret=%d\n", ret);
+        destroy_contexts(ctxs);
+        return ret;
+      }
+      ctxs->push_back(dup);
+      // the inputs belong to the context
+      ret = rknn_inputs_set(dup, n_input, inputs);
+      if (ret < 0) {
+        printf("rknn_input_set fail! ret=%d\n", ret);
+        destroy_contexts(ctxs);
+        return ret;
+      }
+    }
+    masks->push_back(list[i % list.size()]);
+    if (rknn_set_core_mask((*ctxs)[i], (rknn_core_mask)(*masks)[i]) < 0) {
+      printf("rknn_set_core_mask %u fail!\n", (*masks)[i]);
+    }
+  }
+  return 0;
+}
+
+static void* throughput_worker(void* arg)
+{
+  bench_worker* w = (bench_worker*)arg;
+  bench_gate*   g = w->gate;
+  w->ret          = run_loop(w->ctx, w->opts->warmup, 0, w->opts->verbose, &w->warmup);
+  pthread_mutex_lock(&g->mutex);
+  g->ready++;
+  pthread_cond_broadcast(&g->cond);
+  while (!g->open) {
+    pthread_cond_wait(&g->cond, &g->mutex);
+  }
+  pthread_mutex_unlock(&g->mutex);
+  if (w->ret == 0) {
+    w->ret = run_loop(w->ctx, w->loop_count, w->opts->duration_s, w->opts->verbose, &w->steady);
+  }
+  return NULL;
+}
+
+/* ctx and opts->contexts - 1 duplicates of it, each set to its core mask and run by its own thread, loop_count runs
+   or opts->duration_s seconds each. results get the merged warmup, a row per context and the aggregate, whose FPS
+   counts all runs over the time from the start of the measured runs to the end of the last one. */
+static int run_throughput(rknn_context ctx, uint32_t n_input, rknn_input* inputs, uint32_t core_mask, int loop_count,
+                          const bench_options* opts, std::vector<bench_result>* results)
+{
+  int                       num = opts->contexts;
+  std::vector<rknn_context> ctxs;
+  std::vector<uint32_t>     masks;
+  int                       ret = create_contexts(ctx, num, n_input, inputs, core_mask, opts, &ctxs, &masks);
+  if (ret < 0) {
+    return ret;
+  }
+
+  std::vector<bench_worker> workers(num);
+  std::vector<pthread_t>    threads(num);
+  std::vector<int>          started(num, 0);
+  for (int i = 0; i < num; ++i) {
+    bench_worker* w     = &workers[i];
+    w->ctx              = ctxs[i];
+    w->loop_count       = loop_count;
+    w->opts             = opts;
+    w->ret              = 0;
+    w->warmup.name      = "warmup";
+    w->warmup.core_mask = masks[i];
+    w->warmup.wall_us   = 0;
+    w->steady.name      = "ctx" + std::to_string(i);
+    w->steady.core_mask = masks[i];
+    w->steady.wall_us   = 0;
+  }
+
+  bench_gate gate;
+  pthread_mutex_init(&gate.mutex, NULL);
+  pthread_cond_init(&gate.cond, NULL);
+  gate.ready = 0;
+  gate.open  = 0;
+  int spawned = 0;
+  for (int i = 0; i < num && ret == 0; ++i) {
+    workers[i].gate = &gate;
+    if (pthread_create(&threads[i], NULL, throughput_worker, &workers[i]) != 0) {
+      printf("pthread_create fail!\n");
+      ret = -1;
+      break;
+    }
+    started[i] = 1;
+    spawned++;
+  }
+
+  // open the gate when every worker is warm, or at once to let them go on an error
+  pthread_mutex_lock(&gate.mutex);
+  while (ret == 0 && gate.ready < spawned) {
+    pthread_cond_wait(&gate.cond, &gate.mutex);
+  }
+  if (ret == 0) {
+    printf("Begin perf with %d contexts ...\n", num);
+  }
+  gate.open_us = getCurrentTimeUs();
+  gate.open    = 1;
+  pthread_cond_broadcast(&gate.cond);
+  pthread_mutex_unlock(&gate.mutex);
+  for (int i = 0; i < num; ++i) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+      ret = workers[i].ret < 0 ? workers[i].ret : ret;
+    }
+  }
+  int64_t end_us = getCurrentTimeUs();
+  pthread_cond_destroy(&gate.cond);
+  pthread_mutex_destroy(&gate.mutex);
+
+  if (ret == 0) {
+    bench_result warmup, total;
+    warmup.name      = "warmup";
+    warmup.core_mask = 0;
+    warmup.wall_us   = 0;
+    total.name       = "aggregate";
+    total.core_mask  = 0;
+    total.wall_us    = end_us - gate.open_us;
+    results->clear();
+    for (int i = 0; i < num; ++i) {
+      warmup.core_mask |= workers[i].steady.core_mask;
+      warmup.wall_us = workers[i].warmup.wall_us > warmup.wall_us ? workers[i].warmup.wall_us : warmup.wall_us;
+      warmup.hist.Merge(workers[i].warmup.hist);
+      total.core_mask |= workers[i].steady.core_mask;
+      total.hist.Merge(workers[i].steady.hist);
+    }
+    results->push_back(warmup);
+    for (int i = 0; i < num; ++i) {
+      results->push_back(workers[i].steady);
+    }
+    results->push_back(total);
+  }
+  destroy_contexts(&ctxs);
+  return ret;
+}
+
+// stands for the pre / post-processing of a frame
+static void cpu_work(int us)
+{
+  int64_t end_us = getCurrentTimeUs() + us;
+  while (getCurrentTimeUs() < end_us) {
+  }
+}
+
+typedef struct _async_stats
+{
+  bench_result warmup;
+  bench_result e2e;    // submit to outputs read back
+  bench_result submit; // in rknn_run
+  bench_result wait;   // blocked in rknn_wait / rknn_outputs_get, free for other work
+  bench_result fetch;  // rknn_outputs_get after rknn_wait
+  int          completed;
+  int          mismatch;
+  int64_t      steady_us; // end of the warmup
+} async_stats;
+
+// warmup frames are tagged at submit, so that all the rows of a frame go to the same side
+static int async_submit(async_slot* slot, bool warmup, async_stats* st)
+{
+  rknn_run_extend extend;
+  memset(&extend, 0, sizeof(rknn_run_extend));
+  extend.non_block = 1;
+  int64_t start_us = getCurrentTimeUs();
+  int     ret      = rknn_run(slot->ctx, &extend);
+  int64_t end_us   = getCurrentTimeUs();
+  if (ret < 0) {
+    printf("rknn run error %d\n", ret);
+    return ret;
+  }
+  if (!warmup) {
+    st->submit.hist.Record(end_us - start_us);
+  }
+  slot->frame_ids.push_back(extend.frame_id);
+  slot->submit_us.push_back(start_us);
+  slot->warmup.push_back(warmup);
+  return 0;
+}
+
+/* reads back the oldest frame of the slot. ASYNC_WAIT waits for it by frame_id, then gets the outputs, ASYNC_FLAG gets
+   the outputs of the frame before the last submitted one, or only waits for the last one when fetch is 0. either way
+   the frame_id handed back must be the oldest one. */
+static int async_complete(async_slot* slot, uint32_t n_output, rknn_output* outputs, async_api api, int fetch,
+                          int warmup, async_stats* st)
+{
+  uint64_t frame_id = slot->frame_ids.front();
+  int64_t  wait_us  = 0;
+  int64_t  fetch_us = 0;
+  int64_t  start_us = getCurrentTimeUs();
+  int      ret      = 0;
+  if (api == ASYNC_WAIT || !fetch) {
+    rknn_run_extend extend;
+    memset(&extend, 0, sizeof(rknn_run_extend));
+    extend.frame_id = frame_id;
+    ret             = rknn_wait(slot->ctx, &extend);
+    wait_us         = getCurrentTimeUs() - start_us;
+    start_us        = getCurrentTimeUs();
+  }
+  if (ret == 0 && fetch) {
+    rknn_output_extend extend;
+    memset(&extend, 0, sizeof(rknn_output_extend));
+    memset(outputs, 0, n_output * sizeof(rknn_output));
+    for (uint32_t i = 0; i < n_output; ++i) {
+      outputs[i].index = i;
+    }
+    ret = rknn_outputs_get(slot->ctx, n_output, outputs, &extend);
+    if (ret == 0) {
+      rknn_outputs_release(slot->ctx, n_output, outputs);
+      st->mismatch += extend.frame_id != frame_id;
+    }
+    // with the flag the blocking is inside rknn_outputs_get
+    if (api == ASYNC_FLAG) {
+      wait_us = getCurrentTimeUs() - start_us;
+    } else {
+      fetch_us = getCurrentTimeUs() - start_us;
+    }
+  }
+  if (ret < 0) {
+    printf("rknn async read back error %d\n", ret);
+    return ret;
+  }
+  int64_t now_us = getCurrentTimeUs();
+  if (slot->warmup.front()) {
+    st->warmup.hist.Record(now_us - slot->submit_us.front());
+  } else {
+    st->e2e.hist.Record(now_us - slot->submit_us.front());
+    st->wait.hist.Record(wait_us);
+    if (api == ASYNC_WAIT && fetch) {
+      st->fetch.hist.Record(fetch_us);
+    }
+  }
+  // frames complete in submission order, the last warmup one ends the warmup
+  if (++st->completed == warmup) {
+    st->steady_us = now_us;
+  }
+  slot->frame_ids.pop_front();
+  slot->submit_us.pop_front();
+  slot->warmup.pop_front();
+  return 0;
+}
+
+/* ctx and opts->inflight - 1 duplicates of it, fed round robin by the calling thread: each turn reads back the oldest
+   frame of a context and submits the next one to it, then does opts->cpu_work_us of CPU work. e2e latency runs
+   from submit to read back, wait is the time blocked in the runtime: CPU time that pre / post-processing could fill
+   without losing frames. the first opts->warmup frames go to the warmup row. */
+static int run_async(rknn_context ctx, uint32_t n_input, rknn_input* inputs, uint32_t n_output, uint32_t core_mask,
+                     int loop_count, const bench_options* opts, std::vector<bench_result>* results)
+{
+  int                       num = opts->inflight;
+  std::vector<rknn_context> ctxs;
+  std::vector<uint32_t>     masks;
+  int                       ret = create_contexts(ctx, num, n_input, inputs, core_mask, opts, &ctxs, &masks);
+  if (ret < 0) {
+    return ret;
+  }
+  std::vector<async_slot> slots(num);
+  uint32_t                all_masks = 0;
+  for (int i = 0; i < num; ++i) {
+    slots[i].ctx = ctxs[i];
+    all_masks |= masks[i];
+  }
+  std::vector<rknn_output> outputs(n_output);
+
+  async_stats st;
+  st.warmup.name = "warmup";
+  st.e2e.name    = "e2e";
+  st.submit.name = "submit";
+  st.wait.name   = "wait";
+  st.fetch.name  = "fetch";
+  st.completed   = 0;
+  st.mismatch    = 0;
+  st.steady_us   = opts->warmup > 0 ? 0 : getCurrentTimeUs();
+
+  printf("Begin perf with %d contexts in flight ...\n", num);
+  int64_t begin_us  = getCurrentTimeUs();
+  int64_t submitted = 0;
+  for (int64_t n = 0; ret == 0; ++n) {
+    async_slot* slot = &slots[n % num];
+    if (opts->api == ASYNC_WAIT && !slot->frame_ids.empty()) {
+      ret = async_complete(slot, n_output, outputs.data(), opts->api, 1, opts->warmup, &st);
+    }
+    bool stop = opts->duration_s > 0 ? st.steady_us > 0 && getCurrentTimeUs() >= st.steady_us + opts->duration_s * 1000000
+                                     : submitted >= opts->warmup + loop_count;
+    if (ret < 0 || stop) {
+      break;
+    }
+    ret = async_submit(slot, submitted < opts->warmup, &st);
+    submitted += ret == 0;
+    // overlaps the runs in flight
+    cpu_work(opts->cpu_work_us);
+    if (ret == 0 && opts->api == ASYNC_FLAG && slot->frame_ids.size() > 1) {
+      ret = async_complete(slot, n_output, outputs.data(), opts->api, 1, opts->warmup, &st);
+    }
+  }
+  // drain in submission order, the last frame of a flag context has no outputs to get, it is waited for
+  for (int64_t n = submitted; ret == 0 && n < submitted + num; ++n) {
+    async_slot* slot = &slots[n % num];
+    while (ret == 0 && !slot->frame_ids.empty()) {
+      ret = async_complete(slot, n_output, outputs.data(), opts->api, opts->api == ASYNC_WAIT, opts->warmup, &st);
+    }
+  }
+  int64_t end_us = getCurrentTimeUs();
+  destroy_contexts(&ctxs);
+  if (ret < 0) {
+    return ret;
+  }
+  if (st.mismatch) {
+    printf("%d outputs came back with another frame_id!\n", st.mismatch);
+    return -1;
+  }
+
+  st.warmup.core_mask = all_masks;
+  st.warmup.wall_us   = (st.steady_us > 0 ? st.steady_us : end_us) - begin_us;
+  st.e2e.core_mask    = all_masks;
+  st.e2e.wall_us      = st.steady_us > 0 ? end_us - st.steady_us : 0;
+  st.submit.core_mask = all_masks;
+  st.submit.wall_us   = 0;
+  st.wait.core_mask   = all_masks;
+  st.wait.wall_us     = 0;
+  st.fetch.core_mask  = all_masks;
+  st.fetch.wall_us    = 0;
+  results->clear();
+  results->push_back(st.warmup);
+  results->push_back(st.e2e);
+  results->push_back(st.submit);
+  results->push_back(st.wait);
+  if (st.fetch.hist.Count() > 0) {
+    results->push_back(st.fetch);
+  }
+  if (st.e2e.hist.Count() > 0 && st.e2e.wall_us > 0) {
+    latency_summary w = st.wait.hist.Summarize();
+    double          frame_us = (double)st.e2e.wall_us / st.e2e.hist.Count();
+    printf("\n%.2f FPS, cpu free between submit and completion %.3f ms per frame (%.1f%% of the frame time)\n\n",
+           1000000 / frame_us, w.mean_us / 1000, 100 * w.mean_us / frame_us);
+  }
+  return 0;
+}
+
+static const char* get_io_path_string(io_path path)
+{
+  switch (path) {
+  case IO_NORMAL:
+    return "normal";
+  case IO_NHWC:
+    return "zero_copy_nhwc";
+  case IO_NATIVE:
+    return "zero_copy_native";
+  default:
+    return "unknown";
+  }
+}
+
+static void destroy_io_binding(io_binding* b)
+{
+  for (size_t i = 0; i < b->in_mems.size(); ++i) {
+    if (b->in_mems[i] != NULL) {
+      rknn_destroy_mem(b->ctx, b->in_mems[i]);
+    }
+  }
+  for (size_t i = 0; i < b->out_mems.size(); ++i) {
+    if (b->out_mems[i] != NULL) {
+      rknn_destroy_mem(b->ctx, b->out_mems[i]);
+    }
+  }
+  b->in_mems.clear();
+  b->out_mems.clear();
+  rknn_packer_destroy(b->packer);
+  b->packer = NULL;
+}
+
+/* binds the memory of a zero-copy path to b->ctx: NHWC takes the frames as they are (uint8 NHWC, the NPU normalizes
+   and quantizes them), native takes them packed by rknn_pack_input(). outputs are in the layout of the path, with
+   the layouts to convert them to float in the normal layout. returns 0, or -1 when the model does not fit the path. */
+static int create_io_binding(io_binding* b, const rknn_input_output_num* io_num, const rknn_tensor_attr* input_attrs,
+                             const rknn_tensor_attr* output_attrs, const rknn_input* inputs)
+{
+  b->in_attrs.resize(io_num->n_input);
+  b->in_mems.assign(io_num->n_input, NULL);
+  b->out_mems.assign(io_num->n_output, NULL);
+  b->out_src.resize(io_num->n_output);
+  b->out_dst.resize(io_num->n_output);
+  b->out_float.resize(io_num->n_output);
+  if (b->path == IO_NATIVE && rknn_packer_create(1, &b->packer) != 0) {
+    return -1;
+  }
+  for (uint32_t i = 0; i < io_num->n_input; ++i) {
+    if (inputs[i].type != RKNN_TENSOR_UINT8) {
+      printf("%s: input %u is not uint8\n", get_io_path_string(b->path), i);
+      return -1;
+    }
+    rknn_tensor_attr* attr = &b->in_attrs[i];
+    if (b->path == IO_NHWC) {
+      *attr      = input_attrs[i];
+      attr->type = RKNN_TENSOR_UINT8;
+      attr->fmt  = RKNN_TENSOR_NHWC;
+    } else {
+      memset(attr, 0, sizeof(rknn_tensor_attr));
+      attr->index = i;
+      if (rknn_query(b->ctx, RKNN_QUERY_NATIVE_INPUT_ATTR, attr, sizeof(rknn_tensor_attr)) != RKNN_SUCC) {
+        printf("rknn_query fail!\n");
+        return -1;
+      }
+      attr->pass_through = 1;
+    }
+    b->in_mems[i] = rknn_create_mem(b->ctx, attr->size_with_stride);
+    if (b->in_mems[i] == NULL || rknn_set_io_mem(b->ctx, b->in_mems[i], attr) < 0) {
+      printf("%s: rknn_set_io_mem of input %u fail!\n", get_io_path_string(b->path), i);
+      return -1;
+    }
+  }
+  for (uint32_t i = 0; i < io_num->n_output; ++i) {
+    rknn_tensor_attr attr;
+    memset(&attr, 0, sizeof(rknn_tensor_attr));
+    attr.index = i;
+    if (rknn_query(b->ctx, b->path == IO_NHWC ? RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR : RKNN_QUERY_NATIVE_OUTPUT_ATTR,
+                   &attr, sizeof(rknn_tensor_attr)) != RKNN_SUCC) {
+      printf("rknn_query fail!\n");
+      return -1;
+    }
+    b->out_mems[i] = rknn_create_mem(b->ctx, attr.size_with_stride);
+    if (b->out_mems[i] == NULL || rknn_set_io_mem(b->ctx, b->out_mems[i], &attr) < 0) {
+      printf("%s: rknn_set_io_mem of output %u fail!\n", get_io_path_string(b->path), i);
+      return -1;
+    }
+    rknn_layout normal;
+    if (rknn_layout_from_attr(&output_attrs[i], 0, &normal) != 0 ||
+        rknn_layout_from_attr(&attr, normal.c, &b->out_src[i]) != 0) {
+      return -1;
+    }
+    b->out_dst[i]       = normal;
+    b->out_dst[i].type  = RKNN_TENSOR_FLOAT32;
+    b->out_dst[i].zp    = 0;
+    b->out_dst[i].scale = 1.f;
+    b->out_float[i].resize(rknn_layout_size(&b->out_dst[i]) / sizeof(float));
+  }
+  return 0;
+}
+
+// the frame of input i, uint8 NHWC as the normal path gets it, written into the memory of the path
+static int io_write_input(io_binding* b, uint32_t i, const rknn_tensor_attr* input_attr, const rknn_input* input)
+{
+  uint32_t h = input_attr->fmt == RKNN_TENSOR_NCHW ? input_attr->dims[2] : input_attr->dims[1];
+  uint32_t w = input_attr->fmt == RKNN_TENSOR_NCHW ? input_attr->dims[3] : input_attr->dims[2];
+  uint32_t c = input_attr->fmt == RKNN_TENSOR_NCHW ? input_attr->dims[1] : input_attr->dims[3];
+  if (b->path == IO_NATIVE) {
+    // mean / std of the model are not known here, they cost the same
+    rknn_pack_frame frame;
+    memset(&frame, 0, sizeof(rknn_pack_frame));
+    frame.fmt    = RKNN_PACK_RGB888;
+    frame.width  = w;
+    frame.height = h;
+    frame.data   = input->buf;
+    return c == 3 ? rknn_pack_input(b->packer, &b->in_attrs[i], &frame, NULL, NULL, b->in_mems[i]) : -1;
+  }
+  // rows padded to w_stride
+  uint32_t       stride = b->in_attrs[i].w_stride > w ? b->in_attrs[i].w_stride : w;
+  const uint8_t* src    = (const uint8_t*)input->buf;
+  uint8_t*       dst    = (uint8_t*)b->in_mems[i]->virt_addr;
+  if (stride == w) {
+    memcpy(dst, src, (size_t)h * w * c);
+    return 0;
+  }
+  for (uint32_t y = 0; y < h; ++y) {
+    memcpy(dst + (size_t)y * stride * c, src + (size_t)y * w * c, (size_t)w * c);
+  }
+  return 0;
+}
+
+// one frame of b->path, the time of its input / run / output stages in stage_us
+static int io_frame(io_binding* b, int want_float, const rknn_input_output_num* io_num,
+                    const rknn_tensor_attr* input_attrs, rknn_input* inputs, rknn_output* outputs, int64_t* stage_us)
+{
+  int64_t t0  = getCurrentTimeUs();
+  int     ret = 0;
+  if (b->path == IO_NORMAL) {
+    ret = rknn_inputs_set(b->ctx, io_num->n_input, inputs);
+  } else {
+    for (uint32_t i = 0; i < io_num->n_input && ret == 0; ++i) {
+      ret = io_write_input(b, i, &input_attrs[i], &inputs[i]);
+    }
+  }
+  int64_t t1 = getCurrentTimeUs();
+  if (ret == 0) {
+    ret = rknn_run(b->ctx, NULL);
+  }
+  int64_t t2 = getCurrentTimeUs();
+  if (ret == 0 && b->path == IO_NORMAL) {
+    memset(outputs, 0, io_num->n_output * sizeof(rknn_output));
+    for (uint32_t i = 0; i < io_num->n_output; ++i) {
+      outputs[i].index      = i;
+      outputs[i].want_float = want_float;
+    }
+    ret = rknn_outputs_get(b->ctx, io_num->n_output, outputs, NULL);
+    if (ret == 0) {
+      rknn_outputs_release(b->ctx, io_num->n_output, outputs);
+    }
+  } else if (ret == 0 && want_float) {
+    for (uint32_t i = 0; i < io_num->n_output && ret == 0; ++i) {
+      ret = rknn_convert_layout(&b->out_src[i], b->out_mems[i]->virt_addr, &b->out_dst[i], b->out_float[i].data(), 1);
+    }
+  }
+  int64_t t3  = getCurrentTimeUs();
+  stage_us[0] = t1 - t0;
+  stage_us[1] = t2 - t1;
+  stage_us[2] = t3 - t2;
+  return ret;
+}
+
+/* the normal path with want_float 1 / 0, then the zero-copy NHWC and native paths with the outputs converted to
+   float in the normal layout (rknn_convert_layout() on one thread) or left as the NPU wrote them. each on its own
+   context, opts->warmup frames, then loop_count frames or opts->duration_s seconds. a frame is timed from the uint8
+   NHWC input in CPU memory to the outputs readable by the post-process. results get a row per path and its input /
+   run / output stages. */
+static int run_io(rknn_context ctx, const rknn_input_output_num* io_num, const rknn_tensor_attr* input_attrs,
+                  const rknn_tensor_attr* output_attrs, rknn_input* inputs, uint32_t core_mask, int loop_count,
+                  const bench_options* opts, std::vector<bench_result>* results)
+{
+  std::vector<rknn_context> ctxs;
+  std::vector<uint32_t>     masks;
+  int ret = create_contexts(ctx, IO_PATH_NUM, io_num->n_input, inputs, core_mask, opts, &ctxs, &masks);
+  if (ret < 0) {
+    return ret;
+  }
+  std::vector<io_binding> bindings(IO_PATH_NUM);
+  for (int p = 0; p < IO_PATH_NUM; ++p) {
+    bindings[p].path   = (io_path)p;
+    bindings[p].ctx    = ctxs[p];
+    bindings[p].packer = NULL;
+  }
+  std::vector<rknn_output> outputs(io_num->n_output);
+
+  results->clear();
+  bench_result warmup;
+  warmup.name      = "warmup";
+  warmup.core_mask = masks[0];
+  warmup.wall_us   = 0;
+  results->push_back(warmup);
+  const char* stage_names[3] = {"input", "run", "output"};
+  printf("%-24s %10s %10s %10s %10s %10s\n", "path", "input ms", "run ms", "output ms", "total ms", "saved ms");
+  double normal_ms = 0;
+  for (int p = 0; p < IO_PATH_NUM && ret == 0; ++p) {
+    io_binding* b = &bindings[p];
+    if (p != IO_NORMAL && create_io_binding(b, io_num, input_attrs, output_attrs, inputs) != 0) {
+      printf("%-24s skipped\n", get_io_path_string(b->path));
+      continue;
+    }
+    for (int want_float = 1; want_float >= 0 && ret == 0; --want_float) {
+      std::string  name = std::string(get_io_path_string(b->path)) + (want_float ? "_float" : "_raw");
+      bench_result total, stages[3];
+      total.name      = name;
+      total.core_mask = masks[p];
+      for (int s = 0; s < 3; ++s) {
+        stages[s].name      = name + "/" + stage_names[s];
+        stages[s].core_mask = masks[p];
+        stages[s].wall_us   = 0;
+      }
+      int64_t stage_us[3];
+      for (int i = 0; i < opts->warmup && ret == 0; ++i) {
+        ret = io_frame(b, want_float, io_num, input_attrs, inputs, outputs.data(), stage_us);
+        (*results)[0].hist.Record(stage_us[0] + stage_us[1] + stage_us[2]);
+      }
+      int64_t begin_us = getCurrentTimeUs();
+      int64_t end_us   = begin_us + (int64_t)(opts->duration_s * 1000000);
+      int64_t now_us   = begin_us;
+      for (int i = 0; ret == 0 && (opts->duration_s > 0 ? now_us < end_us : i < loop_count); ++i) {
+        ret = io_frame(b, want_float, io_num, input_attrs, inputs, outputs.data(), stage_us);
+        total.hist.Record(stage_us[0] + stage_us[1] + stage_us[2]);
+        for (int s = 0; s < 3; ++s) {
+          stages[s].hist.Record(stage_us[s]);
+        }
+        now_us = getCurrentTimeUs();
+      }
+      total.wall_us = now_us - begin_us;
+      if (ret < 0) {
+        printf("%s: frame fail! ret=%d\n", name.c_str(), ret);
+        break;
+      }
+      double mean_ms[3];
+      for (int s = 0; s < 3; ++s) {
+        mean_ms[s] = stages[s].hist.Summarize().mean_us / 1000;
+      }
+      double total_ms = total.hist.Summarize().mean_us / 1000;
+      normal_ms       = p == IO_NORMAL && want_float ? total_ms : normal_ms;
+      printf("%-24s %10.3f %10.3f %10.3f %10.3f %10.3f\n", name.c_str(), mean_ms[0], mean_ms[1], mean_ms[2], total_ms,
+             normal_ms - total_ms);
+      results->push_back(total);
+      for (int s = 0; s < 3; ++s) {
+        results->push_back(stages[s]);
+      }
+    }
+  }
+  printf("saved ms: against normal_float, per frame\n\n");
+  for (int p = 0; p < IO_PATH_NUM; ++p) {
+    destroy_io_binding(&bindings[p]);
+  }
+  destroy_contexts(&ctxs);
+  return ret;
+}
+
+/* the per-op table of every measured run into profile, a context made with RKNN_FLAG_COLLECT_PERF_MASK. runs are
+   timed into (*results)[1] as in latency mode, the time the runtime reports for them (RKNN_QUERY_PERF_RUN) into
+   (*results)[2]; collecting perf slows the runs down, so they are no latency figure to compare with other modes. */
+static int run_profile(rknn_context ctx, int loop_count, const bench_options* opts, std::vector<bench_result>* results,
+                       PerfProfile* profile)
+{
+  printf("Warmup ...\n");
+  int ret = run_loop(ctx, opts->warmup, 0, opts->verbose, &(*results)[0]);
+  if (ret < 0) {
+    return ret;
+  }
+
+  printf("Begin profile ...\n");
+  bench_result&        steady   = (*results)[1];
+  bench_result&        npu      = (*results)[2];
+  int64_t              begin_us = getCurrentTimeUs();
+  int64_t              end_us   = begin_us + (int64_t)(opts->duration_s * 1000000);
+  int64_t              now_us   = begin_us;
+  std::vector<perf_op> ops;
+  for (int i = 0; opts->duration_s > 0 ? now_us < end_us : i < loop_count; ++i) {
+    int64_t start_us = getCurrentTimeUs();
+    ret              = rknn_run(ctx, NULL);
+    now_us           = getCurrentTimeUs();
+    if (ret < 0) {
+      printf("rknn run error %d\n", ret);
+      return ret;
+    }
+    steady.hist.Record(now_us - start_us);
+
+    rknn_perf_run perf_run;
+    if (rknn_query(ctx, RKNN_QUERY_PERF_RUN, &perf_run, sizeof(perf_run)) == RKNN_SUCC) {
+      npu.hist.Record(perf_run.run_duration);
+    }
+    // perf_data belongs to the context and is rewritten by the next run
+    rknn_perf_detail detail;
+    ret = rknn_query(ctx, RKNN_QUERY_PERF_DETAIL, &detail, sizeof(detail));
+    if (ret != RKNN_SUCC) {
+      printf("rknn_query perf detail fail! ret=%d\n", ret);
+      return -1;
+    }
+    if (parse_perf_detail(detail.perf_data, detail.data_len, &ops) != 0 || ops.empty()) {
+      printf("no per-op table in the perf detail:\n%.*s\n", (int)detail.data_len, detail.perf_data);
+      return -1;
+    }
+    if (profile->Add(ops) != 0) {
+      printf("run %d: the per-op table does not match the previous runs\n", i);
+      return -1;
+    }
+    if (opts->verbose) {
+      printf("%4d: Elapse Time = %.2fms, %zu ops\n", i, (now_us - start_us) / 1000.f, ops.size());
+    }
+    now_us = getCurrentTimeUs();
+  }
+  steady.wall_us = now_us - begin_us;
+  return 0;
+}
+
+// the ops taking the most time, by median
+static void print_profile_ops(const std::vector<perf_op_summary>& ops, const perf_profile_info* info, size_t top)
+{
+  std::vector<size_t> order(ops.size());
+  for (size_t i = 0; i < ops.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&ops](size_t a, size_t b) { return ops[a].op.time_us > ops[b].op.time_us; });
+  top = top < ops.size() ? top : ops.size();
+
+  printf("\n%zu ops, total op time median %lld us, p99 %lld us over %lld runs, top %zu by median:\n", ops.size(),
+         (long long)info->total_median_us, (long long)info->total_p99_us, (long long)info->runs, top);
+  printf("%-5s %-18s %-6s %10s %10s %10s %7s  %s\n", "ID", "OpType", "Target", "median_us", "p99_us", "mean_us",
+         "share", "FullName");
+  for (size_t i = 0; i < top; ++i) {
+    const perf_op_summary& s = ops[order[i]];
+    double                 share = info->total_median_us > 0 ? 100. * s.op.time_us / info->total_median_us : 0;
+    printf("%-5d %-18s %-6s %10lld %10lld %10.1f %6.1f%%  %s\n", s.op.id, s.op.type.c_str(), s.op.target.c_str(),
+           (long long)s.op.time_us, (long long)s.p99_us, s.mean_us, share, s.op.name.c_str());
+  }
+}
+
+static void print_json_string(FILE* fp, const char* str)
+{
+  fputc('"', fp);
+  for (; *str; ++str) {
+    if (*str == '"' || *str == '\\') {
+      fputc('\\', fp);
+    }
+    fputc(*str, fp);
+  }
+  fputc('"', fp);
+}
+
+static void print_report(FILE* fp, report_format format, const char* model_path, bench_mode mode,
+                         const std::vector<bench_result>& results)
+{
+  const char* mode_names[] = {"latency", "throughput", "async", "io", "profile"};
+  const char* mode_str     = mode_names[mode];
+  if (format == REPORT_CSV) {
+    fprintf(fp, "mode,name,core_mask,runs,seconds,fps,mean_ms,stddev_ms,min_ms,p50_ms,p90_ms,p99_ms,p999_ms,max_ms\n");
+  } else if (format == REPORT_JSON) {
+    fprintf(fp, "{\n  \"model\": ");
+    print_json_string(fp, model_path);
+    fprintf(fp, ",\n  \"mode\": \"%s\",\n  \"results\": [", mode_str);
+  }
+  for (size_t i = 0; i < results.size(); ++i) {
+    const bench_result& r   = results[i];
+    latency_summary     s   = r.hist.Summarize();
+    double              sec = r.wall_us / 1e6;
+    double              fps = r.wall_us > 0 ? s.count / sec : 0;
+    if (format == REPORT_CSV) {
+      fprintf(fp, "%s,%s,%u,%lld,%.3f,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", mode_str, r.name.c_str(),
+              r.core_mask, (long long)s.count, sec, fps, s.mean_us / 1000, s.stddev_us / 1000, s.min_us / 1000.,
+              s.p50_us / 1000., s.p90_us / 1000., s.p99_us / 1000., s.p999_us / 1000., s.max_us / 1000.);
+    } else if (format == REPORT_JSON) {
+      fprintf(fp,
+              "%s\n    {\"name\": \"%s\", \"core_mask\": %u, \"runs\": %lld, \"seconds\": %.3f, \"fps\": %.2f, "
+              "\"latency_ms\": {\"mean\": %.3f, \"stddev\": %.3f, \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, "
+              "\"p99.9\": %.3f, \"max\": %.3f}}",
+              i ? "," : "", r.name.c_str(), r.core_mask, (long long)s.count, sec, fps, s.mean_us / 1000, s.stddev_us / 1000,
+              s.min_us / 1000., s.p50_us / 1000., s.p90_us / 1000., s.p99_us / 1000., s.p999_us / 1000.,
+              s.max_us / 1000.);
+    } else {
+      // rows of a part of each run (async submit / wait / fetch, io stages) have no wall time of their own
+      if (r.wall_us > 0) {
+        fprintf(fp, "%-9s core_mask %u, %6lld runs in %8.3f s, %9.2f FPS\n", r.name.c_str(), r.core_mask,
+                (long long)s.count, sec, fps);
+      } else {
+        fprintf(fp, "%-9s core_mask %u, %6lld runs\n", r.name.c_str(), r.core_mask, (long long)s.count);
+      }
+      fprintf(fp,
+              "          latency ms: avg %.3f, std %.3f, min %.3f, p50 %.3f, p90 %.3f, p99 %.3f, p99.9 %.3f, max %.3f\n",
+              s.mean_us / 1000, s.stddev_us / 1000, s.min_us / 1000., s.p50_us / 1000., s.p90_us / 1000.,
+              s.p99_us / 1000., s.p999_us / 1000., s.max_us / 1000.);
+    }
+  }
+  if (format == REPORT_JSON) {
+    fprintf(fp, "\n  ]\n}\n");
+  }
+}
+
 /*-------------------------------------------
                   Main Functions
 -------------------------------------------*/
 int main(int argc, char* argv[])
 {
-  if (argc < 2) {
-    printf("Usage:%s model_path [input_path] [loop_count] [core_mask]\n", argv[0]);
+  bench_options opts;
+  memset(&opts, 0, sizeof(bench_options));
+  opts.mode     = BENCH_LATENCY;
+  opts.contexts = 3;
+  opts.inflight = 2;
+  opts.api      = ASYNC_WAIT;
+  opts.warmup   = 5;
+  opts.format   = REPORT_TEXT;
+
+  // positional arguments as before, --key=value options anywhere
+  std::vector<char*> args;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+      print_usage(argv);
+      return 0;
+    }
+    if (!strncmp(argv[i], "--", 2)) {
+      if (parse_option(argv[i], &opts) != 0) {
+        print_usage(argv);
+        return -1;
+      }
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (args.size() < 1 || opts.contexts < 1 || opts.inflight < 1) {
+    print_usage(argv);
     return -1;
   }
 
-  char* model_path = argv[1];
+  // a json / csv report on stdout stays alone there, so that it can be piped: the printf of the text goes to stderr
+  FILE* report_fp = stdout;
+  if (opts.format != REPORT_TEXT && opts.output == NULL) {
+    fflush(stdout);
+    int fd    = dup(STDOUT_FILENO);
+    report_fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (report_fp == NULL || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+      fprintf(stderr, "redirect stdout fail!\n");
+      return -1;
+    }
+  }
+
+  char* model_path = args[0];
   std::vector<std::string> input_paths_split;
   int loop_count = 10;
   uint32_t core_mask = 1;
   rknn_context ctx = 0;
   uint32_t topNum = 5;
-  double total_time = 0;
-
-  if (argc > 2) {
-    char* input_paths = argv[2];
+  std::vector<bench_result> results(2);
+  results[0].name = "warmup";
+  results[1].name = "steady";
+  PerfProfile                  profile;
+  std::vector<perf_op_summary> profile_ops;
+  perf_profile_info            profile_info;
+
+  if (args.size() > 1) {
+    char* input_paths = args[1];
     input_paths_split = split(input_paths, "#");
   }
 
-  if (argc > 3) {
-    loop_count = atoi(argv[3]);
+  if (args.size() > 2) {
+    loop_count = atoi(args[2]);
   }
 
-  if (argc > 4) {
-    core_mask = strtoul(argv[4], NULL, 10);
+  if (args.size() > 3) {
+    core_mask = strtoul(args[3], NULL, 10);
   }
+  results[0].core_mask = core_mask;
+  results[1].core_mask = core_mask;
 
 
   // Init rknn from model path
-  int ret = rknn_init(&ctx, model_path, 0, 0, NULL);
+  uint32_t flag = opts.mode == BENCH_ASYNC && opts.api == ASYNC_FLAG ? RKNN_FLAG_ASYNC_MASK : 0;
+  flag |= opts.mode == BENCH_PROFILE ? RKNN_FLAG_COLLECT_PERF_MASK : 0;
+  int      ret  = rknn_init(&ctx, model_path, 0, flag, NULL);
 
   if (ret < 0) {
     printf("rknn_init fail! ret=%d\n", ret);
@@ -412,34 +1444,58 @@ int main(int argc, char* argv[])
 
   rknn_set_core_mask(ctx, (rknn_core_mask)core_mask);
 
-  // Warmup
-  printf("Warmup ...\n");
-  for (int i = 0; i < 5; ++i) {
-    int64_t start_us  = getCurrentTimeUs();
-    ret               = rknn_run(ctx, NULL);
-    int64_t elapse_us = getCurrentTimeUs() - start_us;
-    if (ret < 0) {
-      printf("rknn run error %d\n", ret);
-      goto out;
-    }
-    printf("%4d: Elapse Time = %.2fms, FPS = %.2f\n", i, elapse_us / 1000.f, 1000.f * 1000.f / elapse_us);
-  }
-
-
   // Run
-  printf("Begin perf ...\n");
-  for (int i = 0; i < loop_count; ++i) {
-    int64_t start_us  = getCurrentTimeUs();
-    ret               = rknn_run(ctx, NULL);
-    int64_t elapse_us = getCurrentTimeUs() - start_us;
-    if (ret < 0) {
-      printf("rknn run error %d\n", ret);
-      return -1;
+  if (opts.mode == BENCH_THROUGHPUT) {
+    printf("Warmup ...\n");
+    ret = run_throughput(ctx, io_num.n_input, inputs, core_mask, loop_count, &opts, &results);
+  } else if (opts.mode == BENCH_ASYNC) {
+    ret = run_async(ctx, io_num.n_input, inputs, io_num.n_output, core_mask, loop_count, &opts, &results);
+  } else if (opts.mode == BENCH_IO) {
+    printf("Begin perf of the io paths ...\n");
+    ret = run_io(ctx, &io_num, input_attrs, output_attrs, inputs, core_mask, loop_count, &opts, &results);
+  } else if (opts.mode == BENCH_PROFILE) {
+    results.resize(3);
+    results[2].name      = "npu";
+    results[2].core_mask = core_mask;
+    ret                  = run_profile(ctx, loop_count, &opts, &results, &profile);
+  } else {
+    ret = run_latency(ctx, loop_count, &opts, &results);
+  }
+  if (ret < 0) {
+    goto out;
+  }
+  print_report(stdout, REPORT_TEXT, model_path, opts.mode, results);
+  if (opts.mode == BENCH_PROFILE) {
+    profile.Summarize(&profile_ops, &profile_info);
+    profile_info.model          = model_path;
+    profile_info.sdk_version    = sdk_ver.api_version;
+    profile_info.driver_version = sdk_ver.drv_version;
+    profile_info.core_mask      = core_mask;
+    print_profile_ops(profile_ops, &profile_info, 20);
+  }
+  if (opts.format != REPORT_TEXT) {
+    FILE* fp = opts.output ? fopen(opts.output, "w") : report_fp;
+    if (fp == NULL) {
+      printf("open %s fail!\n", opts.output);
+    } else if (opts.mode == BENCH_PROFILE) {
+      if (opts.format == REPORT_JSON) {
+        write_perf_profile_json(fp, &profile_info, profile_ops);
+      } else {
+        write_perf_profile_csv(fp, profile_ops);
+      }
+      if (fp != report_fp) {
+        fclose(fp);
+        printf("Save profile to %s\n", opts.output);
+      }
+    } else {
+      print_report(fp, opts.format, model_path, opts.mode, results);
+      if (fp != report_fp) {
+        fclose(fp);
+        printf("Save report to %s\n", opts.output);
+      }
     }
-    total_time += elapse_us / 1000.f;
-    printf("%4d: Elapse Time = %.2fms, FPS = %.2f\n", i, elapse_us / 1000.f, 1000.f * 1000.f / elapse_us);
   }
-  printf("\nAvg Time %.2fms, Avg FPS = %.3f\n\n", total_time/loop_count, loop_count * 1000.f / total_time);
+  printf("\n");
 
   // Get output
   memset(outputs, 0, io_num.n_output * sizeof(rknn_output));
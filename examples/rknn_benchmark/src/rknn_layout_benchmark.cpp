@@ -0,0 +1,305 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  cost of getting float outputs in the normal layout:
+  - rknn_outputs_get() with want_float = 1, the conversion done by the runtime
+  - native outputs bound with rknn_set_io_mem(), converted by an element by element loop
+  - the same native outputs converted by rknn_convert_layout() (utils/rknn_layout.h) on 1..N threads
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "rknn_api.h"
+#include "rknn_layout.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int query_io(rknn_context ctx, rknn_query_cmd in_cmd, rknn_query_cmd out_cmd, rknn_input_output_num* io_num,
+                    std::vector<rknn_tensor_attr>& input_attrs, std::vector<rknn_tensor_attr>& output_attrs)
+{
+  int ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, io_num, sizeof(rknn_input_output_num));
+  if (ret != RKNN_SUCC) {
+    printf("rknn_query fail! ret=%d\n", ret);
+    return -1;
+  }
+  input_attrs.resize(io_num->n_input);
+  output_attrs.resize(io_num->n_output);
+  for (uint32_t i = 0; i < io_num->n_input; i++) {
+    memset(&input_attrs[i], 0, sizeof(rknn_tensor_attr));
+    input_attrs[i].index = i;
+    ret                  = rknn_query(ctx, in_cmd, &input_attrs[i], sizeof(rknn_tensor_attr));
+    if (ret != RKNN_SUCC) {
+      printf("rknn_query fail! ret=%d\n", ret);
+      return -1;
+    }
+  }
+  for (uint32_t i = 0; i < io_num->n_output; i++) {
+    memset(&output_attrs[i], 0, sizeof(rknn_tensor_attr));
+    output_attrs[i].index = i;
+    ret                   = rknn_query(ctx, out_cmd, &output_attrs[i], sizeof(rknn_tensor_attr));
+    if (ret != RKNN_SUCC) {
+      printf("rknn_query fail! ret=%d\n", ret);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static size_t layout_offset(const rknn_layout* l, uint32_t n, uint32_t c, uint32_t h, uint32_t w)
+{
+  size_t hw = (size_t)l->h * l->w;
+  size_t p  = (size_t)h * l->w + w;
+  if (l->fmt == RKNN_TENSOR_NCHW) {
+    return ((size_t)n * l->c + c) * hw + p;
+  }
+  if (l->fmt == RKNN_TENSOR_NHWC) {
+    uint32_t ca = l->c_align ? l->c_align : l->c;
+    return ((size_t)n * hw + p) * ca + c;
+  }
+  uint32_t c2 = l->c_align ? l->c_align : rknn_layout_default_c2(l->type);
+  uint32_t c1 = (l->c + c2 - 1) / c2;
+  return (((size_t)n * c1 + c / c2) * hw + p) * c2 + c % c2;
+}
+
+// element by element reference, what each application used to write by hand
+static void reference_convert(const rknn_layout* src, const void* src_data, const rknn_layout* dst, float* dst_data)
+{
+  for (uint32_t n = 0; n < src->n; n++) {
+    for (uint32_t c = 0; c < src->c; c++) {
+      for (uint32_t h = 0; h < src->h; h++) {
+        for (uint32_t w = 0; w < src->w; w++) {
+          size_t s = layout_offset(src, n, c, h, w);
+          float  v;
+          if (src->type == RKNN_TENSOR_INT8) {
+            v = (((const int8_t*)src_data)[s] - src->zp) * src->scale;
+          } else if (src->type == RKNN_TENSOR_UINT8) {
+            v = (((const uint8_t*)src_data)[s] - src->zp) * src->scale;
+          } else if (src->type == RKNN_TENSOR_FLOAT32) {
+            v = ((const float*)src_data)[s];
+          } else {
+            // fp16, through a 1 element conversion
+            rknn_layout one = {RKNN_TENSOR_NCHW, RKNN_TENSOR_FLOAT16, 1, 1, 1, 1, 0, 0, 1.f};
+            rknn_layout f32 = one;
+            f32.type        = RKNN_TENSOR_FLOAT32;
+            rknn_convert_layout(&one, (const uint16_t*)src_data + s, &f32, &v, 1);
+          }
+          dst_data[layout_offset(dst, n, c, h, w)] = v;
+        }
+      }
+    }
+  }
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    printf("Usage:%s model_path [loop_count=100] [threads=1,2,4]\n", argv[0]);
+    return -1;
+  }
+
+  char*            model_path = argv[1];
+  int              loop_count = argc > 2 ? atoi(argv[2]) : 100;
+  std::vector<int> thread_counts;
+  std::string      threads_arg = argc > 3 ? argv[3] : "1,2,4";
+  for (size_t begin = 0; begin < threads_arg.size();) {
+    size_t end = threads_arg.find(',', begin);
+    end        = end == std::string::npos ? threads_arg.size() : end;
+    int n      = atoi(threads_arg.substr(begin, end - begin).c_str());
+    if (n > 0) {
+      thread_counts.push_back(n);
+    }
+    begin = end + 1;
+  }
+  if (loop_count <= 0 || thread_counts.empty()) {
+    printf("loop_count and threads must be > 0\n");
+    return -1;
+  }
+
+  // context A: normal outputs, converted to float by rknn_outputs_get()
+  rknn_context ctx_a = 0;
+  int          ret   = rknn_init(&ctx_a, model_path, 0, 0, NULL);
+  if (ret < 0) {
+    printf("rknn_init fail! ret=%d\n", ret);
+    return -1;
+  }
+  rknn_input_output_num         io_num;
+  std::vector<rknn_tensor_attr> input_attrs, output_attrs;
+  if (query_io(ctx_a, RKNN_QUERY_INPUT_ATTR, RKNN_QUERY_OUTPUT_ATTR, &io_num, input_attrs, output_attrs) != 0) {
+    return -1;
+  }
+
+  std::vector<std::vector<uint8_t>> input_data(io_num.n_input);
+  std::vector<rknn_input>           inputs(io_num.n_input);
+  for (uint32_t i = 0; i < io_num.n_input; i++) {
+    input_data[i].assign(input_attrs[i].size, 0);
+    memset(&inputs[i], 0, sizeof(rknn_input));
+    inputs[i].index = i;
+    inputs[i].type  = input_attrs[i].type;
+    inputs[i].fmt   = input_attrs[i].fmt;
+    inputs[i].buf   = input_data[i].data();
+    inputs[i].size  = input_attrs[i].size;
+  }
+  ret = rknn_inputs_set(ctx_a, io_num.n_input, inputs.data());
+  if (ret < 0) {
+    printf("rknn_inputs_set fail! ret=%d\n", ret);
+    return -1;
+  }
+  ret = rknn_run(ctx_a, NULL);
+  if (ret < 0) {
+    printf("rknn_run fail! ret=%d\n", ret);
+    return -1;
+  }
+
+  // context B: native outputs in memory bound with rknn_set_io_mem()
+  rknn_context ctx_b = 0;
+  ret                = rknn_init(&ctx_b, model_path, 0, 0, NULL);
+  if (ret < 0) {
+    printf("rknn_init fail! ret=%d\n", ret);
+    return -1;
+  }
+  std::vector<rknn_tensor_attr> native_input_attrs, native_output_attrs;
+  if (query_io(ctx_b, RKNN_QUERY_INPUT_ATTR, RKNN_QUERY_NATIVE_OUTPUT_ATTR, &io_num, native_input_attrs,
+               native_output_attrs) != 0) {
+    return -1;
+  }
+  std::vector<rknn_tensor_mem*> input_mems(io_num.n_input), output_mems(io_num.n_output);
+  for (uint32_t i = 0; i < io_num.n_input; i++) {
+    input_mems[i] = rknn_create_mem(ctx_b, native_input_attrs[i].size_with_stride);
+    memset(input_mems[i]->virt_addr, 0, native_input_attrs[i].size_with_stride);
+    ret = rknn_set_io_mem(ctx_b, input_mems[i], &native_input_attrs[i]);
+    if (ret < 0) {
+      printf("rknn_set_io_mem fail! ret=%d\n", ret);
+      return -1;
+    }
+  }
+  for (uint32_t i = 0; i < io_num.n_output; i++) {
+    output_mems[i] = rknn_create_mem(ctx_b, native_output_attrs[i].size_with_stride);
+    ret            = rknn_set_io_mem(ctx_b, output_mems[i], &native_output_attrs[i]);
+    if (ret < 0) {
+      printf("rknn_set_io_mem fail! ret=%d\n", ret);
+      return -1;
+    }
+  }
+  ret = rknn_run(ctx_b, NULL);
+  if (ret < 0) {
+    printf("rknn_run fail! ret=%d\n", ret);
+    return -1;
+  }
+
+  // layouts: native source, float destination in the layout of the normal output
+  std::vector<rknn_layout>        src_layouts(io_num.n_output), dst_layouts(io_num.n_output);
+  std::vector<std::vector<float>> converted(io_num.n_output);
+  for (uint32_t i = 0; i < io_num.n_output; i++) {
+    rknn_layout normal;
+    if (rknn_layout_from_attr(&output_attrs[i], 0, &normal) != 0 ||
+        rknn_layout_from_attr(&native_output_attrs[i], normal.c, &src_layouts[i]) != 0) {
+      return -1;
+    }
+    dst_layouts[i]       = normal;
+    dst_layouts[i].type  = RKNN_TENSOR_FLOAT32;
+    dst_layouts[i].zp    = 0;
+    dst_layouts[i].scale = 1.f;
+    converted[i].resize(rknn_layout_size(&dst_layouts[i]) / sizeof(float));
+    printf("output %u: %s %s -> %s float32, %u x %u x %u x %u\n", i, get_format_string(native_output_attrs[i].fmt),
+           get_type_string(native_output_attrs[i].type), get_format_string(output_attrs[i].fmt), normal.n, normal.c,
+           normal.h, normal.w);
+  }
+
+  // want_float = 1
+  std::vector<rknn_output> outputs(io_num.n_output);
+  int64_t                  start_us = getCurrentTimeUs();
+  for (int l = 0; l < loop_count; l++) {
+    memset(outputs.data(), 0, io_num.n_output * sizeof(rknn_output));
+    for (uint32_t i = 0; i < io_num.n_output; i++) {
+      outputs[i].want_float = 1;
+      outputs[i].index      = i;
+    }
+    ret = rknn_outputs_get(ctx_a, io_num.n_output, outputs.data(), NULL);
+    if (ret < 0) {
+      printf("rknn_outputs_get fail! ret=%d\n", ret);
+      return -1;
+    }
+    if (l + 1 < loop_count) {
+      rknn_outputs_release(ctx_a, io_num.n_output, outputs.data());
+    }
+  }
+  printf("rknn_outputs_get(want_float=1): %10.1f us/frame\n", (double)(getCurrentTimeUs() - start_us) / loop_count);
+
+  // element by element
+  start_us = getCurrentTimeUs();
+  for (int l = 0; l < loop_count; l++) {
+    for (uint32_t i = 0; i < io_num.n_output; i++) {
+      reference_convert(&src_layouts[i], output_mems[i]->virt_addr, &dst_layouts[i], converted[i].data());
+    }
+  }
+  printf("element by element loop:        %10.1f us/frame\n", (double)(getCurrentTimeUs() - start_us) / loop_count);
+
+  // rknn_convert_layout
+  for (size_t t = 0; t < thread_counts.size(); t++) {
+    start_us = getCurrentTimeUs();
+    for (int l = 0; l < loop_count; l++) {
+      for (uint32_t i = 0; i < io_num.n_output; i++) {
+        rknn_convert_layout(&src_layouts[i], output_mems[i]->virt_addr, &dst_layouts[i], converted[i].data(),
+                            thread_counts[t]);
+      }
+    }
+    int64_t elapse_us = getCurrentTimeUs() - start_us;
+
+    // same inputs in both contexts, so the results must match the runtime conversion
+    float max_diff = 0.f;
+    for (uint32_t i = 0; i < io_num.n_output; i++) {
+      const float* ref = (const float*)outputs[i].buf;
+      size_t       n   = outputs[i].size / sizeof(float) < converted[i].size() ? outputs[i].size / sizeof(float)
+                                                                              : converted[i].size();
+      for (size_t k = 0; k < n; k++) {
+        max_diff = fmaxf(max_diff, fabsf(ref[k] - converted[i][k]));
+      }
+    }
+    printf("rknn_convert_layout %2d threads: %10.1f us/frame, max diff to want_float %g\n", thread_counts[t],
+           (double)elapse_us / loop_count, max_diff);
+  }
+
+  rknn_outputs_release(ctx_a, io_num.n_output, outputs.data());
+  for (uint32_t i = 0; i < io_num.n_input; i++) {
+    rknn_destroy_mem(ctx_b, input_mems[i]);
+  }
+  for (uint32_t i = 0; i < io_num.n_output; i++) {
+    rknn_destroy_mem(ctx_b, output_mems[i]);
+  }
+  rknn_destroy(ctx_b);
+  rknn_destroy(ctx_a);
+  return 0;
+}
@@ -0,0 +1,200 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  compares two profiles written by rknn_benchmark --mode=profile --format=json, of two versions of a model, two SDK
+  versions or two core masks, and ranks the ops by how much their median time grew:
+  - ops are matched by FullName, the n-th op of a name in one profile with the n-th of that name in the other
+  - ops found in one profile only are listed apart, as are ops moved to another target
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "perf_detail.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef struct _op_diff
+{
+  const perf_op_summary* base;
+  const perf_op_summary* cur;
+  int64_t                delta_us;
+} op_diff;
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static void print_usage(char* argv[])
+{
+  printf("Usage: %s base.json new.json [top=20] [min_delta_us=1]\n", argv[0]);
+  printf("  profiles of rknn_benchmark model_path [input_path] [loop_count] [core_mask] --mode=profile --format=json "
+         "--output=FILE\n");
+}
+
+static void print_info(const char* tag, const char* path, const perf_profile_info* info)
+{
+  printf("%s %s\n", tag, path);
+  printf("      model %s, sdk %s, driver %s, core_mask %u, %lld runs\n", info->model.c_str(), info->sdk_version.c_str(),
+         info->driver_version.c_str(), info->core_mask, (long long)info->runs);
+}
+
+// the name of an op, with the count of the ops of that name before it
+static std::vector<std::string> op_keys(const std::vector<perf_op_summary>& ops)
+{
+  std::map<std::string, int> seen;
+  std::vector<std::string>   keys;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    const std::string& name = ops[i].op.name.empty() ? ops[i].op.type : ops[i].op.name;
+    char               n[16];
+    snprintf(n, sizeof(n), "#%d", seen[name]++);
+    keys.push_back(name + n);
+  }
+  return keys;
+}
+
+static double percent(int64_t delta, int64_t base) { return base > 0 ? 100. * delta / base : 0; }
+
+static void print_diff_header()
+{
+  printf("%-5s %-5s %-18s %-9s %9s %9s %9s %8s %9s %9s  %s\n", "rank", "ID", "OpType", "Target", "base_us", "new_us",
+         "delta_us", "delta", "base_p99", "new_p99", "FullName");
+}
+
+static void print_diff(int rank, const op_diff& d)
+{
+  std::string target = d.base->op.target;
+  if (d.cur->op.target != d.base->op.target) {
+    target += "->" + d.cur->op.target;
+  }
+  printf("%-5d %-5d %-18s %-9s %9lld %9lld %+9lld %+7.1f%% %9lld %9lld  %s\n", rank, d.cur->op.id,
+         d.cur->op.type.c_str(), target.c_str(), (long long)d.base->op.time_us, (long long)d.cur->op.time_us,
+         (long long)d.delta_us, percent(d.delta_us, d.base->op.time_us), (long long)d.base->p99_us,
+         (long long)d.cur->p99_us, d.cur->op.name.c_str());
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char* argv[])
+{
+  if (argc < 3 || !strcmp(argv[1], "-h")) {
+    print_usage(argv);
+    return argc < 3 ? -1 : 0;
+  }
+  int     top          = argc > 3 ? atoi(argv[3]) : 20;
+  int64_t min_delta_us = argc > 4 ? atoll(argv[4]) : 1;
+  top                  = top > 0 ? top : 20;
+
+  perf_profile_info            base_info, cur_info;
+  std::vector<perf_op_summary> base_ops, cur_ops;
+  if (read_perf_profile(argv[1], &base_info, &base_ops) != 0 || read_perf_profile(argv[2], &cur_info, &cur_ops) != 0) {
+    return -1;
+  }
+  print_info("base:", argv[1], &base_info);
+  print_info("new: ", argv[2], &cur_info);
+  int64_t total_delta = cur_info.total_median_us - base_info.total_median_us;
+  printf("total op time median: %lld -> %lld us (%+lld us, %+.1f%%), p99: %lld -> %lld us\n",
+         (long long)base_info.total_median_us, (long long)cur_info.total_median_us, (long long)total_delta,
+         percent(total_delta, base_info.total_median_us), (long long)base_info.total_p99_us,
+         (long long)cur_info.total_p99_us);
+
+  // match
+  std::vector<std::string>      base_keys = op_keys(base_ops);
+  std::vector<std::string>      cur_keys  = op_keys(cur_ops);
+  std::map<std::string, size_t> base_index;
+  for (size_t i = 0; i < base_keys.size(); ++i) {
+    base_index[base_keys[i]] = i;
+  }
+  std::vector<bool>    matched(base_ops.size(), false);
+  std::vector<op_diff> diffs;
+  std::vector<size_t>  added;
+  int                  moved = 0;
+  for (size_t i = 0; i < cur_ops.size(); ++i) {
+    std::map<std::string, size_t>::iterator it = base_index.find(cur_keys[i]);
+    if (it == base_index.end()) {
+      added.push_back(i);
+      continue;
+    }
+    matched[it->second] = true;
+    op_diff d;
+    d.base     = &base_ops[it->second];
+    d.cur      = &cur_ops[i];
+    d.delta_us = d.cur->op.time_us - d.base->op.time_us;
+    moved += d.cur->op.target != d.base->op.target;
+    diffs.push_back(d);
+  }
+  std::stable_sort(diffs.begin(), diffs.end(), [](const op_diff& a, const op_diff& b) { return a.delta_us > b.delta_us; });
+  printf("%zu ops matched, %zu added, %zu removed, %d moved to another target\n", diffs.size(), added.size(),
+         base_ops.size() - diffs.size(), moved);
+
+  // ranking, the largest growth of the median first
+  printf("\nregressed ops, by median delta:\n");
+  print_diff_header();
+  int rank = 0;
+  for (size_t i = 0; i < diffs.size() && rank < top && diffs[i].delta_us >= min_delta_us; ++i) {
+    print_diff(++rank, diffs[i]);
+  }
+  if (rank == 0) {
+    printf("none\n");
+  }
+
+  printf("\nimproved ops, by median delta:\n");
+  print_diff_header();
+  rank = 0;
+  for (size_t i = diffs.size(); i > 0 && rank < top && diffs[i - 1].delta_us <= -min_delta_us; --i) {
+    print_diff(++rank, diffs[i - 1]);
+  }
+  if (rank == 0) {
+    printf("none\n");
+  }
+
+  if (moved > 0) {
+    printf("\nops moved to another target:\n");
+    print_diff_header();
+    rank = 0;
+    for (size_t i = 0; i < diffs.size(); ++i) {
+      if (diffs[i].cur->op.target != diffs[i].base->op.target) {
+        print_diff(++rank, diffs[i]);
+      }
+    }
+  }
+
+  if (!added.empty()) {
+    printf("\nops only in new:\n");
+    for (size_t i = 0; i < added.size(); ++i) {
+      const perf_op_summary& s = cur_ops[added[i]];
+      printf("  %-5d %-18s %-6s %9lld us  %s\n", s.op.id, s.op.type.c_str(), s.op.target.c_str(),
+             (long long)s.op.time_us, s.op.name.c_str());
+    }
+  }
+  if (diffs.size() < base_ops.size()) {
+    printf("\nops only in base:\n");
+    for (size_t i = 0; i < base_ops.size(); ++i) {
+      if (!matched[i]) {
+        const perf_op_summary& s = base_ops[i];
+        printf("  %-5d %-18s %-6s %9lld us  %s\n", s.op.id, s.op.type.c_str(), s.op.target.c_str(),
+               (long long)s.op.time_us, s.op.name.c_str());
+      }
+    }
+  }
+  return 0;
+}
@@ -19,8 +19,8 @@
 #include "opencv2/imgcodecs.hpp"
 #include "opencv2/imgproc.hpp"
 #include "rknn_api.h"
+#include "rknn_topk.h"
 
-#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,33 +39,6 @@ static inline int64_t getCurrentTimeUs()
   return tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-static int rknn_GetTopN(float* pfProb, float* pfMaxProb, uint32_t* pMaxClass, uint32_t outputCount, uint32_t topNum)
-{
-  uint32_t i, j;
-  uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-  for (i = 0; i < topNum; ++i) {
-    pfMaxProb[i] = -FLT_MAX;
-    pMaxClass[i] = -1;
-  }
-
-  for (j = 0; j < top_count; j++) {
-    for (i = 0; i < outputCount; i++) {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4))) {
-        continue;
-      }
-
-      if (pfProb[i] > *(pfMaxProb + j)) {
-        *(pfMaxProb + j) = pfProb[i];
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
-
-  return 1;
-}
-
 static void dump_tensor_attr(rknn_tensor_attr* attr)
 {
   printf("  index=%d, name=%s, n_dims=%d, dims=[%d, %d, %d, %d], n_elems=%d, size=%d, fmt=%s, type=%s, qnt_type=%s, "
@@ -241,10 +214,8 @@ int main(int argc, char* argv[])
   // Create output tensor memory
   rknn_tensor_mem* output_mems[io_num.n_output];
   for (uint32_t i = 0; i < io_num.n_output; ++i) {
-    // default output type is depend on model, this require float32 to compute top5
-    // allocate float32 output tensor
-    int output_size = output_attrs[i].n_elems * sizeof(float);
-    output_mems[i]  = rknn_create_mem(ctx, output_size);
+    // keep the output type of the model, top5 is computed on the quantized values
+    output_mems[i] = rknn_create_mem(ctx, output_attrs[i].size_with_stride);
   }
 
   // Set input tensor memory
@@ -256,8 +227,6 @@ int main(int argc, char* argv[])
 
   // Set output tensor memory
   for (uint32_t i = 0; i < io_num.n_output; ++i) {
-    // default output type is depend on model, this require float32 to compute top5
-    output_attrs[i].type = RKNN_TENSOR_FLOAT32;
     // set output memory and attribute
     ret = rknn_set_io_mem(ctx, output_mems[i], &output_attrs[i]);
     if (ret < 0) {
@@ -282,17 +251,12 @@ int main(int argc, char* argv[])
   // Get top 5
   uint32_t topNum = 5;
   for (uint32_t i = 0; i < io_num.n_output; i++) {
-    uint32_t MaxClass[topNum];
-    float    fMaxProb[topNum];
-    float*   buffer    = (float*)output_mems[i]->virt_addr;
-    uint32_t sz        = output_attrs[i].n_elems;
-    int      top_count = sz > topNum ? topNum : sz;
-
-    rknn_GetTopN(buffer, fMaxProb, MaxClass, sz, topNum);
+    rknn_topk_result results[topNum];
+    int top_count = rknn_GetTopK(&output_attrs[i], output_mems[i]->virt_addr, 0, topNum, results);
 
     printf("---- Top%d ----\n", top_count);
     for (int j = 0; j < top_count; j++) {
-      printf("%8.6f - %d\n", fMaxProb[j], MaxClass[j]);
+      printf("%8.6f - %d\n", results[j].prob, results[j].index);
     }
   }
 
@@ -37,38 +37,6 @@ static inline int64_t getCurrentTimeUs()
     return tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-static int rknn_GetTopN(float *pfProb, float *pfMaxProb, uint32_t *pMaxClass, uint32_t outputCount, uint32_t topNum)
-{
-    uint32_t i, j;
-    uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-    for (i = 0; i < topNum; ++i)
-    {
-        pfMaxProb[i] = -FLT_MAX;
-        pMaxClass[i] = -1;
-    }
-
-    for (j = 0; j < top_count; j++)
-    {
-        for (i = 0; i < outputCount; i++)
-        {
-            if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-                (i == *(pMaxClass + 4)))
-            {
-                continue;
-            }
-
-            if (pfProb[i] > *(pfMaxProb + j))
-            {
-                *(pfMaxProb + j) = pfProb[i];
-                *(pMaxClass + j) = i;
-            }
-        }
-    }
-
-    return 1;
-}
-
 static void dump_tensor_attr(rknn_tensor_attr *attr)
 {
     std::string shape_str = attr->n_dims < 1 ? "" : std::to_string(attr->dims[0]);
@@ -0,0 +1,20 @@
+#!/bin/bash
+set -e
+
+TARGET_SOC="rk3588"
+
+ROOT_PWD=$( cd "$( dirname $0 )" && cd -P "$( dirname "$SOURCE" )" && pwd )
+
+# build
+BUILD_DIR=${ROOT_PWD}/build/build_linux_host
+
+if [[ ! -d "${BUILD_DIR}" ]]; then
+  mkdir -p ${BUILD_DIR}
+fi
+
+cd ${BUILD_DIR}
+cmake ../.. \
+    -DTARGET_SOC=${TARGET_SOC}
+make -j4
+make install
+cd -
@@ -0,0 +1,812 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "rknn_api.h"
+#include "stub_context.h"
+#include "stub_model.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <thread>
+#include <vector>
+
+using namespace rknn_stub;
+
+/*-------------------------------------------
+            context registry / device
+-------------------------------------------*/
+namespace rknn_stub {
+
+static std::mutex                                      g_ctx_mu;
+static std::map<rknn_context, std::shared_ptr<Context>> g_contexts;
+static rknn_context                                    g_next_handle = 1;
+
+static std::mutex g_dev_mu;
+static int64_t    g_core_free_us[3] = {0, 0, 0};
+
+static std::mutex g_mem_mu;
+static uint64_t   g_dma_allocated = 0;
+
+rknn_context register_context(std::shared_ptr<Context> ctx)
+{
+  std::lock_guard<std::mutex> lock(g_ctx_mu);
+  rknn_context                handle = g_next_handle++;
+  g_contexts[handle]                 = ctx;
+  return handle;
+}
+
+std::shared_ptr<Context> find_context(rknn_context handle)
+{
+  std::lock_guard<std::mutex> lock(g_ctx_mu);
+  auto                        it = g_contexts.find(handle);
+  return it == g_contexts.end() ? std::shared_ptr<Context>() : it->second;
+}
+
+std::shared_ptr<Context> unregister_context(rknn_context handle)
+{
+  std::lock_guard<std::mutex> lock(g_ctx_mu);
+  auto                        it = g_contexts.find(handle);
+  if (it == g_contexts.end()) {
+    return std::shared_ptr<Context>();
+  }
+  std::shared_ptr<Context> ctx = it->second;
+  g_contexts.erase(it);
+  return ctx;
+}
+
+int64_t now_us()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+void sleep_until_us(int64_t t_us)
+{
+  std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::microseconds(t_us)));
+}
+
+int64_t device_schedule(const std::string& soc, rknn_core_mask core_mask, int64_t ready_us, int64_t latency_us,
+                        int64_t* start_us)
+{
+  std::lock_guard<std::mutex> lock(g_dev_mu);
+
+  int      core_num = soc_core_num(soc);
+  uint32_t cores    = (uint32_t)core_mask & ((1u << core_num) - 1);
+  if (core_mask == RKNN_NPU_CORE_AUTO || core_mask == RKNN_NPU_CORE_UNDEFINED || cores == 0) {
+    // auto mode runs on the core that becomes idle first
+    int best = 0;
+    for (int i = 1; i < core_num; ++i) {
+      if (g_core_free_us[i] < g_core_free_us[best]) {
+        best = i;
+      }
+    }
+    cores = 1u << best;
+  }
+
+  int64_t start = ready_us;
+  int     n     = 0;
+  for (int i = 0; i < core_num; ++i) {
+    if (cores & (1u << i)) {
+      start = std::max(start, g_core_free_us[i]);
+      n++;
+    }
+  }
+  // a multi-core run splits the work across the selected cores
+  int64_t done = start + latency_us / n;
+  for (int i = 0; i < core_num; ++i) {
+    if (cores & (1u << i)) {
+      g_core_free_us[i] = done;
+    }
+  }
+  if (start_us) {
+    *start_us = start;
+  }
+  return done;
+}
+
+} // namespace rknn_stub
+
+/*-------------------------------------------
+                model context
+-------------------------------------------*/
+struct PendingRun
+{
+  uint64_t frame_id;
+  int64_t  done_us;
+  int64_t  latency_us;
+};
+
+struct ModelContext : public Context
+{
+  std::shared_ptr<const StubModel> model;
+  uint32_t                         flag           = 0;
+  int                              batch_core_num = 1;
+
+  std::vector<rknn_tensor_attr>     cur_inputs;
+  std::vector<std::vector<uint8_t>> input_bufs;
+
+  std::vector<rknn_tensor_mem*>  in_mems;
+  std::vector<rknn_tensor_mem*>  out_mems;
+  std::vector<rknn_tensor_attr>  out_mem_attrs;
+
+  std::deque<PendingRun> pending;
+  uint64_t               submitted      = 0;
+  uint64_t               completed      = 0;
+  int64_t                last_done_us   = 0;
+  int64_t                last_run_us    = 0;
+  uint32_t               rng            = 1;
+  std::string            perf_text;
+};
+
+static std::shared_ptr<ModelContext> get_model_context(rknn_context context)
+{
+  std::shared_ptr<Context> ctx = find_context(context);
+  if (!ctx || ctx->is_matmul) {
+    return std::shared_ptr<ModelContext>();
+  }
+  return std::static_pointer_cast<ModelContext>(ctx);
+}
+
+static void init_model_context(ModelContext* ctx, std::shared_ptr<const StubModel> model, uint32_t flag)
+{
+  ctx->model      = model;
+  ctx->soc        = model->soc;
+  ctx->flag       = flag;
+  ctx->rng        = (uint32_t)(uintptr_t)ctx | 1;
+  ctx->cur_inputs.clear();
+  ctx->input_bufs.clear();
+  for (size_t i = 0; i < model->inputs.size(); ++i) {
+    const rknn_tensor_attr& attr = model->inputs[i].attr;
+    ctx->cur_inputs.push_back(attr);
+    ctx->input_bufs.push_back(std::vector<uint8_t>(std::max(attr.size, attr.size_with_stride)));
+  }
+  ctx->in_mems.assign(model->inputs.size(), NULL);
+  ctx->out_mems.assign(model->outputs.size(), NULL);
+  ctx->out_mem_attrs.resize(model->outputs.size());
+}
+
+static int64_t next_latency(ModelContext* ctx)
+{
+  int64_t latency = ctx->model->run_us;
+  if (ctx->model->run_jitter_us > 0) {
+    ctx->rng ^= ctx->rng << 13;
+    ctx->rng ^= ctx->rng >> 17;
+    ctx->rng ^= ctx->rng << 5;
+    latency += (int64_t)(ctx->rng % (2 * ctx->model->run_jitter_us + 1)) - ctx->model->run_jitter_us;
+  }
+  return std::max<int64_t>(latency, 1);
+}
+
+static const uint8_t* replay_frame(const StubTensor& t, uint64_t frame_id)
+{
+  uint32_t idx = (uint32_t)((frame_id - 1) % t.n_frames);
+  return &t.frames[(size_t)idx * t.attr.size];
+}
+
+static void build_perf_text(ModelContext* ctx, int64_t latency_us)
+{
+  const StubModel& model = *ctx->model;
+  std::vector<StubOp> ops = model.ops;
+  if (ops.empty()) {
+    StubOp op;
+    op.id        = 1;
+    op.type      = "NpuGraph";
+    op.target    = "NPU";
+    op.data_type = get_type_string(model.inputs[0].attr.type);
+    op.time_us   = model.run_us;
+    op.name      = "NpuGraph:stub";
+    ops.push_back(op);
+  }
+
+  int64_t total = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    total += ops[i].time_us;
+  }
+
+  char        line[512];
+  std::string sep(120, '-');
+  std::string text = sep + "\n";
+  text += "                                            Network Layer Information Table\n";
+  text += sep + "\n";
+  // a space after each column as the runtime prints it, a longer value pushes the ones after it
+  snprintf(line, sizeof(line), "%-4s %-17s %-8s %-6s %-15s %-15s %-11s %-12s %s\n", "ID", "OpType", "DataType",
+           "Target", "InputShape", "OutputShape", "Time(us)", "MacUsage(%)", "FullName");
+  text += line;
+  text += sep + "\n";
+  int64_t elapsed = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    // spread the jitter of this run over the ops
+    int64_t t = total > 0 ? ops[i].time_us * latency_us / total : 0;
+    elapsed += t;
+    snprintf(line, sizeof(line), "%-4d %-17s %-8s %-6s %-15s %-15s %-11lld %-12s %s\n", ops[i].id,
+             ops[i].type.c_str(), ops[i].data_type.empty() ? "INT8" : ops[i].data_type.c_str(),
+             ops[i].target.empty() ? "NPU" : ops[i].target.c_str(),
+             ops[i].in_shape.empty() ? "\\" : ops[i].in_shape.c_str(),
+             ops[i].out_shape.empty() ? "\\" : ops[i].out_shape.c_str(), (long long)t, "\\",
+             ops[i].name.empty() ? ops[i].type.c_str() : ops[i].name.c_str());
+    text += line;
+  }
+  text += sep + "\n";
+  snprintf(line, sizeof(line), "Total Operator Elapsed Time(us): %lld\n", (long long)elapsed);
+  text += line;
+  text += sep + "\n";
+  ctx->perf_text = text;
+}
+
+// called with ctx->mu held, completes all runs up to frame_id
+static void retire_runs(ModelContext* ctx, uint64_t frame_id)
+{
+  while (!ctx->pending.empty() && ctx->pending.front().frame_id <= frame_id) {
+    PendingRun run = ctx->pending.front();
+    ctx->pending.pop_front();
+
+    for (size_t i = 0; i < ctx->out_mems.size(); ++i) {
+      rknn_tensor_mem* mem = ctx->out_mems[i];
+      if (mem == NULL) {
+        continue;
+      }
+      const StubTensor& t = ctx->model->outputs[i];
+      convert_tensor(t.attr, replay_frame(t, run.frame_id), ctx->out_mem_attrs[i],
+                     (uint8_t*)mem->virt_addr + mem->offset, mem->size - mem->offset);
+    }
+    ctx->completed   = run.frame_id;
+    ctx->last_run_us = run.latency_us;
+    if (ctx->flag & RKNN_FLAG_COLLECT_PERF_MASK) {
+      build_perf_text(ctx, run.latency_us);
+    }
+  }
+}
+
+// called with lock held on ctx->mu, returns with it held
+static int wait_run(ModelContext* ctx, std::unique_lock<std::mutex>& lock, uint64_t frame_id)
+{
+  if (frame_id == 0 || frame_id > ctx->submitted) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  if (frame_id <= ctx->completed) {
+    return RKNN_SUCC;
+  }
+  int64_t done_us = 0;
+  for (size_t i = 0; i < ctx->pending.size(); ++i) {
+    if (ctx->pending[i].frame_id == frame_id) {
+      done_us = ctx->pending[i].done_us;
+      break;
+    }
+  }
+  lock.unlock();
+  sleep_until_us(done_us);
+  lock.lock();
+  retire_runs(ctx, frame_id);
+  return RKNN_SUCC;
+}
+
+/*-------------------------------------------
+                  rknn api
+-------------------------------------------*/
+int rknn_init(rknn_context* context, void* model, uint32_t size, uint32_t flag, rknn_init_extend* extend)
+{
+  if (context == NULL || model == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+
+  std::shared_ptr<StubModel> stub_model = std::make_shared<StubModel>();
+  int                        ret        = load_model(model, size, stub_model.get());
+  if (ret != RKNN_SUCC) {
+    return ret;
+  }
+
+  std::shared_ptr<ModelContext> ctx = std::make_shared<ModelContext>();
+  init_model_context(ctx.get(), stub_model, flag);
+  *context = register_context(ctx);
+  if (extend) {
+    extend->ctx = *context;
+  }
+  return RKNN_SUCC;
+}
+
+int rknn_dup_context(rknn_context* context_in, rknn_context* context_out)
+{
+  if (context_in == NULL || context_out == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  std::shared_ptr<ModelContext> src = get_model_context(*context_in);
+  if (!src) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  // the model description (and its recorded outputs) is shared like weights
+  std::shared_ptr<ModelContext> ctx = std::make_shared<ModelContext>();
+  init_model_context(ctx.get(), src->model, src->flag);
+  *context_out = register_context(ctx);
+  return RKNN_SUCC;
+}
+
+int rknn_destroy(rknn_context context)
+{
+  std::shared_ptr<Context> ctx = unregister_context(context);
+  return ctx ? RKNN_SUCC : RKNN_ERR_CTX_INVALID;
+}
+
+int rknn_query(rknn_context context, rknn_query_cmd cmd, void* info, uint32_t size)
+{
+  std::shared_ptr<ModelContext> ctx = get_model_context(context);
+  if (!ctx) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  if (info == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  std::lock_guard<std::mutex> lock(ctx->mu);
+  const StubModel&            model = *ctx->model;
+
+  switch (cmd) {
+  case RKNN_QUERY_IN_OUT_NUM: {
+    if (size < sizeof(rknn_input_output_num)) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    rknn_input_output_num* io_num = (rknn_input_output_num*)info;
+    io_num->n_input               = model.inputs.size();
+    io_num->n_output              = model.outputs.size();
+    return RKNN_SUCC;
+  }
+  case RKNN_QUERY_INPUT_ATTR:
+  case RKNN_QUERY_OUTPUT_ATTR:
+  case RKNN_QUERY_CURRENT_INPUT_ATTR:
+  case RKNN_QUERY_CURRENT_OUTPUT_ATTR:
+  case RKNN_QUERY_NATIVE_INPUT_ATTR:
+  case RKNN_QUERY_NATIVE_OUTPUT_ATTR:
+  case RKNN_QUERY_NATIVE_NHWC_INPUT_ATTR:
+  case RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR:
+  case RKNN_QUERY_CURRENT_NATIVE_INPUT_ATTR:
+  case RKNN_QUERY_CURRENT_NATIVE_OUTPUT_ATTR: {
+    if (size < sizeof(rknn_tensor_attr)) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    rknn_tensor_attr* attr     = (rknn_tensor_attr*)info;
+    bool              is_input = cmd == RKNN_QUERY_INPUT_ATTR || cmd == RKNN_QUERY_CURRENT_INPUT_ATTR ||
+                    cmd == RKNN_QUERY_NATIVE_INPUT_ATTR || cmd == RKNN_QUERY_NATIVE_NHWC_INPUT_ATTR ||
+                    cmd == RKNN_QUERY_CURRENT_NATIVE_INPUT_ATTR;
+    const std::vector<StubTensor>& tensors = is_input ? model.inputs : model.outputs;
+    if (attr->index >= tensors.size()) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    StubTensor t = tensors[attr->index];
+    if (is_input) {
+      t.attr = ctx->cur_inputs[attr->index];
+    }
+    if (cmd == RKNN_QUERY_INPUT_ATTR || cmd == RKNN_QUERY_OUTPUT_ATTR || cmd == RKNN_QUERY_CURRENT_INPUT_ATTR ||
+        cmd == RKNN_QUERY_CURRENT_OUTPUT_ATTR) {
+      *attr = t.attr;
+    } else {
+      int native_cmd = cmd;
+      if (cmd == RKNN_QUERY_CURRENT_NATIVE_INPUT_ATTR) {
+        native_cmd = RKNN_QUERY_NATIVE_INPUT_ATTR;
+      } else if (cmd == RKNN_QUERY_CURRENT_NATIVE_OUTPUT_ATTR) {
+        native_cmd = RKNN_QUERY_NATIVE_OUTPUT_ATTR;
+      }
+      make_native_attr(model, t, native_cmd, attr);
+    }
+    return RKNN_SUCC;
+  }
+  case RKNN_QUERY_INPUT_DYNAMIC_RANGE: {
+    if (size < sizeof(rknn_input_range)) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    rknn_input_range* range = (rknn_input_range*)info;
+    if (range->index >= model.inputs.size()) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    const rknn_tensor_attr& attr = model.inputs[range->index].attr;
+    range->shape_number          = 1;
+    range->fmt                   = attr.fmt;
+    range->n_dims                = attr.n_dims;
+    memcpy(range->name, attr.name, sizeof(range->name));
+    memcpy(range->dyn_range[0], attr.dims, sizeof(attr.dims));
+    return RKNN_SUCC;
+  }
+  case RKNN_QUERY_PERF_DETAIL: {
+    if (size < sizeof(rknn_perf_detail) || !(ctx->flag & RKNN_FLAG_COLLECT_PERF_MASK)) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    rknn_perf_detail* detail = (rknn_perf_detail*)info;
+    detail->perf_data        = (char*)ctx->perf_text.c_str();
+    detail->data_len         = ctx->perf_text.size();
+    return RKNN_SUCC;
+  }
+  case RKNN_QUERY_PERF_RUN: {
+    if (size < sizeof(rknn_perf_run)) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    ((rknn_perf_run*)info)->run_duration = ctx->last_run_us;
+    return RKNN_SUCC;
+  }
+  case RKNN_QUERY_SDK_VERSION: {
+    if (size < sizeof(rknn_sdk_version)) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    rknn_sdk_version* ver = (rknn_sdk_version*)info;
+    snprintf(ver->api_version, sizeof(ver->api_version), "1.5.2 (rknn_host_stub, %s)", model.soc.c_str());
+    snprintf(ver->drv_version, sizeof(ver->drv_version), "0.0.0 (host)");
+    return RKNN_SUCC;
+  }
+  case RKNN_QUERY_MEM_SIZE: {
+    if (size < sizeof(rknn_mem_size)) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    rknn_mem_size* mem_size = (rknn_mem_size*)info;
+    memset(mem_size, 0, sizeof(rknn_mem_size));
+    mem_size->total_weight_size   = model.weight_size;
+    mem_size->total_internal_size = model.internal_size;
+    std::lock_guard<std::mutex> mem_lock(g_mem_mu);
+    mem_size->total_dma_allocated_size = g_dma_allocated;
+    return RKNN_SUCC;
+  }
+  case RKNN_QUERY_CUSTOM_STRING: {
+    if (size < sizeof(rknn_custom_string)) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    rknn_custom_string* custom = (rknn_custom_string*)info;
+    snprintf(custom->string, sizeof(custom->string), "%s", model.custom_string.c_str());
+    return RKNN_SUCC;
+  }
+  default:
+    return RKNN_ERR_PARAM_INVALID;
+  }
+}
+
+int rknn_inputs_set(rknn_context context, uint32_t n_inputs, rknn_input inputs[])
+{
+  std::shared_ptr<ModelContext> ctx = get_model_context(context);
+  if (!ctx) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  if (inputs == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  std::lock_guard<std::mutex> lock(ctx->mu);
+  for (uint32_t i = 0; i < n_inputs; ++i) {
+    uint32_t index = inputs[i].index;
+    if (index >= ctx->cur_inputs.size()) {
+      return RKNN_ERR_INPUT_INVALID;
+    }
+    std::vector<uint8_t>& buf = ctx->input_bufs[index];
+    int ret = convert_input(ctx->cur_inputs[index], inputs[i], buf.data(), buf.size());
+    if (ret != RKNN_SUCC) {
+      return RKNN_ERR_INPUT_INVALID;
+    }
+  }
+  return RKNN_SUCC;
+}
+
+int rknn_set_batch_core_num(rknn_context context, int core_num)
+{
+  std::shared_ptr<ModelContext> ctx = get_model_context(context);
+  if (!ctx) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  if (core_num < 1 || core_num > soc_core_num(ctx->soc)) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  std::lock_guard<std::mutex> lock(ctx->mu);
+  ctx->batch_core_num = core_num;
+  return RKNN_SUCC;
+}
+
+int rknn_set_core_mask(rknn_context context, rknn_core_mask core_mask)
+{
+  std::shared_ptr<Context> ctx = find_context(context);
+  if (!ctx) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  if (core_mask != RKNN_NPU_CORE_AUTO && soc_core_num(ctx->soc) == 1) {
+    printf("rknn_host_stub: core mask is only supported on rk3588\n");
+    return RKNN_ERR_FAIL;
+  }
+  std::lock_guard<std::mutex> lock(ctx->mu);
+  ctx->core_mask = core_mask;
+  return RKNN_SUCC;
+}
+
+int rknn_run(rknn_context context, rknn_run_extend* extend)
+{
+  std::shared_ptr<ModelContext> ctx = get_model_context(context);
+  if (!ctx) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  std::unique_lock<std::mutex> lock(ctx->mu);
+
+  int64_t latency = next_latency(ctx.get());
+  // runs of one context execute in order
+  int64_t ready = std::max(now_us(), ctx->last_done_us);
+  int64_t done  = device_schedule(ctx->soc, ctx->core_mask, ready, latency, NULL);
+
+  PendingRun run;
+  run.frame_id   = ++ctx->submitted;
+  run.done_us    = done;
+  run.latency_us = done - std::max(ready, done - latency);
+  ctx->pending.push_back(run);
+  ctx->last_done_us = done;
+
+  if (extend) {
+    extend->frame_id = run.frame_id;
+  }
+  bool non_block = (extend && extend->non_block) || (ctx->flag & RKNN_FLAG_ASYNC_MASK);
+  if (non_block) {
+    return RKNN_SUCC;
+  }
+  return wait_run(ctx.get(), lock, run.frame_id);
+}
+
+int rknn_wait(rknn_context context, rknn_run_extend* extend)
+{
+  std::shared_ptr<ModelContext> ctx = get_model_context(context);
+  if (!ctx) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  std::unique_lock<std::mutex> lock(ctx->mu);
+  uint64_t                     frame_id = extend && extend->frame_id ? extend->frame_id : ctx->submitted;
+  if (ctx->submitted == 0) {
+    return RKNN_ERR_FAIL;
+  }
+  return wait_run(ctx.get(), lock, frame_id);
+}
+
+int rknn_outputs_get(rknn_context context, uint32_t n_outputs, rknn_output outputs[], rknn_output_extend* extend)
+{
+  std::shared_ptr<ModelContext> ctx = get_model_context(context);
+  if (!ctx) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  if (outputs == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  std::unique_lock<std::mutex> lock(ctx->mu);
+  if (ctx->submitted == 0) {
+    printf("rknn_host_stub: rknn_outputs_get before rknn_run\n");
+    return RKNN_ERR_FAIL;
+  }
+
+  // async mode hands out the previous frame while the current one is still running
+  uint64_t frame_id = ctx->submitted;
+  if ((ctx->flag & RKNN_FLAG_ASYNC_MASK) && frame_id > 1) {
+    frame_id--;
+  }
+  int ret = wait_run(ctx.get(), lock, frame_id);
+  if (ret != RKNN_SUCC) {
+    return ret;
+  }
+
+  const StubModel& model = *ctx->model;
+  for (uint32_t i = 0; i < n_outputs; ++i) {
+    uint32_t index = n_outputs == model.outputs.size() ? i : outputs[i].index;
+    if (index >= model.outputs.size()) {
+      return RKNN_ERR_OUTPUT_INVALID;
+    }
+    const StubTensor& t   = model.outputs[index];
+    rknn_tensor_attr  dst = t.attr;
+    if (outputs[i].want_float) {
+      dst.type     = RKNN_TENSOR_FLOAT32;
+      dst.qnt_type = RKNN_TENSOR_QNT_NONE;
+    }
+    uint32_t need = dst.n_elems * type_bytes(dst.type);
+    if (outputs[i].is_prealloc) {
+      if (outputs[i].buf == NULL || outputs[i].size < need) {
+        return RKNN_ERR_OUTPUT_INVALID;
+      }
+    } else {
+      outputs[i].buf  = malloc(need);
+      outputs[i].size = need;
+      if (outputs[i].buf == NULL) {
+        return RKNN_ERR_MALLOC_FAIL;
+      }
+    }
+    outputs[i].index = index;
+    convert_tensor(t.attr, replay_frame(t, frame_id), dst, outputs[i].buf, need);
+  }
+  if (extend) {
+    extend->frame_id = frame_id;
+  }
+  return RKNN_SUCC;
+}
+
+int rknn_outputs_release(rknn_context context, uint32_t n_ouputs, rknn_output outputs[])
+{
+  if (!find_context(context)) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  if (outputs == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  for (uint32_t i = 0; i < n_ouputs; ++i) {
+    if (!outputs[i].is_prealloc && outputs[i].buf) {
+      free(outputs[i].buf);
+      outputs[i].buf = NULL;
+    }
+  }
+  return RKNN_SUCC;
+}
+
+/*-------------------------------------------
+                tensor memory
+-------------------------------------------*/
+// priv_data of memory allocated by rknn_create_mem
+static char kOwnedMem;
+
+static rknn_tensor_mem* wrap_mem(void* virt_addr, uint64_t phys_addr, int32_t fd, int32_t offset, uint32_t size,
+                                 uint32_t flags)
+{
+  rknn_tensor_mem* mem = (rknn_tensor_mem*)calloc(1, sizeof(rknn_tensor_mem));
+  if (mem == NULL) {
+    return NULL;
+  }
+  mem->virt_addr = virt_addr;
+  mem->phys_addr = phys_addr;
+  mem->fd        = fd;
+  mem->offset    = offset;
+  mem->size      = size;
+  mem->flags     = flags;
+  return mem;
+}
+
+rknn_tensor_mem* rknn_create_mem(rknn_context ctx, uint32_t size)
+{
+  if (!find_context(ctx) || size == 0) {
+    return NULL;
+  }
+  void* data = NULL;
+  if (posix_memalign(&data, 64, size) != 0) {
+    return NULL;
+  }
+  memset(data, 0, size);
+  rknn_tensor_mem* mem = wrap_mem(data, 0, -1, 0, size, RKNN_TENSOR_MEMORY_FLAGS_ALLOC_INSIDE);
+  if (mem == NULL) {
+    free(data);
+    return NULL;
+  }
+  mem->priv_data = &kOwnedMem;
+
+  std::lock_guard<std::mutex> lock(g_mem_mu);
+  g_dma_allocated += size;
+  return mem;
+}
+
+rknn_tensor_mem* rknn_create_mem_from_phys(rknn_context ctx, uint64_t phys_addr, void* virt_addr, uint32_t size)
+{
+  if (!find_context(ctx) || virt_addr == NULL) {
+    return NULL;
+  }
+  return wrap_mem(virt_addr, phys_addr, -1, 0, size, RKNN_TENSOR_MEMORY_FLAGS_FROM_PHYS);
+}
+
+rknn_tensor_mem* rknn_create_mem_from_fd(rknn_context ctx, int32_t fd, void* virt_addr, uint32_t size, int32_t offset)
+{
+  if (!find_context(ctx) || virt_addr == NULL) {
+    return NULL;
+  }
+  return wrap_mem(virt_addr, 0, fd, offset, size, RKNN_TENSOR_MEMORY_FLAGS_FROM_FD);
+}
+
+rknn_tensor_mem* rknn_create_mem_from_mb_blk(rknn_context ctx, void* mb_blk, int32_t offset)
+{
+  // there is no MB_BLK allocator on the host
+  (void)ctx;
+  (void)mb_blk;
+  (void)offset;
+  printf("rknn_host_stub: rknn_create_mem_from_mb_blk is not supported\n");
+  return NULL;
+}
+
+int rknn_destroy_mem(rknn_context ctx, rknn_tensor_mem* mem)
+{
+  (void)ctx;
+  if (mem == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  if (mem->priv_data == &kOwnedMem) {
+    std::lock_guard<std::mutex> lock(g_mem_mu);
+    g_dma_allocated -= mem->size;
+    free(mem->virt_addr);
+  }
+  free(mem);
+  return RKNN_SUCC;
+}
+
+int rknn_set_weight_mem(rknn_context ctx, rknn_tensor_mem* mem)
+{
+  if (!get_model_context(ctx)) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  return mem ? RKNN_SUCC : RKNN_ERR_PARAM_INVALID;
+}
+
+int rknn_set_internal_mem(rknn_context ctx, rknn_tensor_mem* mem)
+{
+  if (!get_model_context(ctx)) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  return mem ? RKNN_SUCC : RKNN_ERR_PARAM_INVALID;
+}
+
+int rknn_set_io_mem(rknn_context context, rknn_tensor_mem* mem, rknn_tensor_attr* attr)
+{
+  std::shared_ptr<ModelContext> ctx = get_model_context(context);
+  if (!ctx) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  if (mem == NULL || attr == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  std::lock_guard<std::mutex> lock(ctx->mu);
+  const StubModel&            model = *ctx->model;
+
+  // tensors are matched by name, inputs and outputs share the index space
+  for (size_t i = 0; i < model.inputs.size(); ++i) {
+    if (strcmp(attr->name, model.inputs[i].attr.name) == 0) {
+      ctx->in_mems[i] = mem;
+      return RKNN_SUCC;
+    }
+  }
+  for (size_t i = 0; i < model.outputs.size(); ++i) {
+    if (strcmp(attr->name, model.outputs[i].attr.name) == 0) {
+      ctx->out_mems[i]      = mem;
+      ctx->out_mem_attrs[i] = *attr;
+      return RKNN_SUCC;
+    }
+  }
+  printf("rknn_host_stub: rknn_set_io_mem: unknown tensor '%s'\n", attr->name);
+  return RKNN_ERR_PARAM_INVALID;
+}
+
+int rknn_set_input_shape(rknn_context context, rknn_tensor_attr* attr)
+{
+  std::shared_ptr<ModelContext> ctx = get_model_context(context);
+  if (!ctx) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  if (attr == NULL || attr->index >= ctx->cur_inputs.size()) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  std::lock_guard<std::mutex> lock(ctx->mu);
+  rknn_tensor_attr&           cur = ctx->cur_inputs[attr->index];
+  cur.n_dims                      = attr->n_dims;
+  memcpy(cur.dims, attr->dims, sizeof(cur.dims));
+  cur.n_elems = 1;
+  for (uint32_t i = 0; i < cur.n_dims; ++i) {
+    cur.n_elems *= cur.dims[i];
+  }
+  cur.size             = cur.n_elems * type_bytes(cur.type);
+  cur.w_stride         = cur.fmt == RKNN_TENSOR_NHWC && cur.n_dims == 4 ? cur.dims[2] : 0;
+  cur.size_with_stride = cur.size;
+  ctx->input_bufs[attr->index].resize(cur.size);
+  return RKNN_SUCC;
+}
+
+int rknn_set_input_shapes(rknn_context context, uint32_t n_inputs, rknn_tensor_attr attr[])
+{
+  for (uint32_t i = 0; i < n_inputs; ++i) {
+    int ret = rknn_set_input_shape(context, &attr[i]);
+    if (ret != RKNN_SUCC) {
+      return ret;
+    }
+  }
+  return RKNN_SUCC;
+}
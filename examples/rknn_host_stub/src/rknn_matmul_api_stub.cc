@@ -0,0 +1,276 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "rknn_matmul_api.h"
+#include "stub_context.h"
+#include "stub_model.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <vector>
+
+using namespace rknn_stub;
+
+/*-------------------------------------------
+                matmul context
+-------------------------------------------*/
+struct MatmulContext : public Context
+{
+  rknn_matmul_info    info;
+  rknn_matmul_io_attr io_attr;
+  rknn_tensor_mem*    A = NULL;
+  rknn_tensor_mem*    B = NULL;
+  rknn_tensor_mem*    C = NULL;
+
+  // block sizes of the perf layout of A and the native layout of B
+  int a_sub_k;
+  int b_sub_n;
+  int b_sub_k;
+};
+
+static std::shared_ptr<MatmulContext> get_matmul_context(rknn_matmul_ctx context)
+{
+  std::shared_ptr<Context> ctx = find_context(context);
+  if (!ctx || !ctx->is_matmul) {
+    return std::shared_ptr<MatmulContext>();
+  }
+  return std::static_pointer_cast<MatmulContext>(ctx);
+}
+
+static void set_attr(rknn_matmul_tensor_attr* attr, const char* name, rknn_tensor_type type,
+                     std::initializer_list<uint32_t> dims)
+{
+  memset(attr, 0, sizeof(rknn_matmul_tensor_attr));
+  snprintf(attr->name, sizeof(attr->name), "%s", name);
+  attr->type   = type;
+  attr->n_dims = 0;
+  uint32_t n   = 1;
+  for (uint32_t d : dims) {
+    attr->dims[attr->n_dims++] = d;
+    n *= d;
+  }
+  attr->size = n * type_bytes(type);
+}
+
+static int64_t env_int(const char* name, int64_t def)
+{
+  const char* v = getenv(name);
+  return v && v[0] ? atoll(v) : def;
+}
+
+/*-------------------------------------------
+                  compute
+-------------------------------------------*/
+static float load_elem(const MatmulContext* ctx, const void* p, size_t idx)
+{
+  return ctx->info.type == RKNN_TENSOR_INT8 ? ((const int8_t*)p)[idx] : half_to_float(((const uint16_t*)p)[idx]);
+}
+
+// unpack A to (M, K) and B to (K, N) normal layout
+template <typename T>
+static void unpack_ab(const MatmulContext* ctx, std::vector<T>* a, std::vector<T>* b)
+{
+  const int32_t M = ctx->info.M, K = ctx->info.K, N = ctx->info.N;
+  const int32_t s = ctx->a_sub_k, sn = ctx->b_sub_n, sk = ctx->b_sub_k;
+  const void*   pa = (const uint8_t*)ctx->A->virt_addr + ctx->A->offset;
+  const void*   pb = (const uint8_t*)ctx->B->virt_addr + ctx->B->offset;
+
+  a->resize((size_t)M * K);
+  for (int32_t m = 0; m < M; ++m) {
+    for (int32_t k = 0; k < K; ++k) {
+      size_t idx = ctx->info.perf_layout ? ((size_t)(k / s) * M + m) * s + k % s : (size_t)m * K + k;
+      (*a)[(size_t)m * K + k] = (T)load_elem(ctx, pa, idx);
+    }
+  }
+  b->resize((size_t)K * N);
+  for (int32_t k = 0; k < K; ++k) {
+    for (int32_t n = 0; n < N; ++n) {
+      size_t idx = ctx->info.native_layout ? (((size_t)(n / sn) * (K / sk) + k / sk) * sn + n % sn) * sk + k % sk
+                                           : (size_t)k * N + n;
+      (*b)[(size_t)k * N + n] = (T)load_elem(ctx, pb, idx);
+    }
+  }
+}
+
+// T is int32_t for int8 matmul (exact accumulation), float for float16
+template <typename T>
+static void compute(MatmulContext* ctx)
+{
+  const int32_t  M = ctx->info.M, K = ctx->info.K, N = ctx->info.N;
+  std::vector<T> a, b;
+  unpack_ab(ctx, &a, &b);
+
+  T*             c = (T*)((uint8_t*)ctx->C->virt_addr + ctx->C->offset);
+  std::vector<T> row(N);
+  for (int32_t m = 0; m < M; ++m) {
+    std::fill(row.begin(), row.end(), (T)0);
+    for (int32_t k = 0; k < K; ++k) {
+      T        av = a[(size_t)m * K + k];
+      const T* bk = &b[(size_t)k * N];
+      for (int32_t n = 0; n < N; ++n) {
+        row[n] += av * bk[n];
+      }
+    }
+    for (int32_t n = 0; n < N; ++n) {
+      size_t idx = ctx->info.perf_layout ? ((size_t)(n / 4) * M + m) * 4 + n % 4 : (size_t)m * N + n;
+      c[idx]     = row[n];
+    }
+  }
+}
+
+/*-------------------------------------------
+                matmul api
+-------------------------------------------*/
+int rknn_matmul_create(rknn_matmul_ctx* ctx, rknn_matmul_info* info, rknn_matmul_io_attr* io_attr)
+{
+  if (ctx == NULL || info == NULL || io_attr == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  if (info->type != RKNN_TENSOR_INT8 && info->type != RKNN_TENSOR_FLOAT16) {
+    printf("rknn_host_stub: matmul type %s is not supported\n", get_type_string(info->type));
+    return RKNN_ERR_PARAM_INVALID;
+  }
+
+  std::shared_ptr<MatmulContext> mm = std::make_shared<MatmulContext>();
+  mm->is_matmul                     = true;
+  mm->soc                           = soc_from_env();
+  mm->info                          = *info;
+
+  bool rk3588 = mm->soc == "rk3588";
+  bool int8   = info->type == RKNN_TENSOR_INT8;
+  int  k_align, n_align;
+  if (rk3588) {
+    k_align     = 32;
+    n_align     = int8 ? 32 : 16;
+    mm->a_sub_k = int8 ? 16 : 8;
+    mm->b_sub_n = int8 ? 32 : 16;
+    mm->b_sub_k = 32;
+  } else {
+    k_align     = int8 ? 32 : 16;
+    n_align     = int8 ? 16 : 8;
+    mm->a_sub_k = int8 ? 8 : 4;
+    mm->b_sub_n = int8 ? 16 : 8;
+    mm->b_sub_k = int8 ? 32 : 16;
+  }
+  if (info->M <= 0 || info->K <= 0 || info->N <= 0 || info->K > 4096 || info->K % k_align != 0 ||
+      info->N % n_align != 0) {
+    printf("rknn_host_stub: invalid matmul shape M=%d K=%d N=%d for %s %s, K must be aligned to %d and <= 4096, N "
+           "must be aligned to %d\n",
+           info->M, info->K, info->N, mm->soc.c_str(), get_type_string(info->type), k_align, n_align);
+    return RKNN_ERR_PARAM_INVALID;
+  }
+
+  uint32_t         M = info->M, K = info->K, N = info->N;
+  rknn_tensor_type c_type = int8 ? RKNN_TENSOR_INT32 : RKNN_TENSOR_FLOAT32;
+  if (info->perf_layout) {
+    set_attr(&mm->io_attr.A, "A", info->type, {K / mm->a_sub_k, M, (uint32_t)mm->a_sub_k});
+    set_attr(&mm->io_attr.C, "C", c_type, {N / 4, M, 4});
+  } else {
+    set_attr(&mm->io_attr.A, "A", info->type, {M, K});
+    set_attr(&mm->io_attr.C, "C", c_type, {M, N});
+  }
+  if (info->native_layout) {
+    set_attr(&mm->io_attr.B, "B", info->type,
+             {N / mm->b_sub_n, K / mm->b_sub_k, (uint32_t)mm->b_sub_n, (uint32_t)mm->b_sub_k});
+  } else {
+    set_attr(&mm->io_attr.B, "B", info->type, {K, N});
+  }
+  *io_attr = mm->io_attr;
+  *ctx     = register_context(mm);
+  return RKNN_SUCC;
+}
+
+int rknn_matmul_set_io_mem(rknn_matmul_ctx ctx, rknn_tensor_mem* mem, rknn_matmul_tensor_attr* attr)
+{
+  std::shared_ptr<MatmulContext> mm = get_matmul_context(ctx);
+  if (!mm) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  if (mem == NULL || attr == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  std::lock_guard<std::mutex> lock(mm->mu);
+
+  rknn_matmul_tensor_attr* expect = NULL;
+  rknn_tensor_mem**        slot   = NULL;
+  if (strcmp(attr->name, "A") == 0) {
+    expect = &mm->io_attr.A;
+    slot   = &mm->A;
+  } else if (strcmp(attr->name, "B") == 0) {
+    expect = &mm->io_attr.B;
+    slot   = &mm->B;
+  } else if (strcmp(attr->name, "C") == 0) {
+    expect = &mm->io_attr.C;
+    slot   = &mm->C;
+  } else {
+    printf("rknn_host_stub: rknn_matmul_set_io_mem: unknown tensor '%s'\n", attr->name);
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  if (mem->size < mem->offset + expect->size) {
+    printf("rknn_host_stub: rknn_matmul_set_io_mem: %s needs %u bytes, got %u\n", attr->name, expect->size,
+           mem->size - mem->offset);
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  *slot = mem;
+  return RKNN_SUCC;
+}
+
+int rknn_matmul_set_core_mask(rknn_matmul_ctx context, rknn_core_mask core_mask)
+{
+  return rknn_set_core_mask(context, core_mask);
+}
+
+int rknn_matmul_run(rknn_matmul_ctx ctx)
+{
+  std::shared_ptr<MatmulContext> mm = get_matmul_context(ctx);
+  if (!mm) {
+    return RKNN_ERR_CTX_INVALID;
+  }
+  std::lock_guard<std::mutex> lock(mm->mu);
+  if (mm->A == NULL || mm->B == NULL || mm->C == NULL) {
+    printf("rknn_host_stub: rknn_matmul_run: A, B and C must be set by rknn_matmul_set_io_mem\n");
+    return RKNN_ERR_PARAM_INVALID;
+  }
+
+  // modeled NPU time: RKNN_STUB_MATMUL_OVERHEAD_US + 2*M*K*N / RKNN_STUB_MATMUL_GOPS
+  double  gops    = (double)env_int("RKNN_STUB_MATMUL_GOPS", 0);
+  int64_t latency = env_int("RKNN_STUB_MATMUL_OVERHEAD_US", 0);
+  if (gops > 0) {
+    latency += (int64_t)(2.0 * mm->info.M * mm->info.K * mm->info.N / (gops * 1e3));
+  }
+  int64_t done = device_schedule(mm->soc, mm->core_mask, now_us(), latency, NULL);
+
+  if (env_int("RKNN_STUB_MATMUL_COMPUTE", 1)) {
+    if (mm->info.type == RKNN_TENSOR_INT8) {
+      compute<int32_t>(mm.get());
+    } else {
+      compute<float>(mm.get());
+    }
+  }
+  sleep_until_us(done);
+  return RKNN_SUCC;
+}
+
+int rknn_matmul_destroy(rknn_matmul_ctx ctx)
+{
+  std::shared_ptr<Context> mm = unregister_context(ctx);
+  return mm ? RKNN_SUCC : RKNN_ERR_CTX_INVALID;
+}
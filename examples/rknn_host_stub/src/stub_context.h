@@ -0,0 +1,56 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_HOST_STUB_CONTEXT_H_
+#define _RKNN_HOST_STUB_CONTEXT_H_
+
+#include "rknn_api.h"
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace rknn_stub {
+
+/*
+  common part of model and matmul contexts, both live in the same handle space.
+ */
+struct Context
+{
+  virtual ~Context() {}
+
+  bool           is_matmul = false;
+  std::string    soc;
+  rknn_core_mask core_mask = RKNN_NPU_CORE_AUTO;
+  std::mutex     mu;
+};
+
+rknn_context             register_context(std::shared_ptr<Context> ctx);
+std::shared_ptr<Context> find_context(rknn_context handle);
+std::shared_ptr<Context> unregister_context(rknn_context handle);
+
+int64_t now_us();
+void    sleep_until_us(int64_t t_us);
+
+/* reserve the NPU cores selected by core_mask for latency_us, starting no earlier than ready_us.
+   the cores are shared by all contexts of the process, so concurrent contexts queue up as on the device.
+   returns the completion time, *start_us receives the start time. */
+int64_t device_schedule(const std::string& soc, rknn_core_mask core_mask, int64_t ready_us, int64_t latency_us,
+                        int64_t* start_us);
+
+} // namespace rknn_stub
+
+#endif //_RKNN_HOST_STUB_CONTEXT_H_
@@ -0,0 +1,838 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stub_model.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace rknn_stub {
+
+/*-------------------------------------------
+                fp16 helpers
+-------------------------------------------*/
+float half_to_float(uint16_t h)
+{
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp  = (h >> 10) & 0x1f;
+  uint32_t man  = h & 0x3ff;
+  uint32_t bits;
+
+  if (exp == 0) {
+    if (man == 0) {
+      bits = sign;
+    } else {
+      // subnormal, normalize it
+      exp = 127 - 15 + 1;
+      while ((man & 0x400) == 0) {
+        man <<= 1;
+        exp--;
+      }
+      man &= 0x3ff;
+      bits = sign | (exp << 23) | (man << 13);
+    }
+  } else if (exp == 0x1f) {
+    bits = sign | 0x7f800000 | (man << 13);
+  } else {
+    bits = sign | ((exp + 127 - 15) << 23) | (man << 13);
+  }
+
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+uint16_t float_to_half(float f)
+{
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+
+  uint16_t sign = (bits >> 16) & 0x8000;
+  uint32_t absb = bits & 0x7fffffff;
+
+  if (absb >= 0x7f800000) {
+    // inf or nan
+    return sign | (absb > 0x7f800000 ? 0x7e00 : 0x7c00);
+  }
+  if (absb >= 0x477ff000) {
+    // overflow after rounding
+    return sign | 0x7c00;
+  }
+  if (absb < 0x38800000) {
+    // subnormal or zero, round to nearest even by the fp32 adder
+    float    a = fabsf(f) + 0.5f;
+    uint32_t ab;
+    memcpy(&ab, &a, sizeof(ab));
+    return sign | (uint16_t)(ab - 0x3f000000);
+  }
+  uint32_t mant_odd = (absb >> 13) & 1;
+  absb += 0xc8000fff + mant_odd;
+  return sign | (uint16_t)(absb >> 13);
+}
+
+/*-------------------------------------------
+                tensor helpers
+-------------------------------------------*/
+size_t type_bytes(rknn_tensor_type type)
+{
+  switch (type) {
+  case RKNN_TENSOR_FLOAT32:
+  case RKNN_TENSOR_INT32:
+  case RKNN_TENSOR_UINT32:
+    return 4;
+  case RKNN_TENSOR_FLOAT16:
+  case RKNN_TENSOR_INT16:
+  case RKNN_TENSOR_UINT16:
+    return 2;
+  case RKNN_TENSOR_INT64:
+    return 8;
+  default:
+    return 1;
+  }
+}
+
+std::string soc_from_env()
+{
+  const char* soc = getenv("RKNN_STUB_SOC");
+  return soc ? std::string(soc) : std::string("rk3588");
+}
+
+int soc_core_num(const std::string& soc) { return soc == "rk3588" ? 3 : 1; }
+
+int native_c2(const std::string& soc, rknn_tensor_type type)
+{
+  // default C2 of the NC1HWC2 native layout, a tensor can override it with c2=
+  (void)soc;
+  switch (type) {
+  case RKNN_TENSOR_INT8:
+  case RKNN_TENSOR_UINT8:
+    return 16;
+  case RKNN_TENSOR_FLOAT16:
+    return 8;
+  default:
+    return 4;
+  }
+}
+
+static float load_f32(const rknn_tensor_attr& attr, const uint8_t* p)
+{
+  float scale = attr.qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC ? attr.scale : 1.f;
+  int   zp    = attr.qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC ? attr.zp : 0;
+  if (attr.qnt_type == RKNN_TENSOR_QNT_DFP) {
+    scale = ldexpf(1.f, -attr.fl);
+  }
+  switch (attr.type) {
+  case RKNN_TENSOR_FLOAT32: {
+    float v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+  case RKNN_TENSOR_FLOAT16: {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return half_to_float(v);
+  }
+  case RKNN_TENSOR_INT8:
+    return ((float)(int8_t)p[0] - zp) * scale;
+  case RKNN_TENSOR_UINT8:
+  case RKNN_TENSOR_BOOL:
+    return ((float)p[0] - zp) * scale;
+  case RKNN_TENSOR_INT16: {
+    int16_t v;
+    memcpy(&v, p, 2);
+    return ((float)v - zp) * scale;
+  }
+  case RKNN_TENSOR_UINT16: {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return ((float)v - zp) * scale;
+  }
+  case RKNN_TENSOR_INT32: {
+    int32_t v;
+    memcpy(&v, p, 4);
+    return ((float)v - zp) * scale;
+  }
+  case RKNN_TENSOR_UINT32: {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ((float)v - zp) * scale;
+  }
+  case RKNN_TENSOR_INT64: {
+    int64_t v;
+    memcpy(&v, p, 8);
+    return (float)v;
+  }
+  default:
+    return 0.f;
+  }
+}
+
+template <typename T>
+static T saturate(float v, float lo, float hi)
+{
+  v = roundf(v);
+  return (T)(v < lo ? lo : (v > hi ? hi : v));
+}
+
+static void store_f32(const rknn_tensor_attr& attr, float v, uint8_t* p)
+{
+  if (attr.qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && attr.scale != 0.f) {
+    v = v / attr.scale + attr.zp;
+  } else if (attr.qnt_type == RKNN_TENSOR_QNT_DFP) {
+    v = ldexpf(v, attr.fl);
+  }
+  switch (attr.type) {
+  case RKNN_TENSOR_FLOAT32:
+    memcpy(p, &v, 4);
+    break;
+  case RKNN_TENSOR_FLOAT16: {
+    uint16_t h = float_to_half(v);
+    memcpy(p, &h, 2);
+    break;
+  }
+  case RKNN_TENSOR_INT8:
+    p[0] = (uint8_t)saturate<int8_t>(v, -128.f, 127.f);
+    break;
+  case RKNN_TENSOR_UINT8:
+  case RKNN_TENSOR_BOOL:
+    p[0] = saturate<uint8_t>(v, 0.f, 255.f);
+    break;
+  case RKNN_TENSOR_INT16: {
+    int16_t q = saturate<int16_t>(v, -32768.f, 32767.f);
+    memcpy(p, &q, 2);
+    break;
+  }
+  case RKNN_TENSOR_UINT16: {
+    uint16_t q = saturate<uint16_t>(v, 0.f, 65535.f);
+    memcpy(p, &q, 2);
+    break;
+  }
+  case RKNN_TENSOR_INT32:
+  case RKNN_TENSOR_UINT32: {
+    int32_t q = (int32_t)roundf(v);
+    memcpy(p, &q, 4);
+    break;
+  }
+  case RKNN_TENSOR_INT64: {
+    int64_t q = (int64_t)roundf(v);
+    memcpy(p, &q, 8);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// logical N, C, H, W of a 4-D attribute
+static void logical_dims(const rknn_tensor_attr& attr, uint32_t* n, uint32_t* c, uint32_t* h, uint32_t* w)
+{
+  switch (attr.fmt) {
+  case RKNN_TENSOR_NHWC:
+    *n = attr.dims[0], *h = attr.dims[1], *w = attr.dims[2], *c = attr.dims[3];
+    break;
+  case RKNN_TENSOR_NC1HWC2:
+    *n = attr.dims[0], *c = attr.dims[1] * attr.dims[4], *h = attr.dims[2], *w = attr.dims[3];
+    break;
+  default:
+    *n = attr.dims[0], *c = attr.dims[1], *h = attr.dims[2], *w = attr.dims[3];
+    break;
+  }
+}
+
+static size_t element_offset(const rknn_tensor_attr& attr, uint32_t n, uint32_t c, uint32_t h, uint32_t w)
+{
+  switch (attr.fmt) {
+  case RKNN_TENSOR_NHWC: {
+    uint32_t ws = attr.w_stride ? attr.w_stride : attr.dims[2];
+    return (((size_t)n * attr.dims[1] + h) * ws + w) * attr.dims[3] + c;
+  }
+  case RKNN_TENSOR_NC1HWC2: {
+    uint32_t c2 = attr.dims[4];
+    return ((((size_t)n * attr.dims[1] + c / c2) * attr.dims[2] + h) * attr.dims[3] + w) * c2 + c % c2;
+  }
+  default:
+    return (((size_t)n * attr.dims[1] + c) * attr.dims[2] + h) * attr.dims[3] + w;
+  }
+}
+
+static size_t attr_bytes(const rknn_tensor_attr& attr)
+{
+  if (attr.size_with_stride > attr.size) {
+    return attr.size_with_stride;
+  }
+  return attr.size;
+}
+
+int convert_tensor(const rknn_tensor_attr& src, const void* src_data, const rknn_tensor_attr& dst, void* dst_data,
+                   uint32_t dst_size)
+{
+  const uint8_t* s      = (const uint8_t*)src_data;
+  uint8_t*       d      = (uint8_t*)dst_data;
+  size_t         s_elem = type_bytes(src.type);
+  size_t         d_elem = type_bytes(dst.type);
+  bool           same_t = src.type == dst.type && src.qnt_type == dst.qnt_type && src.zp == dst.zp &&
+               src.scale == dst.scale && src.fl == dst.fl;
+
+  bool same_layout = src.fmt == dst.fmt && src.w_stride == dst.w_stride;
+  if (src.n_dims != 4 || dst.n_dims < 4 || same_layout || src.fmt == RKNN_TENSOR_UNDEFINED ||
+      dst.fmt == RKNN_TENSOR_UNDEFINED) {
+    if ((size_t)src.n_elems * d_elem > dst_size) {
+      return RKNN_ERR_PARAM_INVALID;
+    }
+    if (same_t) {
+      memcpy(d, s, (size_t)src.n_elems * s_elem);
+    } else {
+      for (uint32_t i = 0; i < src.n_elems; ++i) {
+        store_f32(dst, load_f32(src, s + i * s_elem), d + i * d_elem);
+      }
+    }
+    return RKNN_SUCC;
+  }
+
+  if (attr_bytes(dst) > dst_size) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+
+  uint32_t N, C, H, W;
+  logical_dims(src, &N, &C, &H, &W);
+
+  // clear the padding channels / columns of the destination
+  memset(d, 0, attr_bytes(dst));
+
+  for (uint32_t n = 0; n < N; ++n) {
+    for (uint32_t c = 0; c < C; ++c) {
+      for (uint32_t h = 0; h < H; ++h) {
+        for (uint32_t w = 0; w < W; ++w) {
+          const uint8_t* sp = s + element_offset(src, n, c, h, w) * s_elem;
+          uint8_t*       dp = d + element_offset(dst, n, c, h, w) * d_elem;
+          if (same_t) {
+            memcpy(dp, sp, s_elem);
+          } else {
+            store_f32(dst, load_f32(src, sp), dp);
+          }
+        }
+      }
+    }
+  }
+  return RKNN_SUCC;
+}
+
+int convert_input(const rknn_tensor_attr& model_attr, const rknn_input& in, void* dst, uint32_t dst_size)
+{
+  if (in.buf == NULL) {
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  if (in.pass_through) {
+    memcpy(dst, in.buf, in.size < dst_size ? in.size : dst_size);
+    return RKNN_SUCC;
+  }
+
+  rknn_tensor_attr src = model_attr;
+  src.type             = in.type;
+  src.fmt              = in.fmt;
+  src.qnt_type         = RKNN_TENSOR_QNT_NONE;
+  src.w_stride         = 0;
+  if (model_attr.n_dims == 4 && in.fmt != model_attr.fmt && model_attr.fmt != RKNN_TENSOR_UNDEFINED) {
+    uint32_t N, C, H, W;
+    logical_dims(model_attr, &N, &C, &H, &W);
+    if (in.fmt == RKNN_TENSOR_NCHW) {
+      src.dims[0] = N, src.dims[1] = C, src.dims[2] = H, src.dims[3] = W;
+    } else {
+      src.dims[0] = N, src.dims[1] = H, src.dims[2] = W, src.dims[3] = C;
+    }
+  }
+  if (in.size < src.n_elems * type_bytes(in.type)) {
+    printf("rknn_host_stub: input %d size %u < %u\n", in.index, in.size, (uint32_t)(src.n_elems * type_bytes(in.type)));
+    return RKNN_ERR_PARAM_INVALID;
+  }
+  return convert_tensor(src, in.buf, model_attr, dst, dst_size);
+}
+
+void make_native_attr(const StubModel& model, const StubTensor& t, int cmd, rknn_tensor_attr* out)
+{
+  const rknn_tensor_attr& attr = t.attr;
+  uint32_t                index = out->index;
+  *out                          = attr;
+  out->index                    = index;
+
+  if (attr.n_dims != 4 || attr.fmt == RKNN_TENSOR_UNDEFINED) {
+    return;
+  }
+
+  uint32_t N, C, H, W;
+  logical_dims(attr, &N, &C, &H, &W);
+  size_t esize = type_bytes(attr.type);
+
+  bool is_input = cmd == RKNN_QUERY_NATIVE_INPUT_ATTR || cmd == RKNN_QUERY_NATIVE_NHWC_INPUT_ATTR;
+  bool nhwc     = cmd == RKNN_QUERY_NATIVE_NHWC_INPUT_ATTR || cmd == RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR;
+  // image-like inputs stay NHWC in native layout
+  if (is_input && C <= 4) {
+    nhwc = true;
+  }
+
+  if (nhwc) {
+    out->fmt     = RKNN_TENSOR_NHWC;
+    out->dims[0] = N, out->dims[1] = H, out->dims[2] = W, out->dims[3] = C;
+    if (!is_input || attr.fmt != RKNN_TENSOR_NHWC) {
+      out->w_stride = is_input ? W : 0;
+    }
+    uint32_t ws            = out->w_stride ? out->w_stride : W;
+    out->size_with_stride = N * H * ws * C * esize;
+    return;
+  }
+
+  uint32_t c2 = t.c2 ? t.c2 : native_c2(model.soc, attr.type);
+  uint32_t c1 = (C + c2 - 1) / c2;
+
+  out->fmt              = RKNN_TENSOR_NC1HWC2;
+  out->n_dims           = 5;
+  out->dims[0]          = N;
+  out->dims[1]          = c1;
+  out->dims[2]          = H;
+  out->dims[3]          = W;
+  out->dims[4]          = c2;
+  out->w_stride         = 0;
+  out->size_with_stride = N * c1 * H * W * c2 * esize;
+}
+
+/*-------------------------------------------
+              description parser
+-------------------------------------------*/
+static bool read_file(const std::string& path, std::string* out)
+{
+  std::ifstream f(path.c_str(), std::ios::binary);
+  if (!f) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << f.rdbuf();
+  *out = ss.str();
+  return true;
+}
+
+static std::string dir_name(const std::string& path)
+{
+  size_t pos = path.find_last_of('/');
+  return pos == std::string::npos ? std::string(".") : path.substr(0, pos);
+}
+
+static bool starts_with_magic(const std::string& text)
+{
+  size_t pos = text.find_first_not_of(" \t\r\n");
+  return pos != std::string::npos && text.compare(pos, strlen(RKNN_STUB_MAGIC), RKNN_STUB_MAGIC) == 0;
+}
+
+static bool parse_type(const std::string& v, rknn_tensor_type* type)
+{
+  for (int i = 0; i < RKNN_TENSOR_TYPE_MAX; ++i) {
+    if (v == get_type_string((rknn_tensor_type)i)) {
+      *type = (rknn_tensor_type)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool parse_fmt(const std::string& v, rknn_tensor_format* fmt)
+{
+  for (int i = 0; i < RKNN_TENSOR_FORMAT_MAX; ++i) {
+    if (v == get_format_string((rknn_tensor_format)i)) {
+      *fmt = (rknn_tensor_format)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool parse_qnt(const std::string& v, rknn_tensor_qnt_type* qnt)
+{
+  for (int i = 0; i < RKNN_TENSOR_QNT_MAX; ++i) {
+    if (v == get_qnt_type_string((rknn_tensor_qnt_type)i)) {
+      *qnt = (rknn_tensor_qnt_type)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// minimal .npy reader: little endian, C order
+static bool load_npy(const std::string& path, rknn_tensor_attr* attr, std::vector<uint8_t>* data, size_t* count)
+{
+  std::string buf;
+  if (!read_file(path, &buf) || buf.size() < 10 || buf.compare(0, 6, "\x93NUMPY") != 0) {
+    return false;
+  }
+  size_t hdr_len, hdr_off;
+  if ((uint8_t)buf[6] == 1) {
+    hdr_len = (uint8_t)buf[8] | ((uint8_t)buf[9] << 8);
+    hdr_off = 10;
+  } else {
+    hdr_len = (uint8_t)buf[8] | ((uint8_t)buf[9] << 8) | ((uint8_t)buf[10] << 16) | ((size_t)(uint8_t)buf[11] << 24);
+    hdr_off = 12;
+  }
+  std::string hdr = buf.substr(hdr_off, hdr_len);
+  if (hdr.find("'fortran_order': True") != std::string::npos) {
+    printf("rknn_host_stub: %s: fortran order npy is not supported\n", path.c_str());
+    return false;
+  }
+
+  size_t      d = hdr.find("'descr'");
+  size_t      q = hdr.find('\'', hdr.find(':', d) + 1);
+  std::string descr = hdr.substr(q + 1, hdr.find('\'', q + 1) - q - 1);
+  std::string code  = descr.substr(descr[0] == '<' || descr[0] == '|' || descr[0] == '=' ? 1 : 0);
+
+  static const struct
+  {
+    const char*      code;
+    rknn_tensor_type type;
+  } kTypes[] = {
+    {"f4", RKNN_TENSOR_FLOAT32}, {"f2", RKNN_TENSOR_FLOAT16}, {"i1", RKNN_TENSOR_INT8},   {"u1", RKNN_TENSOR_UINT8},
+    {"i2", RKNN_TENSOR_INT16},   {"u2", RKNN_TENSOR_UINT16},  {"i4", RKNN_TENSOR_INT32},  {"u4", RKNN_TENSOR_UINT32},
+    {"i8", RKNN_TENSOR_INT64},   {"b1", RKNN_TENSOR_BOOL},
+  };
+  bool found = false;
+  for (size_t i = 0; i < sizeof(kTypes) / sizeof(kTypes[0]); ++i) {
+    if (code == kTypes[i].code) {
+      attr->type = kTypes[i].type;
+      found      = true;
+    }
+  }
+  if (!found) {
+    printf("rknn_host_stub: %s: unsupported npy dtype %s\n", path.c_str(), descr.c_str());
+    return false;
+  }
+
+  size_t s     = hdr.find('(', hdr.find("'shape'"));
+  size_t e     = hdr.find(')', s);
+  size_t elems = 1;
+  std::stringstream shape(hdr.substr(s + 1, e - s - 1));
+  std::string       item;
+  while (std::getline(shape, item, ',')) {
+    if (item.find_first_not_of(" ") != std::string::npos) {
+      elems *= strtoull(item.c_str(), NULL, 10);
+    }
+  }
+
+  size_t data_off = hdr_off + hdr_len;
+  size_t bytes    = elems * type_bytes(attr->type);
+  if (buf.size() < data_off + bytes) {
+    return false;
+  }
+  data->assign(buf.begin() + data_off, buf.begin() + data_off + bytes);
+  *count = elems;
+  return true;
+}
+
+static int load_tensor_data(const std::string& path, const std::string& base_dir, StubTensor* t)
+{
+  std::string full = path[0] == '/' ? path : base_dir + "/" + path;
+
+  if (full.size() > 4 && full.compare(full.size() - 4, 4, ".npy") == 0) {
+    rknn_tensor_attr     src = t->attr;
+    std::vector<uint8_t> raw;
+    size_t               count = 0;
+    src.qnt_type               = RKNN_TENSOR_QNT_NONE;
+    if (!load_npy(full, &src, &raw, &count)) {
+      printf("rknn_host_stub: failed to load %s\n", full.c_str());
+      return -1;
+    }
+    if (count == 0 || count % t->attr.n_elems != 0) {
+      printf("rknn_host_stub: %s has %zu elements, not a multiple of %u\n", full.c_str(), count, t->attr.n_elems);
+      return -1;
+    }
+    // float recordings (e.g. rknn_benchmark rt_output*.npy) are quantized to the tensor type
+    if (src.type == t->attr.type) {
+      src.qnt_type = t->attr.qnt_type;
+      src.zp       = t->attr.zp;
+      src.scale    = t->attr.scale;
+    }
+    t->n_frames = count / t->attr.n_elems;
+    t->frames.resize((size_t)t->n_frames * t->attr.size);
+    size_t src_frame = (size_t)t->attr.n_elems * type_bytes(src.type);
+    src.n_dims       = 1;
+    src.n_elems      = t->attr.n_elems;
+    rknn_tensor_attr dst = t->attr;
+    dst.n_dims           = 1;
+    for (uint32_t f = 0; f < t->n_frames; ++f) {
+      convert_tensor(src, &raw[f * src_frame], dst, &t->frames[(size_t)f * t->attr.size], t->attr.size);
+    }
+    return 0;
+  }
+
+  std::string raw;
+  if (!read_file(full, &raw)) {
+    printf("rknn_host_stub: failed to load %s\n", full.c_str());
+    return -1;
+  }
+  if (raw.empty() || raw.size() % t->attr.size != 0) {
+    printf("rknn_host_stub: %s has %zu bytes, not a multiple of %u\n", full.c_str(), raw.size(), t->attr.size);
+    return -1;
+  }
+  t->n_frames = raw.size() / t->attr.size;
+  t->frames.assign(raw.begin(), raw.end());
+  return 0;
+}
+
+static void fill_tensor(const std::string& fill, uint32_t seed, StubTensor* t)
+{
+  t->n_frames = 1;
+  t->frames.resize(t->attr.size);
+
+  size_t   esize = type_bytes(t->attr.type);
+  uint32_t state = seed ? seed : 1;
+  for (uint32_t i = 0; i < t->attr.n_elems; ++i) {
+    float v = 0.f;
+    if (fill == "random") {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      float u = (state >> 8) * (1.f / 16777216.f);
+      if (t->attr.qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC) {
+        // cover the whole quantized range
+        float lo = t->attr.type == RKNN_TENSOR_UINT8 ? 0.f : -128.f;
+        v        = (lo + u * 255.f - t->attr.zp) * t->attr.scale;
+      } else {
+        v = u * 2.f - 1.f;
+      }
+    } else if (fill != "zero") {
+      v = strtof(fill.c_str(), NULL);
+    }
+    store_f32(t->attr, v, &t->frames[i * esize]);
+  }
+}
+
+static int parse_tensor(std::istringstream& ls, const std::string& base_dir, const char* prefix, uint32_t index,
+                        StubTensor* t)
+{
+  rknn_tensor_attr& attr = t->attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.index    = index;
+  attr.fmt      = RKNN_TENSOR_NCHW;
+  attr.type     = RKNN_TENSOR_INT8;
+  attr.qnt_type = RKNN_TENSOR_QNT_NONE;
+  attr.scale    = 1.f;
+  snprintf(attr.name, sizeof(attr.name), "%s%u", prefix, index);
+
+  std::string data, fill = "zero";
+  uint32_t    seed = index + 1;
+  std::string tok;
+  while (ls >> tok) {
+    size_t eq = tok.find('=');
+    if (eq == std::string::npos) {
+      printf("rknn_host_stub: bad token '%s'\n", tok.c_str());
+      return -1;
+    }
+    std::string key = tok.substr(0, eq);
+    std::string val = tok.substr(eq + 1);
+    if (key == "name") {
+      snprintf(attr.name, sizeof(attr.name), "%s", val.c_str());
+    } else if (key == "dims") {
+      std::stringstream ds(val);
+      std::string       d;
+      attr.n_dims = 0;
+      while (std::getline(ds, d, ',') && attr.n_dims < RKNN_MAX_DIMS) {
+        attr.dims[attr.n_dims++] = strtoul(d.c_str(), NULL, 10);
+      }
+    } else if (key == "fmt") {
+      if (!parse_fmt(val, &attr.fmt)) {
+        printf("rknn_host_stub: bad fmt '%s'\n", val.c_str());
+        return -1;
+      }
+    } else if (key == "type") {
+      if (!parse_type(val, &attr.type)) {
+        printf("rknn_host_stub: bad type '%s'\n", val.c_str());
+        return -1;
+      }
+    } else if (key == "qnt") {
+      if (!parse_qnt(val, &attr.qnt_type)) {
+        printf("rknn_host_stub: bad qnt '%s'\n", val.c_str());
+        return -1;
+      }
+    } else if (key == "zp") {
+      attr.zp = atoi(val.c_str());
+    } else if (key == "scale") {
+      attr.scale = strtof(val.c_str(), NULL);
+    } else if (key == "fl") {
+      attr.fl = atoi(val.c_str());
+    } else if (key == "w_stride") {
+      attr.w_stride = strtoul(val.c_str(), NULL, 10);
+    } else if (key == "c2") {
+      t->c2 = strtoul(val.c_str(), NULL, 10);
+    } else if (key == "data") {
+      data = val;
+    } else if (key == "fill") {
+      fill = val;
+    } else if (key == "seed") {
+      seed = strtoul(val.c_str(), NULL, 10);
+    } else {
+      printf("rknn_host_stub: unknown key '%s'\n", key.c_str());
+      return -1;
+    }
+  }
+  if (attr.n_dims == 0) {
+    printf("rknn_host_stub: %s has no dims\n", attr.name);
+    return -1;
+  }
+
+  attr.n_elems = 1;
+  for (uint32_t i = 0; i < attr.n_dims; ++i) {
+    attr.n_elems *= attr.dims[i];
+  }
+  size_t esize          = type_bytes(attr.type);
+  attr.size             = attr.n_elems * esize;
+  attr.size_with_stride = attr.size;
+  if (attr.n_dims == 4 && attr.fmt == RKNN_TENSOR_NHWC && attr.w_stride > attr.dims[2]) {
+    attr.size_with_stride = attr.dims[0] * attr.dims[1] * attr.w_stride * attr.dims[3] * esize;
+  } else if (attr.w_stride == 0 && attr.n_dims == 4 && attr.fmt == RKNN_TENSOR_NHWC && prefix[0] == 'i') {
+    attr.w_stride = attr.dims[2];
+  }
+
+  if (!data.empty()) {
+    return load_tensor_data(data, base_dir, t);
+  }
+  fill_tensor(fill, seed, t);
+  return 0;
+}
+
+static int parse_model(const std::string& text, const std::string& base_dir, StubModel* model)
+{
+  std::istringstream in(text);
+  std::string        line;
+  int                line_no = 0;
+
+  model->soc = soc_from_env();
+
+  while (std::getline(in, line)) {
+    line_no++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.erase(hash);
+    }
+    std::istringstream ls(line);
+    std::string        key;
+    if (!(ls >> key)) {
+      continue;
+    }
+
+    int ret = 0;
+    if (key == RKNN_STUB_MAGIC) {
+      continue;
+    } else if (key == "soc") {
+      ls >> model->soc;
+    } else if (key == "custom_string") {
+      std::getline(ls >> std::ws, model->custom_string);
+    } else if (key == "run_us") {
+      ls >> model->run_us;
+    } else if (key == "run_jitter_us") {
+      ls >> model->run_jitter_us;
+    } else if (key == "weight_size") {
+      ls >> model->weight_size;
+    } else if (key == "internal_size") {
+      ls >> model->internal_size;
+    } else if (key == "input") {
+      model->inputs.push_back(StubTensor());
+      ret = parse_tensor(ls, base_dir, "input", model->inputs.size() - 1, &model->inputs.back());
+    } else if (key == "output") {
+      model->outputs.push_back(StubTensor());
+      ret = parse_tensor(ls, base_dir, "output", model->outputs.size() - 1, &model->outputs.back());
+    } else if (key == "op") {
+      StubOp      op;
+      std::string tok;
+      op.id = model->ops.size() + 1;
+      while (ls >> tok) {
+        size_t      eq  = tok.find('=');
+        std::string k   = tok.substr(0, eq);
+        std::string v   = eq == std::string::npos ? "" : tok.substr(eq + 1);
+        if (k == "id") {
+          op.id = atoi(v.c_str());
+        } else if (k == "type") {
+          op.type = v;
+        } else if (k == "target") {
+          op.target = v;
+        } else if (k == "dtype") {
+          op.data_type = v;
+        } else if (k == "time_us") {
+          op.time_us = strtoll(v.c_str(), NULL, 10);
+        } else if (k == "name") {
+          op.name = v;
+        } else if (k == "in_shape") {
+          op.in_shape = v;
+        } else if (k == "out_shape") {
+          op.out_shape = v;
+        }
+      }
+      model->ops.push_back(op);
+    } else {
+      printf("rknn_host_stub: line %d: unknown key '%s'\n", line_no, key.c_str());
+      return RKNN_ERR_MODEL_INVALID;
+    }
+    if (ret < 0) {
+      printf("rknn_host_stub: line %d: invalid tensor description\n", line_no);
+      return RKNN_ERR_MODEL_INVALID;
+    }
+  }
+
+  if (model->inputs.empty() || model->outputs.empty()) {
+    printf("rknn_host_stub: model description needs at least one input and one output\n");
+    return RKNN_ERR_MODEL_INVALID;
+  }
+  return RKNN_SUCC;
+}
+
+int load_model(const void* model, uint32_t size, StubModel* out)
+{
+  std::string text;
+  std::string base_dir = ".";
+  const char* env_cfg  = getenv("RKNN_STUB_CONFIG");
+
+  if (size == 0) {
+    std::string path = (const char*)model;
+    if (!read_file(path, &text)) {
+      printf("rknn_host_stub: failed to open %s\n", path.c_str());
+      return RKNN_ERR_MODEL_INVALID;
+    }
+    base_dir = dir_name(path);
+    if (!starts_with_magic(text)) {
+      // a real rknn model, look for its description next to it
+      std::string cfg = env_cfg ? std::string(env_cfg) : path + ".stub";
+      if (!read_file(cfg, &text)) {
+        printf("rknn_host_stub: %s is not a stub description and %s is missing\n", path.c_str(), cfg.c_str());
+        return RKNN_ERR_MODEL_INVALID;
+      }
+      base_dir = dir_name(cfg);
+    }
+  } else {
+    text.assign((const char*)model, size);
+    if (!starts_with_magic(text)) {
+      if (env_cfg == NULL || !read_file(env_cfg, &text)) {
+        printf("rknn_host_stub: model buffer is not a stub description, set RKNN_STUB_CONFIG\n");
+        return RKNN_ERR_MODEL_INVALID;
+      }
+      base_dir = dir_name(env_cfg);
+    }
+  }
+
+  if (!starts_with_magic(text)) {
+    printf("rknn_host_stub: description must start with '%s'\n", RKNN_STUB_MAGIC);
+    return RKNN_ERR_MODEL_INVALID;
+  }
+  return parse_model(text, base_dir, out);
+}
+
+} // namespace rknn_stub
@@ -0,0 +1,97 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_HOST_STUB_MODEL_H_
+#define _RKNN_HOST_STUB_MODEL_H_
+
+#include "rknn_api.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace rknn_stub {
+
+/*
+  one input or output tensor of a stub model description.
+  recorded frames are stored in attr.fmt / attr.type, attr.size bytes per frame.
+ */
+struct StubTensor
+{
+  rknn_tensor_attr     attr;
+  std::vector<uint8_t> frames;
+  uint32_t             n_frames = 0;
+  uint32_t             c2       = 0; // NC1HWC2 channel block of the native layout, 0 means SoC default
+};
+
+/*
+  one row of the synthetic RKNN_QUERY_PERF_DETAIL table.
+ */
+struct StubOp
+{
+  int         id = 0;
+  std::string type;
+  std::string target;
+  std::string data_type;
+  int64_t     time_us = 0;
+  std::string name;
+  std::string in_shape; // InputShape / OutputShape columns, empty: a backslash
+  std::string out_shape;
+};
+
+struct StubModel
+{
+  std::string             soc = "rk3588";
+  std::string             custom_string;
+  int64_t                 run_us        = 1000; // modeled NPU latency of one rknn_run on a single core
+  int64_t                 run_jitter_us = 0;    // uniform jitter added to run_us
+  uint32_t                weight_size   = 0;
+  uint32_t                internal_size = 0;
+  std::vector<StubTensor> inputs;
+  std::vector<StubTensor> outputs;
+  std::vector<StubOp>     ops;
+};
+
+// stub description files must start with this magic line
+#define RKNN_STUB_MAGIC "rknn_host_stub"
+
+/* load a stub model description.
+   if size == 0, model is a file path, otherwise a buffer holding the description text.
+   a real .rknn file is accepted too, the description is then taken from $RKNN_STUB_CONFIG or "<path>.stub". */
+int load_model(const void* model, uint32_t size, StubModel* out);
+
+std::string soc_from_env();
+int         soc_core_num(const std::string& soc);
+
+size_t type_bytes(rknn_tensor_type type);
+int    native_c2(const std::string& soc, rknn_tensor_type type);
+
+/* fill *out with the attribute returned for the native query cmd of tensor t. */
+void make_native_attr(const StubModel& model, const StubTensor& t, int cmd, rknn_tensor_attr* out);
+
+/* convert one recorded frame of tensor src into a buffer described by dst (layout, type, stride). */
+int convert_tensor(const rknn_tensor_attr& src, const void* src_data, const rknn_tensor_attr& dst, void* dst_data,
+                   uint32_t dst_size);
+
+/* copy a user input buffer (rknn_input) into the model input layout, as the runtime does before a run. */
+int convert_input(const rknn_tensor_attr& model_attr, const rknn_input& in, void* dst, uint32_t dst_size);
+
+float    half_to_float(uint16_t h);
+uint16_t float_to_half(float f);
+
+} // namespace rknn_stub
+
+#endif //_RKNN_HOST_STUB_MODEL_H_
@@ -1,6 +1,19 @@
 #ifndef _RKNPU2_RKNN_MATMUL_API_DEMO_H_
 #define _RKNPU2_RKNN_MATMUL_API_DEMO_H_
 
+#include <stddef.h>
+
+#include "rknn_fp16.h"
+
+// the fp16 kernels of matmul_cpu.cc / matmul_epilogue.cc
+#if defined(__aarch64__) || ((defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__ARM_FP) && (__ARM_FP & 2))
+#include <arm_neon.h>
+#define FLOAT16_NEON_CVT 1
+#elif defined(__F16C__)
+#include <immintrin.h>
+#define FLOAT16_F16C_CVT 1
+#endif
+
 namespace rknpu2 {
 
 using ushort = unsigned short;
@@ -180,6 +193,21 @@ protected:
   ushort w = 0;
 };
 
+/*
+  bulk conversion of arrays, with the round to nearest even of float16::bits() / operator float(), by the
+  rknn_convert_fp* functions of examples/utils (NEON fcvt on ARM, F16C on x86 CPUs that have it).
+  only the payload of NaNs may differ from the class.
+*/
+inline void convertFloat32ToFloat16(const float* src, float16* dst, size_t count)
+{
+  rknn_convert_fp32_to_fp16(src, reinterpret_cast<ushort*>(dst), count);
+}
+
+inline void convertFloat16ToFloat32(const float16* src, float* dst, size_t count)
+{
+  rknn_convert_fp16_to_fp32(reinterpret_cast<const ushort*>(src), dst, count);
+}
+
 } // namespace rknn
 
 #endif /* _RKNPU2_RKNN_MATMUL_API_DEMO_H_ */
\ No newline at end of file
@@ -0,0 +1,391 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+// default buckets: powers of two up to 256, multiples of 256 beyond
+static const int32_t kDefaultBuckets[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// B memory of one weight matrix, created by the context of its first use and imported by the others
+struct SharedB
+{
+  const void*      weights;
+  int32_t          K;
+  int32_t          N;
+  rknn_matmul_ctx  owner; // destroyed with the last reference, it may outlive its cache entry
+  rknn_tensor_mem* mem;
+  int32_t          refs;
+};
+
+struct CacheKey
+{
+  int32_t     M;
+  int32_t     K;
+  int32_t     N;
+  const void* weights;
+
+  bool operator<(const CacheKey& other) const
+  {
+    if (M != other.M) {
+      return M < other.M;
+    }
+    if (K != other.K) {
+      return K < other.K;
+    }
+    if (N != other.N) {
+      return N < other.N;
+    }
+    return weights < other.weights;
+  }
+};
+
+struct CacheEntry
+{
+  matmul_cache_entry pub;
+  CacheKey           key;
+  SharedB*           shared_b; // NULL: B could not be imported and is private to the entry
+  bool               b_owner;
+  size_t             bytes; // A and C, plus B when private
+};
+
+struct _matmul_cache
+{
+  matmul_cache_config  config;
+  std::vector<int32_t> buckets;
+
+  std::list<CacheEntry*>                               lru; // most recently used first
+  std::map<CacheKey, std::list<CacheEntry*>::iterator> entries;
+  std::map<CacheKey, SharedB*>                         shared_b; // keyed with M = 0
+  matmul_cache_stats                                   stats;
+
+  std::vector<uint8_t> scratch_a; // A / C of an M below the bucket, padded to the bucket
+  std::vector<uint8_t> scratch_c;
+};
+
+static uint32_t elem_bytes(rknn_tensor_type type)
+{
+  return type == RKNN_TENSOR_INT8 ? 1 : 2;
+}
+
+/*-------------------------------------------
+                  entries
+-------------------------------------------*/
+static int fill_B(const matmul_cache_entry* e, const void* weights, rknn_tensor_mem* mem)
+{
+  if (e->io_attr.B.n_dims == 2) {
+    memcpy(mem->virt_addr, weights, (size_t)e->info.K * e->info.N * elem_bytes(e->info.type));
+    return 0;
+  }
+  return matmul_pack_B(&e->layout, weights, 0, mem->virt_addr);
+}
+
+static void release_shared_b(matmul_cache* cache, SharedB* s)
+{
+  if (--s->refs > 0) {
+    return;
+  }
+  CacheKey key = {0, s->K, s->N, s->weights};
+  cache->shared_b.erase(key);
+  cache->stats.mem_bytes -= s->mem->size;
+  rknn_destroy_mem(s->owner, s->mem);
+  rknn_matmul_destroy(s->owner);
+  delete s;
+}
+
+static void destroy_entry(matmul_cache* cache, CacheEntry* e)
+{
+  matmul_cache_entry* p = &e->pub;
+  if (p->A != NULL) {
+    rknn_destroy_mem(p->ctx, p->A);
+  }
+  if (p->C != NULL) {
+    rknn_destroy_mem(p->ctx, p->C);
+  }
+  // the owner keeps B and its context until the last importer is gone
+  if (p->B != NULL && !e->b_owner) {
+    rknn_destroy_mem(p->ctx, p->B);
+  }
+  if (!e->b_owner) {
+    rknn_matmul_destroy(p->ctx);
+  }
+  if (e->shared_b != NULL) {
+    release_shared_b(cache, e->shared_b);
+  }
+  cache->stats.mem_bytes -= e->bytes;
+  delete e;
+}
+
+static CacheEntry* create_entry(matmul_cache* cache, const CacheKey& key)
+{
+  CacheEntry* e = new CacheEntry;
+  memset(&e->pub, 0, sizeof(matmul_cache_entry));
+  e->key      = key;
+  e->shared_b = NULL;
+  e->b_owner  = false;
+  e->bytes    = 0;
+
+  matmul_cache_entry* p = &e->pub;
+  p->info.M             = key.M;
+  p->info.K             = key.K;
+  p->info.N             = key.N;
+  p->info.type          = cache->config.type;
+  p->info.native_layout = cache->config.native_layout;
+  p->info.perf_layout   = cache->config.perf_layout;
+  int ret               = rknn_matmul_create(&p->ctx, &p->info, &p->io_attr);
+  if (ret < 0) {
+    printf("rknn_matmul_create fail! ret=%d\n", ret);
+    delete e;
+    return NULL;
+  }
+  if (matmul_layout_from_attr(&p->info, &p->io_attr, &p->layout) != 0) {
+    destroy_entry(cache, e);
+    return NULL;
+  }
+  p->A = rknn_create_mem(p->ctx, p->io_attr.A.size);
+  p->C = rknn_create_mem(p->ctx, p->io_attr.C.size);
+  if (p->A == NULL || p->C == NULL) {
+    printf("rknn_create_mem fail!\n");
+    destroy_entry(cache, e);
+    return NULL;
+  }
+  e->bytes = p->A->size + p->C->size;
+  cache->stats.mem_bytes += e->bytes;
+
+  // B: imported from another bucket of the same weights, or created and filled here
+  CacheKey                               b_key = {0, key.K, key.N, key.weights};
+  std::map<CacheKey, SharedB*>::iterator it    = cache->shared_b.find(b_key);
+  if (it != cache->shared_b.end() && it->second->mem->size >= p->io_attr.B.size) {
+    rknn_tensor_mem* m = it->second->mem;
+    p->B               = rknn_create_mem_from_fd(p->ctx, m->fd, m->virt_addr, m->size, m->offset);
+    if (p->B != NULL) {
+      e->shared_b = it->second;
+      ++e->shared_b->refs;
+      ++cache->stats.b_shared;
+    }
+  }
+  if (p->B == NULL) {
+    p->B = rknn_create_mem(p->ctx, p->io_attr.B.size);
+    if (p->B == NULL) {
+      printf("rknn_create_mem fail!\n");
+      destroy_entry(cache, e);
+      return NULL;
+    }
+    if (it == cache->shared_b.end()) {
+      SharedB* s  = new SharedB;
+      s->weights  = key.weights;
+      s->K        = key.K;
+      s->N        = key.N;
+      s->owner    = p->ctx;
+      s->mem      = p->B;
+      s->refs     = 1;
+      e->shared_b = s;
+      e->b_owner  = true;
+      cache->shared_b[b_key] = s;
+      cache->stats.mem_bytes += p->B->size;
+    } else {
+      e->bytes += p->B->size;
+      cache->stats.mem_bytes += p->B->size;
+    }
+    if (fill_B(p, key.weights, p->B) != 0) {
+      destroy_entry(cache, e);
+      return NULL;
+    }
+  }
+
+  if ((ret = rknn_matmul_set_io_mem(p->ctx, p->A, &p->io_attr.A)) < 0 ||
+      (ret = rknn_matmul_set_io_mem(p->ctx, p->B, &p->io_attr.B)) < 0 ||
+      (ret = rknn_matmul_set_io_mem(p->ctx, p->C, &p->io_attr.C)) < 0) {
+    printf("rknn_matmul_set_io_mem fail! ret=%d\n", ret);
+    destroy_entry(cache, e);
+    return NULL;
+  }
+  return e;
+}
+
+// least recently used first, never the entry just handed out
+static void evict(matmul_cache* cache)
+{
+  while (cache->config.mem_budget > 0 && cache->stats.mem_bytes > cache->config.mem_budget && cache->lru.size() > 1) {
+    CacheEntry* e = cache->lru.back();
+    cache->lru.pop_back();
+    cache->entries.erase(e->key);
+    destroy_entry(cache, e);
+    ++cache->stats.evictions;
+  }
+}
+
+/*-------------------------------------------
+                  cache api
+-------------------------------------------*/
+int matmul_cache_create(const matmul_cache_config* config, matmul_cache** cache)
+{
+  *cache = NULL;
+  if (config->type != RKNN_TENSOR_INT8 && config->type != RKNN_TENSOR_FLOAT16) {
+    printf("matmul_cache_create: type %s is not supported\n", get_type_string(config->type));
+    return -1;
+  }
+  matmul_cache* c = new matmul_cache;
+  c->config       = *config;
+  if (config->m_buckets != NULL && config->num_m_buckets > 0) {
+    c->buckets.assign(config->m_buckets, config->m_buckets + config->num_m_buckets);
+  } else {
+    c->buckets.assign(kDefaultBuckets, kDefaultBuckets + sizeof(kDefaultBuckets) / sizeof(kDefaultBuckets[0]));
+  }
+  for (size_t i = 0; i < c->buckets.size(); ++i) {
+    if (c->buckets[i] <= 0 || (i > 0 && c->buckets[i] <= c->buckets[i - 1])) {
+      printf("matmul_cache_create: M buckets must be positive and ascending\n");
+      delete c;
+      return -1;
+    }
+  }
+  c->config.m_buckets     = NULL;
+  c->config.num_m_buckets = (int32_t)c->buckets.size();
+  memset(&c->stats, 0, sizeof(matmul_cache_stats));
+  *cache = c;
+  return 0;
+}
+
+int32_t matmul_cache_bucket(const matmul_cache* cache, int32_t M)
+{
+  for (size_t i = 0; i < cache->buckets.size(); ++i) {
+    if (M <= cache->buckets[i]) {
+      return cache->buckets[i];
+    }
+  }
+  int32_t last = cache->buckets.back();
+  return (M + last - 1) / last * last;
+}
+
+int matmul_cache_get(matmul_cache* cache, int32_t M, int32_t K, int32_t N, const void* B, matmul_cache_entry** entry)
+{
+  *entry = NULL;
+  if (M <= 0 || B == NULL) {
+    printf("matmul_cache_get: invalid M=%d or B\n", M);
+    return -1;
+  }
+  CacheKey key = {matmul_cache_bucket(cache, M), K, N, B};
+
+  std::map<CacheKey, std::list<CacheEntry*>::iterator>::iterator it = cache->entries.find(key);
+  if (it != cache->entries.end()) {
+    cache->lru.splice(cache->lru.begin(), cache->lru, it->second);
+    ++cache->stats.hits;
+    *entry = &(*it->second)->pub;
+    return 0;
+  }
+
+  int64_t     start_us = getCurrentTimeUs();
+  CacheEntry* e        = create_entry(cache, key);
+  if (e == NULL) {
+    return -1;
+  }
+  cache->lru.push_front(e);
+  cache->entries[key] = cache->lru.begin();
+  ++cache->stats.misses;
+  cache->stats.create_us += getCurrentTimeUs() - start_us;
+  evict(cache);
+  *entry = &e->pub;
+  return 0;
+}
+
+int matmul_cache_run(matmul_cache* cache, matmul_cache_entry* entry, const void* A, int32_t M, void* C)
+{
+  const rknn_matmul_info* info = &entry->info;
+  if (M <= 0 || M > info->M) {
+    printf("matmul_cache_run: M=%d does not fit the bucket %d\n", M, info->M);
+    return -1;
+  }
+  size_t a_bytes = (size_t)M * info->K * elem_bytes(info->type);
+  size_t c_bytes = (size_t)M * info->N * sizeof(float);
+
+  // rows of A beyond M keep what they held, the rows of C they produce are not read
+  if (entry->io_attr.A.n_dims == 2) {
+    memcpy(entry->A->virt_addr, A, a_bytes);
+  } else {
+    const void* a = A;
+    if (M < info->M) {
+      cache->scratch_a.resize((size_t)info->M * info->K * elem_bytes(info->type));
+      memcpy(cache->scratch_a.data(), A, a_bytes);
+      a = cache->scratch_a.data();
+    }
+    if (matmul_pack_A(&entry->layout, a, 0, entry->A->virt_addr) != 0) {
+      return -1;
+    }
+  }
+
+  int ret = rknn_matmul_run(entry->ctx);
+  if (ret < 0) {
+    printf("rknn_matmul_run fail! ret=%d\n", ret);
+    return -1;
+  }
+
+  if (entry->io_attr.C.n_dims == 2) {
+    memcpy(C, entry->C->virt_addr, c_bytes);
+  } else if (M == info->M) {
+    return matmul_unpack_C(&entry->layout, entry->C->virt_addr, C, 0);
+  } else {
+    cache->scratch_c.resize((size_t)info->M * info->N * sizeof(float));
+    if (matmul_unpack_C(&entry->layout, entry->C->virt_addr, cache->scratch_c.data(), 0) != 0) {
+      return -1;
+    }
+    memcpy(C, cache->scratch_c.data(), c_bytes);
+  }
+  return 0;
+}
+
+void matmul_cache_get_stats(const matmul_cache* cache, matmul_cache_stats* stats)
+{
+  *stats          = cache->stats;
+  stats->contexts = (int32_t)cache->lru.size();
+}
+
+void matmul_cache_dump(const matmul_cache* cache)
+{
+  const matmul_cache_stats* s        = &cache->stats;
+  int64_t                   requests = s->hits + s->misses;
+  double                    per_miss = s->misses ? (double)s->create_us / s->misses : 0.;
+  printf("matmul cache: %zu contexts, %.2f MB, %lld requests, hit rate %.1f%%, %lld evictions, %lld B shared\n",
+         cache->lru.size(), s->mem_bytes / (1024. * 1024.), (long long)requests,
+         requests ? 100. * s->hits / requests : 0., (long long)s->evictions, (long long)s->b_shared);
+  printf("matmul cache: create %.2f ms on %lld misses (%.3f ms each), ~%.2f ms saved by %lld hits\n",
+         s->create_us / 1000., (long long)s->misses, per_miss / 1000., per_miss * s->hits / 1000.,
+         (long long)s->hits);
+}
+
+void matmul_cache_destroy(matmul_cache* cache)
+{
+  if (cache == NULL) {
+    return;
+  }
+  while (!cache->lru.empty()) {
+    CacheEntry* e = cache->lru.back();
+    cache->lru.pop_back();
+    destroy_entry(cache, e);
+  }
+  delete cache;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNPU2_MATMUL_CACHE_H_
+#define _RKNPU2_MATMUL_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matmul_layout.h"
+#include "rknn_matmul_api.h"
+
+/*
+  matmul contexts kept alive across calls, so that a varying M (sequence lengths) does not pay rknn_matmul_create(),
+  rknn_create_mem() and rknn_matmul_set_io_mem() on every call.
+  M is rounded up to a bucket, contexts are looked up by (bucket, K, N, B). the B memory of one weight matrix is
+  filled once and shared by the contexts of all buckets through rknn_create_mem_from_fd(). the least recently used
+  contexts are destroyed when the A / B / C memory goes beyond the budget.
+  not thread safe, one cache per thread.
+*/
+
+typedef struct _matmul_cache_config
+{
+  rknn_tensor_type type; // RKNN_TENSOR_INT8 or RKNN_TENSOR_FLOAT16
+  int32_t          native_layout;
+  int32_t          perf_layout;
+  size_t           mem_budget;    // bytes of A / B / C memory, 0: no limit
+  const int32_t*   m_buckets;     // ascending padded M, NULL: powers of two. beyond the last: multiples of it
+  int32_t          num_m_buckets;
+} matmul_cache_config;
+
+typedef struct _matmul_cache_entry
+{
+  rknn_matmul_ctx     ctx;
+  rknn_matmul_info    info; // info.M is the bucket
+  rknn_matmul_io_attr io_attr;
+  matmul_layout       layout; // block sizes of the perf / native tensors
+  rknn_tensor_mem*    A;
+  rknn_tensor_mem*    B;
+  rknn_tensor_mem*    C;
+} matmul_cache_entry;
+
+typedef struct _matmul_cache_stats
+{
+  int64_t hits;
+  int64_t misses;
+  int64_t evictions;
+  int64_t b_shared;  // misses that found the B of their weights already filled
+  int64_t create_us; // spent in creating contexts and memory on misses
+  size_t  mem_bytes; // A / B / C memory alive
+  int32_t contexts;
+} matmul_cache_stats;
+
+typedef struct _matmul_cache matmul_cache;
+
+int matmul_cache_create(const matmul_cache_config* config, matmul_cache** cache);
+
+/* context for an M x K x N matmul with the weights B (K, N) in normal layout. B is identified by its address and is
+   copied / packed into the context on the first use only, it must not change while the cache holds it.
+   the entry stays valid until the next matmul_cache_get(). returns 0 or -1. */
+int matmul_cache_get(matmul_cache* cache, int32_t M, int32_t K, int32_t N, const void* B, matmul_cache_entry** entry);
+
+/* loads A (M, K), runs and reads C (M, N) back, all in normal layout. M may be below the bucket of the entry. */
+int matmul_cache_run(matmul_cache* cache, matmul_cache_entry* entry, const void* A, int32_t M, void* C);
+
+/* bucket of M, the M of the context that serves it */
+int32_t matmul_cache_bucket(const matmul_cache* cache, int32_t M);
+
+void matmul_cache_get_stats(const matmul_cache* cache, matmul_cache_stats* stats);
+
+// prints hit rate, evictions and the create time saved by the hits
+void matmul_cache_dump(const matmul_cache* cache);
+
+void matmul_cache_destroy(matmul_cache* cache);
+
+#endif //_RKNPU2_MATMUL_CACHE_H_
@@ -0,0 +1,400 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_cpu.h"
+#include "Float16.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CPU_BLOCK_K     256
+#define CPU_BLOCK_N     256
+#define CPU_ROWS        4 // rows of A per kernel call
+#define CPU_COLS        8 // columns of C per kernel call
+#define CPU_MAX_THREADS 16
+// multiply-adds a thread has to get before it is worth starting
+#define CPU_MIN_MACS (1 << 20)
+
+using rknpu2::float16;
+
+struct CpuJob
+{
+  rknn_tensor_type type;
+  const void*      A; // int8, or float16 A converted to float32
+  const void*      B;
+  void*            C;
+  int32_t          K;
+  int32_t          N;
+  int32_t          m_begin;
+  int32_t          m_end;
+  int32_t          n_begin;
+  int32_t          n_end;
+};
+
+/*-------------------------------------------
+                  kernels
+-------------------------------------------*/
+/* R rows x 8 columns of C over kc values of K: C = acc for the first block of K, C += acc for the others. */
+template <int R>
+static void kernel_i8(const int8_t* a, int32_t lda, const int8_t* b, int32_t ldb, int32_t kc, int32_t* c,
+                      int32_t ldc, bool first)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  int32x4_t acc[R][2];
+  for (int r = 0; r < R; ++r) {
+    acc[r][0] = acc[r][1] = vdupq_n_s32(0);
+  }
+  for (int32_t k = 0; k < kc; ++k) {
+    int16x8_t bk = vmovl_s8(vld1_s8(b + (size_t)k * ldb));
+    for (int r = 0; r < R; ++r) {
+      int16_t av = a[(size_t)r * lda + k];
+      acc[r][0]  = vmlal_n_s16(acc[r][0], vget_low_s16(bk), av);
+      acc[r][1]  = vmlal_n_s16(acc[r][1], vget_high_s16(bk), av);
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    int32_t* cr = c + (size_t)r * ldc;
+    if (!first) {
+      acc[r][0] = vaddq_s32(acc[r][0], vld1q_s32(cr));
+      acc[r][1] = vaddq_s32(acc[r][1], vld1q_s32(cr + 4));
+    }
+    vst1q_s32(cr, acc[r][0]);
+    vst1q_s32(cr + 4, acc[r][1]);
+  }
+#elif defined(__SSE2__)
+  // two rows of B interleaved, so that one madd gives a[k] * b[k] + a[k + 1] * b[k + 1] for 4 columns
+  __m128i acc[R][2];
+  for (int r = 0; r < R; ++r) {
+    acc[r][0] = acc[r][1] = _mm_setzero_si128();
+  }
+  for (int32_t k = 0; k < kc; k += 2) {
+    bool    pair = k + 1 < kc;
+    __m128i b0   = _mm_loadl_epi64((const __m128i*)(b + (size_t)k * ldb));
+    __m128i b1   = pair ? _mm_loadl_epi64((const __m128i*)(b + (size_t)(k + 1) * ldb)) : _mm_setzero_si128();
+    b0           = _mm_srai_epi16(_mm_unpacklo_epi8(b0, b0), 8);
+    b1           = _mm_srai_epi16(_mm_unpacklo_epi8(b1, b1), 8);
+    __m128i lo   = _mm_unpacklo_epi16(b0, b1);
+    __m128i hi   = _mm_unpackhi_epi16(b0, b1);
+    for (int r = 0; r < R; ++r) {
+      const int8_t* ar = a + (size_t)r * lda + k;
+      uint32_t      a0 = (uint16_t)(int16_t)ar[0];
+      uint32_t      a1 = pair ? (uint16_t)(int16_t)ar[1] : 0;
+      __m128i       av = _mm_set1_epi32((int32_t)(a0 | (a1 << 16)));
+      acc[r][0]        = _mm_add_epi32(acc[r][0], _mm_madd_epi16(lo, av));
+      acc[r][1]        = _mm_add_epi32(acc[r][1], _mm_madd_epi16(hi, av));
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    __m128i* cr = (__m128i*)(c + (size_t)r * ldc);
+    if (!first) {
+      acc[r][0] = _mm_add_epi32(acc[r][0], _mm_loadu_si128(cr));
+      acc[r][1] = _mm_add_epi32(acc[r][1], _mm_loadu_si128(cr + 1));
+    }
+    _mm_storeu_si128(cr, acc[r][0]);
+    _mm_storeu_si128(cr + 1, acc[r][1]);
+  }
+#else
+  int32_t acc[R][CPU_COLS];
+  memset(acc, 0, sizeof(acc));
+  for (int32_t k = 0; k < kc; ++k) {
+    const int8_t* bk = b + (size_t)k * ldb;
+    for (int r = 0; r < R; ++r) {
+      int32_t av = a[(size_t)r * lda + k];
+      for (int j = 0; j < CPU_COLS; ++j) {
+        acc[r][j] += av * bk[j];
+      }
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    for (int j = 0; j < CPU_COLS; ++j) {
+      c[(size_t)r * ldc + j] = first ? acc[r][j] : c[(size_t)r * ldc + j] + acc[r][j];
+    }
+  }
+#endif
+}
+
+template <int R>
+static void kernel_f16(const float* a, int32_t lda, const uint16_t* b, int32_t ldb, int32_t kc, float* c,
+                       int32_t ldc, bool first)
+{
+#if defined(FLOAT16_NEON_CVT)
+  float32x4_t acc[R][2];
+  for (int r = 0; r < R; ++r) {
+    acc[r][0] = acc[r][1] = vdupq_n_f32(0.f);
+  }
+  for (int32_t k = 0; k < kc; ++k) {
+    uint16x8_t  h  = vld1q_u16(b + (size_t)k * ldb);
+    float32x4_t b0 = vcvt_f32_f16(vreinterpret_f16_u16(vget_low_u16(h)));
+    float32x4_t b1 = vcvt_f32_f16(vreinterpret_f16_u16(vget_high_u16(h)));
+    for (int r = 0; r < R; ++r) {
+      float av  = a[(size_t)r * lda + k];
+      acc[r][0] = vmlaq_n_f32(acc[r][0], b0, av);
+      acc[r][1] = vmlaq_n_f32(acc[r][1], b1, av);
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    float* cr = c + (size_t)r * ldc;
+    if (!first) {
+      acc[r][0] = vaddq_f32(acc[r][0], vld1q_f32(cr));
+      acc[r][1] = vaddq_f32(acc[r][1], vld1q_f32(cr + 4));
+    }
+    vst1q_f32(cr, acc[r][0]);
+    vst1q_f32(cr + 4, acc[r][1]);
+  }
+#elif defined(FLOAT16_F16C_CVT)
+  __m256 acc[R];
+  for (int r = 0; r < R; ++r) {
+    acc[r] = _mm256_setzero_ps();
+  }
+  for (int32_t k = 0; k < kc; ++k) {
+    __m256 bk = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(b + (size_t)k * ldb)));
+    for (int r = 0; r < R; ++r) {
+      acc[r] = _mm256_add_ps(acc[r], _mm256_mul_ps(bk, _mm256_set1_ps(a[(size_t)r * lda + k])));
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    float* cr = c + (size_t)r * ldc;
+    _mm256_storeu_ps(cr, first ? acc[r] : _mm256_add_ps(acc[r], _mm256_loadu_ps(cr)));
+  }
+#else
+  float acc[R][CPU_COLS];
+  memset(acc, 0, sizeof(acc));
+  for (int32_t k = 0; k < kc; ++k) {
+    float bk[CPU_COLS];
+    for (int j = 0; j < CPU_COLS; ++j) {
+      bk[j] = (float)float16::fromBits(b[(size_t)k * ldb + j]);
+    }
+    for (int r = 0; r < R; ++r) {
+      float av = a[(size_t)r * lda + k];
+      for (int j = 0; j < CPU_COLS; ++j) {
+        acc[r][j] += av * bk[j];
+      }
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    for (int j = 0; j < CPU_COLS; ++j) {
+      c[(size_t)r * ldc + j] = first ? acc[r][j] : c[(size_t)r * ldc + j] + acc[r][j];
+    }
+  }
+#endif
+}
+
+// the columns beyond the last multiple of 8
+static void tail_i8(const int8_t* a, int32_t lda, const int8_t* b, int32_t ldb, int32_t kc, int32_t* c, int32_t ldc,
+                    int32_t rows, int32_t cols, bool first)
+{
+  for (int32_t r = 0; r < rows; ++r) {
+    for (int32_t j = 0; j < cols; ++j) {
+      int32_t sum = first ? 0 : c[(size_t)r * ldc + j];
+      for (int32_t k = 0; k < kc; ++k) {
+        sum += (int32_t)a[(size_t)r * lda + k] * b[(size_t)k * ldb + j];
+      }
+      c[(size_t)r * ldc + j] = sum;
+    }
+  }
+}
+
+static void tail_f16(const float* a, int32_t lda, const uint16_t* b, int32_t ldb, int32_t kc, float* c, int32_t ldc,
+                     int32_t rows, int32_t cols, bool first)
+{
+  for (int32_t r = 0; r < rows; ++r) {
+    for (int32_t j = 0; j < cols; ++j) {
+      float sum = first ? 0.f : c[(size_t)r * ldc + j];
+      for (int32_t k = 0; k < kc; ++k) {
+        sum += a[(size_t)r * lda + k] * (float)float16::fromBits(b[(size_t)k * ldb + j]);
+      }
+      c[(size_t)r * ldc + j] = sum;
+    }
+  }
+}
+
+/*-------------------------------------------
+                   blocking
+-------------------------------------------*/
+struct OpsI8
+{
+  typedef int8_t  Ta;
+  typedef int8_t  Tb;
+  typedef int32_t Tc;
+  template <int R>
+  static void kernel(const Ta* a, int32_t lda, const Tb* b, int32_t ldb, int32_t kc, Tc* c, int32_t ldc, bool first)
+  {
+    kernel_i8<R>(a, lda, b, ldb, kc, c, ldc, first);
+  }
+  static void tail(const Ta* a, int32_t lda, const Tb* b, int32_t ldb, int32_t kc, Tc* c, int32_t ldc, int32_t rows,
+                   int32_t cols, bool first)
+  {
+    tail_i8(a, lda, b, ldb, kc, c, ldc, rows, cols, first);
+  }
+};
+
+struct OpsF16
+{
+  typedef float    Ta;
+  typedef uint16_t Tb;
+  typedef float    Tc;
+  template <int R>
+  static void kernel(const Ta* a, int32_t lda, const Tb* b, int32_t ldb, int32_t kc, Tc* c, int32_t ldc, bool first)
+  {
+    kernel_f16<R>(a, lda, b, ldb, kc, c, ldc, first);
+  }
+  static void tail(const Ta* a, int32_t lda, const Tb* b, int32_t ldb, int32_t kc, Tc* c, int32_t ldc, int32_t rows,
+                   int32_t cols, bool first)
+  {
+    tail_f16(a, lda, b, ldb, kc, c, ldc, rows, cols, first);
+  }
+};
+
+// a block of K, then a block of N, then all rows of the job over it, 4 rows x 8 columns at a time
+template <typename Ops>
+static void gemm_block(const CpuJob* job)
+{
+  typedef typename Ops::Ta Ta;
+  typedef typename Ops::Tb Tb;
+  typedef typename Ops::Tc Tc;
+  const Ta* A = (const Ta*)job->A;
+  const Tb* B = (const Tb*)job->B;
+  Tc*       C = (Tc*)job->C;
+  int32_t   K = job->K, N = job->N;
+  for (int32_t k0 = 0; k0 < K; k0 += CPU_BLOCK_K) {
+    int32_t kc    = K - k0 < CPU_BLOCK_K ? K - k0 : CPU_BLOCK_K;
+    bool    first = k0 == 0;
+    for (int32_t n0 = job->n_begin; n0 < job->n_end; n0 += CPU_BLOCK_N) {
+      int32_t n1 = n0 + CPU_BLOCK_N < job->n_end ? n0 + CPU_BLOCK_N : job->n_end;
+      for (int32_t m = job->m_begin; m < job->m_end; m += CPU_ROWS) {
+        int32_t   rows = job->m_end - m < CPU_ROWS ? job->m_end - m : CPU_ROWS;
+        const Ta* a    = A + (size_t)m * K + k0;
+        int32_t   n    = n0;
+        for (; n + CPU_COLS <= n1; n += CPU_COLS) {
+          const Tb* b = B + (size_t)k0 * N + n;
+          Tc*       c = C + (size_t)m * N + n;
+          switch (rows) {
+          case 4:
+            Ops::template kernel<4>(a, K, b, N, kc, c, N, first);
+            break;
+          case 3:
+            Ops::template kernel<3>(a, K, b, N, kc, c, N, first);
+            break;
+          case 2:
+            Ops::template kernel<2>(a, K, b, N, kc, c, N, first);
+            break;
+          default:
+            Ops::template kernel<1>(a, K, b, N, kc, c, N, first);
+            break;
+          }
+        }
+        if (n < n1) {
+          Ops::tail(a, K, B + (size_t)k0 * N + n, N, kc, C + (size_t)m * N + n, N, rows, n1 - n, first);
+        }
+      }
+    }
+  }
+}
+
+static void* gemm_job(void* arg)
+{
+  const CpuJob* job = (const CpuJob*)arg;
+  if (job->type == RKNN_TENSOR_INT8) {
+    gemm_block<OpsI8>(job);
+  } else {
+    gemm_block<OpsF16>(job);
+  }
+  return NULL;
+}
+
+int matmul_cpu_run(rknn_tensor_type type, const void* A, const void* B, void* C, int32_t M, int32_t K, int32_t N,
+                   int num_threads)
+{
+  if (type != RKNN_TENSOR_INT8 && type != RKNN_TENSOR_FLOAT16) {
+    printf("matmul_cpu_run: type %s is not supported\n", get_type_string(type));
+    return -1;
+  }
+  if (M <= 0 || K <= 0 || N <= 0) {
+    printf("matmul_cpu_run: invalid shape M=%d K=%d N=%d\n", M, K, N);
+    return -1;
+  }
+
+  // A is read by every column block, float16 A is converted once
+  std::vector<float> a_f32;
+  CpuJob             job;
+  job.type = type;
+  job.A    = A;
+  if (type == RKNN_TENSOR_FLOAT16) {
+    a_f32.resize((size_t)M * K);
+    rknpu2::convertFloat16ToFloat32((const float16*)A, a_f32.data(), a_f32.size());
+    job.A = a_f32.data();
+  }
+  job.B       = B;
+  job.C       = C;
+  job.K       = K;
+  job.N       = N;
+  job.m_begin = 0;
+  job.m_end   = M;
+  job.n_begin = 0;
+  job.n_end   = N;
+
+  int64_t macs        = (int64_t)M * K * N;
+  int64_t max_threads = macs / CPU_MIN_MACS > 0 ? macs / CPU_MIN_MACS : 1;
+  num_threads         = num_threads > CPU_MAX_THREADS ? CPU_MAX_THREADS : num_threads;
+  num_threads         = num_threads > max_threads ? (int)max_threads : num_threads;
+  if (num_threads <= 1) {
+    gemm_job(&job);
+    return 0;
+  }
+
+  // column ranges in multiples of 8 when N is wide enough, row ranges otherwise
+  int32_t col_groups = (N + CPU_COLS - 1) / CPU_COLS;
+  bool    split_n    = col_groups >= num_threads;
+  if (!split_n && num_threads > M) {
+    num_threads = M > col_groups ? M : col_groups;
+    split_n     = col_groups >= num_threads;
+  }
+  CpuJob    jobs[CPU_MAX_THREADS];
+  pthread_t threads[CPU_MAX_THREADS];
+  bool      started[CPU_MAX_THREADS] = {false};
+  for (int t = 0; t < num_threads; t++) {
+    jobs[t] = job;
+    if (split_n) {
+      jobs[t].n_begin = (int32_t)((int64_t)col_groups * t / num_threads) * CPU_COLS;
+      jobs[t].n_end   = (int32_t)((int64_t)col_groups * (t + 1) / num_threads) * CPU_COLS;
+      jobs[t].n_end   = jobs[t].n_end < N ? jobs[t].n_end : N;
+    } else {
+      jobs[t].m_begin = (int32_t)((int64_t)M * t / num_threads);
+      jobs[t].m_end   = (int32_t)((int64_t)M * (t + 1) / num_threads);
+    }
+  }
+  for (int t = 1; t < num_threads; t++) {
+    started[t] = pthread_create(&threads[t], NULL, gemm_job, &jobs[t]) == 0;
+    if (!started[t]) {
+      // run it here instead
+      gemm_job(&jobs[t]);
+    }
+  }
+  gemm_job(&jobs[0]);
+  for (int t = 1; t < num_threads; t++) {
+    if (started[t]) {
+      pthread_join(threads[t], NULL);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,34 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNPU2_MATMUL_CPU_H_
+#define _RKNPU2_MATMUL_CPU_H_
+
+#include <stdint.h>
+
+#include "rknn_matmul_api.h"
+
+/*
+  the matmul of rknn_matmul_api.h on the CPU: int8 x int8 -> int32 (exact), float16 x float16 -> float32.
+  K is walked in blocks of 256 and N in blocks of 256 columns, so that the block of B stays in the cache while up to
+  4 rows of A run over it, 8 columns of C at a time in NEON (SSE2 / F16C on x86) registers.
+  the threads take column ranges of C, or row ranges when N is too narrow to share.
+*/
+
+/* C (M, N) = A (M, K) x B (K, N), all in normal layout. type is RKNN_TENSOR_INT8 or RKNN_TENSOR_FLOAT16.
+   returns 0 or -1. */
+int matmul_cpu_run(rknn_tensor_type type, const void* A, const void* B, void* C, int32_t M, int32_t K, int32_t N,
+                   int num_threads);
+
+#endif //_RKNPU2_MATMUL_CPU_H_
@@ -0,0 +1,272 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_dispatch.h"
+#include "matmul_cache.h"
+#include "matmul_cpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <map>
+#include <vector>
+
+#define DEFAULT_CALIB_LOOPS 5
+
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+struct ShapeKey
+{
+  int32_t K;
+  int32_t N;
+
+  bool operator<(const ShapeKey& other) const { return K != other.K ? K < other.K : N < other.N; }
+};
+
+struct CalibEntry
+{
+  int64_t cpu_us;
+  int64_t npu_us; // -1: the NPU does not take this shape
+};
+
+struct _matmul_dispatch
+{
+  matmul_dispatch_config config;
+  matmul_cache*          cache;
+  // M bucket -> times, per K x N
+  std::map<ShapeKey, std::map<int32_t, CalibEntry>> table;
+  matmul_dispatch_stats                             stats;
+};
+
+static uint32_t elem_bytes(rknn_tensor_type type)
+{
+  return type == RKNN_TENSOR_INT8 ? 1 : 2;
+}
+
+// random int8, or float16 in [-1, 1)
+static void fill_random(rknn_tensor_type type, std::vector<uint8_t>& data)
+{
+  if (type == RKNN_TENSOR_INT8) {
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = (uint8_t)rand();
+    }
+    return;
+  }
+  uint16_t* h = (uint16_t*)data.data();
+  for (size_t i = 0; i < data.size() / 2; ++i) {
+    // sign, exponent of 2^-1 .. 2^-4, random mantissa
+    h[i] = (uint16_t)((rand() & 0x8000) | ((11 + rand() % 4) << 10) | (rand() & 0x3ff));
+  }
+}
+
+// average of loops runs after one warm-up run, -1 on failure
+static int64_t time_cpu(const matmul_dispatch* d, const void* A, const void* B, void* C, int32_t M, int32_t K,
+                        int32_t N, int loops)
+{
+  if (matmul_cpu_run(d->config.type, A, B, C, M, K, N, d->config.cpu_threads) != 0) {
+    return -1;
+  }
+  int64_t start_us = getCurrentTimeUs();
+  for (int i = 0; i < loops; ++i) {
+    matmul_cpu_run(d->config.type, A, B, C, M, K, N, d->config.cpu_threads);
+  }
+  return (getCurrentTimeUs() - start_us) / loops;
+}
+
+// steady state: the context is created by the warm-up run, the timed runs are cache hits
+static int64_t time_npu(matmul_cache* cache, const void* A, const void* B, void* C, int32_t M, int32_t K, int32_t N,
+                        int loops)
+{
+  matmul_cache_entry* entry = NULL;
+  if (matmul_cache_get(cache, M, K, N, B, &entry) != 0 || matmul_cache_run(cache, entry, A, M, C) != 0) {
+    return -1;
+  }
+  int64_t start_us = getCurrentTimeUs();
+  for (int i = 0; i < loops; ++i) {
+    if (matmul_cache_get(cache, M, K, N, B, &entry) != 0 || matmul_cache_run(cache, entry, A, M, C) != 0) {
+      return -1;
+    }
+  }
+  return (getCurrentTimeUs() - start_us) / loops;
+}
+
+// measures the M in buckets that are not in the table yet
+static int calibrate(matmul_dispatch* d, int32_t K, int32_t N, const std::vector<int32_t>& buckets)
+{
+  std::map<int32_t, CalibEntry>& shape = d->table[ShapeKey{K, N}];
+  int32_t                        max_m = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    max_m = shape.count(buckets[i]) == 0 && buckets[i] > max_m ? buckets[i] : max_m;
+  }
+  if (max_m == 0) {
+    return 0;
+  }
+
+  // a cache of its own, so that the random weights do not stay behind in the dispatcher's one
+  matmul_cache_config cache_config;
+  memset(&cache_config, 0, sizeof(matmul_cache_config));
+  cache_config.type          = d->config.type;
+  cache_config.native_layout = d->config.native_layout;
+  cache_config.perf_layout   = d->config.perf_layout;
+  matmul_cache* cache        = NULL;
+  if (matmul_cache_create(&cache_config, &cache) != 0) {
+    return -1;
+  }
+
+  int64_t              start_us = getCurrentTimeUs();
+  int                  loops    = d->config.calib_loops > 0 ? d->config.calib_loops : DEFAULT_CALIB_LOOPS;
+  std::vector<uint8_t> A((size_t)max_m * K * elem_bytes(d->config.type));
+  std::vector<uint8_t> B((size_t)K * N * elem_bytes(d->config.type));
+  std::vector<uint8_t> C((size_t)max_m * N * 4);
+  fill_random(d->config.type, A);
+  fill_random(d->config.type, B);
+
+  int ret = 0;
+  for (size_t i = 0; i < buckets.size() && ret == 0; ++i) {
+    int32_t M = buckets[i];
+    if (shape.count(M) != 0) {
+      continue;
+    }
+    CalibEntry e;
+    e.cpu_us = time_cpu(d, A.data(), B.data(), C.data(), M, K, N, loops);
+    e.npu_us = time_npu(cache, A.data(), B.data(), C.data(), M, K, N, loops);
+    if (e.cpu_us < 0) {
+      ret = -1;
+    } else {
+      shape[M] = e;
+    }
+  }
+  matmul_cache_destroy(cache);
+  d->stats.calib_us += getCurrentTimeUs() - start_us;
+  return ret;
+}
+
+int matmul_dispatch_create(const matmul_dispatch_config* config, matmul_dispatch** dispatch)
+{
+  *dispatch = NULL;
+  if (config->type != RKNN_TENSOR_INT8 && config->type != RKNN_TENSOR_FLOAT16) {
+    printf("matmul_dispatch_create: type %s is not supported\n", get_type_string(config->type));
+    return -1;
+  }
+  matmul_cache_config cache_config;
+  memset(&cache_config, 0, sizeof(matmul_cache_config));
+  cache_config.type          = config->type;
+  cache_config.native_layout = config->native_layout;
+  cache_config.perf_layout   = config->perf_layout;
+
+  matmul_dispatch* d    = new matmul_dispatch;
+  d->config             = *config;
+  d->config.cpu_threads = config->cpu_threads > 0 ? config->cpu_threads : 1;
+  memset(&d->stats, 0, sizeof(matmul_dispatch_stats));
+  if (matmul_cache_create(&cache_config, &d->cache) != 0) {
+    delete d;
+    return -1;
+  }
+  *dispatch = d;
+  return 0;
+}
+
+int matmul_dispatch_calibrate(matmul_dispatch* d, int32_t K, int32_t N, int32_t max_m)
+{
+  if (K <= 0 || N <= 0 || max_m <= 0) {
+    printf("matmul_dispatch_calibrate: invalid shape K=%d N=%d max_m=%d\n", K, N, max_m);
+    return -1;
+  }
+  std::vector<int32_t> buckets;
+  int32_t              last = matmul_cache_bucket(d->cache, max_m);
+  for (int32_t M = 1; M <= last;) {
+    int32_t bucket = matmul_cache_bucket(d->cache, M);
+    buckets.push_back(bucket);
+    M = bucket + 1;
+  }
+  return calibrate(d, K, N, buckets);
+}
+
+int matmul_dispatch_use_npu(matmul_dispatch* d, int32_t M, int32_t K, int32_t N)
+{
+  if (M <= 0 || K <= 0 || N <= 0) {
+    printf("matmul_dispatch: invalid shape M=%d K=%d N=%d\n", M, K, N);
+    return -1;
+  }
+  int32_t                                                     bucket = matmul_cache_bucket(d->cache, M);
+  std::map<ShapeKey, std::map<int32_t, CalibEntry>>::iterator shape  = d->table.find(ShapeKey{K, N});
+  if (shape == d->table.end() || shape->second.count(bucket) == 0) {
+    if (calibrate(d, K, N, std::vector<int32_t>(1, bucket)) != 0) {
+      return -1;
+    }
+    shape = d->table.find(ShapeKey{K, N});
+  }
+  const CalibEntry& e = shape->second[bucket];
+  return e.npu_us >= 0 && e.npu_us < e.cpu_us ? 1 : 0;
+}
+
+int matmul_dispatch_run(matmul_dispatch* d, const void* A, const void* B, void* C, int32_t M, int32_t K, int32_t N)
+{
+  int use_npu = matmul_dispatch_use_npu(d, M, K, N);
+  if (use_npu < 0) {
+    return -1;
+  }
+  if (use_npu == 0) {
+    ++d->stats.cpu_calls;
+    return matmul_cpu_run(d->config.type, A, B, C, M, K, N, d->config.cpu_threads);
+  }
+  ++d->stats.npu_calls;
+  matmul_cache_entry* entry = NULL;
+  if (matmul_cache_get(d->cache, M, K, N, B, &entry) != 0) {
+    return -1;
+  }
+  return matmul_cache_run(d->cache, entry, A, M, C);
+}
+
+void matmul_dispatch_get_stats(const matmul_dispatch* d, matmul_dispatch_stats* stats)
+{
+  *stats = d->stats;
+}
+
+void matmul_dispatch_dump(const matmul_dispatch* d)
+{
+  printf("matmul dispatch %s, %d CPU threads: %lld CPU calls, %lld NPU calls, calibration %.3f ms\n",
+         get_type_string(d->config.type), d->config.cpu_threads, (long long)d->stats.cpu_calls,
+         (long long)d->stats.npu_calls, d->stats.calib_us / 1000.);
+  std::map<ShapeKey, std::map<int32_t, CalibEntry>>::const_iterator shape;
+  for (shape = d->table.begin(); shape != d->table.end(); ++shape) {
+    printf("  K=%d N=%d\n", shape->first.K, shape->first.N);
+    std::map<int32_t, CalibEntry>::const_iterator it;
+    for (it = shape->second.begin(); it != shape->second.end(); ++it) {
+      const CalibEntry& e = it->second;
+      if (e.npu_us < 0) {
+        printf("    M<=%-5d cpu %9.3f ms, npu       n/a -> cpu\n", it->first, e.cpu_us / 1000.);
+      } else {
+        printf("    M<=%-5d cpu %9.3f ms, npu %9.3f ms -> %s\n", it->first, e.cpu_us / 1000., e.npu_us / 1000.,
+               e.npu_us < e.cpu_us ? "npu" : "cpu");
+      }
+    }
+  }
+}
+
+void matmul_dispatch_destroy(matmul_dispatch* d)
+{
+  if (d == NULL) {
+    return;
+  }
+  matmul_cache_destroy(d->cache);
+  delete d;
+}
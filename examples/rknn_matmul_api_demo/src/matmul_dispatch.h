@@ -0,0 +1,68 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNPU2_MATMUL_DISPATCH_H_
+#define _RKNPU2_MATMUL_DISPATCH_H_
+
+#include <stdint.h>
+
+#include "rknn_matmul_api.h"
+
+/*
+  runs each matmul on the CPU (matmul_cpu.h) or on the NPU (through matmul_cache.h), whichever was faster for its
+  shape. for small M the NPU time is mostly the fixed cost of a run plus the packing of A / C, the CPU wins there.
+  the choice comes from a table of (K, N, M bucket) -> CPU time, NPU time, measured by matmul_dispatch_calibrate()
+  at startup, or on the first call of a shape that was not calibrated.
+  not thread safe, one dispatcher per thread.
+*/
+
+typedef struct _matmul_dispatch_config
+{
+  rknn_tensor_type type; // RKNN_TENSOR_INT8 or RKNN_TENSOR_FLOAT16
+  int32_t          native_layout;
+  int32_t          perf_layout;
+  int32_t          cpu_threads;
+  int32_t          calib_loops; // timed runs per side and M bucket, 0: 5
+} matmul_dispatch_config;
+
+typedef struct _matmul_dispatch_stats
+{
+  int64_t cpu_calls;
+  int64_t npu_calls;
+  int64_t calib_us; // spent in calibration
+} matmul_dispatch_stats;
+
+typedef struct _matmul_dispatch matmul_dispatch;
+
+int matmul_dispatch_create(const matmul_dispatch_config* config, matmul_dispatch** dispatch);
+
+/* measures the M buckets of matmul_cache.h up to the one of max_m for K x N, on random weights. returns 0 or -1. */
+int matmul_dispatch_calibrate(matmul_dispatch* dispatch, int32_t K, int32_t N, int32_t max_m);
+
+/* C (M, N) = A (M, K) x B (K, N), all in normal layout, on the faster side. B is cached by address on the NPU side as
+   with matmul_cache_get(). returns 0 or -1. */
+int matmul_dispatch_run(matmul_dispatch* dispatch, const void* A, const void* B, void* C, int32_t M, int32_t K,
+                        int32_t N);
+
+/* 1 when M x K x N goes to the NPU, 0 for the CPU. calibrates the shape first if needed, -1 on failure. */
+int matmul_dispatch_use_npu(matmul_dispatch* dispatch, int32_t M, int32_t K, int32_t N);
+
+void matmul_dispatch_get_stats(const matmul_dispatch* dispatch, matmul_dispatch_stats* stats);
+
+// prints the calibration table and the calls made on each side
+void matmul_dispatch_dump(const matmul_dispatch* dispatch);
+
+void matmul_dispatch_destroy(matmul_dispatch* dispatch);
+
+#endif //_RKNPU2_MATMUL_DISPATCH_H_
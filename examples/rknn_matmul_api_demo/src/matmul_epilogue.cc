@@ -0,0 +1,353 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_epilogue.h"
+#include "Float16.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define EPILOGUE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define EPILOGUE_SSE2 1
+#endif
+
+using rknpu2::float16;
+
+// sqrt(2 / pi) * 2: 0.5 * (1 + tanh(y)) is sigmoid(2 * y)
+#define GELU_K0 1.5957691216f
+#define GELU_K1 0.044715f
+
+/*-------------------------------------------
+                scalar code
+-------------------------------------------*/
+static inline float act_scalar(float x, matmul_activation act)
+{
+  switch (act) {
+  case MATMUL_ACT_RELU:
+    return x > 0.f ? x : 0.f;
+  case MATMUL_ACT_GELU:
+    return x / (1.f + expf(-GELU_K0 * (x + GELU_K1 * x * x * x)));
+  case MATMUL_ACT_SILU:
+    return x / (1.f + expf(-x));
+  default:
+    return x;
+  }
+}
+
+static inline float load_scalar(const int32_t* p)
+{
+  return (float)*p;
+}
+
+static inline float load_scalar(const float* p)
+{
+  return *p;
+}
+
+static inline void store_scalar(float* p, float x)
+{
+  *p = x;
+}
+
+static inline void store_scalar(uint16_t* p, float x)
+{
+  *p = float16::bits(x);
+}
+
+/*-------------------------------------------
+                 4 at a time
+-------------------------------------------*/
+#if defined(EPILOGUE_NEON)
+typedef float32x4_t v4f;
+
+static inline v4f v_load(const int32_t* p)
+{
+  return vcvtq_f32_s32(vld1q_s32(p));
+}
+static inline v4f v_load(const float* p)
+{
+  return vld1q_f32(p);
+}
+static inline v4f v_dup(float x)
+{
+  return vdupq_n_f32(x);
+}
+static inline v4f v_add(v4f a, v4f b)
+{
+  return vaddq_f32(a, b);
+}
+static inline v4f v_sub(v4f a, v4f b)
+{
+  return vsubq_f32(a, b);
+}
+static inline v4f v_mul(v4f a, v4f b)
+{
+  return vmulq_f32(a, b);
+}
+static inline v4f v_max(v4f a, v4f b)
+{
+  return vmaxq_f32(a, b);
+}
+static inline v4f v_min(v4f a, v4f b)
+{
+  return vminq_f32(a, b);
+}
+// 1 / x, estimate and two Newton steps, armv7 has no vector division
+static inline v4f v_recip(v4f x)
+{
+  v4f e = vrecpeq_f32(x);
+  e     = vmulq_f32(vrecpsq_f32(x, e), e);
+  return vmulq_f32(vrecpsq_f32(x, e), e);
+}
+static inline v4f v_floor(v4f x)
+{
+  v4f t = vcvtq_f32_s32(vcvtq_s32_f32(x));
+  return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(t, x), vreinterpretq_u32_f32(vdupq_n_f32(1.f)))));
+}
+// 2^n for integral n
+static inline v4f v_pow2(v4f n)
+{
+  return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23));
+}
+static inline void v_store(float* p, v4f x)
+{
+  vst1q_f32(p, x);
+}
+static inline void v_store(uint16_t* p, v4f x)
+{
+#if defined(FLOAT16_NEON_CVT)
+  vst1_u16(p, vreinterpret_u16_f16(vcvt_f16_f32(x)));
+#else
+  float t[4];
+  vst1q_f32(t, x);
+  for (int i = 0; i < 4; ++i) {
+    p[i] = float16::bits(t[i]);
+  }
+#endif
+}
+#elif defined(EPILOGUE_SSE2)
+typedef __m128 v4f;
+
+static inline v4f v_load(const int32_t* p)
+{
+  return _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)p));
+}
+static inline v4f v_load(const float* p)
+{
+  return _mm_loadu_ps(p);
+}
+static inline v4f v_dup(float x)
+{
+  return _mm_set1_ps(x);
+}
+static inline v4f v_add(v4f a, v4f b)
+{
+  return _mm_add_ps(a, b);
+}
+static inline v4f v_sub(v4f a, v4f b)
+{
+  return _mm_sub_ps(a, b);
+}
+static inline v4f v_mul(v4f a, v4f b)
+{
+  return _mm_mul_ps(a, b);
+}
+static inline v4f v_max(v4f a, v4f b)
+{
+  return _mm_max_ps(a, b);
+}
+static inline v4f v_min(v4f a, v4f b)
+{
+  return _mm_min_ps(a, b);
+}
+static inline v4f v_recip(v4f x)
+{
+  return _mm_div_ps(_mm_set1_ps(1.f), x);
+}
+static inline v4f v_floor(v4f x)
+{
+  v4f t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+  return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.f)));
+}
+static inline v4f v_pow2(v4f n)
+{
+  return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23));
+}
+static inline void v_store(float* p, v4f x)
+{
+  _mm_storeu_ps(p, x);
+}
+static inline void v_store(uint16_t* p, v4f x)
+{
+#if defined(FLOAT16_F16C_CVT)
+  _mm_storel_epi64((__m128i*)p, _mm_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT));
+#else
+  float t[4];
+  _mm_storeu_ps(t, x);
+  for (int i = 0; i < 4; ++i) {
+    p[i] = float16::bits(t[i]);
+  }
+#endif
+}
+#endif
+
+#if defined(EPILOGUE_NEON) || defined(EPILOGUE_SSE2)
+// exp(x) as 2^n * p(r), with the cephes polynomial of expf
+static inline v4f v_exp(v4f x)
+{
+  x     = v_min(v_max(x, v_dup(-87.3f)), v_dup(88.3f));
+  v4f n = v_floor(v_add(v_mul(x, v_dup(1.44269504088896341f)), v_dup(0.5f)));
+  v4f r = v_sub(v_sub(x, v_mul(n, v_dup(0.693359375f))), v_mul(n, v_dup(-2.12194440e-4f)));
+  v4f p = v_dup(1.9875691500e-4f);
+  p     = v_add(v_mul(p, r), v_dup(1.3981999507e-3f));
+  p     = v_add(v_mul(p, r), v_dup(8.3334519073e-3f));
+  p     = v_add(v_mul(p, r), v_dup(4.1665795894e-2f));
+  p     = v_add(v_mul(p, r), v_dup(1.6666665459e-1f));
+  p     = v_add(v_mul(p, r), v_dup(5.0000001201e-1f));
+  p     = v_add(v_add(v_mul(v_mul(p, r), r), r), v_dup(1.f));
+  return v_mul(p, v_pow2(n));
+}
+
+// x * sigmoid(k * x)
+static inline v4f v_gate(v4f x, v4f kx)
+{
+  return v_mul(x, v_recip(v_add(v_dup(1.f), v_exp(v_sub(v_dup(0.f), kx)))));
+}
+
+static inline v4f v_act(v4f x, matmul_activation act)
+{
+  switch (act) {
+  case MATMUL_ACT_RELU:
+    return v_max(x, v_dup(0.f));
+  case MATMUL_ACT_GELU:
+    return v_gate(x, v_mul(v_dup(GELU_K0), v_add(x, v_mul(v_dup(GELU_K1), v_mul(x, v_mul(x, x))))));
+  case MATMUL_ACT_SILU:
+    return v_gate(x, x);
+  default:
+    return x;
+  }
+}
+#endif
+
+/*-------------------------------------------
+                  one pass
+-------------------------------------------*/
+// len values of one row, from the column of cs / bias
+template <typename Tc, typename To>
+static inline void epilogue_span(const Tc* c, float row_scale, const float* cs, const float* bias,
+                                 matmul_activation act, To* out, int32_t len)
+{
+  int32_t n = 0;
+#if defined(EPILOGUE_NEON) || defined(EPILOGUE_SSE2)
+  v4f rs = v_dup(row_scale);
+  for (; n + 4 <= len; n += 4) {
+    v4f x = v_add(v_mul(v_mul(v_load(c + n), rs), v_load(cs + n)), v_load(bias + n));
+    v_store(out + n, v_act(x, act));
+  }
+#endif
+  for (; n < len; ++n) {
+    store_scalar(out + n, act_scalar(load_scalar(c + n) * row_scale * cs[n] + bias[n], act));
+  }
+}
+
+template <typename Tc, typename To>
+static void epilogue_run(const matmul_layout* l, const matmul_epilogue* e, const float* cs, const float* bias,
+                         const Tc* C, int32_t sub_n, To* out, int32_t ld_out)
+{
+  const int32_t M = l->M, N = l->N;
+  if (sub_n == 0) {
+    for (int32_t m = 0; m < M; ++m) {
+      float rs = e->row_scales ? e->row_scales[m] : 1.f;
+      epilogue_span(C + (size_t)m * N, rs, cs, bias, e->act, out + (size_t)m * ld_out, N);
+    }
+    return;
+  }
+  // perf C is read in its order, each block of sub_n lands in its row of out
+  for (int32_t n = 0; n < N; n += sub_n) {
+    const Tc* c = C + (size_t)n * M;
+    for (int32_t m = 0; m < M; ++m) {
+      float rs = e->row_scales ? e->row_scales[m] : 1.f;
+      epilogue_span(c + (size_t)m * sub_n, rs, cs + n, bias + n, e->act, out + (size_t)m * ld_out + n, sub_n);
+    }
+  }
+}
+
+int matmul_epilogue_run(const matmul_layout* l, const matmul_epilogue* e, const void* C, int32_t perf_c, void* out,
+                        int32_t ld_out)
+{
+  if (l->type != RKNN_TENSOR_INT8 && l->type != RKNN_TENSOR_FLOAT16) {
+    printf("matmul_epilogue_run: type %s is not supported\n", get_type_string(l->type));
+    return -1;
+  }
+  if (e->out_type != RKNN_TENSOR_FLOAT32 && e->out_type != RKNN_TENSOR_FLOAT16) {
+    printf("matmul_epilogue_run: output type %s is not supported\n", get_type_string(e->out_type));
+    return -1;
+  }
+  int32_t sub_n = perf_c ? l->c_sub_n : 0;
+  if (perf_c && (sub_n <= 0 || l->N % sub_n != 0)) {
+    printf("matmul_epilogue_run: perf C block %d does not divide N=%d\n", sub_n, l->N);
+    return -1;
+  }
+  ld_out = ld_out ? ld_out : l->N;
+
+  // missing column scales / bias are 1 / 0, so that the loops do not branch on them
+  std::vector<float> ones, zeros;
+  const float*       cs   = e->col_scales;
+  const float*       bias = e->bias;
+  if (cs == NULL) {
+    ones.assign(l->N, 1.f);
+    cs = ones.data();
+  }
+  if (bias == NULL) {
+    zeros.assign(l->N, 0.f);
+    bias = zeros.data();
+  }
+
+  if (l->type == RKNN_TENSOR_INT8) {
+    if (e->out_type == RKNN_TENSOR_FLOAT32) {
+      epilogue_run(l, e, cs, bias, (const int32_t*)C, sub_n, (float*)out, ld_out);
+    } else {
+      epilogue_run(l, e, cs, bias, (const int32_t*)C, sub_n, (uint16_t*)out, ld_out);
+    }
+  } else {
+    if (e->out_type == RKNN_TENSOR_FLOAT32) {
+      epilogue_run(l, e, cs, bias, (const float*)C, sub_n, (float*)out, ld_out);
+    } else {
+      epilogue_run(l, e, cs, bias, (const float*)C, sub_n, (uint16_t*)out, ld_out);
+    }
+  }
+  return 0;
+}
+
+const char* get_activation_string(matmul_activation act)
+{
+  switch (act) {
+  case MATMUL_ACT_NONE:
+    return "none";
+  case MATMUL_ACT_RELU:
+    return "relu";
+  case MATMUL_ACT_GELU:
+    return "gelu";
+  case MATMUL_ACT_SILU:
+    return "silu";
+  default:
+    return "UNKNOW";
+  }
+}
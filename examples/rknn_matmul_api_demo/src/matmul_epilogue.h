@@ -0,0 +1,59 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNPU2_MATMUL_EPILOGUE_H_
+#define _RKNPU2_MATMUL_EPILOGUE_H_
+
+#include <stdint.h>
+
+#include "matmul_layout.h"
+#include "rknn_matmul_api.h"
+
+/*
+  the layer tail of a quantized matmul in one pass over C:
+
+    out[m][n] = act(C[m][n] * row_scales[m] * col_scales[n] + bias[n])
+
+  row_scales are per token (row of A), col_scales per output channel (column of B). C is the int32 output of an int8
+  matmul or the float32 output of a float16 one, read in normal or perf layout, so that a perf C is not unpacked
+  first. out is float32 or float16 in normal layout. 4 values at a time in NEON (SSE2 / F16C on x86) registers,
+  GELU (tanh form) and SiLU through a polynomial exp.
+*/
+
+typedef enum _matmul_activation
+{
+  MATMUL_ACT_NONE = 0,
+  MATMUL_ACT_RELU,
+  MATMUL_ACT_GELU,
+  MATMUL_ACT_SILU,
+} matmul_activation;
+
+typedef struct _matmul_epilogue
+{
+  const float*      row_scales; // M values, NULL: 1
+  const float*      col_scales; // N values, NULL: 1
+  const float*      bias;       // N values, NULL: 0
+  matmul_activation act;
+  rknn_tensor_type  out_type; // RKNN_TENSOR_FLOAT32 or RKNN_TENSOR_FLOAT16
+} matmul_epilogue;
+
+/* C as written by rknn_matmul_run(): normal layout (M, N) when perf_c is 0, perf layout (N / c_sub_n, M, c_sub_n)
+   otherwise, with the block size of layout. ld_out is the row stride of out in elements, 0 for N.
+   returns 0 or -1. */
+int matmul_epilogue_run(const matmul_layout* layout, const matmul_epilogue* epilogue, const void* C, int32_t perf_c,
+                        void* out, int32_t ld_out);
+
+const char* get_activation_string(matmul_activation act);
+
+#endif //_RKNPU2_MATMUL_EPILOGUE_H_
@@ -0,0 +1,616 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_gemm.h"
+#include "matmul_layout.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define MATMUL_GEMM_MAX_K     4096
+#define MATMUL_GEMM_MAX_N     4096
+#define MATMUL_GEMM_MAX_M     512
+#define MATMUL_GEMM_MAX_CORES 3
+
+// one K step of one output tile
+struct GemmStep
+{
+  bool    valid;
+  int32_t mi;
+  int32_t ni;
+  int32_t ki;
+};
+
+// a matmul context of one tile shape, bound once to its own A / B / C
+struct GemmSlot
+{
+  rknn_matmul_ctx     ctx;
+  rknn_matmul_io_attr io_attr;
+  rknn_tensor_mem*    A;
+  rknn_tensor_mem*    B;
+  rknn_tensor_mem*    C;
+  // tiles held by A / B, staged again only when they change
+  int32_t a_mi;
+  int32_t a_ki;
+  int32_t b_ki;
+  int32_t b_ni;
+};
+
+/*
+  one NPU core: two slots run in turn. the stager thread fills the slot that is not running with the next step and
+  adds the partial C of the step that ran in it before, while rknn_matmul_run() works on the other slot.
+*/
+struct GemmWorker
+{
+  matmul_gemm*         gemm;
+  int32_t              core;
+  GemmSlot             slot[2];
+  std::vector<uint8_t> scratch_a; // edge tiles in normal layout, before packing
+  std::vector<uint8_t> scratch_b;
+  int                  ret;
+
+  pthread_t       stager;
+  bool            stager_started;
+  pthread_mutex_t mu;
+  pthread_cond_t  cond;
+  bool            pending;
+  bool            quit;
+  GemmStep        stage_step; // staged into slot[task_slot]
+  GemmStep        acc_step;   // accumulated from slot[task_slot]
+  int             task_slot;
+};
+
+struct _matmul_gemm
+{
+  matmul_gemm_config config;
+  int32_t            M;
+  int32_t            K;
+  int32_t            N;
+  matmul_layout      tile; // Mt x Kt x Nt, block sizes from the attrs of the tile contexts
+  int32_t            m_tiles;
+  int32_t            k_tiles;
+  int32_t            n_tiles;
+  uint32_t           elem_bytes; // of A and B, C is always 4
+  bool               perf_a;
+  bool               native_b;
+  bool               perf_c;
+
+  std::vector<GemmWorker*> workers;
+
+  // per matmul_gemm_run()
+  const uint8_t*       A;
+  const uint8_t*       B;
+  uint8_t*             C;
+  std::atomic<int32_t> next_job;
+  std::atomic<bool>    failed;
+};
+
+static int32_t div_up(int32_t a, int32_t b)
+{
+  return (a + b - 1) / b;
+}
+
+static int32_t align_up(int32_t a, int32_t align)
+{
+  return div_up(a, align) * align;
+}
+
+/*-------------------------------------------
+              accumulation of C
+-------------------------------------------*/
+static inline void add_i32(int32_t* dst, const int32_t* src, int32_t n)
+{
+  int32_t i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for (; i + 4 <= n; i += 4) {
+    vst1q_s32(dst + i, vaddq_s32(vld1q_s32(dst + i), vld1q_s32(src + i)));
+  }
+#elif defined(__SSE2__)
+  for (; i + 4 <= n; i += 4) {
+    __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi32(d, _mm_loadu_si128((const __m128i*)(src + i))));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] += src[i];
+  }
+}
+
+static inline void add_f32(float* dst, const float* src, int32_t n)
+{
+  int32_t i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+  }
+#elif defined(__SSE2__)
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] += src[i];
+  }
+}
+
+// n elements of 4 bytes: copied for the first K step of a tile, added for the others
+static inline void acc_row(bool is_int, bool store, void* dst, const void* src, int32_t n)
+{
+  if (store) {
+    memcpy(dst, src, (size_t)n * 4);
+  } else if (is_int) {
+    add_i32((int32_t*)dst, (const int32_t*)src, n);
+  } else {
+    add_f32((float*)dst, (const float*)src, n);
+  }
+}
+
+static void accumulate_C(matmul_gemm* g, const GemmStep* step, const GemmSlot* slot)
+{
+  const matmul_layout* t      = &g->tile;
+  int32_t              m0     = step->mi * t->M;
+  int32_t              n0     = step->ni * t->N;
+  int32_t              rows   = g->M - m0 < t->M ? g->M - m0 : t->M;
+  int32_t              cols   = g->N - n0 < t->N ? g->N - n0 : t->N;
+  bool                 is_int = t->type == RKNN_TENSOR_INT8;
+  bool                 store  = step->ki == 0;
+  const uint8_t*       src    = (const uint8_t*)slot->C->virt_addr;
+  uint8_t*             dst    = g->C + ((size_t)m0 * g->N + n0) * 4;
+
+  if (!g->perf_c) {
+    for (int32_t r = 0; r < rows; ++r) {
+      acc_row(is_int, store, dst + (size_t)r * g->N * 4, src + (size_t)r * t->N * 4, cols);
+    }
+    return;
+  }
+  // perf C (Nt / s, Mt, s): one block of s columns per row and block, a full block is one SIMD add
+  int32_t s = t->c_sub_n;
+  for (int32_t r = 0; r < rows; ++r) {
+    uint8_t* d = dst + (size_t)r * g->N * 4;
+    for (int32_t b = 0; b * s < cols; ++b) {
+      int32_t n = cols - b * s < s ? cols - b * s : s;
+      acc_row(is_int, store, d + (size_t)b * s * 4, src + ((size_t)b * t->M + r) * s * 4, n);
+    }
+  }
+}
+
+/*-------------------------------------------
+              staging of A and B
+-------------------------------------------*/
+// rows x row_bytes from src into a dst_rows x dst_ld buffer, the rest of which is zeroed
+static void copy_padded(const uint8_t* src, size_t src_ld, int32_t rows, size_t row_bytes, uint8_t* dst,
+                        size_t dst_ld, int32_t dst_rows)
+{
+  for (int32_t r = 0; r < rows; ++r) {
+    memcpy(dst + r * dst_ld, src + r * src_ld, row_bytes);
+    if (row_bytes < dst_ld) {
+      memset(dst + r * dst_ld + row_bytes, 0, dst_ld - row_bytes);
+    }
+  }
+  if (rows < dst_rows) {
+    memset(dst + rows * dst_ld, 0, (dst_rows - rows) * dst_ld);
+  }
+}
+
+static int stage_A(GemmWorker* w, const GemmStep* step, GemmSlot* slot)
+{
+  matmul_gemm*         g = w->gemm;
+  const matmul_layout* t = &g->tile;
+  if (slot->a_mi == step->mi && slot->a_ki == step->ki) {
+    return 0;
+  }
+  slot->a_mi = step->mi;
+  slot->a_ki = step->ki;
+
+  int32_t        m0   = step->mi * t->M;
+  int32_t        k0   = step->ki * t->K;
+  int32_t        rows = g->M - m0 < t->M ? g->M - m0 : t->M;
+  int32_t        kc   = g->K - k0 < t->K ? g->K - k0 : t->K;
+  const uint8_t* src  = g->A + ((size_t)m0 * g->K + k0) * g->elem_bytes;
+  uint8_t*       mem  = (uint8_t*)slot->A->virt_addr;
+  if (rows == t->M && kc == t->K && g->perf_a) {
+    return matmul_pack_A(t, src, g->K, mem);
+  }
+  uint8_t* dst = g->perf_a ? w->scratch_a.data() : mem;
+  copy_padded(src, (size_t)g->K * g->elem_bytes, rows, (size_t)kc * g->elem_bytes, dst,
+              (size_t)t->K * g->elem_bytes, t->M);
+  return g->perf_a ? matmul_pack_A(t, dst, 0, mem) : 0;
+}
+
+static int stage_B(GemmWorker* w, const GemmStep* step, GemmSlot* slot)
+{
+  matmul_gemm*         g = w->gemm;
+  const matmul_layout* t = &g->tile;
+  if (slot->b_ki == step->ki && slot->b_ni == step->ni) {
+    return 0;
+  }
+  slot->b_ki = step->ki;
+  slot->b_ni = step->ni;
+
+  int32_t        k0  = step->ki * t->K;
+  int32_t        n0  = step->ni * t->N;
+  int32_t        kc  = g->K - k0 < t->K ? g->K - k0 : t->K;
+  int32_t        nc  = g->N - n0 < t->N ? g->N - n0 : t->N;
+  const uint8_t* src = g->B + ((size_t)k0 * g->N + n0) * g->elem_bytes;
+  uint8_t*       mem = (uint8_t*)slot->B->virt_addr;
+  if (kc == t->K && nc == t->N && g->native_b) {
+    return matmul_pack_B(t, src, g->N, mem);
+  }
+  uint8_t* dst = g->native_b ? w->scratch_b.data() : mem;
+  copy_padded(src, (size_t)g->N * g->elem_bytes, kc, (size_t)nc * g->elem_bytes, dst,
+              (size_t)t->N * g->elem_bytes, t->K);
+  return g->native_b ? matmul_pack_B(t, dst, 0, mem) : 0;
+}
+
+static int stage(GemmWorker* w, const GemmStep* step, GemmSlot* slot)
+{
+  if (stage_A(w, step, slot) != 0 || stage_B(w, step, slot) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/*-------------------------------------------
+                 stager thread
+-------------------------------------------*/
+static void* stager_loop(void* arg)
+{
+  GemmWorker* w = (GemmWorker*)arg;
+  pthread_mutex_lock(&w->mu);
+  while (true) {
+    while (!w->pending && !w->quit) {
+      pthread_cond_wait(&w->cond, &w->mu);
+    }
+    if (!w->pending) {
+      break;
+    }
+    GemmStep stage_step = w->stage_step;
+    GemmStep acc_step   = w->acc_step;
+    GemmSlot* slot      = &w->slot[w->task_slot];
+    pthread_mutex_unlock(&w->mu);
+
+    // the C of the previous step first, the staging does not touch it
+    if (acc_step.valid) {
+      accumulate_C(w->gemm, &acc_step, slot);
+    }
+    int ret = stage_step.valid ? stage(w, &stage_step, slot) : 0;
+
+    pthread_mutex_lock(&w->mu);
+    if (ret != 0) {
+      w->ret = -1;
+    }
+    w->pending = false;
+    pthread_cond_broadcast(&w->cond);
+  }
+  pthread_mutex_unlock(&w->mu);
+  return NULL;
+}
+
+static void stager_post(GemmWorker* w, const GemmStep* stage_step, const GemmStep* acc_step, int slot)
+{
+  pthread_mutex_lock(&w->mu);
+  w->stage_step = *stage_step;
+  w->acc_step   = *acc_step;
+  w->task_slot  = slot;
+  w->pending    = true;
+  pthread_cond_broadcast(&w->cond);
+  pthread_mutex_unlock(&w->mu);
+}
+
+static void stager_wait(GemmWorker* w)
+{
+  pthread_mutex_lock(&w->mu);
+  while (w->pending) {
+    pthread_cond_wait(&w->cond, &w->mu);
+  }
+  pthread_mutex_unlock(&w->mu);
+}
+
+/*-------------------------------------------
+                   workers
+-------------------------------------------*/
+// output tiles are taken N major, so that tiles next to each other in the queue share B
+static GemmStep next_step(matmul_gemm* g, const GemmStep* cur)
+{
+  GemmStep step;
+  if (cur != NULL && cur->valid && cur->ki + 1 < g->k_tiles) {
+    step = *cur;
+    ++step.ki;
+    return step;
+  }
+  int32_t job = g->next_job++;
+  step.valid  = !g->failed && job < g->m_tiles * g->n_tiles;
+  step.mi     = job % g->m_tiles;
+  step.ni     = job / g->m_tiles;
+  step.ki     = 0;
+  return step;
+}
+
+static void* worker_run(void* arg)
+{
+  GemmWorker*  w = (GemmWorker*)arg;
+  matmul_gemm* g = w->gemm;
+  GemmStep     prev;
+  prev.valid   = false;
+  GemmStep cur = next_step(g, NULL);
+  int      s   = 0;
+  if (cur.valid && stage(w, &cur, &w->slot[s]) != 0) {
+    w->ret = -1;
+  }
+  while (cur.valid && w->ret == 0) {
+    GemmStep nxt = next_step(g, &cur);
+    stager_post(w, &nxt, &prev, s ^ 1);
+    int ret = rknn_matmul_run(w->slot[s].ctx);
+    stager_wait(w);
+    if (ret < 0) {
+      printf("rknn_matmul_run fail! core=%d ret=%d\n", w->core, ret);
+      w->ret = -1;
+    }
+    prev = cur;
+    cur  = nxt;
+    s ^= 1;
+  }
+  if (w->ret == 0 && prev.valid) {
+    accumulate_C(g, &prev, &w->slot[s ^ 1]);
+  }
+  if (w->ret != 0) {
+    g->failed = true;
+  }
+  return NULL;
+}
+
+static int create_slot(matmul_gemm* g, rknn_core_mask core_mask, GemmSlot* slot)
+{
+  rknn_matmul_info info;
+  memset(&info, 0, sizeof(rknn_matmul_info));
+  info.M             = g->tile.M;
+  info.K             = g->tile.K;
+  info.N             = g->tile.N;
+  info.type          = g->tile.type;
+  info.native_layout = g->config.native_layout;
+  info.perf_layout   = g->config.perf_layout;
+
+  int ret = rknn_matmul_create(&slot->ctx, &info, &slot->io_attr);
+  if (ret < 0) {
+    printf("rknn_matmul_create fail! ret=%d\n", ret);
+    slot->ctx = 0;
+    return -1;
+  }
+#ifdef RKNN_MATMUL_CORE_MASK
+  if (core_mask != RKNN_NPU_CORE_AUTO) {
+    ret = rknn_matmul_set_core_mask(slot->ctx, core_mask);
+    if (ret < 0) {
+      printf("rknn_matmul_set_core_mask fail! ret=%d\n", ret);
+      return -1;
+    }
+  }
+#else
+  (void)core_mask;
+#endif
+  slot->A = rknn_create_mem(slot->ctx, slot->io_attr.A.size);
+  slot->B = rknn_create_mem(slot->ctx, slot->io_attr.B.size);
+  slot->C = rknn_create_mem(slot->ctx, slot->io_attr.C.size);
+  if (slot->A == NULL || slot->B == NULL || slot->C == NULL) {
+    printf("rknn_create_mem fail!\n");
+    return -1;
+  }
+  if ((ret = rknn_matmul_set_io_mem(slot->ctx, slot->A, &slot->io_attr.A)) < 0 ||
+      (ret = rknn_matmul_set_io_mem(slot->ctx, slot->B, &slot->io_attr.B)) < 0 ||
+      (ret = rknn_matmul_set_io_mem(slot->ctx, slot->C, &slot->io_attr.C)) < 0) {
+    printf("rknn_matmul_set_io_mem fail! ret=%d\n", ret);
+    return -1;
+  }
+
+  // the packers take their block sizes from the first context
+  if (g->tile.a_sub_k == 0 && g->tile.b_sub_n == 0 && g->tile.c_sub_n == 0) {
+    matmul_layout from_attr;
+    if (matmul_layout_from_attr(&info, &slot->io_attr, &from_attr) != 0) {
+      return -1;
+    }
+    g->tile.a_sub_k = from_attr.a_sub_k;
+    g->tile.b_sub_n = from_attr.b_sub_n;
+    g->tile.b_sub_k = from_attr.b_sub_k;
+    g->tile.c_sub_n = from_attr.c_sub_n;
+    g->perf_a       = slot->io_attr.A.n_dims != 2;
+    g->native_b     = slot->io_attr.B.n_dims != 2;
+    g->perf_c       = slot->io_attr.C.n_dims != 2;
+  }
+  return 0;
+}
+
+static void destroy_slot(GemmSlot* slot)
+{
+  if (slot->ctx == 0) {
+    return;
+  }
+  if (slot->A != NULL) {
+    rknn_destroy_mem(slot->ctx, slot->A);
+  }
+  if (slot->B != NULL) {
+    rknn_destroy_mem(slot->ctx, slot->B);
+  }
+  if (slot->C != NULL) {
+    rknn_destroy_mem(slot->ctx, slot->C);
+  }
+  rknn_matmul_destroy(slot->ctx);
+  slot->ctx = 0;
+}
+
+/*-------------------------------------------
+                  gemm api
+-------------------------------------------*/
+int matmul_gemm_create(const matmul_gemm_config* config, int32_t M, int32_t K, int32_t N, matmul_gemm** gemm)
+{
+  *gemm = NULL;
+  if (M <= 0 || K <= 0 || N <= 0) {
+    printf("matmul_gemm_create: invalid shape M=%d K=%d N=%d\n", M, K, N);
+    return -1;
+  }
+  matmul_layout align;
+  if (matmul_layout_init(config->soc, config->type, 1, 0, 0, &align) != 0) {
+    return -1;
+  }
+
+  // tiles of one legal shape: K <= 4096 and K / N aligned, split as evenly as possible
+  bool    multi_core = strcmp(config->soc, "rk3588") == 0;
+  int32_t cores      = multi_core ? config->num_cores : 1;
+  cores              = cores < 1 ? 1 : (cores > MATMUL_GEMM_MAX_CORES ? MATMUL_GEMM_MAX_CORES : cores);
+
+  int32_t max_k = MATMUL_GEMM_MAX_K / align.k_align * align.k_align;
+  int32_t Mt    = config->tile_m > 0 ? config->tile_m : div_up(M, div_up(M, MATMUL_GEMM_MAX_M));
+  int32_t Kt    = config->tile_k > 0 ? align_up(config->tile_k, align.k_align)
+                                     : align_up(div_up(K, div_up(K, max_k)), align.k_align);
+  Kt            = Kt > max_k ? max_k : Kt;
+  Mt            = Mt > M ? M : Mt;
+  int32_t m_tiles = div_up(M, Mt);
+  int32_t Nt      = config->tile_n > 0 ? align_up(config->tile_n, align.n_align) : 0;
+  if (Nt == 0) {
+    // at least two output tiles per core, so that staging the next tile always has a run to hide behind
+    int32_t n_tiles = div_up(N, MATMUL_GEMM_MAX_N);
+    int32_t min_n   = div_up(2 * cores, m_tiles);
+    n_tiles         = n_tiles < min_n ? min_n : n_tiles;
+    Nt              = align_up(div_up(N, n_tiles), align.n_align);
+  }
+
+  matmul_gemm* g = new matmul_gemm;
+  g->config      = *config;
+  g->M           = M;
+  g->K           = K;
+  g->N           = N;
+  if (matmul_layout_init(config->soc, config->type, Mt, Kt, Nt, &g->tile) != 0) {
+    delete g;
+    return -1;
+  }
+  // block sizes come from the attrs of the first context
+  g->tile.a_sub_k = g->tile.b_sub_n = g->tile.b_sub_k = g->tile.c_sub_n = 0;
+  g->m_tiles      = m_tiles;
+  g->k_tiles      = div_up(K, Kt);
+  g->n_tiles      = div_up(N, Nt);
+  g->elem_bytes   = config->type == RKNN_TENSOR_INT8 ? 1 : 2;
+  g->perf_a = g->native_b = g->perf_c = false;
+  g->A = g->B = NULL;
+  g->C        = NULL;
+  g->next_job = 0;
+  g->failed   = false;
+
+  for (int32_t i = 0; i < cores; ++i) {
+    GemmWorker* w = new GemmWorker;
+    w->gemm       = g;
+    w->core       = multi_core ? i : -1;
+    memset(w->slot, 0, sizeof(w->slot));
+    w->ret            = 0;
+    w->stager_started = false;
+    w->pending        = false;
+    w->quit           = false;
+    pthread_mutex_init(&w->mu, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    g->workers.push_back(w);
+
+    rknn_core_mask core_mask = multi_core ? (rknn_core_mask)(RKNN_NPU_CORE_0 << i) : RKNN_NPU_CORE_AUTO;
+    if (create_slot(g, core_mask, &w->slot[0]) != 0 || create_slot(g, core_mask, &w->slot[1]) != 0) {
+      matmul_gemm_destroy(g);
+      return -1;
+    }
+    if (pthread_create(&w->stager, NULL, stager_loop, w) != 0) {
+      printf("matmul_gemm_create: pthread_create fail!\n");
+      matmul_gemm_destroy(g);
+      return -1;
+    }
+    w->stager_started = true;
+  }
+  for (size_t i = 0; i < g->workers.size(); ++i) {
+    g->workers[i]->scratch_a.resize(g->perf_a ? (size_t)Mt * Kt * g->elem_bytes : 0);
+    g->workers[i]->scratch_b.resize(g->native_b ? (size_t)Kt * Nt * g->elem_bytes : 0);
+  }
+  *gemm = g;
+  return 0;
+}
+
+int matmul_gemm_run(matmul_gemm* g, const void* A, const void* B, void* C)
+{
+  g->A        = (const uint8_t*)A;
+  g->B        = (const uint8_t*)B;
+  g->C        = (uint8_t*)C;
+  g->next_job = 0;
+  g->failed   = false;
+
+  size_t                 num_workers = g->workers.size();
+  std::vector<pthread_t> threads(num_workers);
+  std::vector<bool>      started(num_workers, false);
+  for (size_t i = 0; i < num_workers; ++i) {
+    GemmWorker* w = g->workers[i];
+    w->ret        = 0;
+    for (int s = 0; s < 2; ++s) {
+      w->slot[s].a_mi = w->slot[s].a_ki = -1;
+      w->slot[s].b_ki = w->slot[s].b_ni = -1;
+    }
+  }
+  // the calling thread drives the first core, a worker that fails to start is run inline after it
+  for (size_t i = 1; i < num_workers; ++i) {
+    started[i] = pthread_create(&threads[i], NULL, worker_run, g->workers[i]) == 0;
+  }
+  worker_run(g->workers[0]);
+  for (size_t i = 1; i < num_workers; ++i) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    } else {
+      worker_run(g->workers[i]);
+    }
+  }
+  return g->failed ? -1 : 0;
+}
+
+void matmul_gemm_dump(const matmul_gemm* g)
+{
+  const matmul_layout* t = &g->tile;
+  printf("matmul gemm M=%d K=%d N=%d %s on %s: tile %dx%dx%d, %dx%dx%d tiles (padded %dx%dx%d), %zu core(s), "
+         "A %s, B %s, C %s\n",
+         g->M, g->K, g->N, get_type_string(t->type), g->config.soc, t->M, t->K, t->N, g->m_tiles, g->k_tiles,
+         g->n_tiles, g->m_tiles * t->M, g->k_tiles * t->K, g->n_tiles * t->N, g->workers.size(),
+         g->perf_a ? "perf" : "normal", g->native_b ? "native" : "normal", g->perf_c ? "perf" : "normal");
+}
+
+void matmul_gemm_destroy(matmul_gemm* g)
+{
+  if (g == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < g->workers.size(); ++i) {
+    GemmWorker* w = g->workers[i];
+    if (w->stager_started) {
+      pthread_mutex_lock(&w->mu);
+      w->quit = true;
+      pthread_cond_broadcast(&w->cond);
+      pthread_mutex_unlock(&w->mu);
+      pthread_join(w->stager, NULL);
+    }
+    destroy_slot(&w->slot[0]);
+    destroy_slot(&w->slot[1]);
+    pthread_mutex_destroy(&w->mu);
+    pthread_cond_destroy(&w->cond);
+    delete w;
+  }
+  delete g;
+}
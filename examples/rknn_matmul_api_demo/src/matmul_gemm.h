@@ -0,0 +1,55 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNPU2_MATMUL_GEMM_H_
+#define _RKNPU2_MATMUL_GEMM_H_
+
+#include <stdint.h>
+
+#include "rknn_matmul_api.h"
+
+/*
+  C = A x B of any M x K x N on top of rknn_matmul, which takes K <= 4096 with K / N aligned per SoC.
+  M, K and N are split into tiles of one legal shape, the ragged edges padded with zeros. every NPU core gets its own
+  pair of matmul contexts and takes output tiles (M, N) from a shared counter, running all K tiles of one output
+  tile in turn: while one context runs, a helper thread packs A / B of the next K tile into the other context and
+  adds the int32 / fp32 partial C of the previous one into C.
+*/
+
+typedef struct _matmul_gemm_config
+{
+  const char*      soc;  // "rk3588", "rk356x" or "rk3562", for the alignment of K / N
+  rknn_tensor_type type; // RKNN_TENSOR_INT8: int8 A, B, int32 C. RKNN_TENSOR_FLOAT16: float16 A, B, float32 C
+  int32_t          tile_m; // 0: min(M, 512)
+  int32_t          tile_k; // 0: K split evenly in tiles of <= 4096
+  int32_t          tile_n; // 0: N split evenly in tiles of <= 4096, at least one per core
+  int32_t          num_cores;     // rk3588: 1..3, tiles on cores 0..num_cores - 1. other SoCs: 1
+  int32_t          native_layout; // layouts of the tiles given to the NPU, packed on the CPU
+  int32_t          perf_layout;
+} matmul_gemm_config;
+
+typedef struct _matmul_gemm matmul_gemm;
+
+/* contexts and tile memory for an M x K x N GEMM. returns 0 or -1. */
+int matmul_gemm_create(const matmul_gemm_config* config, int32_t M, int32_t K, int32_t N, matmul_gemm** gemm);
+
+/* A (M, K), B (K, N) and C (M, N) in normal layout, element types as in config->type. returns 0 or -1. */
+int matmul_gemm_run(matmul_gemm* gemm, const void* A, const void* B, void* C);
+
+// prints the tile plan
+void matmul_gemm_dump(const matmul_gemm* gemm);
+
+void matmul_gemm_destroy(matmul_gemm* gemm);
+
+#endif //_RKNPU2_MATMUL_GEMM_H_
@@ -0,0 +1,367 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_layout.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// rows of A / C copied per pass over one 64 byte line of each row
+#define MATMUL_ROW_TILE 64
+
+static uint32_t elem_bytes(rknn_tensor_type type)
+{
+  return type == RKNN_TENSOR_INT8 ? 1 : 2;
+}
+
+/*-------------------------------------------
+              block copies (A, C)
+-------------------------------------------*/
+template <int BLK>
+static inline void copy_block(const uint8_t* src, uint8_t* dst)
+{
+  memcpy(dst, src, BLK);
+}
+
+template <>
+inline void copy_block<16>(const uint8_t* src, uint8_t* dst)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  vst1q_u8(dst, vld1q_u8(src));
+#elif defined(__SSE2__)
+  _mm_storeu_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
+#else
+  memcpy(dst, src, 16);
+#endif
+}
+
+/*
+  (rows, blocks * BLK bytes) with a row stride of ld bytes <-> (blocks, rows, BLK bytes).
+  the rows are walked in tiles so that each 64 byte line of the row major side is read / written once.
+*/
+template <int BLK>
+static void rows_blocks(uint8_t* rows_data, size_t ld, int32_t rows, int32_t blocks, uint8_t* blocks_data,
+                        bool to_blocks)
+{
+  const int32_t line_blocks = 64 / BLK;
+  for (int32_t r0 = 0; r0 < rows; r0 += MATMUL_ROW_TILE) {
+    int32_t r1 = r0 + MATMUL_ROW_TILE < rows ? r0 + MATMUL_ROW_TILE : rows;
+    for (int32_t b0 = 0; b0 < blocks; b0 += line_blocks) {
+      int32_t b1 = b0 + line_blocks < blocks ? b0 + line_blocks : blocks;
+      for (int32_t b = b0; b < b1; ++b) {
+        uint8_t* r = rows_data + r0 * ld + (size_t)b * BLK;
+        uint8_t* k = blocks_data + ((size_t)b * rows + r0) * BLK;
+        for (int32_t i = r0; i < r1; ++i, r += ld, k += BLK) {
+          if (to_blocks) {
+            copy_block<BLK>(r, k);
+          } else {
+            copy_block<BLK>(k, r);
+          }
+        }
+      }
+    }
+  }
+}
+
+static void rows_blocks(uint32_t blk, uint8_t* rows_data, size_t ld, int32_t rows, int32_t blocks,
+                        uint8_t* blocks_data, bool to_blocks)
+{
+  switch (blk) {
+  case 16:
+    rows_blocks<16>(rows_data, ld, rows, blocks, blocks_data, to_blocks);
+    break;
+  case 8:
+    rows_blocks<8>(rows_data, ld, rows, blocks, blocks_data, to_blocks);
+    break;
+  case 4:
+    rows_blocks<4>(rows_data, ld, rows, blocks, blocks_data, to_blocks);
+    break;
+  default:
+    // not a size of the matmul layouts, kept general
+    for (int32_t b = 0; b < blocks; ++b) {
+      for (int32_t i = 0; i < rows; ++i) {
+        uint8_t* r = rows_data + i * ld + (size_t)b * blk;
+        uint8_t* k = blocks_data + ((size_t)b * rows + i) * blk;
+        memcpy(to_blocks ? k : r, to_blocks ? r : k, blk);
+      }
+    }
+    break;
+  }
+}
+
+/*-------------------------------------------
+              transposes (B)
+-------------------------------------------*/
+// 16 x 16 bytes: four rounds of interleaving row i with row i + 8
+static inline void transpose_u8(const uint8_t* src, size_t ss, uint8_t* dst, size_t ds)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  uint8x16_t a[16];
+  for (int i = 0; i < 16; ++i) {
+    a[i] = vld1q_u8(src + i * ss);
+  }
+  for (int round = 0; round < 4; ++round) {
+    uint8x16_t b[16];
+    for (int i = 0; i < 8; ++i) {
+      uint8x16x2_t z = vzipq_u8(a[i], a[i + 8]);
+      b[2 * i]       = z.val[0];
+      b[2 * i + 1]   = z.val[1];
+    }
+    memcpy(a, b, sizeof(a));
+  }
+  for (int i = 0; i < 16; ++i) {
+    vst1q_u8(dst + i * ds, a[i]);
+  }
+#elif defined(__SSE2__)
+  __m128i a[16];
+  for (int i = 0; i < 16; ++i) {
+    a[i] = _mm_loadu_si128((const __m128i*)(src + i * ss));
+  }
+  for (int round = 0; round < 4; ++round) {
+    __m128i b[16];
+    for (int i = 0; i < 8; ++i) {
+      b[2 * i]     = _mm_unpacklo_epi8(a[i], a[i + 8]);
+      b[2 * i + 1] = _mm_unpackhi_epi8(a[i], a[i + 8]);
+    }
+    memcpy(a, b, sizeof(a));
+  }
+  for (int i = 0; i < 16; ++i) {
+    _mm_storeu_si128((__m128i*)(dst + i * ds), a[i]);
+  }
+#else
+  for (int i = 0; i < 16; ++i) {
+    for (int j = 0; j < 16; ++j) {
+      dst[j * ds + i] = src[i * ss + j];
+    }
+  }
+#endif
+}
+
+// 8 x 8 16 bit elements, three rounds of interleaving row i with row i + 4
+static inline void transpose_u16(const uint8_t* src, size_t ss, uint8_t* dst, size_t ds)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  uint16x8_t a[8];
+  for (int i = 0; i < 8; ++i) {
+    a[i] = vld1q_u16((const uint16_t*)(src + i * ss));
+  }
+  for (int round = 0; round < 3; ++round) {
+    uint16x8_t b[8];
+    for (int i = 0; i < 4; ++i) {
+      uint16x8x2_t z = vzipq_u16(a[i], a[i + 4]);
+      b[2 * i]       = z.val[0];
+      b[2 * i + 1]   = z.val[1];
+    }
+    memcpy(a, b, sizeof(a));
+  }
+  for (int i = 0; i < 8; ++i) {
+    vst1q_u16((uint16_t*)(dst + i * ds), a[i]);
+  }
+#elif defined(__SSE2__)
+  __m128i a[8];
+  for (int i = 0; i < 8; ++i) {
+    a[i] = _mm_loadu_si128((const __m128i*)(src + i * ss));
+  }
+  for (int round = 0; round < 3; ++round) {
+    __m128i b[8];
+    for (int i = 0; i < 4; ++i) {
+      b[2 * i]     = _mm_unpacklo_epi16(a[i], a[i + 4]);
+      b[2 * i + 1] = _mm_unpackhi_epi16(a[i], a[i + 4]);
+    }
+    memcpy(a, b, sizeof(a));
+  }
+  for (int i = 0; i < 8; ++i) {
+    _mm_storeu_si128((__m128i*)(dst + i * ds), a[i]);
+  }
+#else
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 8; ++j) {
+      memcpy(dst + j * ds + i * 2, src + i * ss + j * 2, 2);
+    }
+  }
+#endif
+}
+
+/*
+  normal B (K, N) <-> native B (N / sn, K / sk, sn, sk): every sn x sk tile is the transpose of a sk x sn block of
+  B. the sk rows of B of one tile row are walked once, writing whole tiles.
+*/
+static void b_transpose(const matmul_layout* l, uint8_t* normal, size_t ld, uint8_t* native, bool pack)
+{
+  const uint32_t eb = elem_bytes(l->type);
+  const int32_t  t  = 16 / eb; // elements per transpose block
+  const int32_t  sn = l->b_sub_n, sk = l->b_sub_k;
+  const int32_t  kt = l->K / sk;
+  const size_t   ts = (size_t)sk * eb; // row stride inside a tile
+  for (int32_t kb = 0; kb < kt; ++kb) {
+    for (int32_t nb = 0; nb < l->N / sn; ++nb) {
+      uint8_t* tile = native + ((size_t)nb * kt + kb) * sn * sk * eb;
+      for (int32_t n0 = 0; n0 < sn; n0 += t) {
+        for (int32_t k0 = 0; k0 < sk; k0 += t) {
+          uint8_t* np = normal + (size_t)(kb * sk + k0) * ld + (size_t)(nb * sn + n0) * eb;
+          uint8_t* tp = tile + ((size_t)n0 * sk + k0) * eb;
+          if (eb == 1 && pack) {
+            transpose_u8(np, ld, tp, ts);
+          } else if (eb == 1) {
+            transpose_u8(tp, ts, np, ld);
+          } else if (pack) {
+            transpose_u16(np, ld, tp, ts);
+          } else {
+            transpose_u16(tp, ts, np, ld);
+          }
+        }
+      }
+    }
+  }
+}
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+int matmul_layout_init(const char* soc, rknn_tensor_type type, int32_t M, int32_t K, int32_t N,
+                       matmul_layout* layout)
+{
+  if (type != RKNN_TENSOR_INT8 && type != RKNN_TENSOR_FLOAT16) {
+    printf("matmul_layout_init: type %s is not supported\n", get_type_string(type));
+    return -1;
+  }
+  bool int8 = type == RKNN_TENSOR_INT8;
+  memset(layout, 0, sizeof(matmul_layout));
+  layout->type    = type;
+  layout->M       = M;
+  layout->K       = K;
+  layout->N       = N;
+  layout->c_sub_n = 4;
+  if (strcmp(soc, "rk3588") == 0) {
+    layout->k_align = 32;
+    layout->n_align = int8 ? 32 : 16;
+    layout->a_sub_k = int8 ? 16 : 8;
+    layout->b_sub_n = int8 ? 32 : 16;
+    layout->b_sub_k = 32;
+  } else if (strcmp(soc, "rk356x") == 0 || strcmp(soc, "rk3562") == 0) {
+    layout->k_align = int8 ? 32 : 16;
+    layout->n_align = int8 ? 16 : 8;
+    layout->a_sub_k = int8 ? 8 : 4;
+    layout->b_sub_n = int8 ? 16 : 8;
+    layout->b_sub_k = int8 ? 32 : 16;
+  } else {
+    printf("matmul_layout_init: unknown soc %s\n", soc);
+    return -1;
+  }
+  return 0;
+}
+
+int matmul_layout_from_attr(const rknn_matmul_info* info, const rknn_matmul_io_attr* io_attr, matmul_layout* layout)
+{
+  memset(layout, 0, sizeof(matmul_layout));
+  layout->type = info->type;
+  layout->M    = info->M;
+  layout->K    = info->K;
+  layout->N    = info->N;
+  if (info->type != RKNN_TENSOR_INT8 && info->type != RKNN_TENSOR_FLOAT16) {
+    printf("matmul_layout_from_attr: type %s is not supported\n", get_type_string(info->type));
+    return -1;
+  }
+  // the block is the last dim of the perf / native tensors
+  if (io_attr->A.n_dims > 2) {
+    layout->a_sub_k = io_attr->A.dims[io_attr->A.n_dims - 1];
+  }
+  if (io_attr->B.n_dims == 4) {
+    layout->b_sub_n = io_attr->B.dims[2];
+    layout->b_sub_k = io_attr->B.dims[3];
+  }
+  if (io_attr->C.n_dims > 2) {
+    layout->c_sub_n = io_attr->C.dims[io_attr->C.n_dims - 1];
+  }
+  return 0;
+}
+
+static bool check_block(const char* func, int32_t sub, int32_t dim)
+{
+  if (sub <= 0 || dim % sub != 0) {
+    printf("%s: block size %d does not divide %d\n", func, sub, dim);
+    return false;
+  }
+  return true;
+}
+
+int matmul_pack_A(const matmul_layout* l, const void* a, int32_t lda, void* perf_a)
+{
+  if (!check_block("matmul_pack_A", l->a_sub_k, l->K)) {
+    return -1;
+  }
+  uint32_t eb = elem_bytes(l->type);
+  rows_blocks(l->a_sub_k * eb, (uint8_t*)a, (size_t)(lda ? lda : l->K) * eb, l->M, l->K / l->a_sub_k,
+              (uint8_t*)perf_a, true);
+  return 0;
+}
+
+int matmul_unpack_A(const matmul_layout* l, const void* perf_a, void* a, int32_t lda)
+{
+  if (!check_block("matmul_unpack_A", l->a_sub_k, l->K)) {
+    return -1;
+  }
+  uint32_t eb = elem_bytes(l->type);
+  rows_blocks(l->a_sub_k * eb, (uint8_t*)a, (size_t)(lda ? lda : l->K) * eb, l->M, l->K / l->a_sub_k,
+              (uint8_t*)perf_a, false);
+  return 0;
+}
+
+int matmul_pack_B(const matmul_layout* l, const void* b, int32_t ldb, void* native_b)
+{
+  uint32_t eb = elem_bytes(l->type);
+  if (!check_block("matmul_pack_B", l->b_sub_n, l->N) || !check_block("matmul_pack_B", l->b_sub_k, l->K) ||
+      !check_block("matmul_pack_B", 16 / eb, l->b_sub_n) || !check_block("matmul_pack_B", 16 / eb, l->b_sub_k)) {
+    return -1;
+  }
+  b_transpose(l, (uint8_t*)b, (size_t)(ldb ? ldb : l->N) * eb, (uint8_t*)native_b, true);
+  return 0;
+}
+
+int matmul_unpack_B(const matmul_layout* l, const void* native_b, void* b, int32_t ldb)
+{
+  uint32_t eb = elem_bytes(l->type);
+  if (!check_block("matmul_unpack_B", l->b_sub_n, l->N) || !check_block("matmul_unpack_B", l->b_sub_k, l->K) ||
+      !check_block("matmul_unpack_B", 16 / eb, l->b_sub_n) || !check_block("matmul_unpack_B", 16 / eb, l->b_sub_k)) {
+    return -1;
+  }
+  b_transpose(l, (uint8_t*)b, (size_t)(ldb ? ldb : l->N) * eb, (uint8_t*)native_b, false);
+  return 0;
+}
+
+int matmul_pack_C(const matmul_layout* l, const void* c, int32_t ldc, void* perf_c)
+{
+  if (!check_block("matmul_pack_C", l->c_sub_n, l->N)) {
+    return -1;
+  }
+  rows_blocks(l->c_sub_n * 4, (uint8_t*)c, (size_t)(ldc ? ldc : l->N) * 4, l->M, l->N / l->c_sub_n,
+              (uint8_t*)perf_c, true);
+  return 0;
+}
+
+int matmul_unpack_C(const matmul_layout* l, const void* perf_c, void* c, int32_t ldc)
+{
+  if (!check_block("matmul_unpack_C", l->c_sub_n, l->N)) {
+    return -1;
+  }
+  rows_blocks(l->c_sub_n * 4, (uint8_t*)c, (size_t)(ldc ? ldc : l->N) * 4, l->M, l->N / l->c_sub_n,
+              (uint8_t*)perf_c, false);
+  return 0;
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNPU2_MATMUL_LAYOUT_H_
+#define _RKNPU2_MATMUL_LAYOUT_H_
+
+#include <stdint.h>
+
+#include "rknn_matmul_api.h"
+
+/*
+  packing between the normal layouts of A (M, K), B (K, N), C (M, N) and the layouts of rknn_matmul_api.h:
+    perf A:   (K / a_sub_k, M, a_sub_k)
+    native B: (N / b_sub_n, K / b_sub_k, b_sub_n, b_sub_k)
+    perf C:   (N / c_sub_n, M, c_sub_n)
+  A and C are copied in blocks of 8 / 16 bytes, B goes through 16x16 (int8) / 8x8 (float16) NEON transposes, both
+  blocked so that the source lines are used up while they are in the cache.
+*/
+
+typedef struct _matmul_layout
+{
+  rknn_tensor_type type; // RKNN_TENSOR_INT8 or RKNN_TENSOR_FLOAT16 for A and B, C is int32 / float32
+  int32_t          M;
+  int32_t          K;
+  int32_t          N;
+  int32_t          k_align; // alignment of K and N required by rknn_matmul_create()
+  int32_t          n_align;
+  int32_t          a_sub_k; // block sizes, 0 when the layout is unknown
+  int32_t          b_sub_n;
+  int32_t          b_sub_k;
+  int32_t          c_sub_n;
+} matmul_layout;
+
+/* block sizes of soc ("rk3588", "rk356x" or "rk3562") for an M x K x N matmul of type. returns 0 or -1. */
+int matmul_layout_init(const char* soc, rknn_tensor_type type, int32_t M, int32_t K, int32_t N,
+                       matmul_layout* layout);
+
+/* block sizes from the attrs returned by rknn_matmul_create(), only for the tensors in perf / native layout
+   (k_align / n_align are left 0). returns 0 or -1. */
+int matmul_layout_from_attr(const rknn_matmul_info* info, const rknn_matmul_io_attr* io_attr, matmul_layout* layout);
+
+/* ld* are the row strides of the normal matrices in elements, 0 for K (A) / N (B, C). return 0, or -1 when the block
+   sizes are unknown or do not divide the shape. */
+int matmul_pack_A(const matmul_layout* layout, const void* a, int32_t lda, void* perf_a);
+int matmul_unpack_A(const matmul_layout* layout, const void* perf_a, void* a, int32_t lda);
+int matmul_pack_B(const matmul_layout* layout, const void* b, int32_t ldb, void* native_b);
+int matmul_unpack_B(const matmul_layout* layout, const void* native_b, void* b, int32_t ldb);
+int matmul_pack_C(const matmul_layout* layout, const void* c, int32_t ldc, void* perf_c);
+int matmul_unpack_C(const matmul_layout* layout, const void* perf_c, void* c, int32_t ldc);
+
+#endif //_RKNPU2_MATMUL_LAYOUT_H_
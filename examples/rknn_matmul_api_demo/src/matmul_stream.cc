@@ -0,0 +1,293 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_stream.h"
+#include "matmul_layout.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+struct StreamSlot
+{
+  rknn_matmul_ctx     ctx;
+  rknn_matmul_io_attr io_attr;
+  rknn_tensor_mem*    A;
+  rknn_tensor_mem*    B; // slot 0 owns B, slot 1 imports it
+  rknn_tensor_mem*    C;
+  int64_t             submit_us;
+  int64_t             done_us;
+  int64_t             run_us;
+  int                 ret;
+};
+
+// step n runs in slot n % 2, the counters only grow
+struct _matmul_stream
+{
+  matmul_stream_config config;
+  matmul_layout        layout;
+  StreamSlot           slot[2];
+
+  pthread_t       runner;
+  bool            runner_started;
+  pthread_mutex_t mu;
+  pthread_cond_t  cond;
+  bool            quit;
+  int64_t         submitted;
+  int64_t         done;
+  int64_t         fetched;
+
+  matmul_stream_stats stats;
+  int64_t             first_us;
+};
+
+static void* runner_loop(void* arg)
+{
+  matmul_stream* s = (matmul_stream*)arg;
+  pthread_mutex_lock(&s->mu);
+  while (true) {
+    while (s->done == s->submitted && !s->quit) {
+      pthread_cond_wait(&s->cond, &s->mu);
+    }
+    if (s->done == s->submitted) {
+      break;
+    }
+    StreamSlot* slot = &s->slot[s->done % 2];
+    pthread_mutex_unlock(&s->mu);
+
+    int64_t start_us = getCurrentTimeUs();
+    int     ret      = rknn_matmul_run(slot->ctx);
+    int64_t end_us   = getCurrentTimeUs();
+
+    pthread_mutex_lock(&s->mu);
+    slot->ret     = ret;
+    slot->run_us  = end_us - start_us;
+    slot->done_us = end_us;
+    ++s->done;
+    pthread_cond_broadcast(&s->cond);
+  }
+  pthread_mutex_unlock(&s->mu);
+  return NULL;
+}
+
+static int create_slot(matmul_stream* s, int index, const void* B)
+{
+  StreamSlot*      slot = &s->slot[index];
+  rknn_matmul_info info;
+  memset(&info, 0, sizeof(rknn_matmul_info));
+  info.M             = s->config.M;
+  info.K             = s->config.K;
+  info.N             = s->config.N;
+  info.type          = s->config.type;
+  info.native_layout = 1;
+  info.perf_layout   = s->config.perf_layout;
+
+  int ret = rknn_matmul_create(&slot->ctx, &info, &slot->io_attr);
+  if (ret < 0) {
+    printf("rknn_matmul_create fail! ret=%d\n", ret);
+    slot->ctx = 0;
+    return -1;
+  }
+  if (index == 0 && matmul_layout_from_attr(&info, &slot->io_attr, &s->layout) != 0) {
+    return -1;
+  }
+  slot->A = rknn_create_mem(slot->ctx, slot->io_attr.A.size);
+  slot->C = rknn_create_mem(slot->ctx, slot->io_attr.C.size);
+  if (slot->A == NULL || slot->C == NULL) {
+    printf("rknn_create_mem fail!\n");
+    return -1;
+  }
+
+  // the resident B: packed once, the second context runs on the same memory
+  if (index > 0) {
+    rknn_tensor_mem* m = s->slot[0].B;
+    slot->B            = rknn_create_mem_from_fd(slot->ctx, m->fd, m->virt_addr, m->size, m->offset);
+  }
+  if (slot->B == NULL) {
+    slot->B = rknn_create_mem(slot->ctx, slot->io_attr.B.size);
+    if (slot->B == NULL || matmul_pack_B(&s->layout, B, 0, slot->B->virt_addr) != 0) {
+      printf("matmul_stream_create: B setup fail!\n");
+      return -1;
+    }
+  }
+
+  if ((ret = rknn_matmul_set_io_mem(slot->ctx, slot->A, &slot->io_attr.A)) < 0 ||
+      (ret = rknn_matmul_set_io_mem(slot->ctx, slot->B, &slot->io_attr.B)) < 0 ||
+      (ret = rknn_matmul_set_io_mem(slot->ctx, slot->C, &slot->io_attr.C)) < 0) {
+    printf("rknn_matmul_set_io_mem fail! ret=%d\n", ret);
+    return -1;
+  }
+  return 0;
+}
+
+static void destroy_slot(StreamSlot* slot)
+{
+  if (slot->ctx == 0) {
+    return;
+  }
+  if (slot->A != NULL) {
+    rknn_destroy_mem(slot->ctx, slot->A);
+  }
+  if (slot->B != NULL) {
+    rknn_destroy_mem(slot->ctx, slot->B);
+  }
+  if (slot->C != NULL) {
+    rknn_destroy_mem(slot->ctx, slot->C);
+  }
+  rknn_matmul_destroy(slot->ctx);
+  slot->ctx = 0;
+}
+
+int matmul_stream_create(const matmul_stream_config* config, const void* B, matmul_stream** stream)
+{
+  *stream          = NULL;
+  matmul_stream* s = new matmul_stream;
+  s->config        = *config;
+  memset(s->slot, 0, sizeof(s->slot));
+  memset(&s->stats, 0, sizeof(matmul_stream_stats));
+  s->runner_started = false;
+  s->quit           = false;
+  s->submitted = s->done = s->fetched = 0;
+  s->first_us                         = 0;
+  pthread_mutex_init(&s->mu, NULL);
+  pthread_cond_init(&s->cond, NULL);
+
+  if (create_slot(s, 0, B) != 0 || create_slot(s, 1, B) != 0) {
+    matmul_stream_destroy(s);
+    return -1;
+  }
+  if (pthread_create(&s->runner, NULL, runner_loop, s) != 0) {
+    printf("matmul_stream_create: pthread_create fail!\n");
+    matmul_stream_destroy(s);
+    return -1;
+  }
+  s->runner_started = true;
+  *stream           = s;
+  return 0;
+}
+
+int matmul_stream_submit(matmul_stream* s, const void* A)
+{
+  int64_t start_us = getCurrentTimeUs();
+  pthread_mutex_lock(&s->mu);
+  int64_t step = s->submitted;
+  bool    full = step - s->fetched >= 2;
+  pthread_mutex_unlock(&s->mu);
+  if (full) {
+    printf("matmul_stream_submit: two steps in flight, fetch first\n");
+    return -1;
+  }
+  if (s->first_us == 0) {
+    s->first_us = start_us;
+  }
+
+  // the slot was fetched, the runner does not touch it
+  StreamSlot*                    slot = &s->slot[step % 2];
+  const rknn_matmul_tensor_attr* attr = &slot->io_attr.A;
+  slot->submit_us                     = start_us;
+  if (attr->n_dims == 2) {
+    memcpy(slot->A->virt_addr, A, attr->size);
+  } else if (matmul_pack_A(&s->layout, A, 0, slot->A->virt_addr) != 0) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&s->mu);
+  ++s->submitted;
+  pthread_cond_broadcast(&s->cond);
+  pthread_mutex_unlock(&s->mu);
+  return 0;
+}
+
+int matmul_stream_fetch(matmul_stream* s, void* C)
+{
+  pthread_mutex_lock(&s->mu);
+  if (s->fetched == s->submitted) {
+    pthread_mutex_unlock(&s->mu);
+    printf("matmul_stream_fetch: nothing submitted\n");
+    return -1;
+  }
+  while (s->done <= s->fetched) {
+    pthread_cond_wait(&s->cond, &s->mu);
+  }
+  StreamSlot* slot = &s->slot[s->fetched % 2];
+  pthread_mutex_unlock(&s->mu);
+
+  int ret = slot->ret;
+  if (ret < 0) {
+    printf("rknn_matmul_run fail! ret=%d\n", ret);
+  } else if (slot->io_attr.C.n_dims == 2) {
+    memcpy(C, slot->C->virt_addr, slot->io_attr.C.size);
+  } else {
+    ret = matmul_unpack_C(&s->layout, slot->C->virt_addr, C, 0);
+  }
+
+  matmul_stream_stats* st         = &s->stats;
+  int64_t              latency_us = slot->done_us - slot->submit_us;
+  st->min_latency_us = st->steps == 0 || latency_us < st->min_latency_us ? latency_us : st->min_latency_us;
+  st->max_latency_us = latency_us > st->max_latency_us ? latency_us : st->max_latency_us;
+  st->latency_us += latency_us;
+  st->run_us += slot->run_us;
+  ++st->steps;
+  st->wall_us = getCurrentTimeUs() - s->first_us;
+
+  pthread_mutex_lock(&s->mu);
+  ++s->fetched;
+  pthread_mutex_unlock(&s->mu);
+  return ret < 0 ? -1 : 0;
+}
+
+void matmul_stream_get_stats(const matmul_stream* s, matmul_stream_stats* stats)
+{
+  *stats = s->stats;
+}
+
+void matmul_stream_dump(const matmul_stream* s)
+{
+  const matmul_stream_stats* st  = &s->stats;
+  int64_t                    n   = st->steps ? st->steps : 1;
+  double                     ops = 2.0 * s->config.M * s->config.K * s->config.N * st->steps;
+  printf("matmul stream M=%d K=%d N=%d %s: %lld steps, %.2f GOPS, latency avg %.3f ms (min %.3f, max %.3f), "
+         "run avg %.3f ms\n",
+         s->config.M, s->config.K, s->config.N, get_type_string(s->config.type), (long long)st->steps,
+         st->wall_us ? ops / st->wall_us / 1e3 : 0., st->latency_us / 1000. / n, st->min_latency_us / 1000.,
+         st->max_latency_us / 1000., st->run_us / 1000. / n);
+}
+
+void matmul_stream_destroy(matmul_stream* s)
+{
+  if (s == NULL) {
+    return;
+  }
+  if (s->runner_started) {
+    pthread_mutex_lock(&s->mu);
+    s->quit = true;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mu);
+    pthread_join(s->runner, NULL);
+  }
+  // the importer before the owner of B
+  destroy_slot(&s->slot[1]);
+  destroy_slot(&s->slot[0]);
+  pthread_mutex_destroy(&s->mu);
+  pthread_cond_destroy(&s->cond);
+  delete s;
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNPU2_MATMUL_STREAM_H_
+#define _RKNPU2_MATMUL_STREAM_H_
+
+#include <stdint.h>
+
+#include "rknn_matmul_api.h"
+
+/*
+  many A (M, K) against one fixed B (K, N), as in LLM decoding.
+  B is packed once into native layout and shared by two matmul contexts, each with its own A / C. the runs are made
+  by a thread of the stream, so that the caller writes A[n + 1] and reads C[n - 1] while the NPU computes C[n]:
+
+    submit(A0) submit(A1) fetch(C0) submit(A2) fetch(C1) submit(A3) ...
+
+  at most two steps are in flight, submit() fails when it would need a third one.
+*/
+
+typedef struct _matmul_stream_config
+{
+  rknn_tensor_type type; // RKNN_TENSOR_INT8 or RKNN_TENSOR_FLOAT16
+  int32_t          M;
+  int32_t          K;
+  int32_t          N;
+  int32_t          perf_layout; // A and C are packed / unpacked on the caller's thread
+} matmul_stream_config;
+
+typedef struct _matmul_stream_stats
+{
+  int64_t steps;      // fetched
+  int64_t run_us;     // sum of rknn_matmul_run()
+  int64_t latency_us; // sum from submit() to the end of the run
+  int64_t min_latency_us;
+  int64_t max_latency_us;
+  int64_t wall_us;    // from the first submit() to the last fetch()
+} matmul_stream_stats;
+
+typedef struct _matmul_stream matmul_stream;
+
+/* B (K, N) in normal layout. returns 0 or -1. */
+int matmul_stream_create(const matmul_stream_config* config, const void* B, matmul_stream** stream);
+
+/* writes A (M, K, normal layout) into a free context and queues its run. returns 0 or -1. */
+int matmul_stream_submit(matmul_stream* stream, const void* A);
+
+/* waits for the oldest step in flight and reads its C (M, N, normal layout). returns 0 or -1. */
+int matmul_stream_fetch(matmul_stream* stream, void* C);
+
+void matmul_stream_get_stats(const matmul_stream* stream, matmul_stream_stats* stats);
+
+// prints throughput in GOPS and the latency per step
+void matmul_stream_dump(const matmul_stream* stream);
+
+void matmul_stream_destroy(matmul_stream* stream);
+
+#endif //_RKNPU2_MATMUL_STREAM_H_
@@ -14,6 +14,8 @@
                 Includes
 -------------------------------------------*/
 #include "Float16.h"
+#include "matmul_cpu.h"
+#include "matmul_layout.h"
 #include "rknn_matmul_api.h"
 
 #include <stdio.h>
@@ -35,25 +37,6 @@ static inline int64_t getCurrentTimeUs()
   return tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-// 一维矩阵乘法函数
-template <typename Ti, typename To>
-std::vector<To> matrixMultiply(const Ti* A, const Ti* B, int M, int K, int N)
-{
-  std::vector<To> result(M * N, 0);
-
-  for (int i = 0; i < M; ++i) {
-    for (int j = 0; j < N; ++j) {
-      float sum = 0;
-      for (int k = 0; k < K; ++k) {
-        sum += (float)A[i * K + k] * (float)B[k * N + j];
-      }
-      result[i * N + j] = sum;
-    }
-  }
-
-  return result;
-}
-
 template <typename T>
 bool arraysEqual(const std::vector<T>& arr1, const std::vector<T>& arr2, float eps = 0.0001f)
 {
@@ -172,7 +155,7 @@ static void dump_matmul_tensor(rknn_tensor_mem* tensor, rknn_matmul_tensor_attr*
 
 static void print_usage(char* argv[])
 {
-  printf("Usage: %s [loop_count=1] [native_layout=0] [perf_layout=0]\n", argv[0]);
+  printf("Usage: %s [loop_count=1] [native_layout=0] [perf_layout=0] [type=int8|fp16]\n", argv[0]);
 }
 
 int main(int argc, char* argv[])
@@ -198,6 +181,17 @@ int main(int argc, char* argv[])
     perf_layout = atoi(argv[3]);
   }
 
+  // int8 or float16 matmul
+  rknn_tensor_type type = RKNN_TENSOR_INT8;
+  if (argc > 4) {
+    if (!strcmp(argv[4], "fp16")) {
+      type = RKNN_TENSOR_FLOAT16;
+    } else if (strcmp(argv[4], "int8")) {
+      print_usage(argv);
+      return -1;
+    }
+  }
+
   int32_t M = 4;
   int32_t K = 64;
   int32_t N = 32;
@@ -211,7 +205,7 @@ int main(int argc, char* argv[])
   info.M             = M;
   info.K             = K;
   info.N             = N;
-  info.type          = RKNN_TENSOR_INT8;
+  info.type          = type;
   info.native_layout = native_layout;
   info.perf_layout   = perf_layout;
 
@@ -235,6 +229,32 @@ int main(int argc, char* argv[])
   std::uniform_int_distribution<> int_dis(-128, 127);
   std::normal_distribution<> float_dis(0.0, 1.0);
 
+  // random A (M, K) and B (K, N) in normal layout, packed into the perf / native layouts below
+  size_t               elem_size = info.type == RKNN_TENSOR_INT8 ? sizeof(int8_t) : sizeof(float16);
+  std::vector<uint8_t> A_normal(M * K * elem_size);
+  std::vector<uint8_t> B_normal(K * N * elem_size);
+  if (info.type == RKNN_TENSOR_INT8) {
+    for (size_t i = 0; i < A_normal.size(); ++i) {
+      A_normal[i] = (uint8_t)int_dis(gen);
+    }
+    for (size_t i = 0; i < B_normal.size(); ++i) {
+      B_normal[i] = (uint8_t)int_dis(gen);
+    }
+  } else if (info.type == RKNN_TENSOR_FLOAT16) {
+    std::vector<float> values(M * K + K * N);
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i] = float_dis(gen);
+    }
+    convertFloat32ToFloat16(values.data(), (float16*)A_normal.data(), M * K);
+    convertFloat32ToFloat16(values.data() + M * K, (float16*)B_normal.data(), K * N);
+  }
+
+  // block sizes of the perf / native layouts returned by rknn_matmul_create
+  matmul_layout layout;
+  if (matmul_layout_from_attr(&info, &io_attr, &layout) != 0) {
+    return -1;
+  }
+
   // Create A
   rknn_tensor_mem* A = rknn_create_mem(ctx, io_attr.A.size);
   if (A == NULL) {
@@ -243,33 +263,11 @@ int main(int argc, char* argv[])
   }
   // normal layout
   if (io_attr.A.n_dims == 2) {
-    for (uint32_t i = 0; i < io_attr.A.dims[0]; ++i) {
-      for (uint32_t j = 0; j < io_attr.A.dims[1]; ++j) {
-        if (info.type == RKNN_TENSOR_INT8) {
-          ((int8_t*)A->virt_addr)[i * io_attr.A.dims[1] + j] = int_dis(gen);
-        } else if (info.type == RKNN_TENSOR_FLOAT16) {
-          ((float16*)A->virt_addr)[i * io_attr.A.dims[1] + j] = float_dis(gen);
-        }
-      }
-    }
+    memcpy(A->virt_addr, A_normal.data(), A_normal.size());
   }
   // perf layout
-  else if (io_attr.A.n_dims == 4) {
-    for (uint32_t n = 0; n < io_attr.A.dims[0]; ++n) {
-      for (uint32_t k = 0; k < io_attr.A.dims[1]; ++k) {
-        for (uint32_t nn = 0; nn < io_attr.A.dims[2]; ++nn) {
-          for (uint32_t kk = 0; kk < io_attr.A.dims[3]; ++kk) {
-            if (info.type == RKNN_TENSOR_INT8) {
-              ((int8_t*)A->virt_addr)[((n * io_attr.A.dims[1] + k) * io_attr.A.dims[2] + nn) * io_attr.A.dims[3] + kk] =
-                1;
-            } else if (info.type == RKNN_TENSOR_FLOAT16) {
-              ((float16*)
-                 A->virt_addr)[((n * io_attr.A.dims[1] + k) * io_attr.A.dims[2] + nn) * io_attr.A.dims[3] + kk] = 1;
-            }
-          }
-        }
-      }
-    }
+  else if (matmul_pack_A(&layout, A_normal.data(), 0, A->virt_addr) != 0) {
+    return -1;
   }
 
   // Create B
@@ -278,37 +276,13 @@ int main(int argc, char* argv[])
     printf("rknn_create_mem fail!\n");
     return -1;
   }
-
   // normal layout
   if (io_attr.B.n_dims == 2) {
-    for (uint32_t i = 0; i < io_attr.B.dims[1]; ++i) {
-      for (uint32_t j = 0; j < io_attr.B.dims[0]; ++j) {
-        if (info.type == RKNN_TENSOR_INT8) {
-          ((int8_t*)B->virt_addr)[i * io_attr.B.dims[0] + j] = int_dis(gen);
-        } else if (info.type == RKNN_TENSOR_FLOAT16) {
-          ((float16*)B->virt_addr)[i * io_attr.B.dims[0] + j] = float_dis(gen);
-        }
-      }
-    }
+    memcpy(B->virt_addr, B_normal.data(), B_normal.size());
   }
   // native layout
-  else if (io_attr.B.n_dims == 4) {
-    for (uint32_t n = 0; n < io_attr.B.dims[0]; ++n) {
-      for (uint32_t k = 0; k < io_attr.B.dims[1]; ++k) {
-        for (uint32_t nn = 0; nn < io_attr.B.dims[2]; ++nn) {
-          for (uint32_t kk = 0; kk < io_attr.B.dims[3]; ++kk) {
-            if (info.type == RKNN_TENSOR_INT8) {
-              ((int8_t*)B->virt_addr)[((n * io_attr.B.dims[1] + k) * io_attr.B.dims[2] + nn) * io_attr.B.dims[3] + kk] =
-                nn + 1;
-            } else if (info.type == RKNN_TENSOR_FLOAT16) {
-              ((float16*)
-                 B->virt_addr)[((n * io_attr.B.dims[1] + k) * io_attr.B.dims[2] + nn) * io_attr.B.dims[3] + kk] =
-                nn + 1;
-            }
-          }
-        }
-      }
-    }
+  else if (matmul_pack_B(&layout, B_normal.data(), 0, B->virt_addr) != 0) {
+    return -1;
   }
 
   // Create C
@@ -358,28 +332,36 @@ int main(int argc, char* argv[])
   dump_matmul_tensor(B, &io_attr.B);
   dump_matmul_tensor(C, &io_attr.C);
 
-  // compare NPU res vs CPU res
-  if (io_attr.A.n_dims == 2 && io_attr.B.n_dims == 2) {
-    size_t C_elems = 1;
-    for (int i = 0; i < io_attr.C.n_dims; ++i) {
-      C_elems *= io_attr.C.dims[i];
+  // compare NPU res vs CPU res, a perf layout C is unpacked to (M, N) first
+  {
+    size_t               C_elems = M * N;
+    std::vector<uint8_t> C_normal(C_elems * 4);
+    if (io_attr.C.n_dims == 2) {
+      memcpy(C_normal.data(), C->virt_addr, C_normal.size());
+    } else if (matmul_unpack_C(&layout, C->virt_addr, C_normal.data(), 0) != 0) {
+      return -1;
     }
+    // blocked int8 -> int32 / float16 -> float32 GEMM on the CPU
+    int cpu_threads = 4;
     if (info.type == RKNN_TENSOR_INT8) {
-      std::vector<int32_t> cpu_res;
-      cpu_res.reserve(C_elems);
-      cpu_res = matrixMultiply<int8_t, int32_t>((const int8_t*)A->virt_addr, (const int8_t*)B->virt_addr, M, K, N);
-      std::vector<int32_t> npu_res((int32_t*)C->virt_addr, (int32_t*)C->virt_addr + C_elems);
+      std::vector<int32_t> cpu_res(C_elems);
+      if (matmul_cpu_run(info.type, A_normal.data(), B_normal.data(), cpu_res.data(), M, K, N, cpu_threads) != 0) {
+        return -1;
+      }
+      std::vector<int32_t> npu_res((int32_t*)C_normal.data(), (int32_t*)C_normal.data() + C_elems);
       if (arraysEqual<int32_t>(cpu_res, npu_res)) {
         printf("int8 matmul result is correct\n");
       } else {
         printf("int8 matmul result is wrong\n");
       }
     } else if (info.type == RKNN_TENSOR_FLOAT16) {
-      std::vector<float> cpu_res;
-      cpu_res.reserve(C_elems);
-      cpu_res = matrixMultiply<float16, float>((const float16*)A->virt_addr, (const float16*)B->virt_addr, M, K, N);
-      std::vector<float> npu_res((float*)C->virt_addr, (float*)C->virt_addr + C_elems);
-      if (arraysEqual<float>(cpu_res, npu_res)) {
+      std::vector<float> cpu_res(C_elems);
+      if (matmul_cpu_run(info.type, A_normal.data(), B_normal.data(), cpu_res.data(), M, K, N, cpu_threads) != 0) {
+        return -1;
+      }
+      std::vector<float> npu_res((float*)C_normal.data(), (float*)C_normal.data() + C_elems);
+      // the sums are not made in the same order, let the rounding grow with K
+      if (arraysEqual<float>(cpu_res, npu_res, 1e-5f * K)) {
         printf("fp16 matmul result is correct\n");
       } else {
         printf("fp16 matmul result is wrong\n");
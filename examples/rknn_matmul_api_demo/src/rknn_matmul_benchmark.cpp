@@ -0,0 +1,419 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  performance sweep of rknn_matmul_api.h: every M x K x N of the grids, for every type, layout and core mask.
+  rknn_matmul_create(), rknn_create_mem(), rknn_matmul_set_io_mem() and rknn_matmul_run() are timed separately, as
+  is the host work around a run (filling A, B and reading C back, packed with matmul_layout.h when the layout is not
+  normal). results are written to stdout as CSV or JSON, skipped shapes and errors to stderr.
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "matmul_layout.h"
+#include "rknn_matmul_api.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#ifndef RKNN_MATMUL_SOC
+#define RKNN_MATMUL_SOC "rk3588"
+#endif
+
+// auto, then 1, 2 and 3 cores on rk3588; the runtime picks the core elsewhere
+#ifdef RKNN_MATMUL_CORE_MASK
+#define DEFAULT_CORE_MASKS "0,1,3,7"
+#else
+#define DEFAULT_CORE_MASKS "0"
+#endif
+
+enum
+{
+  LAYOUT_NORMAL = 0, // A, B and C in normal layout
+  LAYOUT_NATIVE,     // B in native layout
+  LAYOUT_PERF,       // A and C in perf layout
+  LAYOUT_NATIVE_PERF,
+  LAYOUT_NUM
+};
+
+static const char* layout_names[LAYOUT_NUM] = {"normal", "native", "perf", "native_perf"};
+
+struct BenchResult
+{
+  double create_us;
+  double mem_us;      // rknn_create_mem() of A, B and C
+  double set_io_us;   // rknn_matmul_set_io_mem() of A, B and C
+  double pack_a_us;   // A in, copied or packed
+  double pack_b_us;   // B in, copied or packed
+  double unpack_c_us; // C out, copied or unpacked
+  double run_us;
+  double run_min_us;
+  size_t bytes; // A + B + C of the run
+};
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static std::vector<std::string> split_list(const char* value)
+{
+  std::vector<std::string> items;
+  std::string              s(value);
+  for (size_t begin = 0; begin < s.size();) {
+    size_t end = s.find(',', begin);
+    end        = end == std::string::npos ? s.size() : end;
+    if (end > begin) {
+      items.push_back(s.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return items;
+}
+
+static int parse_ints(const char* name, const char* value, std::vector<int>& out)
+{
+  std::vector<std::string> items = split_list(value);
+  for (size_t i = 0; i < items.size(); ++i) {
+    char* end = NULL;
+    long  v   = strtol(items[i].c_str(), &end, 0);
+    if (*end != '\0' || v < 0) {
+      fprintf(stderr, "bad %s value %s\n", name, items[i].c_str());
+      return -1;
+    }
+    out.push_back((int)v);
+  }
+  return out.empty() ? -1 : 0;
+}
+
+// random int8, or float16 of magnitude 2^-4 .. 1, so that the run does not meet inf / NaN
+static void fill_random(rknn_tensor_type type, std::vector<uint8_t>& data)
+{
+  if (type == RKNN_TENSOR_INT8) {
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = (uint8_t)rand();
+    }
+    return;
+  }
+  uint16_t* h = (uint16_t*)data.data();
+  for (size_t i = 0; i < data.size() / 2; ++i) {
+    h[i] = (uint16_t)((rand() & 0x8000) | ((11 + rand() % 4) << 10) | (rand() & 0x3ff));
+  }
+}
+
+static int bench_one(rknn_tensor_type type, int M, int K, int N, int layout, int core_mask, int loop_count,
+                     BenchResult* r)
+{
+  memset(r, 0, sizeof(BenchResult));
+  rknn_matmul_info info;
+  memset(&info, 0, sizeof(rknn_matmul_info));
+  info.M             = M;
+  info.K             = K;
+  info.N             = N;
+  info.type          = type;
+  info.native_layout = layout == LAYOUT_NATIVE || layout == LAYOUT_NATIVE_PERF;
+  info.perf_layout   = layout == LAYOUT_PERF || layout == LAYOUT_NATIVE_PERF;
+
+  rknn_matmul_ctx     ctx;
+  rknn_matmul_io_attr io_attr;
+  memset(&io_attr, 0, sizeof(rknn_matmul_io_attr));
+  int64_t start_us = getCurrentTimeUs();
+  int     ret      = rknn_matmul_create(&ctx, &info, &io_attr);
+  r->create_us     = getCurrentTimeUs() - start_us;
+  if (ret < 0) {
+    fprintf(stderr, "rknn_matmul_create fail! ret=%d\n", ret);
+    return -1;
+  }
+#ifdef RKNN_MATMUL_CORE_MASK
+  if ((ret = rknn_matmul_set_core_mask(ctx, (rknn_core_mask)core_mask)) < 0) {
+    fprintf(stderr, "rknn_matmul_set_core_mask fail! ret=%d\n", ret);
+    rknn_matmul_destroy(ctx);
+    return -1;
+  }
+#else
+  (void)core_mask;
+#endif
+
+  start_us           = getCurrentTimeUs();
+  rknn_tensor_mem* A = rknn_create_mem(ctx, io_attr.A.size);
+  rknn_tensor_mem* B = rknn_create_mem(ctx, io_attr.B.size);
+  rknn_tensor_mem* C = rknn_create_mem(ctx, io_attr.C.size);
+  r->mem_us          = getCurrentTimeUs() - start_us;
+  r->bytes           = (size_t)io_attr.A.size + io_attr.B.size + io_attr.C.size;
+
+  matmul_layout l;
+  uint32_t      eb = type == RKNN_TENSOR_INT8 ? 1 : 2;
+  ret              = A && B && C ? matmul_layout_from_attr(&info, &io_attr, &l) : -1;
+  if (ret != 0) {
+    fprintf(stderr, "rknn_create_mem fail!\n");
+  }
+
+  // the host side, in normal layout
+  std::vector<uint8_t> a((size_t)M * K * eb), b((size_t)K * N * eb), c((size_t)M * N * 4);
+  fill_random(type, a);
+  fill_random(type, b);
+
+  for (int i = 0; i < loop_count && ret == 0; ++i) {
+    start_us = getCurrentTimeUs();
+    if (io_attr.A.n_dims == 2) {
+      memcpy(A->virt_addr, a.data(), a.size());
+    } else {
+      ret |= matmul_pack_A(&l, a.data(), 0, A->virt_addr);
+    }
+    int64_t a_us = getCurrentTimeUs();
+    if (io_attr.B.n_dims == 2) {
+      memcpy(B->virt_addr, b.data(), b.size());
+    } else {
+      ret |= matmul_pack_B(&l, b.data(), 0, B->virt_addr);
+    }
+    int64_t b_us = getCurrentTimeUs();
+    if (rknn_matmul_set_io_mem(ctx, A, &io_attr.A) < 0 || rknn_matmul_set_io_mem(ctx, B, &io_attr.B) < 0 ||
+        rknn_matmul_set_io_mem(ctx, C, &io_attr.C) < 0) {
+      fprintf(stderr, "rknn_matmul_set_io_mem fail!\n");
+      ret = -1;
+    }
+    r->pack_a_us += a_us - start_us;
+    r->pack_b_us += b_us - a_us;
+    r->set_io_us += getCurrentTimeUs() - b_us;
+  }
+
+  // one warm-up run, then loop_count timed ones
+  for (int i = -1; i < loop_count && ret == 0; ++i) {
+    start_us       = getCurrentTimeUs();
+    ret            = rknn_matmul_run(ctx);
+    int64_t run_us = getCurrentTimeUs() - start_us;
+    if (ret < 0) {
+      fprintf(stderr, "rknn_matmul_run fail! ret=%d\n", ret);
+    } else if (i >= 0) {
+      r->run_us += run_us;
+      r->run_min_us = i == 0 || run_us < r->run_min_us ? run_us : r->run_min_us;
+    }
+  }
+
+  for (int i = 0; i < loop_count && ret == 0; ++i) {
+    start_us = getCurrentTimeUs();
+    if (io_attr.C.n_dims == 2) {
+      memcpy(c.data(), C->virt_addr, c.size());
+    } else {
+      ret = matmul_unpack_C(&l, C->virt_addr, c.data(), 0);
+    }
+    r->unpack_c_us += getCurrentTimeUs() - start_us;
+  }
+
+  r->pack_a_us /= loop_count;
+  r->pack_b_us /= loop_count;
+  r->set_io_us /= loop_count;
+  r->run_us /= loop_count;
+  r->unpack_c_us /= loop_count;
+
+  if (A != NULL) {
+    rknn_destroy_mem(ctx, A);
+  }
+  if (B != NULL) {
+    rknn_destroy_mem(ctx, B);
+  }
+  if (C != NULL) {
+    rknn_destroy_mem(ctx, C);
+  }
+  rknn_matmul_destroy(ctx);
+  return ret < 0 ? -1 : 0;
+}
+
+static void print_usage(char* argv[])
+{
+  printf("Usage: %s [key=value ...]\n"
+         "  M=1,16,64,256         rows of A\n"
+         "  K=512,1024,4096       columns of A, rows of B\n"
+         "  N=512,1024,4096       columns of B\n"
+         "  types=int8,fp16\n"
+         "  layouts=normal,native,perf,native_perf\n"
+         "  core_masks=%-11s rknn_core_mask values, rk3588 only (1: core 0, 3: cores 0/1, 7: cores 0/1/2)\n"
+         "  loop_count=10\n"
+         "  format=csv            csv or json\n",
+         argv[0], DEFAULT_CORE_MASKS);
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char* argv[])
+{
+  const char* m_arg         = "1,16,64,256";
+  const char* k_arg         = "512,1024,4096";
+  const char* n_arg         = "512,1024,4096";
+  const char* types_arg     = "int8,fp16";
+  const char* layouts_arg   = "normal,native,perf,native_perf";
+  const char* core_mask_arg = DEFAULT_CORE_MASKS;
+  const char* format        = "csv";
+  int         loop_count    = 10;
+  for (int i = 1; i < argc; ++i) {
+    const char* eq = strchr(argv[i], '=');
+    if (eq == NULL) {
+      print_usage(argv);
+      return !strcmp(argv[i], "-h") ? 0 : -1;
+    }
+    std::string key(argv[i], eq - argv[i]);
+    const char* value = eq + 1;
+    if (key == "M") {
+      m_arg = value;
+    } else if (key == "K") {
+      k_arg = value;
+    } else if (key == "N") {
+      n_arg = value;
+    } else if (key == "types") {
+      types_arg = value;
+    } else if (key == "layouts") {
+      layouts_arg = value;
+    } else if (key == "core_masks") {
+      core_mask_arg = value;
+    } else if (key == "loop_count") {
+      loop_count = atoi(value);
+    } else if (key == "format") {
+      format = value;
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      print_usage(argv);
+      return -1;
+    }
+  }
+
+  std::vector<int> Ms, Ks, Ns, types, layouts, core_masks;
+  if (parse_ints("M", m_arg, Ms) != 0 || parse_ints("K", k_arg, Ks) != 0 || parse_ints("N", n_arg, Ns) != 0 ||
+      parse_ints("core_masks", core_mask_arg, core_masks) != 0) {
+    print_usage(argv);
+    return -1;
+  }
+  std::vector<std::string> items = split_list(types_arg);
+  for (size_t i = 0; i < items.size(); ++i) {
+    if (items[i] != "int8" && items[i] != "fp16") {
+      fprintf(stderr, "unknown type %s, ref value: int8 or fp16\n", items[i].c_str());
+      return -1;
+    }
+    types.push_back(items[i] == "int8" ? RKNN_TENSOR_INT8 : RKNN_TENSOR_FLOAT16);
+  }
+  items = split_list(layouts_arg);
+  for (size_t i = 0; i < items.size(); ++i) {
+    int l = 0;
+    while (l < LAYOUT_NUM && items[i] != layout_names[l]) {
+      ++l;
+    }
+    if (l == LAYOUT_NUM) {
+      fprintf(stderr, "unknown layout %s, ref value: normal, native, perf or native_perf\n", items[i].c_str());
+      return -1;
+    }
+    layouts.push_back(l);
+  }
+  bool json = !strcmp(format, "json");
+  if ((!json && strcmp(format, "csv")) || loop_count <= 0 || types.empty() || layouts.empty()) {
+    print_usage(argv);
+    return -1;
+  }
+#ifndef RKNN_MATMUL_CORE_MASK
+  if (core_masks.size() > 1 || core_masks[0] != 0) {
+    fprintf(stderr, "core_masks: rknn_matmul_set_core_mask is not available on %s\n", RKNN_MATMUL_SOC);
+    return -1;
+  }
+#endif
+
+  // the first context of the process also pays the runtime initialization, keep it out of the results
+  {
+    rknn_matmul_info info;
+    memset(&info, 0, sizeof(rknn_matmul_info));
+    info.M    = 1;
+    info.K    = 64;
+    info.N    = 64;
+    info.type = RKNN_TENSOR_INT8;
+    rknn_matmul_ctx     ctx;
+    rknn_matmul_io_attr io_attr;
+    if (rknn_matmul_create(&ctx, &info, &io_attr) == 0) {
+      rknn_matmul_destroy(ctx);
+    }
+  }
+
+  if (json) {
+    printf("{\n  \"soc\": \"%s\",\n  \"loop_count\": %d,\n  \"results\": [", RKNN_MATMUL_SOC, loop_count);
+  } else {
+    printf("soc,type,M,K,N,layout,core_mask,create_us,mem_us,set_io_us,pack_a_us,pack_b_us,unpack_c_us,run_us,"
+           "run_min_us,gops,bandwidth_gbps,e2e_gops\n");
+  }
+  int  failed = 0;
+  bool first  = true;
+  for (size_t ti = 0; ti < types.size(); ++ti) {
+    rknn_tensor_type type = (rknn_tensor_type)types[ti];
+    for (size_t mi = 0; mi < Ms.size(); ++mi) {
+      for (size_t ki = 0; ki < Ks.size(); ++ki) {
+        for (size_t ni = 0; ni < Ns.size(); ++ni) {
+          int           M = Ms[mi], K = Ks[ki], N = Ns[ni];
+          matmul_layout l;
+          if (M <= 0 || matmul_layout_init(RKNN_MATMUL_SOC, type, M, K, N, &l) != 0) {
+            return -1;
+          }
+          if (K > 4096 || K % l.k_align != 0 || N % l.n_align != 0) {
+            fprintf(stderr, "%s %dx%dx%d skipped, K must be <= 4096 and aligned to %d, N aligned to %d\n",
+                    get_type_string(type), M, K, N, l.k_align, l.n_align);
+            continue;
+          }
+          for (size_t li = 0; li < layouts.size(); ++li) {
+            for (size_t ci = 0; ci < core_masks.size(); ++ci) {
+              fprintf(stderr, "%s %dx%dx%d %s core_mask %d\n", get_type_string(type), M, K, N,
+                      layout_names[layouts[li]], core_masks[ci]);
+              BenchResult r;
+              if (bench_one(type, M, K, N, layouts[li], core_masks[ci], loop_count, &r) != 0) {
+                ++failed;
+                continue;
+              }
+              // steady state of a resident B: A in, run, C out
+              double ops      = 2.0 * M * K * N;
+              double run_us   = r.run_us > 0 ? r.run_us : 1;
+              double gops     = ops / run_us / 1e3;
+              double gbps     = r.bytes / run_us / 1e3;
+              double e2e_gops = ops / (r.pack_a_us + run_us + r.unpack_c_us) / 1e3;
+              if (json) {
+                printf("%s\n    {\"type\": \"%s\", \"M\": %d, \"K\": %d, \"N\": %d, \"layout\": \"%s\", "
+                       "\"core_mask\": %d, \"create_us\": %.1f, \"mem_us\": %.1f, \"set_io_us\": %.1f, "
+                       "\"pack_a_us\": %.1f, \"pack_b_us\": %.1f, \"unpack_c_us\": %.1f, \"run_us\": %.1f, "
+                       "\"run_min_us\": %.1f, \"gops\": %.2f, \"bandwidth_gbps\": %.2f, \"e2e_gops\": %.2f}",
+                       first ? "" : ",", get_type_string(type), M, K, N, layout_names[layouts[li]], core_masks[ci],
+                       r.create_us, r.mem_us, r.set_io_us, r.pack_a_us, r.pack_b_us, r.unpack_c_us, r.run_us,
+                       r.run_min_us, gops, gbps, e2e_gops);
+              } else {
+                printf("%s,%s,%d,%d,%d,%s,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f,%.2f,%.2f\n",
+                       RKNN_MATMUL_SOC, get_type_string(type), M, K, N, layout_names[layouts[li]], core_masks[ci],
+                       r.create_us, r.mem_us, r.set_io_us, r.pack_a_us, r.pack_b_us, r.unpack_c_us, r.run_us,
+                       r.run_min_us, gops, gbps, e2e_gops);
+              }
+              first = false;
+              fflush(stdout);
+            }
+          }
+        }
+      }
+    }
+  }
+  if (json) {
+    printf("\n  ]\n}\n");
+  }
+  return failed ? -1 : 0;
+}
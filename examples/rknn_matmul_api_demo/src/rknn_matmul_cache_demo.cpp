@@ -0,0 +1,284 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  matmuls of a random M (a sequence length) against a few weight matrices, as the layers of a transformer see them:
+  once through matmul_cache.h and once with a context created and destroyed per call. the cached results are checked
+  against a CPU reference.
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "Float16.h"
+#include "matmul_cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <random>
+#include <vector>
+using namespace rknpu2;
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// i-k-j order, so that the inner loop runs along rows of B and C
+template <typename Ti, typename To>
+static void matrixMultiply(const Ti* A, const Ti* B, To* C, int M, int K, int N)
+{
+  for (int i = 0; i < M; ++i) {
+    To* c = C + (size_t)i * N;
+    memset(c, 0, N * sizeof(To));
+    for (int k = 0; k < K; ++k) {
+      To        a = (To)A[(size_t)i * K + k];
+      const Ti* b = B + (size_t)k * N;
+      for (int j = 0; j < N; ++j) {
+        c[j] += a * (To)b[j];
+      }
+    }
+  }
+}
+
+/* the path without the cache: create, fill, run, read back and destroy on every call. A and C have M rows.
+   setup_us gets the time of rknn_matmul_create / rknn_create_mem and of their destroy, the part the cache saves. */
+static int run_uncached(const rknn_matmul_info* base, int32_t M, const void* A, const void* B, void* C,
+                        int64_t* setup_us)
+{
+  rknn_matmul_info info = *base;
+  info.M                = M;
+  rknn_matmul_ctx     ctx;
+  rknn_matmul_io_attr io_attr;
+  memset(&io_attr, 0, sizeof(rknn_matmul_io_attr));
+  int64_t start_us = getCurrentTimeUs();
+  int     ret      = rknn_matmul_create(&ctx, &info, &io_attr);
+  if (ret < 0) {
+    printf("rknn_matmul_create fail! ret=%d\n", ret);
+    return -1;
+  }
+  matmul_layout    layout;
+  uint32_t         eb = info.type == RKNN_TENSOR_INT8 ? 1 : 2;
+  rknn_tensor_mem* mA = rknn_create_mem(ctx, io_attr.A.size);
+  rknn_tensor_mem* mB = rknn_create_mem(ctx, io_attr.B.size);
+  rknn_tensor_mem* mC = rknn_create_mem(ctx, io_attr.C.size);
+  *setup_us += getCurrentTimeUs() - start_us;
+  ret = mA && mB && mC ? matmul_layout_from_attr(&info, &io_attr, &layout) : -1;
+  if (ret == 0) {
+    if (io_attr.A.n_dims == 2) {
+      memcpy(mA->virt_addr, A, (size_t)M * info.K * eb);
+    } else {
+      ret |= matmul_pack_A(&layout, A, 0, mA->virt_addr);
+    }
+    if (io_attr.B.n_dims == 2) {
+      memcpy(mB->virt_addr, B, (size_t)info.K * info.N * eb);
+    } else {
+      ret |= matmul_pack_B(&layout, B, 0, mB->virt_addr);
+    }
+  }
+  if (ret == 0 && (rknn_matmul_set_io_mem(ctx, mA, &io_attr.A) < 0 || rknn_matmul_set_io_mem(ctx, mB, &io_attr.B) < 0 ||
+                   rknn_matmul_set_io_mem(ctx, mC, &io_attr.C) < 0 || rknn_matmul_run(ctx) < 0)) {
+    ret = -1;
+  }
+  if (ret == 0) {
+    if (io_attr.C.n_dims == 2) {
+      memcpy(C, mC->virt_addr, (size_t)M * info.N * 4);
+    } else {
+      ret = matmul_unpack_C(&layout, mC->virt_addr, C, 0);
+    }
+  }
+  start_us = getCurrentTimeUs();
+  if (mA != NULL) {
+    rknn_destroy_mem(ctx, mA);
+  }
+  if (mB != NULL) {
+    rknn_destroy_mem(ctx, mB);
+  }
+  if (mC != NULL) {
+    rknn_destroy_mem(ctx, mC);
+  }
+  rknn_matmul_destroy(ctx);
+  *setup_us += getCurrentTimeUs() - start_us;
+  return ret;
+}
+
+static void print_usage(char* argv[])
+{
+  printf("Usage: %s [loop_count=100] [max_m=128] [budget_mb=0] [type=int8|fp16] [native_layout=0] [perf_layout=0]\n",
+         argv[0]);
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && !strcmp(argv[1], "-h")) {
+    print_usage(argv);
+    return 0;
+  }
+  int loop_count = argc > 1 ? atoi(argv[1]) : 100;
+  int max_m      = argc > 2 ? atoi(argv[2]) : 128;
+  int budget_mb  = argc > 3 ? atoi(argv[3]) : 0;
+  loop_count     = loop_count > 0 ? loop_count : 1;
+  max_m          = max_m > 0 ? max_m : 1;
+
+  matmul_cache_config config;
+  memset(&config, 0, sizeof(matmul_cache_config));
+  config.type = RKNN_TENSOR_INT8;
+  if (argc > 4) {
+    if (!strcmp(argv[4], "fp16")) {
+      config.type = RKNN_TENSOR_FLOAT16;
+    } else if (strcmp(argv[4], "int8")) {
+      print_usage(argv);
+      return -1;
+    }
+  }
+  config.native_layout = argc > 5 ? atoi(argv[5]) : 0;
+  config.perf_layout   = argc > 6 ? atoi(argv[6]) : 0;
+  config.mem_budget    = (size_t)budget_mb * 1024 * 1024;
+
+  // q / o projections share K x N but not their weights, the up projection has its own shape
+  const int num_weights    = 3;
+  const int K[num_weights] = {512, 512, 512};
+  const int N[num_weights] = {512, 512, 1024};
+  size_t    elem_size      = config.type == RKNN_TENSOR_INT8 ? sizeof(int8_t) : sizeof(float16);
+
+  std::random_device rd;
+  std::mt19937       gen(rd());
+  std::uniform_int_distribution<> int_dis(-128, 127);
+  std::normal_distribution<>      float_dis(0.0, 1.0);
+
+  // random values, kept as float for the reference of the float16 matmul
+  std::vector<float> values((size_t)max_m * 1024 + 1024 * 1024 * num_weights);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = config.type == RKNN_TENSOR_INT8 ? (float)int_dis(gen) : (float)float_dis(gen);
+  }
+  std::vector<std::vector<uint8_t>> A(num_weights), B(num_weights);
+  std::vector<std::vector<float>>   A_f32(num_weights), B_f32(num_weights);
+  size_t                            offset = 0;
+  for (int w = 0; w < num_weights; ++w) {
+    A_f32[w].assign(values.begin() + offset, values.begin() + offset + (size_t)max_m * K[w]);
+    offset += (size_t)max_m * K[w];
+    B_f32[w].assign(values.begin() + offset, values.begin() + offset + (size_t)K[w] * N[w]);
+    offset += (size_t)K[w] * N[w];
+    A[w].resize(A_f32[w].size() * elem_size);
+    B[w].resize(B_f32[w].size() * elem_size);
+    if (config.type == RKNN_TENSOR_INT8) {
+      for (size_t i = 0; i < A_f32[w].size(); ++i) {
+        A[w][i] = (uint8_t)(int8_t)A_f32[w][i];
+      }
+      for (size_t i = 0; i < B_f32[w].size(); ++i) {
+        B[w][i] = (uint8_t)(int8_t)B_f32[w][i];
+      }
+    } else {
+      convertFloat32ToFloat16(A_f32[w].data(), (float16*)A[w].data(), A_f32[w].size());
+      convertFloat32ToFloat16(B_f32[w].data(), (float16*)B[w].data(), B_f32[w].size());
+      convertFloat16ToFloat32((const float16*)A[w].data(), A_f32[w].data(), A_f32[w].size());
+      convertFloat16ToFloat32((const float16*)B[w].data(), B_f32[w].data(), B_f32[w].size());
+    }
+  }
+
+  matmul_cache* cache = NULL;
+  if (matmul_cache_create(&config, &cache) != 0) {
+    return -1;
+  }
+
+  // the contexts created per call run at the M of the bucket as well, the rows of A past max_m are 0
+  std::vector<int> Ms(loop_count), padded_Ms(loop_count);
+  std::uniform_int_distribution<> m_dis(1, max_m);
+  for (int i = 0; i < loop_count; ++i) {
+    Ms[i]        = m_dis(gen);
+    padded_Ms[i] = matmul_cache_bucket(cache, Ms[i]);
+  }
+  int max_bucket = matmul_cache_bucket(cache, max_m);
+  for (int w = 0; w < num_weights; ++w) {
+    A[w].resize((size_t)max_bucket * K[w] * elem_size, 0);
+  }
+
+  // cached
+  std::vector<uint8_t> C((size_t)max_bucket * 1024 * 4);
+  std::vector<float>   ref_f32((size_t)max_m * 1024);
+  std::vector<int32_t> ref_i32((size_t)max_m * 1024);
+  int64_t              cached_us = 0;
+  int                  wrong     = 0;
+  float                max_diff  = 0.f;
+  for (int i = 0; i < loop_count; ++i) {
+    for (int w = 0; w < num_weights; ++w) {
+      int64_t             start_us = getCurrentTimeUs();
+      matmul_cache_entry* entry    = NULL;
+      if (matmul_cache_get(cache, Ms[i], K[w], N[w], B[w].data(), &entry) != 0 ||
+          matmul_cache_run(cache, entry, A[w].data(), Ms[i], C.data()) != 0) {
+        matmul_cache_destroy(cache);
+        return -1;
+      }
+      cached_us += getCurrentTimeUs() - start_us;
+
+      if (config.type == RKNN_TENSOR_INT8) {
+        matrixMultiply<int8_t, int32_t>((const int8_t*)A[w].data(), (const int8_t*)B[w].data(), ref_i32.data(),
+                                        Ms[i], K[w], N[w]);
+        wrong += memcmp(ref_i32.data(), C.data(), (size_t)Ms[i] * N[w] * 4) != 0;
+      } else {
+        matrixMultiply<float, float>(A_f32[w].data(), B_f32[w].data(), ref_f32.data(), Ms[i], K[w], N[w]);
+        const float* c = (const float*)C.data();
+        for (size_t j = 0; j < (size_t)Ms[i] * N[w]; ++j) {
+          float diff = fabsf(ref_f32[j] - c[j]);
+          max_diff   = diff > max_diff || diff != diff ? diff : max_diff;
+        }
+      }
+    }
+  }
+  matmul_cache_dump(cache);
+  matmul_cache_destroy(cache);
+
+  // create per call
+  rknn_matmul_info info;
+  memset(&info, 0, sizeof(rknn_matmul_info));
+  info.type          = config.type;
+  info.native_layout = config.native_layout;
+  info.perf_layout   = config.perf_layout;
+  int64_t uncached_us = 0;
+  int64_t setup_us    = 0;
+  for (int i = 0; i < loop_count; ++i) {
+    for (int w = 0; w < num_weights; ++w) {
+      info.K           = K[w];
+      info.N           = N[w];
+      int64_t start_us = getCurrentTimeUs();
+      if (run_uncached(&info, padded_Ms[i], A[w].data(), B[w].data(), C.data(), &setup_us) != 0) {
+        return -1;
+      }
+      uncached_us += getCurrentTimeUs() - start_us;
+    }
+  }
+
+  int calls = loop_count * num_weights;
+  printf("%d matmuls, M in [1, %d] padded to its bucket: cached %.3f ms/call, create per call %.3f ms/call "
+         "(create / destroy %.3f ms of it)\n",
+         calls, max_m, cached_us / 1000.f / calls, uncached_us / 1000.f / calls, setup_us / 1000.f / calls);
+  if (config.type == RKNN_TENSOR_FLOAT16) {
+    wrong = max_diff > 1e-5f * 512;
+    printf("fp16 max diff %f\n", max_diff);
+  }
+  printf("%s cached matmul result is %s\n", get_type_string(config.type), wrong ? "wrong" : "correct");
+  return wrong ? -1 : 0;
+}
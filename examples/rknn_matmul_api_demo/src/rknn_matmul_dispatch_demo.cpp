@@ -0,0 +1,202 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  the blocked CPU GEMM of matmul_cpu.h against a naive loop, then matmuls of a random M sent to the CPU or to the NPU
+  by matmul_dispatch.h from the table it measured at startup. every result is checked against the naive loop.
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "Float16.h"
+#include "matmul_cpu.h"
+#include "matmul_dispatch.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <random>
+#include <vector>
+using namespace rknpu2;
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// i-k-j order, so that the inner loop runs along rows of B and C
+template <typename Ti, typename To>
+static void matrixMultiply(const Ti* A, const Ti* B, To* C, int M, int K, int N)
+{
+  for (int i = 0; i < M; ++i) {
+    To* c = C + (size_t)i * N;
+    memset(c, 0, N * sizeof(To));
+    for (int k = 0; k < K; ++k) {
+      To        a = (To)A[(size_t)i * K + k];
+      const Ti* b = B + (size_t)k * N;
+      for (int j = 0; j < N; ++j) {
+        c[j] += a * (To)b[j];
+      }
+    }
+  }
+}
+
+// int8 A / B, or their float values for float16
+static void reference(rknn_tensor_type type, const void* A, const void* B, const float* A_f32, const float* B_f32,
+                      void* C, int M, int K, int N)
+{
+  if (type == RKNN_TENSOR_INT8) {
+    matrixMultiply<int8_t, int32_t>((const int8_t*)A, (const int8_t*)B, (int32_t*)C, M, K, N);
+  } else {
+    matrixMultiply<float, float>(A_f32, B_f32, (float*)C, M, K, N);
+  }
+}
+
+static bool check(rknn_tensor_type type, const void* ref, const void* C, size_t elems, int K)
+{
+  if (type == RKNN_TENSOR_INT8) {
+    return memcmp(ref, C, elems * sizeof(int32_t)) == 0;
+  }
+  const float* r = (const float*)ref;
+  const float* c = (const float*)C;
+  for (size_t i = 0; i < elems; ++i) {
+    if (!(fabsf(r[i] - c[i]) <= 1e-5f * K)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void print_usage(char* argv[])
+{
+  printf("Usage: %s [KxN=4096x4096] [max_m=64] [cpu_threads=4] [type=int8|fp16] [loop_count=10]\n", argv[0]);
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && !strcmp(argv[1], "-h")) {
+    print_usage(argv);
+    return 0;
+  }
+  int K = 4096, N = 4096;
+  if (argc > 1 && (sscanf(argv[1], "%dx%d", &K, &N) != 2 || K <= 0 || N <= 0)) {
+    print_usage(argv);
+    return -1;
+  }
+  int max_m      = argc > 2 ? atoi(argv[2]) : 64;
+  int loop_count = argc > 5 ? atoi(argv[5]) : 10;
+  max_m          = max_m > 0 ? max_m : 1;
+  loop_count     = loop_count > 0 ? loop_count : 1;
+
+  matmul_dispatch_config config;
+  memset(&config, 0, sizeof(matmul_dispatch_config));
+  config.type        = RKNN_TENSOR_INT8;
+  config.cpu_threads = argc > 3 ? atoi(argv[3]) : 4;
+  if (argc > 4) {
+    if (!strcmp(argv[4], "fp16")) {
+      config.type = RKNN_TENSOR_FLOAT16;
+    } else if (strcmp(argv[4], "int8")) {
+      print_usage(argv);
+      return -1;
+    }
+  }
+  printf("MatMul dispatch K=%d, N=%d, M up to %d, %s\n", K, N, max_m, get_type_string(config.type));
+
+  // random A (max_m, K) and B (K, N), kept as float for the reference of the float16 matmul
+  std::random_device rd;
+  std::mt19937       gen(rd());
+  std::uniform_int_distribution<> int_dis(-128, 127);
+  std::normal_distribution<>      float_dis(0.0, 1.0);
+  size_t                          elem_size = config.type == RKNN_TENSOR_INT8 ? sizeof(int8_t) : sizeof(float16);
+
+  std::vector<float> values((size_t)max_m * K + (size_t)K * N);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = config.type == RKNN_TENSOR_INT8 ? (float)int_dis(gen) : (float)float_dis(gen);
+  }
+  std::vector<uint8_t> data(values.size() * elem_size);
+  if (config.type == RKNN_TENSOR_INT8) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      data[i] = (uint8_t)(int8_t)values[i];
+    }
+  } else {
+    convertFloat32ToFloat16(values.data(), (float16*)data.data(), values.size());
+    convertFloat16ToFloat32((const float16*)data.data(), values.data(), values.size());
+  }
+  const uint8_t* A     = data.data();
+  const uint8_t* B     = data.data() + (size_t)max_m * K * elem_size;
+  const float*   A_f32 = values.data();
+  const float*   B_f32 = values.data() + (size_t)max_m * K;
+
+  std::vector<uint8_t> ref((size_t)max_m * N * 4);
+  std::vector<uint8_t> C((size_t)max_m * N * 4);
+  int                  wrong = 0;
+
+  // blocked CPU GEMM against the naive loop
+  int64_t start_us = getCurrentTimeUs();
+  reference(config.type, A, B, A_f32, B_f32, ref.data(), max_m, K, N);
+  int64_t naive_us = getCurrentTimeUs() - start_us;
+  start_us         = getCurrentTimeUs();
+  if (matmul_cpu_run(config.type, A, B, C.data(), max_m, K, N, config.cpu_threads) != 0) {
+    return -1;
+  }
+  int64_t blocked_us = getCurrentTimeUs() - start_us;
+  bool    cpu_ok     = check(config.type, ref.data(), C.data(), (size_t)max_m * N, K);
+  double  ops        = 2.0 * max_m * K * N;
+  printf("cpu M=%d: naive %.3f ms (%.2f GOPS), blocked %.3f ms (%.2f GOPS) on %d threads, %s\n", max_m,
+         naive_us / 1000., ops / (naive_us ? naive_us : 1) / 1e3, blocked_us / 1000.,
+         ops / (blocked_us ? blocked_us : 1) / 1e3, config.cpu_threads, cpu_ok ? "correct" : "wrong");
+  wrong += !cpu_ok;
+
+  matmul_dispatch* dispatch = NULL;
+  if (matmul_dispatch_create(&config, &dispatch) != 0) {
+    return -1;
+  }
+  if (matmul_dispatch_calibrate(dispatch, K, N, max_m) != 0) {
+    matmul_dispatch_destroy(dispatch);
+    return -1;
+  }
+
+  // random M, each on the side the table picks
+  std::uniform_int_distribution<> m_dis(1, max_m);
+  int64_t                         run_us = 0;
+  for (int i = 0; i < loop_count; ++i) {
+    int M    = m_dis(gen);
+    start_us = getCurrentTimeUs();
+    if (matmul_dispatch_run(dispatch, A, B, C.data(), M, K, N) != 0) {
+      matmul_dispatch_destroy(dispatch);
+      return -1;
+    }
+    run_us += getCurrentTimeUs() - start_us;
+    reference(config.type, A, B, A_f32, B_f32, ref.data(), M, K, N);
+    wrong += !check(config.type, ref.data(), C.data(), (size_t)M * N, K);
+  }
+  matmul_dispatch_dump(dispatch);
+  matmul_dispatch_destroy(dispatch);
+  printf("%d dispatched calls: avg %.3f ms\n", loop_count, run_us / 1000. / loop_count);
+
+  printf("%s matmul dispatch result is %s\n", get_type_string(config.type), wrong ? "wrong" : "correct");
+  return wrong ? -1 : 0;
+}
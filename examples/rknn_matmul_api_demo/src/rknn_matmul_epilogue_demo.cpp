@@ -0,0 +1,267 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  a quantized linear layer on the NPU: int8 matmul, then C dequantized with per-token / per-channel scales, bias and
+  activation by matmul_epilogue.h straight from the layout rknn_matmul_run() wrote, against unpacking C first and a
+  plain loop over it. both are checked against a double precision reference.
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "Float16.h"
+#include "matmul_epilogue.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <random>
+#include <vector>
+using namespace rknpu2;
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static double act_ref(double x, matmul_activation act)
+{
+  switch (act) {
+  case MATMUL_ACT_RELU:
+    return x > 0 ? x : 0;
+  case MATMUL_ACT_GELU:
+    return 0.5 * x * (1 + tanh(sqrt(2 / M_PI) * (x + 0.044715 * x * x * x)));
+  case MATMUL_ACT_SILU:
+    return x / (1 + exp(-x));
+  default:
+    return x;
+  }
+}
+
+// the two pass way: C unpacked to normal layout, then one element at a time
+static void epilogue_plain(const float* c, const float* rs, const float* cs, const float* bias, matmul_activation act,
+                           float* out, int M, int N)
+{
+  for (int m = 0; m < M; ++m) {
+    for (int n = 0; n < N; ++n) {
+      float x = c[(size_t)m * N + n] * rs[m] * cs[n] + bias[n];
+      switch (act) {
+      case MATMUL_ACT_RELU:
+        x = x > 0.f ? x : 0.f;
+        break;
+      case MATMUL_ACT_GELU:
+        x = 0.5f * x * (1.f + tanhf(0.7978845608f * (x + 0.044715f * x * x * x)));
+        break;
+      case MATMUL_ACT_SILU:
+        x = x / (1.f + expf(-x));
+        break;
+      default:
+        break;
+      }
+      out[(size_t)m * N + n] = x;
+    }
+  }
+}
+
+static void print_usage(char* argv[])
+{
+  printf("Usage: %s [MxKxN=64x4096x4096] [perf_layout=0] [act=none|relu|gelu|silu] [out=fp32|fp16] [loop_count=10]\n",
+         argv[0]);
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && !strcmp(argv[1], "-h")) {
+    print_usage(argv);
+    return 0;
+  }
+  int M = 64, K = 4096, N = 4096;
+  if (argc > 1 && (sscanf(argv[1], "%dx%dx%d", &M, &K, &N) != 3 || M <= 0 || K <= 0 || N <= 0)) {
+    print_usage(argv);
+    return -1;
+  }
+  matmul_epilogue epilogue;
+  memset(&epilogue, 0, sizeof(matmul_epilogue));
+  epilogue.act      = MATMUL_ACT_NONE;
+  epilogue.out_type = RKNN_TENSOR_FLOAT32;
+  int perf_layout   = argc > 2 ? atoi(argv[2]) : 0;
+  if (argc > 3) {
+    int a = MATMUL_ACT_NONE;
+    while (a <= MATMUL_ACT_SILU && strcmp(argv[3], get_activation_string((matmul_activation)a))) {
+      ++a;
+    }
+    if (a > MATMUL_ACT_SILU) {
+      print_usage(argv);
+      return -1;
+    }
+    epilogue.act = (matmul_activation)a;
+  }
+  if (argc > 4) {
+    if (!strcmp(argv[4], "fp16")) {
+      epilogue.out_type = RKNN_TENSOR_FLOAT16;
+    } else if (strcmp(argv[4], "fp32")) {
+      print_usage(argv);
+      return -1;
+    }
+  }
+  int loop_count = argc > 5 ? atoi(argv[5]) : 10;
+  loop_count     = loop_count > 0 ? loop_count : 1;
+
+  rknn_matmul_info info;
+  memset(&info, 0, sizeof(rknn_matmul_info));
+  info.M           = M;
+  info.K           = K;
+  info.N           = N;
+  info.type        = RKNN_TENSOR_INT8;
+  info.perf_layout = perf_layout;
+  rknn_matmul_ctx     ctx;
+  rknn_matmul_io_attr io_attr;
+  memset(&io_attr, 0, sizeof(rknn_matmul_io_attr));
+  int ret = rknn_matmul_create(&ctx, &info, &io_attr);
+  if (ret < 0) {
+    printf("rknn_matmul_create fail! ret=%d\n", ret);
+    return -1;
+  }
+  matmul_layout layout;
+  if (matmul_layout_from_attr(&info, &io_attr, &layout) != 0) {
+    rknn_matmul_destroy(ctx);
+    return -1;
+  }
+  printf("MatMul epilogue M=%d, K=%d, N=%d, C in %s layout, %s -> %s\n", M, K, N,
+         io_attr.C.n_dims == 2 ? "normal" : "perf", get_activation_string(epilogue.act),
+         get_type_string(epilogue.out_type));
+
+  // random int8 A / B, scales that bring C to about N(0, 1), as a quantized layer would
+  std::mt19937                     gen(12345);
+  std::uniform_int_distribution<>  int_dis(-128, 127);
+  std::uniform_real_distribution<> scale_dis(0.5, 1.5);
+  std::normal_distribution<>       bias_dis(0.0, 0.5);
+  std::vector<int8_t>              A((size_t)M * K), B((size_t)K * N);
+  std::vector<float>               row_scales(M), col_scales(N), bias(N);
+  for (size_t i = 0; i < A.size(); ++i) {
+    A[i] = (int8_t)int_dis(gen);
+  }
+  for (size_t i = 0; i < B.size(); ++i) {
+    B[i] = (int8_t)int_dis(gen);
+  }
+  for (int m = 0; m < M; ++m) {
+    row_scales[m] = (float)(scale_dis(gen) / 128 / sqrt((double)K));
+  }
+  for (int n = 0; n < N; ++n) {
+    col_scales[n] = (float)(scale_dis(gen) / 64);
+    bias[n]       = (float)bias_dis(gen);
+  }
+  epilogue.row_scales = row_scales.data();
+  epilogue.col_scales = col_scales.data();
+  epilogue.bias       = bias.data();
+
+  rknn_tensor_mem* mA = rknn_create_mem(ctx, io_attr.A.size);
+  rknn_tensor_mem* mB = rknn_create_mem(ctx, io_attr.B.size);
+  rknn_tensor_mem* mC = rknn_create_mem(ctx, io_attr.C.size);
+  ret                 = mA && mB && mC ? 0 : -1;
+  if (ret == 0) {
+    if (io_attr.A.n_dims == 2) {
+      memcpy(mA->virt_addr, A.data(), A.size());
+    } else {
+      ret = matmul_pack_A(&layout, A.data(), 0, mA->virt_addr);
+    }
+    memcpy(mB->virt_addr, B.data(), B.size());
+  }
+  if (ret == 0 && (rknn_matmul_set_io_mem(ctx, mA, &io_attr.A) < 0 || rknn_matmul_set_io_mem(ctx, mB, &io_attr.B) < 0 ||
+                   rknn_matmul_set_io_mem(ctx, mC, &io_attr.C) < 0 || rknn_matmul_run(ctx) < 0)) {
+    printf("rknn_matmul run fail!\n");
+    ret = -1;
+  }
+
+  std::vector<int32_t> C((size_t)M * N);
+  std::vector<float>   C_f32((size_t)M * N), plain((size_t)M * N), fused_f32((size_t)M * N);
+  std::vector<float16> fused_f16((size_t)M * N), plain_f16((size_t)M * N);
+  int64_t              fused_us = 0, plain_us = 0;
+  int                  perf_c   = io_attr.C.n_dims != 2;
+  for (int i = 0; i < loop_count && ret == 0; ++i) {
+    // fused: one pass over C as the NPU wrote it
+    void*   out      = epilogue.out_type == RKNN_TENSOR_FLOAT32 ? (void*)fused_f32.data() : (void*)fused_f16.data();
+    int64_t start_us = getCurrentTimeUs();
+    ret              = matmul_epilogue_run(&layout, &epilogue, mC->virt_addr, perf_c, out, 0);
+    fused_us += getCurrentTimeUs() - start_us;
+
+    // two passes: unpack C, then the plain loop, converted to float16 at the end
+    start_us = getCurrentTimeUs();
+    if (perf_c) {
+      ret |= matmul_unpack_C(&layout, mC->virt_addr, C.data(), 0);
+    } else {
+      memcpy(C.data(), mC->virt_addr, C.size() * sizeof(int32_t));
+    }
+    for (size_t j = 0; j < C.size(); ++j) {
+      C_f32[j] = (float)C[j];
+    }
+    epilogue_plain(C_f32.data(), epilogue.row_scales, epilogue.col_scales, epilogue.bias, epilogue.act, plain.data(),
+                   M, N);
+    if (epilogue.out_type == RKNN_TENSOR_FLOAT16) {
+      convertFloat32ToFloat16(plain.data(), plain_f16.data(), plain.size());
+    }
+    plain_us += getCurrentTimeUs() - start_us;
+  }
+  if (ret == 0) {
+    if (epilogue.out_type == RKNN_TENSOR_FLOAT16) {
+      convertFloat16ToFloat32(fused_f16.data(), fused_f32.data(), fused_f16.size());
+      convertFloat16ToFloat32(plain_f16.data(), plain.data(), plain_f16.size());
+    }
+    // exact int32 C of the NPU, then the layer tail in double
+    double max_fused = 0, max_plain = 0;
+    for (int m = 0; m < M; ++m) {
+      for (int n = 0; n < N; ++n) {
+        size_t idx = (size_t)m * N + n;
+        double ref = act_ref((double)C[idx] * row_scales[m] * col_scales[n] + bias[n], epilogue.act);
+        double tol = epilogue.out_type == RKNN_TENSOR_FLOAT16 ? 1e-3 * (1 + fabs(ref)) : 1e-5 * (1 + fabs(ref));
+        double df  = fabs(fused_f32[idx] - ref) / tol;
+        double dp  = fabs(plain[idx] - ref) / tol;
+        max_fused  = df > max_fused || df != df ? df : max_fused;
+        max_plain  = dp > max_plain || dp != dp ? dp : max_plain;
+      }
+    }
+    double bytes = (double)M * N * (4 + (epilogue.out_type == RKNN_TENSOR_FLOAT32 ? 4 : 2));
+    printf("fused epilogue:  %8.3f ms, %6.2f GB/s\n", fused_us / 1000. / loop_count,
+           bytes / (fused_us ? fused_us : 1) * loop_count / 1e3);
+    printf("unpack + loop:   %8.3f ms, %6.2f GB/s\n", plain_us / 1000. / loop_count,
+           bytes / (plain_us ? plain_us : 1) * loop_count / 1e3);
+    printf("max error / tolerance: fused %.3f, plain %.3f\n", max_fused, max_plain);
+    printf("int8 matmul epilogue result is %s\n", max_fused <= 1 ? "correct" : "wrong");
+    ret = max_fused <= 1 ? 0 : -1;
+  }
+
+  if (mA != NULL) {
+    rknn_destroy_mem(ctx, mA);
+  }
+  if (mB != NULL) {
+    rknn_destroy_mem(ctx, mB);
+  }
+  if (mC != NULL) {
+    rknn_destroy_mem(ctx, mC);
+  }
+  rknn_matmul_destroy(ctx);
+  return ret;
+}
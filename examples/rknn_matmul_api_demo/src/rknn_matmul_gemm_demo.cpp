@@ -0,0 +1,204 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  GEMMs of any shape with matmul_gemm.h: K beyond 4096 and unaligned K / N are tiled onto rknn_matmul, the tiles
+  spread over the NPU cores. every result is checked against a CPU reference.
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "Float16.h"
+#include "matmul_gemm.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <random>
+#include <string>
+#include <vector>
+using namespace rknpu2;
+
+#ifndef RKNN_MATMUL_SOC
+#define RKNN_MATMUL_SOC "rk3588"
+#endif
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// i-k-j order, so that the inner loop runs along rows of B and C
+template <typename Ti, typename To>
+static void matrixMultiply(const Ti* A, const Ti* B, To* C, int M, int K, int N)
+{
+  for (int i = 0; i < M; ++i) {
+    To* c = C + (size_t)i * N;
+    memset(c, 0, N * sizeof(To));
+    for (int k = 0; k < K; ++k) {
+      To        a = (To)A[(size_t)i * K + k];
+      const Ti* b = B + (size_t)k * N;
+      for (int j = 0; j < N; ++j) {
+        c[j] += a * (To)b[j];
+      }
+    }
+  }
+}
+
+static void print_usage(char* argv[])
+{
+  printf("Usage: %s [shapes=1x11008x4096,512x4096x4096] [type=int8|fp16] [num_cores=3] [loop_count=1] "
+         "[native_layout=0] [perf_layout=0]\n",
+         argv[0]);
+}
+
+static int run_shape(const matmul_gemm_config* config, int M, int K, int N, int loop_count, std::mt19937* gen)
+{
+  matmul_gemm* gemm = NULL;
+  if (matmul_gemm_create(config, M, K, N, &gemm) != 0) {
+    return -1;
+  }
+  matmul_gemm_dump(gemm);
+
+  // random A (M, K) and B (K, N)
+  size_t               elem_size = config->type == RKNN_TENSOR_INT8 ? sizeof(int8_t) : sizeof(float16);
+  std::vector<uint8_t> A((size_t)M * K * elem_size);
+  std::vector<uint8_t> B((size_t)K * N * elem_size);
+  std::vector<float>   A_f32, B_f32;
+  if (config->type == RKNN_TENSOR_INT8) {
+    std::uniform_int_distribution<> int_dis(-128, 127);
+    for (size_t i = 0; i < A.size(); ++i) {
+      A[i] = (uint8_t)int_dis(*gen);
+    }
+    for (size_t i = 0; i < B.size(); ++i) {
+      B[i] = (uint8_t)int_dis(*gen);
+    }
+  } else {
+    std::normal_distribution<> float_dis(0.0, 1.0);
+    A_f32.resize((size_t)M * K);
+    B_f32.resize((size_t)K * N);
+    for (size_t i = 0; i < A_f32.size(); ++i) {
+      A_f32[i] = float_dis(*gen);
+    }
+    for (size_t i = 0; i < B_f32.size(); ++i) {
+      B_f32[i] = float_dis(*gen);
+    }
+    convertFloat32ToFloat16(A_f32.data(), (float16*)A.data(), A_f32.size());
+    convertFloat32ToFloat16(B_f32.data(), (float16*)B.data(), B_f32.size());
+    // the reference works on the values the NPU sees
+    convertFloat16ToFloat32((const float16*)A.data(), A_f32.data(), A_f32.size());
+    convertFloat16ToFloat32((const float16*)B.data(), B_f32.data(), B_f32.size());
+  }
+
+  std::vector<uint8_t> C((size_t)M * N * 4);
+  int64_t              total_us = 0;
+  for (int i = 0; i < loop_count; ++i) {
+    int64_t start_us  = getCurrentTimeUs();
+    int     ret       = matmul_gemm_run(gemm, A.data(), B.data(), C.data());
+    int64_t elapse_us = getCurrentTimeUs() - start_us;
+    if (ret != 0) {
+      printf("matmul_gemm_run fail!\n");
+      matmul_gemm_destroy(gemm);
+      return -1;
+    }
+    total_us += elapse_us;
+    printf("%4d: Elapse Time = %.2fms, %.2f GOPS\n", i, elapse_us / 1000.f, 2.0 * M * K * N / elapse_us / 1e3);
+  }
+  printf("avg: Elapse Time = %.2fms, %.2f GOPS\n", total_us / 1000.f / loop_count,
+         2.0 * M * K * N * loop_count / total_us / 1e3);
+  matmul_gemm_destroy(gemm);
+
+  // compare NPU res vs CPU res
+  bool ok = true;
+  if (config->type == RKNN_TENSOR_INT8) {
+    std::vector<int32_t> cpu_res((size_t)M * N);
+    matrixMultiply<int8_t, int32_t>((const int8_t*)A.data(), (const int8_t*)B.data(), cpu_res.data(), M, K, N);
+    ok = memcmp(cpu_res.data(), C.data(), C.size()) == 0;
+  } else {
+    std::vector<float> cpu_res((size_t)M * N);
+    matrixMultiply<float, float>(A_f32.data(), B_f32.data(), cpu_res.data(), M, K, N);
+    // the K tiles are summed in another order than the reference, the error grows with K
+    const float* npu_res  = (const float*)C.data();
+    float        eps      = 1e-5f * K;
+    float        max_diff = 0.f;
+    for (size_t i = 0; i < cpu_res.size(); ++i) {
+      float diff = fabsf(cpu_res[i] - npu_res[i]);
+      max_diff   = diff > max_diff || diff != diff ? diff : max_diff;
+    }
+    ok = max_diff <= eps;
+    printf("fp16 max diff %f (eps %f)\n", max_diff, eps);
+  }
+  printf("%s gemm %dx%dx%d result is %s\n", get_type_string(config->type), M, K, N, ok ? "correct" : "wrong");
+  return ok ? 0 : -1;
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && !strcmp(argv[1], "-h")) {
+    print_usage(argv);
+    return 0;
+  }
+  std::string shapes = argc > 1 ? argv[1] : "1x11008x4096,512x4096x4096";
+
+  matmul_gemm_config config;
+  memset(&config, 0, sizeof(matmul_gemm_config));
+  config.soc       = RKNN_MATMUL_SOC;
+  config.type      = RKNN_TENSOR_INT8;
+  config.num_cores = 3;
+  if (argc > 2) {
+    if (!strcmp(argv[2], "fp16")) {
+      config.type = RKNN_TENSOR_FLOAT16;
+    } else if (strcmp(argv[2], "int8")) {
+      print_usage(argv);
+      return -1;
+    }
+  }
+  if (argc > 3) {
+    config.num_cores = atoi(argv[3]);
+  }
+  int loop_count = argc > 4 ? atoi(argv[4]) : 1;
+  if (loop_count <= 0) {
+    loop_count = 1;
+  }
+  config.native_layout = argc > 5 ? atoi(argv[5]) : 0;
+  config.perf_layout   = argc > 6 ? atoi(argv[6]) : 0;
+
+  std::random_device rd;
+  std::mt19937       gen(rd());
+  int                failed = 0;
+  for (size_t begin = 0; begin < shapes.size();) {
+    size_t end = shapes.find(',', begin);
+    end        = end == std::string::npos ? shapes.size() : end;
+    int M = 0, K = 0, N = 0;
+    if (sscanf(shapes.substr(begin, end - begin).c_str(), "%dx%dx%d", &M, &K, &N) != 3) {
+      printf("bad shape %s\n", shapes.substr(begin, end - begin).c_str());
+      return -1;
+    }
+    begin = end + 1;
+    failed += run_shape(&config, M, K, N, loop_count, &gen) != 0;
+  }
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,178 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  host cost of the perf / native layouts of rknn_matmul_api.h: packing A and B, unpacking C with matmul_layout.h
+  against the element by element loops of the layout description, in bytes of the tensor per second.
+  every packed tensor is checked against the loops. runs on the CPU only, no NPU needed.
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "matmul_layout.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static inline int64_t getCurrentTimeUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// reference loops, with the index formulas of rknn_matmul_api.h
+static void naive_pack_A(const matmul_layout* l, const uint8_t* a, uint8_t* perf_a, uint32_t eb)
+{
+  int32_t s = l->a_sub_k;
+  for (int32_t m = 0; m < l->M; ++m) {
+    for (int32_t k = 0; k < l->K; ++k) {
+      memcpy(perf_a + (((size_t)(k / s) * l->M + m) * s + k % s) * eb, a + ((size_t)m * l->K + k) * eb, eb);
+    }
+  }
+}
+
+static void naive_pack_B(const matmul_layout* l, const uint8_t* b, uint8_t* native_b, uint32_t eb)
+{
+  int32_t sn = l->b_sub_n, sk = l->b_sub_k;
+  for (int32_t k = 0; k < l->K; ++k) {
+    for (int32_t n = 0; n < l->N; ++n) {
+      size_t idx = (((size_t)(n / sn) * (l->K / sk) + k / sk) * sn + n % sn) * sk + k % sk;
+      memcpy(native_b + idx * eb, b + ((size_t)k * l->N + n) * eb, eb);
+    }
+  }
+}
+
+static void naive_unpack_C(const matmul_layout* l, const uint8_t* perf_c, uint8_t* c)
+{
+  int32_t s = l->c_sub_n;
+  for (int32_t m = 0; m < l->M; ++m) {
+    for (int32_t n = 0; n < l->N; ++n) {
+      memcpy(c + ((size_t)m * l->N + n) * 4, perf_c + (((size_t)(n / s) * l->M + m) * s + n % s) * 4, 4);
+    }
+  }
+}
+
+struct Timing
+{
+  double naive_us;
+  double fast_us;
+  bool   same;
+};
+
+template <typename Naive, typename Fast>
+static Timing time_pack(int loop_count, size_t bytes, Naive naive, Fast fast)
+{
+  std::vector<uint8_t> out_naive(bytes), out_fast(bytes);
+  Timing               t;
+  int64_t              start_us = getCurrentTimeUs();
+  for (int i = 0; i < loop_count; ++i) {
+    naive(out_naive.data());
+  }
+  t.naive_us = (double)(getCurrentTimeUs() - start_us) / loop_count;
+  start_us   = getCurrentTimeUs();
+  for (int i = 0; i < loop_count; ++i) {
+    fast(out_fast.data());
+  }
+  t.fast_us = (double)(getCurrentTimeUs() - start_us) / loop_count;
+  t.same    = out_naive == out_fast;
+  return t;
+}
+
+static void print_timing(const char* soc, const char* type, const matmul_layout* l, const char* what, size_t bytes,
+                         const Timing& t)
+{
+  printf("%-7s %-5s %5dx%5dx%5d %-8s %10zu B  naive %9.1f us %7.2f GB/s  packer %9.1f us %7.2f GB/s  %s\n", soc, type,
+         l->M, l->K, l->N, what, bytes, t.naive_us, bytes / t.naive_us / 1e3, t.fast_us, bytes / t.fast_us / 1e3,
+         t.same ? "ok" : "MISMATCH");
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && !strcmp(argv[1], "-h")) {
+    printf("Usage: %s [shapes=1x4096x4096,64x1024x1024,256x4096x1024] [loop_count=10]\n", argv[0]);
+    return 0;
+  }
+  std::string shapes     = argc > 1 ? argv[1] : "1x4096x4096,64x1024x1024,256x4096x1024";
+  int         loop_count = argc > 2 ? atoi(argv[2]) : 10;
+  if (loop_count <= 0) {
+    loop_count = 1;
+  }
+
+  const char*      socs[]  = {"rk3588", "rk356x"};
+  rknn_tensor_type types[] = {RKNN_TENSOR_INT8, RKNN_TENSOR_FLOAT16};
+  int              failed  = 0;
+  for (size_t begin = 0; begin < shapes.size();) {
+    size_t end = shapes.find(',', begin);
+    end        = end == std::string::npos ? shapes.size() : end;
+    int M = 0, K = 0, N = 0;
+    if (sscanf(shapes.substr(begin, end - begin).c_str(), "%dx%dx%d", &M, &K, &N) != 3 || M <= 0) {
+      printf("bad shape %s\n", shapes.substr(begin, end - begin).c_str());
+      return -1;
+    }
+    begin = end + 1;
+
+    for (size_t s = 0; s < sizeof(socs) / sizeof(socs[0]); ++s) {
+      for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); ++t) {
+        matmul_layout l;
+        if (matmul_layout_init(socs[s], types[t], M, K, N, &l) != 0) {
+          return -1;
+        }
+        if (K % l.k_align != 0 || N % l.n_align != 0 || K % l.b_sub_k != 0 || N % l.b_sub_n != 0) {
+          printf("%-7s %-5s %5dx%5dx%5d skipped, K / N not aligned to %d / %d\n", socs[s],
+                 get_type_string(types[t]), M, K, N, l.k_align, l.n_align);
+          continue;
+        }
+        uint32_t             eb = types[t] == RKNN_TENSOR_INT8 ? 1 : 2;
+        std::vector<uint8_t> a((size_t)M * K * eb), b((size_t)K * N * eb), c((size_t)M * N * 4);
+        for (size_t i = 0; i < a.size(); ++i) {
+          a[i] = (uint8_t)rand();
+        }
+        for (size_t i = 0; i < b.size(); ++i) {
+          b[i] = (uint8_t)rand();
+        }
+        for (size_t i = 0; i < c.size(); ++i) {
+          c[i] = (uint8_t)rand();
+        }
+
+        Timing ta = time_pack(
+          loop_count, a.size(), [&](uint8_t* out) { naive_pack_A(&l, a.data(), out, eb); },
+          [&](uint8_t* out) { matmul_pack_A(&l, a.data(), 0, out); });
+        Timing tb = time_pack(
+          loop_count, b.size(), [&](uint8_t* out) { naive_pack_B(&l, b.data(), out, eb); },
+          [&](uint8_t* out) { matmul_pack_B(&l, b.data(), 0, out); });
+        Timing tc = time_pack(
+          loop_count, c.size(), [&](uint8_t* out) { naive_unpack_C(&l, c.data(), out); },
+          [&](uint8_t* out) { matmul_unpack_C(&l, c.data(), out, 0); });
+        print_timing(socs[s], get_type_string(types[t]), &l, "pack A", a.size(), ta);
+        print_timing(socs[s], get_type_string(types[t]), &l, "pack B", b.size(), tb);
+        print_timing(socs[s], get_type_string(types[t]), &l, "unpack C", c.size(), tc);
+        failed += !ta.same + !tb.same + !tc.same;
+      }
+    }
+  }
+  return failed ? -1 : 0;
+}
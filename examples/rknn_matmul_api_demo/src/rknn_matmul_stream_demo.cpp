@@ -0,0 +1,177 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  a decode loop on matmul_stream.h: a stream of A against one resident B, first one step at a time (submit, then
+  fetch), then with the next A written and the previous C read while the NPU runs. every C is checked against a CPU
+  reference.
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include "Float16.h"
+#include "matmul_stream.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+using namespace rknpu2;
+
+// distinct A cycled through the steps
+#define NUM_INPUTS 4
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+// i-k-j order, so that the inner loop runs along rows of B and C
+template <typename Ti, typename To>
+static void matrixMultiply(const Ti* A, const Ti* B, To* C, int M, int K, int N)
+{
+  for (int i = 0; i < M; ++i) {
+    To* c = C + (size_t)i * N;
+    memset(c, 0, N * sizeof(To));
+    for (int k = 0; k < K; ++k) {
+      To        a = (To)A[(size_t)i * K + k];
+      const Ti* b = B + (size_t)k * N;
+      for (int j = 0; j < N; ++j) {
+        c[j] += a * (To)b[j];
+      }
+    }
+  }
+}
+
+static bool check(rknn_tensor_type type, const std::vector<uint8_t>& ref, const std::vector<uint8_t>& C, int K)
+{
+  if (type == RKNN_TENSOR_INT8) {
+    return ref == C;
+  }
+  const float* r = (const float*)ref.data();
+  const float* c = (const float*)C.data();
+  for (size_t i = 0; i < C.size() / sizeof(float); ++i) {
+    if (!(fabsf(r[i] - c[i]) <= 1e-5f * K)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void print_usage(char* argv[])
+{
+  printf("Usage: %s [MxKxN=1x4096x4096] [steps=100] [type=int8|fp16] [perf_layout=0]\n", argv[0]);
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && !strcmp(argv[1], "-h")) {
+    print_usage(argv);
+    return 0;
+  }
+  matmul_stream_config config;
+  memset(&config, 0, sizeof(matmul_stream_config));
+  config.type = RKNN_TENSOR_INT8;
+  config.M    = 1;
+  config.K    = 4096;
+  config.N    = 4096;
+  if (argc > 1 && sscanf(argv[1], "%dx%dx%d", &config.M, &config.K, &config.N) != 3) {
+    print_usage(argv);
+    return -1;
+  }
+  int steps = argc > 2 ? atoi(argv[2]) : 100;
+  steps     = steps > 0 ? steps : 1;
+  if (argc > 3) {
+    if (!strcmp(argv[3], "fp16")) {
+      config.type = RKNN_TENSOR_FLOAT16;
+    } else if (strcmp(argv[3], "int8")) {
+      print_usage(argv);
+      return -1;
+    }
+  }
+  config.perf_layout = argc > 4 ? atoi(argv[4]) : 0;
+
+  const int M = config.M, K = config.K, N = config.N;
+  printf("MatMul stream M=%d, K=%d, N=%d, %d steps\n", M, K, N, steps);
+
+  // random B and NUM_INPUTS A, with the CPU results of each
+  std::random_device rd;
+  std::mt19937       gen(rd());
+  std::uniform_int_distribution<> int_dis(-128, 127);
+  std::normal_distribution<>      float_dis(0.0, 1.0);
+  size_t                          elem_size = config.type == RKNN_TENSOR_INT8 ? sizeof(int8_t) : sizeof(float16);
+
+  std::vector<float> values((size_t)K * N + (size_t)NUM_INPUTS * M * K);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = config.type == RKNN_TENSOR_INT8 ? (float)int_dis(gen) : (float)float_dis(gen);
+  }
+  std::vector<uint8_t> data(values.size() * elem_size);
+  if (config.type == RKNN_TENSOR_INT8) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      data[i] = (uint8_t)(int8_t)values[i];
+    }
+  } else {
+    convertFloat32ToFloat16(values.data(), (float16*)data.data(), values.size());
+    convertFloat16ToFloat32((const float16*)data.data(), values.data(), values.size());
+  }
+  const uint8_t*                    B = data.data();
+  std::vector<const uint8_t*>       A(NUM_INPUTS);
+  std::vector<std::vector<uint8_t>> ref(NUM_INPUTS, std::vector<uint8_t>((size_t)M * N * 4));
+  for (int i = 0; i < NUM_INPUTS; ++i) {
+    size_t offset = (size_t)K * N + (size_t)i * M * K;
+    A[i]          = data.data() + offset * elem_size;
+    if (config.type == RKNN_TENSOR_INT8) {
+      matrixMultiply<int8_t, int32_t>((const int8_t*)A[i], (const int8_t*)B, (int32_t*)ref[i].data(), M, K, N);
+    } else {
+      matrixMultiply<float, float>(values.data() + offset, values.data(), (float*)ref[i].data(), M, K, N);
+    }
+  }
+
+  std::vector<uint8_t> C((size_t)M * N * 4);
+  int                  wrong = 0;
+  for (int overlap = 0; overlap < 2; ++overlap) {
+    matmul_stream* stream = NULL;
+    if (matmul_stream_create(&config, B, &stream) != 0) {
+      return -1;
+    }
+    // overlap: A[n + 1] is submitted before C[n] is fetched
+    int ret = 0;
+    if (overlap) {
+      ret = matmul_stream_submit(stream, A[0]);
+    }
+    for (int n = 0; n < steps && ret == 0; ++n) {
+      int next = overlap ? n + 1 : n;
+      if (next < steps) {
+        ret = matmul_stream_submit(stream, A[next % NUM_INPUTS]);
+      }
+      if (ret == 0) {
+        ret = matmul_stream_fetch(stream, C.data());
+        wrong += !check(config.type, ref[n % NUM_INPUTS], C, K);
+      }
+    }
+    printf("%s: ", overlap ? "double buffered" : "one step at a time");
+    matmul_stream_dump(stream);
+    matmul_stream_destroy(stream);
+    if (ret != 0) {
+      return -1;
+    }
+  }
+  printf("%s matmul stream result is %s\n", get_type_string(config.type), wrong ? "wrong" : "correct");
+  return wrong ? -1 : 0;
+}
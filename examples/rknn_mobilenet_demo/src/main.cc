@@ -19,6 +19,7 @@
 #include "opencv2/imgcodecs.hpp"
 #include "opencv2/imgproc.hpp"
 #include "rknn_api.h"
+#include "rknn_topk.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -67,34 +68,6 @@ static unsigned char* load_model(const char* filename, int* model_size)
   return model;
 }
 
-static int rknn_GetTop(float* pfProb, float* pfMaxProb, uint32_t* pMaxClass, uint32_t outputCount, uint32_t topNum)
-{
-  uint32_t i, j;
-
-#define MAX_TOP_NUM 20
-  if (topNum > MAX_TOP_NUM)
-    return 0;
-
-  memset(pfMaxProb, 0, sizeof(float) * topNum);
-  memset(pMaxClass, 0xff, sizeof(float) * topNum);
-
-  for (j = 0; j < topNum; j++) {
-    for (i = 0; i < outputCount; i++) {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4))) {
-        continue;
-      }
-
-      if (pfProb[i] > *(pfMaxProb + j)) {
-        *(pfMaxProb + j) = pfProb[i];
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
-
-  return 1;
-}
-
 /*-------------------------------------------
                   Main Function
 -------------------------------------------*/
@@ -203,7 +176,8 @@ int main(int argc, char** argv)
   // Get Output
   rknn_output outputs[1];
   memset(outputs, 0, sizeof(outputs));
-  outputs[0].want_float = 1;
+  // top5 is computed on the quantized output, no float conversion needed
+  outputs[0].want_float = 0;
   ret                   = rknn_outputs_get(ctx, 1, outputs, NULL);
   if (ret < 0) {
     printf("rknn_outputs_get fail! ret=%d\n", ret);
@@ -212,16 +186,12 @@ int main(int argc, char** argv)
 
   // Post Process
   for (int i = 0; i < io_num.n_output; i++) {
-    uint32_t MaxClass[5];
-    float    fMaxProb[5];
-    float*   buffer = (float*)outputs[i].buf;
-    uint32_t sz     = outputs[i].size / 4;
-
-    rknn_GetTop(buffer, fMaxProb, MaxClass, sz, 5);
+    rknn_topk_result results[5];
+    int              top_count = rknn_GetTopK(&output_attrs[i], outputs[i].buf, 0, 5, results);
 
     printf(" --- Top5 ---\n");
-    for (int i = 0; i < 5; i++) {
-      printf("%3d: %8.6f\n", MaxClass[i], fMaxProb[i]);
+    for (int j = 0; j < top_count; j++) {
+      printf("%3d: %8.6f\n", results[j].index, results[j].prob);
     }
   }
 
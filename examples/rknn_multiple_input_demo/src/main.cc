@@ -16,8 +16,8 @@
                 Includes
 -------------------------------------------*/
 #include "rknn_api.h"
+#include "rknn_topk.h"
 
-#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,33 +30,6 @@
                   Functions
 -------------------------------------------*/
 
-static int rknn_GetTopN(float* pfProb, float* pfMaxProb, uint32_t* pMaxClass, uint32_t outputCount, uint32_t topNum)
-{
-  uint32_t i, j;
-  uint32_t top_count = outputCount > topNum ? topNum : outputCount;
-
-  for (i = 0; i < topNum; ++i) {
-    pfMaxProb[i] = -FLT_MAX;
-    pMaxClass[i] = -1;
-  }
-
-  for (j = 0; j < top_count; j++) {
-    for (i = 0; i < outputCount; i++) {
-      if ((i == *(pMaxClass + 0)) || (i == *(pMaxClass + 1)) || (i == *(pMaxClass + 2)) || (i == *(pMaxClass + 3)) ||
-          (i == *(pMaxClass + 4))) {
-        continue;
-      }
-
-      if (pfProb[i] > *(pfMaxProb + j)) {
-        *(pfMaxProb + j) = pfProb[i];
-        *(pMaxClass + j) = i;
-      }
-    }
-  }
-
-  return 1;
-}
-
 static void dump_tensor_attr(rknn_tensor_attr* attr)
 {
   printf("  index=%d, name=%s, n_dims=%d, dims=[%d, %d, %d, %d], n_elems=%d, size=%d, fmt=%s, type=%s, qnt_type=%s, "
@@ -216,7 +189,8 @@ int main(int argc, char* argv[])
   rknn_output outputs[io_num.n_output];
   memset(outputs, 0, io_num.n_output * sizeof(rknn_output));
   for (uint32_t i = 0; i < io_num.n_output; ++i) {
-    outputs[i].want_float  = 1;
+    // top5 is computed on the quantized values, no float conversion needed
+    outputs[i].want_float  = 0;
     outputs[i].index       = i;
     outputs[i].is_prealloc = 0;
   }
@@ -230,17 +204,12 @@ int main(int argc, char* argv[])
   // Get top 5
   uint32_t topNum = 5;
   for (uint32_t i = 0; i < io_num.n_output; i++) {
-    uint32_t MaxClass[topNum];
-    float    fMaxProb[topNum];
-    float*   buffer    = (float*)outputs[i].buf;
-    uint32_t sz        = outputs[i].size / sizeof(float);
-    int      top_count = sz > topNum ? topNum : sz;
-
-    rknn_GetTopN(buffer, fMaxProb, MaxClass, sz, topNum);
+    rknn_topk_result results[topNum];
+    int top_count = rknn_GetTopK(&output_attrs[i], outputs[i].buf, 0, topNum, results);
 
     printf("---- Top%d ----\n", top_count);
     for (int j = 0; j < top_count; j++) {
-      printf("%8.6f - %d\n", fMaxProb[j], MaxClass[j]);
+      printf("%8.6f - %d\n", results[j].prob, results[j].index);
     }
   }
 
@@ -0,0 +1,24 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_YOLOV5_DEMO_ALLOC_COUNTER_H_
+#define _RKNN_YOLOV5_DEMO_ALLOC_COUNTER_H_
+
+#include <atomic>
+
+/* number of operator new calls since the start of the program, by any thread (the runtime and libstdc++ included).
+   only for the benchmarks: linking alloc_counter.cc replaces the global operator new / delete. */
+extern std::atomic<long> g_alloc_count;
+
+#endif //_RKNN_YOLOV5_DEMO_ALLOC_COUNTER_H_
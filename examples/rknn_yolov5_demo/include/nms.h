@@ -0,0 +1,83 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_YOLOV5_DEMO_NMS_H_
+#define _RKNN_YOLOV5_DEMO_NMS_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "postprocess.h"
+#include "thread_pool.h"
+
+/*
+  class-bucketed NMS.
+  candidates are bucketed by class once, every bucket is sorted by score and the IoU of a kept box against the rest
+  of its bucket is evaluated with SIMD on a structure-of-arrays copy of the boxes.
+  all buffers are sized by Init(), Run() does no heap allocation.
+  with a thread pool the buckets of large frames are processed in parallel, the result does not change.
+*/
+class NmsEngine
+{
+public:
+  int Init(int max_candidates, int num_classes = OBJ_CLASS_NUM);
+
+  /* boxes are (x, y, w, h) per candidate, as produced by process_i8().
+     if top_k > 0, only the top_k best scores take part (partial sort instead of a full sort).
+     the kept candidate indices are written to keep, best score first. returns their number, or -1 on error. */
+  int Run(const float *boxes, const float *scores, const int *class_ids, int count, float threshold, int *keep,
+          int max_keep, int top_k = 0);
+
+  /* the two stages of Run(), for profiling: Sort() selects, buckets and sorts the candidates and returns how many
+     take part, Suppress() runs the greedy pass on them. boxes / scores must stay valid until Suppress(). */
+  int Sort(const float *boxes, const float *scores, const int *class_ids, int count, int top_k = 0);
+  int Suppress(float threshold, int *keep, int max_keep);
+
+  // NULL processes everything on the calling thread
+  void SetThreadPool(ThreadPool *pool) { this->pool = pool; }
+
+private:
+  static void SortTask(void *userdata, int index);
+  static void SuppressTask(void *userdata, int index);
+  void SortBucket(int c);
+  void SuppressBucket(int c);
+  void SuppressFrom(int p, int end, float threshold);
+
+  int max_candidates = 0;
+  int num_classes = 0;
+  ThreadPool *pool = nullptr;
+
+  // arguments of the current Run()
+  const float *run_boxes = nullptr;
+  const float *run_scores = nullptr;
+  float run_threshold = 0.f;
+  int sorted_count = 0;
+
+  std::vector<int> candidates;
+  std::vector<int> bucket_start;
+  std::vector<int> bucket_fill;
+  std::vector<int> bucket_kept;
+  std::vector<int> bucketed;
+  std::vector<int> kept;
+
+  // boxes in bucket order
+  std::vector<float> x1;
+  std::vector<float> y1;
+  std::vector<float> x2;
+  std::vector<float> y2;
+  std::vector<float> area;
+  std::vector<uint8_t> removed;
+};
+
+#endif //_RKNN_YOLOV5_DEMO_NMS_H_
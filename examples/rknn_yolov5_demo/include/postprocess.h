@@ -4,12 +4,15 @@
 #include <stdint.h>
 #include <vector>
 
+#include "yolo_lut.h"
+
 #define OBJ_NAME_MAX_SIZE 16
 #define OBJ_NUMB_MAX_SIZE 64
 #define OBJ_CLASS_NUM 80
 #define NMS_THRESH 0.45
 #define BOX_THRESH 0.25
 #define PROP_BOX_SIZE (5 + OBJ_CLASS_NUM)
+#define LABEL_NALE_TXT_PATH "./model/coco_80_labels_list.txt"
 
 typedef struct _BOX_RECT
 {
@@ -39,4 +42,12 @@ int post_process(int8_t *input0, int8_t *input1, int8_t *input2, int model_in_h,
                  detect_result_group_t *group);
 
 void deinitPostProcess();
+
+int loadLabelName(const char *locationFilename, char *label[]);
+
+/* decode one int8 NCHW output branch, candidates over threshold are appended to boxes (x, y, w, h), objProbs and
+   classId. lut is built from the zp / scale of the output. nothing is allocated if the vectors have enough capacity.
+   returns the number of candidates. */
+int process_i8(int8_t *input, int *anchor, int grid_h, int grid_w, int stride, std::vector<float> &boxes,
+               std::vector<float> &objProbs, std::vector<int> &classId, float threshold, const YoloQuantLut &lut);
 #endif //_RKNN_YOLOV5_DEMO_POSTPROCESS_H_
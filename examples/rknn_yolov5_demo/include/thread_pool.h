@@ -0,0 +1,65 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_YOLOV5_DEMO_THREAD_POOL_H_
+#define _RKNN_YOLOV5_DEMO_THREAD_POOL_H_
+
+#include <pthread.h>
+
+#include <atomic>
+#include <vector>
+
+typedef void (*ThreadPoolTask)(void *userdata, int index);
+
+/*
+  small persistent pool for the post-process: the workers are created once by Init() and sleep between frames.
+  Run() calls task(userdata, i) for i in [0, count) on the workers and the calling thread, and returns when all are
+  done. Run() must not be called from several threads at once.
+*/
+class ThreadPool
+{
+public:
+  ThreadPool();
+  ~ThreadPool();
+
+  // num_threads includes the calling thread, so num_threads - 1 workers are started
+  int Init(int num_threads);
+  void Run(ThreadPoolTask task, void *userdata, int count);
+  int GetNumThreads() const { return (int)workers.size() + 1; }
+
+private:
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+
+  static void *WorkerEntry(void *arg);
+  void Work();
+  void Stop();
+
+  std::vector<pthread_t> workers;
+  pthread_mutex_t mutex;
+  pthread_cond_t start_cond;
+  pthread_cond_t done_cond;
+  bool quit = false;
+  unsigned int generation = 0;
+  unsigned int start_generation = 0; // generation when the workers were started, their first job is the one after it
+  int pending = 0;
+
+  // current job
+  ThreadPoolTask task = nullptr;
+  void *userdata = nullptr;
+  int count = 0;
+  std::atomic<int> next;
+};
+
+#endif //_RKNN_YOLOV5_DEMO_THREAD_POOL_H_
@@ -0,0 +1,328 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_YOLOV5_DEMO_YOLO_DECODER_H_
+#define _RKNN_YOLOV5_DEMO_YOLO_DECODER_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "rknn_api.h"
+#include "rknn_fp16.h"
+#include "yolo_lut.h"
+
+/*
+  layout-generic yolov5 head decoder.
+  one branch holds 3 anchors of (x, y, w, h, conf, num_classes scores) per grid cell. the decoder is templated on the
+  tensor layout and the element type, so native outputs (NHWC, NC1HWC2) are read in place from the rknn_tensor_mem,
+  without converting them to NCHW float first.
+
+  element types: int8_t (quantized, compared in the quantized domain, decoded through YoloQuantLut), uint16_t (fp16
+  bits) and float.
+*/
+
+/*-------------------------------------------
+                  Layouts
+-------------------------------------------*/
+// offset of channel c of cell (y, x) is Cell(y, x) + Channel(c). Init() gives the channels and the grid H / W of the
+// tensor, -1 when attr is not of that layout
+struct YoloLayoutNCHW
+{
+  int w;
+  int plane;
+
+  // dims = [N, C, H, W]
+  int Init(const rknn_tensor_attr *attr, int *h_out, int *w_out)
+  {
+    *h_out = attr->dims[2];
+    *w_out = attr->dims[3];
+    w = attr->dims[3];
+    plane = attr->dims[2] * attr->dims[3];
+    return attr->n_dims == 4 ? attr->dims[1] : -1;
+  }
+  inline int Cell(int y, int x) const { return y * w + x; }
+  inline int Channel(int c) const { return c * plane; }
+};
+
+struct YoloLayoutNHWC
+{
+  int w;
+  int c_stride;
+
+  // dims = [N, H, W, C], C may be aligned by the npu
+  int Init(const rknn_tensor_attr *attr, int *h_out, int *w_out)
+  {
+    *h_out = attr->dims[1];
+    *w_out = attr->dims[2];
+    w = attr->dims[2];
+    c_stride = attr->dims[3];
+    return attr->n_dims == 4 ? attr->dims[3] : -1;
+  }
+  inline int Cell(int y, int x) const { return (y * w + x) * c_stride; }
+  inline int Channel(int c) const { return c; }
+};
+
+struct YoloLayoutNC1HWC2
+{
+  int w;
+  int c1_step;
+  int c2_shift;
+  int c2_mask;
+
+  // dims = [N, C1, H, W, C2], C2 depends on the SoC and the element type and is always a power of 2
+  int Init(const rknn_tensor_attr *attr, int *h_out, int *w_out)
+  {
+    int c2 = attr->dims[4];
+    if (attr->n_dims != 5 || c2 <= 0 || (c2 & (c2 - 1)) != 0)
+    {
+      return -1;
+    }
+    *h_out = attr->dims[2];
+    *w_out = attr->dims[3];
+    w = attr->dims[3];
+    c1_step = attr->dims[2] * attr->dims[3] * c2;
+    c2_shift = 0;
+    while ((1 << c2_shift) < c2)
+    {
+      c2_shift++;
+    }
+    c2_mask = c2 - 1;
+    return attr->dims[1] * c2;
+  }
+  inline int Cell(int y, int x) const { return (y * w + x) << c2_shift; }
+  inline int Channel(int c) const { return (c >> c2_shift) * c1_step + (c & c2_mask); }
+};
+
+/*-------------------------------------------
+                Element types
+-------------------------------------------*/
+// the cells of a head are read strided, one value at a time
+static inline float yolo_to_f32(uint16_t v) { return rknn_fp16_to_fp32(v); }
+
+static inline float yolo_to_f32(float v) { return v; }
+
+/*
+  Key is what the scores are compared as, Score / XY / WH give act(v), act(v) * 2 - 0.5 and (act(v) * 2)^2.
+  int8 goes through the per-tensor tables, float types compute them for the few candidates only.
+*/
+struct YoloElemI8
+{
+  typedef int8_t Type;
+  typedef int8_t Key;
+  const YoloQuantLut *lut;
+
+  inline Key Threshold(float f) const { return lut->Threshold(f); }
+  inline Key ToKey(int8_t v) const { return v; }
+  inline float Score(int8_t v) const { return lut->Score(v); }
+  inline float XY(int8_t v) const { return lut->XY(v); }
+  inline float WH(int8_t v) const { return lut->WH(v); }
+};
+
+// T is float or uint16_t (fp16 bits)
+template <typename T> struct YoloElemFloat
+{
+  typedef T Type;
+  typedef float Key;
+  bool apply_sigmoid;
+
+  inline Key Threshold(float f) const { return apply_sigmoid ? -1.0 * logf((1.0 / f) - 1.0) : f; }
+  inline Key ToKey(T v) const { return yolo_to_f32(v); }
+  inline float Score(T v) const
+  {
+    float f = yolo_to_f32(v);
+    return apply_sigmoid ? 1.0 / (1.0 + expf(-f)) : f;
+  }
+  inline float XY(T v) const { return Score(v) * 2.0 - 0.5; }
+  inline float WH(T v) const
+  {
+    float f = Score(v) * 2.0;
+    return f * f;
+  }
+};
+
+/*-------------------------------------------
+                  Decoder
+-------------------------------------------*/
+/* decode one branch, candidates over threshold are appended to boxes (x, y, w, h), objProbs and classId.
+   same rules and arithmetic as process_i8(). returns the number of candidates. */
+template <typename Layout, typename Elem>
+int yolo_decode(const typename Elem::Type *input, const Layout &layout, const Elem &elem, const int *anchor, int grid_h,
+                int grid_w, int stride, int num_classes, float threshold, std::vector<float> &boxes,
+                std::vector<float> &objProbs, std::vector<int> &classId)
+{
+  typedef typename Elem::Type T;
+  typedef typename Elem::Key Key;
+  const Key thres = elem.Threshold(threshold);
+  const int prop_size = 5 + num_classes;
+  int validCount = 0;
+  for (int a = 0; a < 3; a++)
+  {
+    const int c0 = prop_size * a;
+    const int conf_off = layout.Channel(c0 + 4);
+    for (int i = 0; i < grid_h; i++)
+    {
+      for (int j = 0; j < grid_w; j++)
+      {
+        const T *cell = input + layout.Cell(i, j);
+        Key box_confidence = elem.ToKey(cell[conf_off]);
+        if (box_confidence < thres)
+        {
+          continue;
+        }
+        Key maxClassProbs = elem.ToKey(cell[layout.Channel(c0 + 5)]);
+        int maxClassId = 0;
+        for (int k = 1; k < num_classes; ++k)
+        {
+          Key prob = elem.ToKey(cell[layout.Channel(c0 + 5 + k)]);
+          if (prob > maxClassProbs)
+          {
+            maxClassId = k;
+            maxClassProbs = prob;
+          }
+        }
+        if (maxClassProbs <= thres)
+        {
+          continue;
+        }
+
+        float box_x = elem.XY(cell[layout.Channel(c0 + 0)]);
+        float box_y = elem.XY(cell[layout.Channel(c0 + 1)]);
+        float box_w = elem.WH(cell[layout.Channel(c0 + 2)]);
+        float box_h = elem.WH(cell[layout.Channel(c0 + 3)]);
+        box_x = (box_x + j) * (float)stride;
+        box_y = (box_y + i) * (float)stride;
+        box_w = box_w * (float)anchor[a * 2];
+        box_h = box_h * (float)anchor[a * 2 + 1];
+        box_x -= (box_w / 2.0);
+        box_y -= (box_h / 2.0);
+
+        objProbs.push_back(elem.Score(cell[layout.Channel(c0 + 5 + maxClassId)]) * elem.Score(cell[conf_off]));
+        classId.push_back(maxClassId);
+        boxes.push_back(box_x);
+        boxes.push_back(box_y);
+        boxes.push_back(box_w);
+        boxes.push_back(box_h);
+        validCount++;
+      }
+    }
+  }
+  return validCount;
+}
+
+// zp / scale of an int8 output, whatever its quantization type
+static inline void yolo_tensor_qnt(const rknn_tensor_attr *attr, int32_t *zp, float *scale)
+{
+  *zp = 0;
+  *scale = 1.f;
+  if (attr->qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC)
+  {
+    *zp = attr->zp;
+    *scale = attr->scale;
+  }
+  else if (attr->qnt_type == RKNN_TENSOR_QNT_DFP)
+  {
+    *scale = ldexpf(1.f, -attr->fl);
+  }
+}
+
+template <typename Layout>
+static int yolo_decode_layout(const rknn_tensor_attr *attr, const void *data, const int *anchor, int grid_h, int grid_w,
+                              int stride, int num_classes, float threshold, std::vector<float> &boxes,
+                              std::vector<float> &objProbs, std::vector<int> &classId, bool apply_sigmoid,
+                              YoloQuantLut *lut)
+{
+  Layout layout;
+  int h = 0, w = 0;
+  int channels = layout.Init(attr, &h, &w);
+  if (channels < 3 * (5 + num_classes))
+  {
+    printf("yolo_decode: output %d has %d channels, need %d\n", attr->index, channels, 3 * (5 + num_classes));
+    return -1;
+  }
+  // the cells are indexed with the strides of attr, a grid larger than the tensor would read past its buffer
+  if (h != grid_h || w != grid_w)
+  {
+    printf("yolo_decode: output %d is a %dx%d grid, expect %dx%d\n", attr->index, h, w, grid_h, grid_w);
+    return -1;
+  }
+
+  switch (attr->type)
+  {
+  case RKNN_TENSOR_INT8:
+  {
+    int32_t zp;
+    float scale;
+    yolo_tensor_qnt(attr, &zp, &scale);
+    YoloQuantLut local_lut;
+    if (lut == NULL)
+    {
+      lut = &local_lut;
+    }
+    if (!lut->Matches(zp, scale, apply_sigmoid))
+    {
+      lut->Build(zp, scale, apply_sigmoid);
+    }
+    YoloElemI8 elem = {lut};
+    return yolo_decode((const int8_t *)data, layout, elem, anchor, grid_h, grid_w, stride, num_classes, threshold,
+                       boxes, objProbs, classId);
+  }
+  case RKNN_TENSOR_FLOAT16:
+  {
+    YoloElemFloat<uint16_t> elem = {apply_sigmoid};
+    return yolo_decode((const uint16_t *)data, layout, elem, anchor, grid_h, grid_w, stride, num_classes, threshold,
+                       boxes, objProbs, classId);
+  }
+  case RKNN_TENSOR_FLOAT32:
+  {
+    YoloElemFloat<float> elem = {apply_sigmoid};
+    return yolo_decode((const float *)data, layout, elem, anchor, grid_h, grid_w, stride, num_classes, threshold,
+                       boxes, objProbs, classId);
+  }
+  default:
+    printf("yolo_decode: unsupported output type %d\n", attr->type);
+    return -1;
+  }
+}
+
+/* decode one branch from its tensor attr (normal or native) and the buffer it describes, e.g. the virt_addr of the
+   rknn_tensor_mem bound with rknn_set_io_mem(). apply_sigmoid is for heads exported without the sigmoid.
+   lut caches the int8 tables of this output between frames, it is rebuilt when zp / scale change; NULL builds them
+   per call. returns the number of candidates, or -1 on error. */
+static inline int yolo_decode_tensor(const rknn_tensor_attr *attr, const void *data, const int *anchor, int grid_h,
+                                     int grid_w, int stride, int num_classes, float threshold,
+                                     std::vector<float> &boxes, std::vector<float> &objProbs,
+                                     std::vector<int> &classId, bool apply_sigmoid = false, YoloQuantLut *lut = NULL)
+{
+  switch (attr->fmt)
+  {
+  case RKNN_TENSOR_NCHW:
+    return yolo_decode_layout<YoloLayoutNCHW>(attr, data, anchor, grid_h, grid_w, stride, num_classes, threshold,
+                                              boxes, objProbs, classId, apply_sigmoid, lut);
+  case RKNN_TENSOR_NHWC:
+    return yolo_decode_layout<YoloLayoutNHWC>(attr, data, anchor, grid_h, grid_w, stride, num_classes, threshold,
+                                              boxes, objProbs, classId, apply_sigmoid, lut);
+  case RKNN_TENSOR_NC1HWC2:
+    return yolo_decode_layout<YoloLayoutNC1HWC2>(attr, data, anchor, grid_h, grid_w, stride, num_classes, threshold,
+                                                 boxes, objProbs, classId, apply_sigmoid, lut);
+  default:
+    printf("yolo_decode: unsupported output format %d\n", attr->fmt);
+    return -1;
+  }
+}
+
+#endif //_RKNN_YOLOV5_DEMO_YOLO_DECODER_H_
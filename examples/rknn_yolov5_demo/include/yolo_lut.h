@@ -0,0 +1,78 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_YOLOV5_DEMO_YOLO_LUT_H_
+#define _RKNN_YOLOV5_DEMO_YOLO_LUT_H_
+
+#include <math.h>
+#include <stdint.h>
+
+/*
+  an int8 output has only 256 possible values, so everything the decoder computes from one value is tabulated once
+  per output tensor (zp / scale). with apply_sigmoid the tables include the sigmoid, for heads exported without it,
+  at the same per-candidate cost as pre-activated heads.
+*/
+struct YoloQuantLut
+{
+  int32_t zp;
+  float scale;
+  bool apply_sigmoid;
+  bool valid;
+
+  // indexed by value + 128
+  float score[256]; // act(dequant)
+  float xy[256];    // act(dequant) * 2 - 0.5
+  float wh[256];    // (act(dequant) * 2)^2
+
+  YoloQuantLut() : zp(0), scale(0.f), apply_sigmoid(false), valid(false) {}
+
+  bool Matches(int32_t zp, float scale, bool apply_sigmoid) const
+  {
+    return valid && this->zp == zp && this->scale == scale && this->apply_sigmoid == apply_sigmoid;
+  }
+
+  void Build(int32_t zp, float scale, bool apply_sigmoid)
+  {
+    this->zp = zp;
+    this->scale = scale;
+    this->apply_sigmoid = apply_sigmoid;
+    for (int v = -128; v < 128; v++)
+    {
+      float f = ((float)v - (float)zp) * scale;
+      if (apply_sigmoid)
+      {
+        f = 1.0 / (1.0 + expf(-f));
+      }
+      float f2 = f * 2.0;
+      score[v + 128] = f;
+      xy[v + 128] = f * 2.0 - 0.5;
+      wh[v + 128] = f2 * f2;
+    }
+    valid = true;
+  }
+
+  // quantized threshold on the raw values; sigmoid is monotonic, so the raw value is compared against its inverse
+  int8_t Threshold(float threshold) const
+  {
+    float f = apply_sigmoid ? -1.0 * logf((1.0 / threshold) - 1.0) : threshold;
+    float q = (f / scale) + zp;
+    return (int8_t)(int32_t)(q <= -128 ? -128 : (q >= 127 ? 127 : q));
+  }
+
+  inline float Score(int8_t v) const { return score[v + 128]; }
+  inline float XY(int8_t v) const { return xy[v + 128]; }
+  inline float WH(int8_t v) const { return wh[v + 128]; }
+};
+
+#endif //_RKNN_YOLOV5_DEMO_YOLO_LUT_H_
@@ -0,0 +1,140 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_YOLOV5_DEMO_YOLO_POSTPROCESSOR_H_
+#define _RKNN_YOLOV5_DEMO_YOLO_POSTPROCESSOR_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "nms.h"
+#include "postprocess.h"
+#include "rknn_api.h"
+#include "thread_pool.h"
+
+// latency of YoloPostProcessor::Run(), in us
+typedef struct _yolo_post_stats_t
+{
+  int frames;
+  int candidates;   // of the last frame
+  double decode_us; // of the last frame
+  double nms_us;    // of the last frame, NMS and output
+  double total_us;  // of the last frame
+  double total_us_sum;
+  double total_us_max;
+} yolo_post_stats_t;
+
+/*
+  reentrant version of post_process().
+  labels are loaded once by Init(), the candidate workspaces are sized from the grids of the model,
+  so Run() does no heap allocation. use one object per thread.
+  with SetThreads() the three branches are decoded concurrently and the NMS classes are processed in parallel on a
+  persistent pool, the result is the same as on one thread.
+*/
+class YoloPostProcessor
+{
+public:
+  YoloPostProcessor();
+  ~YoloPostProcessor();
+
+  int Init(int model_in_h, int model_in_w, const char *label_path = LABEL_NALE_TXT_PATH);
+
+  int Run(int8_t *input0, int8_t *input1, int8_t *input2, float conf_threshold, float nms_threshold, BOX_RECT pads,
+          float scale_w, float scale_h, const std::vector<int32_t> &qnt_zps, const std::vector<float> &qnt_scales,
+          detect_result_group_t *group);
+
+  /* decode the three outputs in the layout and type given by their attrs, e.g. native outputs queried with
+     RKNN_QUERY_NATIVE_OUTPUT_ATTR and bound with rknn_set_io_mem(). zp / scale are taken from the attrs. */
+  int Run(const rknn_tensor_attr *output_attrs, void *const outputs[3], float conf_threshold, float nms_threshold,
+          BOX_RECT pads, float scale_w, float scale_h, detect_result_group_t *group);
+
+  /* batched outputs (dims[0] = batch, e.g. with rknn_set_batch_core_num()): image b uses pads[b], scale_w[b] and
+     scale_h[b], its detections are written to groups[b]. all images are decoded in one pass, on the pool if any.
+     batch must not exceed SetMaxBatch(). */
+  int RunBatch(const rknn_tensor_attr *output_attrs, void *const outputs[3], int batch, float conf_threshold,
+               float nms_threshold, const BOX_RECT *pads, const float *scale_w, const float *scale_h,
+               detect_result_group_t *groups);
+
+  // size the workspaces for batches of up to max_batch images, after Init()
+  int SetMaxBatch(int max_batch);
+
+  /* build the int8 lookup tables of the three outputs from their zp / scale at model load, instead of on the first
+     frame. apply_sigmoid is for heads exported without the sigmoid. */
+  int SetOutputs(const rknn_tensor_attr *output_attrs, bool apply_sigmoid = false);
+
+  int GetMaxCandidates() const { return max_candidates; }
+
+  // keep only the top_k best candidates before NMS, 0 keeps all
+  void SetPreNmsTopK(int top_k) { pre_nms_top_k = top_k; }
+
+  // number of threads including the caller, 1 runs everything on the calling thread
+  int SetThreads(int num_threads);
+
+  const yolo_post_stats_t &GetStats() const { return stats; }
+  void ResetStats();
+
+private:
+  YoloPostProcessor(const YoloPostProcessor &);
+  YoloPostProcessor &operator=(const YoloPostProcessor &);
+
+  // candidates and NMS state of one image, reserved for the grids of the model
+  struct ImageWorkspace
+  {
+    int branch_counts[3];
+    std::vector<float> branch_boxes[3];
+    std::vector<float> branch_probs[3];
+    std::vector<int> branch_ids[3];
+    std::vector<float> filter_boxes;
+    std::vector<float> obj_probs;
+    std::vector<int> class_ids;
+    NmsEngine nms;
+    int keep[OBJ_NUMB_MAX_SIZE];
+    int ret;
+  };
+
+  int ReserveWorkspace(ImageWorkspace *ws);
+  static void DecodeTask(void *userdata, int index);
+  static void OutputTask(void *userdata, int index);
+  void DecodeBranch(int image, int i);
+  int Output(int image);
+  int Process(int batch, float nms_threshold, const BOX_RECT *pads, const float *scale_w, const float *scale_h,
+              detect_result_group_t *groups);
+  const YoloQuantLut &Lut(int i, int32_t zp, float scale);
+
+  int model_in_h = 0;
+  int model_in_w = 0;
+  int max_candidates = 0;
+  int pre_nms_top_k = 0;
+  bool apply_sigmoid = false;
+  char *labels[OBJ_CLASS_NUM];
+  YoloQuantLut luts[3];
+  ThreadPool pool;
+  yolo_post_stats_t stats;
+  std::vector<ImageWorkspace> workspaces;
+
+  // inputs of the current frame, frame_attrs is NULL for int8 NCHW with frame_zps / frame_scales
+  void *frame_inputs[3];
+  int frame_image_bytes[3];
+  const rknn_tensor_attr *frame_attrs = nullptr;
+  int32_t frame_zps[3];
+  float frame_scales[3];
+  float frame_threshold = 0.f;
+  float frame_nms_threshold = 0.f;
+  const BOX_RECT *frame_pads = nullptr;
+  const float *frame_scale_w = nullptr;
+  const float *frame_scale_h = nullptr;
+  detect_result_group_t *frame_groups = nullptr;
+};
+
+#endif //_RKNN_YOLOV5_DEMO_YOLO_POSTPROCESSOR_H_
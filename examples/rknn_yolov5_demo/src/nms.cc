@@ -0,0 +1,290 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nms.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+// below this many candidates the buckets are cheaper to process on the calling thread
+#define NMS_PARALLEL_MIN_CANDIDATES 256
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// higher score first, lower index first on equal scores so the result does not depend on the sort algorithm
+struct ScoreGreater
+{
+  const float *scores;
+  bool operator()(int a, int b) const { return scores[a] > scores[b] || (scores[a] == scores[b] && a < b); }
+};
+
+int NmsEngine::Init(int max_candidates, int num_classes)
+{
+  if (max_candidates <= 0 || num_classes <= 0)
+  {
+    return -1;
+  }
+  this->max_candidates = max_candidates;
+  this->num_classes = num_classes;
+
+  candidates.resize(max_candidates);
+  bucket_start.resize(num_classes + 1);
+  bucket_fill.resize(num_classes);
+  bucket_kept.resize(num_classes);
+  bucketed.resize(max_candidates);
+  kept.resize(max_candidates);
+  x1.resize(max_candidates);
+  y1.resize(max_candidates);
+  x2.resize(max_candidates);
+  y2.resize(max_candidates);
+  area.resize(max_candidates);
+  removed.resize(max_candidates);
+  return 0;
+}
+
+/*
+  suppress the boxes after p in the bucket which overlap p by more than threshold.
+  same IoU as CalculateOverlap() in postprocess.cc, compared as inter > threshold * union to avoid the division.
+*/
+void NmsEngine::SuppressFrom(int p, int end, float threshold)
+{
+  const float bx1 = x1[p];
+  const float by1 = y1[p];
+  const float bx2 = x2[p];
+  const float by2 = y2[p];
+  const float barea = area[p];
+  int j = p + 1;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const float32x4_t vx1 = vdupq_n_f32(bx1);
+  const float32x4_t vy1 = vdupq_n_f32(by1);
+  const float32x4_t vx2 = vdupq_n_f32(bx2);
+  const float32x4_t vy2 = vdupq_n_f32(by2);
+  const float32x4_t varea = vdupq_n_f32(barea);
+  const float32x4_t vthres = vdupq_n_f32(threshold);
+  const float32x4_t zero = vdupq_n_f32(0.f);
+  const float32x4_t one = vdupq_n_f32(1.f);
+  for (; j + 4 <= end; j += 4)
+  {
+    float32x4_t w = vsubq_f32(vminq_f32(vx2, vld1q_f32(&x2[j])), vmaxq_f32(vx1, vld1q_f32(&x1[j])));
+    float32x4_t h = vsubq_f32(vminq_f32(vy2, vld1q_f32(&y2[j])), vmaxq_f32(vy1, vld1q_f32(&y1[j])));
+    w = vmaxq_f32(zero, vaddq_f32(w, one));
+    h = vmaxq_f32(zero, vaddq_f32(h, one));
+    float32x4_t inter = vmulq_f32(w, h);
+    float32x4_t uni = vsubq_f32(vaddq_f32(varea, vld1q_f32(&area[j])), inter);
+    uint32x4_t over = vandq_u32(vcgtq_f32(uni, zero), vcgtq_f32(inter, vmulq_f32(vthres, uni)));
+    removed[j + 0] |= vgetq_lane_u32(over, 0) & 1;
+    removed[j + 1] |= vgetq_lane_u32(over, 1) & 1;
+    removed[j + 2] |= vgetq_lane_u32(over, 2) & 1;
+    removed[j + 3] |= vgetq_lane_u32(over, 3) & 1;
+  }
+#elif defined(__SSE2__)
+  const __m128 vx1 = _mm_set1_ps(bx1);
+  const __m128 vy1 = _mm_set1_ps(by1);
+  const __m128 vx2 = _mm_set1_ps(bx2);
+  const __m128 vy2 = _mm_set1_ps(by2);
+  const __m128 varea = _mm_set1_ps(barea);
+  const __m128 vthres = _mm_set1_ps(threshold);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  for (; j + 4 <= end; j += 4)
+  {
+    __m128 w = _mm_sub_ps(_mm_min_ps(vx2, _mm_loadu_ps(&x2[j])), _mm_max_ps(vx1, _mm_loadu_ps(&x1[j])));
+    __m128 h = _mm_sub_ps(_mm_min_ps(vy2, _mm_loadu_ps(&y2[j])), _mm_max_ps(vy1, _mm_loadu_ps(&y1[j])));
+    w = _mm_max_ps(zero, _mm_add_ps(w, one));
+    h = _mm_max_ps(zero, _mm_add_ps(h, one));
+    __m128 inter = _mm_mul_ps(w, h);
+    __m128 uni = _mm_sub_ps(_mm_add_ps(varea, _mm_loadu_ps(&area[j])), inter);
+    int over = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(uni, zero), _mm_cmpgt_ps(inter, _mm_mul_ps(vthres, uni))));
+    removed[j + 0] |= over & 1;
+    removed[j + 1] |= (over >> 1) & 1;
+    removed[j + 2] |= (over >> 2) & 1;
+    removed[j + 3] |= (over >> 3) & 1;
+  }
+#endif
+
+  for (; j < end; ++j)
+  {
+    float w = std::max(0.f, std::min(bx2, x2[j]) - std::max(bx1, x1[j]) + 1.f);
+    float h = std::max(0.f, std::min(by2, y2[j]) - std::max(by1, y1[j]) + 1.f);
+    float inter = w * h;
+    float uni = barea + area[j] - inter;
+    if (uni > 0.f && inter > threshold * uni)
+    {
+      removed[j] = 1;
+    }
+  }
+}
+
+void NmsEngine::SortTask(void *userdata, int index) { ((NmsEngine *)userdata)->SortBucket(index); }
+
+void NmsEngine::SuppressTask(void *userdata, int index) { ((NmsEngine *)userdata)->SuppressBucket(index); }
+
+void NmsEngine::SortBucket(int c)
+{
+  int begin = bucket_start[c];
+  int end = bucket_start[c + 1];
+  if (end - begin > 1)
+  {
+    ScoreGreater greater = {run_scores};
+    std::sort(bucketed.begin() + begin, bucketed.begin() + end, greater);
+  }
+}
+
+void NmsEngine::SuppressBucket(int c)
+{
+  int begin = bucket_start[c];
+  int end = bucket_start[c + 1];
+  for (int p = begin; p < end; ++p)
+  {
+    const float *box = run_boxes + bucketed[p] * 4;
+    x1[p] = box[0];
+    y1[p] = box[1];
+    x2[p] = box[0] + box[2];
+    y2[p] = box[1] + box[3];
+    area[p] = (x2[p] - x1[p] + 1.f) * (y2[p] - y1[p] + 1.f);
+    removed[p] = 0;
+  }
+
+  // kept boxes of bucket c go to kept[begin..], compacted by Suppress()
+  int kept_count = 0;
+  for (int p = begin; p < end; ++p)
+  {
+    if (removed[p])
+    {
+      continue;
+    }
+    kept[begin + kept_count++] = bucketed[p];
+    SuppressFrom(p, end, run_threshold);
+  }
+  bucket_kept[c] = kept_count;
+}
+
+int NmsEngine::Sort(const float *boxes, const float *scores, const int *class_ids, int count, int top_k)
+{
+  if (count > max_candidates)
+  {
+    printf("NmsEngine: %d candidates, initialized for %d\n", count, max_candidates);
+    return -1;
+  }
+  if (count < 0)
+  {
+    count = 0;
+  }
+  ScoreGreater greater = {scores};
+  run_boxes = boxes;
+  run_scores = scores;
+
+  // pre-selection of the best top_k candidates
+  int n = count;
+  for (int i = 0; i < count; ++i)
+  {
+    candidates[i] = i;
+  }
+  if (top_k > 0 && top_k < count)
+  {
+    std::nth_element(candidates.begin(), candidates.begin() + top_k, candidates.begin() + count, greater);
+    n = top_k;
+  }
+
+  // bucket by class
+  std::fill(bucket_fill.begin(), bucket_fill.end(), 0);
+  for (int i = 0; i < n; ++i)
+  {
+    int c = class_ids[candidates[i]];
+    if (c < 0 || c >= num_classes)
+    {
+      printf("NmsEngine: invalid class id %d\n", c);
+      return -1;
+    }
+    bucket_fill[c]++;
+  }
+  bucket_start[0] = 0;
+  for (int c = 0; c < num_classes; ++c)
+  {
+    bucket_start[c + 1] = bucket_start[c] + bucket_fill[c];
+    bucket_fill[c] = bucket_start[c];
+  }
+  for (int i = 0; i < n; ++i)
+  {
+    int idx = candidates[i];
+    bucketed[bucket_fill[class_ids[idx]]++] = idx;
+  }
+
+  // every bucket is independent
+  sorted_count = n;
+  if (pool != NULL && n >= NMS_PARALLEL_MIN_CANDIDATES)
+  {
+    pool->Run(SortTask, this, num_classes);
+  }
+  else
+  {
+    for (int c = 0; c < num_classes; ++c)
+    {
+      SortBucket(c);
+    }
+  }
+  return n;
+}
+
+int NmsEngine::Suppress(float threshold, int *keep, int max_keep)
+{
+  run_threshold = threshold;
+  if (pool != NULL && sorted_count >= NMS_PARALLEL_MIN_CANDIDATES)
+  {
+    pool->Run(SuppressTask, this, num_classes);
+  }
+  else
+  {
+    for (int c = 0; c < num_classes; ++c)
+    {
+      SuppressBucket(c);
+    }
+  }
+
+  int kept_count = 0;
+  for (int c = 0; c < num_classes; ++c)
+  {
+    for (int p = bucket_start[c]; p < bucket_start[c] + bucket_kept[c]; ++p)
+    {
+      kept[kept_count++] = kept[p];
+    }
+  }
+
+  // merge the classes, best score first
+  ScoreGreater greater = {run_scores};
+  int out_count = std::min(kept_count, max_keep);
+  std::partial_sort(kept.begin(), kept.begin() + out_count, kept.begin() + kept_count, greater);
+  std::copy(kept.begin(), kept.begin() + out_count, keep);
+  return out_count;
+}
+
+int NmsEngine::Run(const float *boxes, const float *scores, const int *class_ids, int count, float threshold,
+                   int *keep, int max_keep, int top_k)
+{
+  if (count <= 0)
+  {
+    return 0;
+  }
+  if (Sort(boxes, scores, class_ids, count, top_k) < 0)
+  {
+    return -1;
+  }
+  return Suppress(threshold, keep, max_keep);
+}
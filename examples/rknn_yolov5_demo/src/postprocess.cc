@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "postprocess.h"
+#include "nms.h"
 
 #include <math.h>
 #include <stdint.h>
@@ -21,9 +22,18 @@
 #include <string.h>
 #include <sys/time.h>
 
-#include <set>
 #include <vector>
-#define LABEL_NALE_TXT_PATH "./model/coco_80_labels_list.txt"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define POST_SIMD_LANES 16
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define POST_SIMD_LANES 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define POST_SIMD_LANES 16
+#endif
 
 static char *labels[OBJ_CLASS_NUM];
 
@@ -100,157 +110,188 @@ int loadLabelName(const char *locationFilename, char *label[])
   return 0;
 }
 
-static float CalculateOverlap(float xmin0, float ymin0, float xmax0, float ymax0, float xmin1, float ymin1, float xmax1,
-                              float ymax1)
-{
-  float w = fmax(0.f, fmin(xmax0, xmax1) - fmax(xmin0, xmin1) + 1.0);
-  float h = fmax(0.f, fmin(ymax0, ymax1) - fmax(ymin0, ymin1) + 1.0);
-  float i = w * h;
-  float u = (xmax0 - xmin0 + 1.0) * (ymax0 - ymin0 + 1.0) + (xmax1 - xmin1 + 1.0) * (ymax1 - ymin1 + 1.0) - i;
-  return u <= 0.f ? 0.f : (i / u);
-}
-
-static int nms(int validCount, std::vector<float> &outputLocations, std::vector<int> classIds, std::vector<int> &order,
-               int filterId, float threshold)
+static inline int8_t max_class_prob(const int8_t *cls, int grid_len, int *maxClassId)
 {
-  for (int i = 0; i < validCount; ++i)
+  int8_t maxClassProbs = cls[0];
+  *maxClassId = 0;
+  for (int k = 1; k < OBJ_CLASS_NUM; ++k)
   {
-    if (order[i] == -1 || classIds[i] != filterId)
+    int8_t prob = cls[k * grid_len];
+    if (prob > maxClassProbs)
     {
-      continue;
+      *maxClassId = k;
+      maxClassProbs = prob;
     }
-    int n = order[i];
-    for (int j = i + 1; j < validCount; ++j)
-    {
-      int m = order[j];
-      if (m == -1 || classIds[i] != filterId)
-      {
-        continue;
-      }
-      float xmin0 = outputLocations[n * 4 + 0];
-      float ymin0 = outputLocations[n * 4 + 1];
-      float xmax0 = outputLocations[n * 4 + 0] + outputLocations[n * 4 + 2];
-      float ymax0 = outputLocations[n * 4 + 1] + outputLocations[n * 4 + 3];
-
-      float xmin1 = outputLocations[m * 4 + 0];
-      float ymin1 = outputLocations[m * 4 + 1];
-      float xmax1 = outputLocations[m * 4 + 0] + outputLocations[m * 4 + 2];
-      float ymax1 = outputLocations[m * 4 + 1] + outputLocations[m * 4 + 3];
+  }
+  return maxClassProbs;
+}
 
-      float iou = CalculateOverlap(xmin0, ymin0, xmax0, ymax0, xmin1, ymin1, xmax1, ymax1);
+#ifdef POST_SIMD_LANES
+// below this many candidates in a block the scalar class scan is cheaper
+#define POST_SIMD_MIN_HITS 3
+
+/*
+  grid cells are contiguous inside each plane of the NCHW output, so POST_SIMD_LANES cells are handled at once:
+  conf_mask() compares their box confidence against the threshold, class_argmax() walks the class planes
+  and keeps the first maximum of every cell, like the scalar loop does.
+*/
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline uint32_t conf_mask(const int8_t *conf, int8_t thres_i8)
+{
+  static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t m = vandq_u8(vcgeq_s8(vld1q_s8(conf), vdupq_n_s8(thres_i8)), vld1q_u8(bits));
+  uint8x8_t s = vpadd_u8(vget_low_u8(m), vget_high_u8(m));
+  s = vpadd_u8(s, s);
+  s = vpadd_u8(s, s);
+  return vget_lane_u8(s, 0) | (vget_lane_u8(s, 1) << 8);
+}
 
-      if (iou > threshold)
-      {
-        order[j] = -1;
-      }
-    }
+static inline void class_argmax(const int8_t *cls, int grid_len, int8_t *max_probs, uint8_t *max_ids)
+{
+  int8x16_t max = vld1q_s8(cls);
+  uint8x16_t ids = vdupq_n_u8(0);
+  for (int k = 1; k < OBJ_CLASS_NUM; ++k)
+  {
+    int8x16_t prob = vld1q_s8(cls + k * grid_len);
+    uint8x16_t gt = vcgtq_s8(prob, max);
+    max = vmaxq_s8(max, prob);
+    ids = vbslq_u8(gt, vdupq_n_u8(k), ids);
   }
-  return 0;
+  vst1q_s8(max_probs, max);
+  vst1q_u8(max_ids, ids);
+}
+#elif defined(__AVX2__)
+static inline uint32_t conf_mask(const int8_t *conf, int8_t thres_i8)
+{
+  __m256i lt = _mm256_cmpgt_epi8(_mm256_set1_epi8(thres_i8), _mm256_loadu_si256((const __m256i *)conf));
+  return ~(uint32_t)_mm256_movemask_epi8(lt);
 }
 
-static int quick_sort_indice_inverse(std::vector<float> &input, int left, int right, std::vector<int> &indices)
+static inline void class_argmax(const int8_t *cls, int grid_len, int8_t *max_probs, uint8_t *max_ids)
 {
-  float key;
-  int key_index;
-  int low = left;
-  int high = right;
-  if (left < right)
+  __m256i max = _mm256_loadu_si256((const __m256i *)cls);
+  __m256i ids = _mm256_setzero_si256();
+  for (int k = 1; k < OBJ_CLASS_NUM; ++k)
   {
-    key_index = indices[left];
-    key = input[left];
-    while (low < high)
-    {
-      while (low < high && input[high] <= key)
-      {
-        high--;
-      }
-      input[low] = input[high];
-      indices[low] = indices[high];
-      while (low < high && input[low] >= key)
-      {
-        low++;
-      }
-      input[high] = input[low];
-      indices[high] = indices[low];
-    }
-    input[low] = key;
-    indices[low] = key_index;
-    quick_sort_indice_inverse(input, left, low - 1, indices);
-    quick_sort_indice_inverse(input, low + 1, right, indices);
+    __m256i prob = _mm256_loadu_si256((const __m256i *)(cls + k * grid_len));
+    __m256i gt = _mm256_cmpgt_epi8(prob, max);
+    max = _mm256_max_epi8(max, prob);
+    ids = _mm256_blendv_epi8(ids, _mm256_set1_epi8(k), gt);
   }
-  return low;
+  _mm256_storeu_si256((__m256i *)max_probs, max);
+  _mm256_storeu_si256((__m256i *)max_ids, ids);
 }
-
-static float sigmoid(float x) { return 1.0 / (1.0 + expf(-x)); }
-
-static float unsigmoid(float y) { return -1.0 * logf((1.0 / y) - 1.0); }
-
-inline static int32_t __clip(float val, float min, float max)
+#else
+static inline uint32_t conf_mask(const int8_t *conf, int8_t thres_i8)
 {
-  float f = val <= min ? min : (val >= max ? max : val);
-  return f;
+  __m128i lt = _mm_cmpgt_epi8(_mm_set1_epi8(thres_i8), _mm_loadu_si128((const __m128i *)conf));
+  return ~(uint32_t)_mm_movemask_epi8(lt) & 0xffff;
 }
 
-static int8_t qnt_f32_to_affine(float f32, int32_t zp, float scale)
+static inline void class_argmax(const int8_t *cls, int grid_len, int8_t *max_probs, uint8_t *max_ids)
 {
-  float dst_val = (f32 / scale) + zp;
-  int8_t res = (int8_t)__clip(dst_val, -128, 127);
-  return res;
+  __m128i max = _mm_loadu_si128((const __m128i *)cls);
+  __m128i ids = _mm_setzero_si128();
+  for (int k = 1; k < OBJ_CLASS_NUM; ++k)
+  {
+    __m128i prob = _mm_loadu_si128((const __m128i *)(cls + k * grid_len));
+    __m128i gt = _mm_cmpgt_epi8(prob, max);
+    // SSE2 has no signed int8 max / blend
+    max = _mm_or_si128(_mm_and_si128(gt, prob), _mm_andnot_si128(gt, max));
+    ids = _mm_or_si128(_mm_and_si128(gt, _mm_set1_epi8(k)), _mm_andnot_si128(gt, ids));
+  }
+  _mm_storeu_si128((__m128i *)max_probs, max);
+  _mm_storeu_si128((__m128i *)max_ids, ids);
 }
+#endif
+#endif // POST_SIMD_LANES
 
-static float deqnt_affine_to_f32(int8_t qnt, int32_t zp, float scale) { return ((float)qnt - (float)zp) * scale; }
+static int decode_box(int8_t *in_ptr, int *anchor, int a, int i, int j, int grid_len, int stride, int8_t box_confidence,
+                      int8_t maxClassProbs, int maxClassId, std::vector<float> &boxes, std::vector<float> &objProbs,
+                      std::vector<int> &classId, int8_t thres_i8, const YoloQuantLut &lut)
+{
+  if (maxClassProbs <= thres_i8)
+  {
+    return 0;
+  }
+  float box_x = lut.XY(*in_ptr);
+  float box_y = lut.XY(in_ptr[grid_len]);
+  float box_w = lut.WH(in_ptr[2 * grid_len]);
+  float box_h = lut.WH(in_ptr[3 * grid_len]);
+  box_x = (box_x + j) * (float)stride;
+  box_y = (box_y + i) * (float)stride;
+  box_w = box_w * (float)anchor[a * 2];
+  box_h = box_h * (float)anchor[a * 2 + 1];
+  box_x -= (box_w / 2.0);
+  box_y -= (box_h / 2.0);
+
+  objProbs.push_back(lut.Score(maxClassProbs) * lut.Score(box_confidence));
+  classId.push_back(maxClassId);
+  boxes.push_back(box_x);
+  boxes.push_back(box_y);
+  boxes.push_back(box_w);
+  boxes.push_back(box_h);
+  return 1;
+}
 
-static int process(int8_t *input, int *anchor, int grid_h, int grid_w, int height, int width, int stride,
-                   std::vector<float> &boxes, std::vector<float> &objProbs, std::vector<int> &classId, float threshold,
-                   int32_t zp, float scale)
+int process_i8(int8_t *input, int *anchor, int grid_h, int grid_w, int stride, std::vector<float> &boxes,
+               std::vector<float> &objProbs, std::vector<int> &classId, float threshold, const YoloQuantLut &lut)
 {
   int validCount = 0;
   int grid_len = grid_h * grid_w;
-  int8_t thres_i8 = qnt_f32_to_affine(threshold, zp, scale);
+  int8_t thres_i8 = lut.Threshold(threshold);
   for (int a = 0; a < 3; a++)
   {
-    for (int i = 0; i < grid_h; i++)
+    int8_t *box_ptr = input + (PROP_BOX_SIZE * a) * grid_len;
+    int8_t *conf_ptr = box_ptr + 4 * grid_len;
+    int8_t *cls_ptr = box_ptr + 5 * grid_len;
+    int p = 0;
+#ifdef POST_SIMD_LANES
+    int8_t max_probs[POST_SIMD_LANES];
+    uint8_t max_ids[POST_SIMD_LANES];
+    for (; p + POST_SIMD_LANES <= grid_len; p += POST_SIMD_LANES)
     {
-      for (int j = 0; j < grid_w; j++)
+      uint32_t mask = conf_mask(conf_ptr + p, thres_i8);
+      if (mask == 0)
+      {
+        continue;
+      }
+      bool vector_scan = __builtin_popcount(mask) >= POST_SIMD_MIN_HITS;
+      if (vector_scan)
+      {
+        class_argmax(cls_ptr + p, grid_len, max_probs, max_ids);
+      }
+      while (mask)
       {
-        int8_t box_confidence = input[(PROP_BOX_SIZE * a + 4) * grid_len + i * grid_w + j];
-        if (box_confidence >= thres_i8)
+        int l = __builtin_ctz(mask);
+        mask &= mask - 1;
+        int cell = p + l;
+        int maxClassId;
+        int8_t maxClassProbs;
+        if (vector_scan)
+        {
+          maxClassId = max_ids[l];
+          maxClassProbs = max_probs[l];
+        }
+        else
         {
-          int offset = (PROP_BOX_SIZE * a) * grid_len + i * grid_w + j;
-          int8_t *in_ptr = input + offset;
-          float box_x = (deqnt_affine_to_f32(*in_ptr, zp, scale)) * 2.0 - 0.5;
-          float box_y = (deqnt_affine_to_f32(in_ptr[grid_len], zp, scale)) * 2.0 - 0.5;
-          float box_w = (deqnt_affine_to_f32(in_ptr[2 * grid_len], zp, scale)) * 2.0;
-          float box_h = (deqnt_affine_to_f32(in_ptr[3 * grid_len], zp, scale)) * 2.0;
-          box_x = (box_x + j) * (float)stride;
-          box_y = (box_y + i) * (float)stride;
-          box_w = box_w * box_w * (float)anchor[a * 2];
-          box_h = box_h * box_h * (float)anchor[a * 2 + 1];
-          box_x -= (box_w / 2.0);
-          box_y -= (box_h / 2.0);
-
-          int8_t maxClassProbs = in_ptr[5 * grid_len];
-          int maxClassId = 0;
-          for (int k = 1; k < OBJ_CLASS_NUM; ++k)
-          {
-            int8_t prob = in_ptr[(5 + k) * grid_len];
-            if (prob > maxClassProbs)
-            {
-              maxClassId = k;
-              maxClassProbs = prob;
-            }
-          }
-          if (maxClassProbs > thres_i8)
-          {
-            objProbs.push_back((deqnt_affine_to_f32(maxClassProbs, zp, scale)) * (deqnt_affine_to_f32(box_confidence, zp, scale)));
-            classId.push_back(maxClassId);
-            validCount++;
-            boxes.push_back(box_x);
-            boxes.push_back(box_y);
-            boxes.push_back(box_w);
-            boxes.push_back(box_h);
-          }
+          maxClassProbs = max_class_prob(cls_ptr + cell, grid_len, &maxClassId);
         }
+        validCount += decode_box(box_ptr + cell, anchor, a, cell / grid_w, cell % grid_w, grid_len, stride,
+                                 conf_ptr[cell], maxClassProbs, maxClassId, boxes, objProbs, classId, thres_i8, lut);
+      }
+    }
+#endif
+    // remaining cells
+    for (; p < grid_len; p++)
+    {
+      int8_t box_confidence = conf_ptr[p];
+      if (box_confidence >= thres_i8)
+      {
+        int maxClassId;
+        int8_t maxClassProbs = max_class_prob(cls_ptr + p, grid_len, &maxClassId);
+        validCount += decode_box(box_ptr + p, anchor, a, p / grid_w, p % grid_w, grid_len, stride, box_confidence,
+                                 maxClassProbs, maxClassId, boxes, objProbs, classId, thres_i8, lut);
       }
     }
   }
@@ -262,6 +303,7 @@ int post_process(int8_t *input0, int8_t *input1, int8_t *input2, int model_in_h,
                  std::vector<float> &qnt_scales, detect_result_group_t *group)
 {
   static int init = -1;
+  static YoloQuantLut luts[3];
   if (init == -1)
   {
     int ret = 0;
@@ -274,6 +316,13 @@ int post_process(int8_t *input0, int8_t *input1, int8_t *input2, int model_in_h,
     init = 0;
   }
   memset(group, 0, sizeof(detect_result_group_t));
+  for (int i = 0; i < 3; i++)
+  {
+    if (!luts[i].Matches(qnt_zps[i], qnt_scales[i], false))
+    {
+      luts[i].Build(qnt_zps[i], qnt_scales[i], false);
+    }
+  }
 
   std::vector<float> filterBoxes;
   std::vector<float> objProbs;
@@ -284,24 +333,24 @@ int post_process(int8_t *input0, int8_t *input1, int8_t *input2, int model_in_h,
   int grid_h0 = model_in_h / stride0;
   int grid_w0 = model_in_w / stride0;
   int validCount0 = 0;
-  validCount0 = process(input0, (int *)anchor0, grid_h0, grid_w0, model_in_h, model_in_w, stride0, filterBoxes, objProbs,
-                        classId, conf_threshold, qnt_zps[0], qnt_scales[0]);
+  validCount0 = process_i8(input0, (int *)anchor0, grid_h0, grid_w0, stride0, filterBoxes, objProbs, classId,
+                           conf_threshold, luts[0]);
 
   // stride 16
   int stride1 = 16;
   int grid_h1 = model_in_h / stride1;
   int grid_w1 = model_in_w / stride1;
   int validCount1 = 0;
-  validCount1 = process(input1, (int *)anchor1, grid_h1, grid_w1, model_in_h, model_in_w, stride1, filterBoxes, objProbs,
-                        classId, conf_threshold, qnt_zps[1], qnt_scales[1]);
+  validCount1 = process_i8(input1, (int *)anchor1, grid_h1, grid_w1, stride1, filterBoxes, objProbs, classId,
+                           conf_threshold, luts[1]);
 
   // stride 32
   int stride2 = 32;
   int grid_h2 = model_in_h / stride2;
   int grid_w2 = model_in_w / stride2;
   int validCount2 = 0;
-  validCount2 = process(input2, (int *)anchor2, grid_h2, grid_w2, model_in_h, model_in_w, stride2, filterBoxes, objProbs,
-                        classId, conf_threshold, qnt_zps[2], qnt_scales[2]);
+  validCount2 = process_i8(input2, (int *)anchor2, grid_h2, grid_w2, stride2, filterBoxes, objProbs, classId,
+                           conf_threshold, luts[2]);
 
   int validCount = validCount0 + validCount1 + validCount2;
   // no object detect
@@ -310,38 +359,24 @@ int post_process(int8_t *input0, int8_t *input1, int8_t *input2, int model_in_h,
     return 0;
   }
 
-  std::vector<int> indexArray;
-  for (int i = 0; i < validCount; ++i)
-  {
-    indexArray.push_back(i);
-  }
-
-  quick_sort_indice_inverse(objProbs, 0, validCount - 1, indexArray);
-
-  std::set<int> class_set(std::begin(classId), std::end(classId));
-
-  for (auto c : class_set)
-  {
-    nms(validCount, filterBoxes, classId, indexArray, c, nms_threshold);
-  }
+  NmsEngine nms_engine;
+  nms_engine.Init(validCount, OBJ_CLASS_NUM);
+  int keep[OBJ_NUMB_MAX_SIZE];
+  int keep_count = nms_engine.Run(filterBoxes.data(), objProbs.data(), classId.data(), validCount, nms_threshold, keep,
+                                  OBJ_NUMB_MAX_SIZE);
 
   int last_count = 0;
   group->count = 0;
   /* box valid detect target */
-  for (int i = 0; i < validCount; ++i)
+  for (int i = 0; i < keep_count; ++i)
   {
-    if (indexArray[i] == -1 || last_count >= OBJ_NUMB_MAX_SIZE)
-    {
-      continue;
-    }
-    int n = indexArray[i];
-
+    int n = keep[i];
     float x1 = filterBoxes[n * 4 + 0] - pads.left;
     float y1 = filterBoxes[n * 4 + 1] - pads.top;
     float x2 = x1 + filterBoxes[n * 4 + 2];
     float y2 = y1 + filterBoxes[n * 4 + 3];
     int id = classId[n];
-    float obj_conf = objProbs[i];
+    float obj_conf = objProbs[n];
 
     group->results[last_count].box.left = (int)(clamp(x1, 0, model_in_w) / scale_w);
     group->results[last_count].box.top = (int)(clamp(y1, 0, model_in_h) / scale_h);
@@ -0,0 +1,153 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <vector>
+
+#include "alloc_counter.h"
+#include "postprocess.h"
+#include "yolo_postprocessor.h"
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static double __get_us(struct timeval t) { return (t.tv_sec * 1000000 + t.tv_usec); }
+
+/* fill one branch like a quantized yolov5 head: everything at zero probability except
+   density_percent of the anchors, which get a box, a confidence and a few class scores. */
+static void fill_branch(std::vector<int8_t> &data, int grid_h, int grid_w, float density_percent, int32_t zp,
+                        float scale, unsigned int *seed)
+{
+  int grid_len = grid_h * grid_w;
+  data.assign(PROP_BOX_SIZE * 3 * grid_len, (int8_t)zp);
+  for (int a = 0; a < 3; a++)
+  {
+    int8_t *in = data.data() + PROP_BOX_SIZE * a * grid_len;
+    for (int p = 0; p < grid_len; p++)
+    {
+      if (rand_r(seed) % 10000 >= density_percent * 100)
+      {
+        continue;
+      }
+      for (int c = 0; c < 4; c++)
+      {
+        in[c * grid_len + p] = (int8_t)(zp + (int)((0.3f + 0.4f * (rand_r(seed) % 100) / 100.f) / scale));
+      }
+      in[4 * grid_len + p] = (int8_t)(zp + (int)((0.3f + 0.7f * (rand_r(seed) % 100) / 100.f) / scale));
+      for (int k = 0; k < 3; k++)
+      {
+        int cls = rand_r(seed) % OBJ_CLASS_NUM;
+        in[(5 + cls) * grid_len + p] = (int8_t)(zp + (int)((0.3f + 0.7f * (rand_r(seed) % 100) / 100.f) / scale));
+      }
+    }
+  }
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char **argv)
+{
+  if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+  {
+    printf("Usage: %s [model_in_size=640] [density_percent=1.0] [loop_count=1000] [pre_nms_top_k=0] [threads=1]\n", argv[0]);
+    return 0;
+  }
+  int model_in_size = argc > 1 ? atoi(argv[1]) : 640;
+  float density_percent = argc > 2 ? atof(argv[2]) : 1.0f;
+  int loop_count = argc > 3 ? atoi(argv[3]) : 1000;
+  int pre_nms_top_k = argc > 4 ? atoi(argv[4]) : 0;
+  int threads = argc > 5 ? atoi(argv[5]) : 1;
+  if (model_in_size < 32 || model_in_size % 32 != 0 || loop_count <= 0)
+  {
+    printf("model_in_size must be a multiple of 32, loop_count must be > 0\n");
+    return -1;
+  }
+
+  int32_t zp = -128;
+  float scale = 0.003922f;
+  std::vector<int32_t> qnt_zps(3, zp);
+  std::vector<float> qnt_scales(3, scale);
+  std::vector<int8_t> outputs[3];
+  unsigned int seed = 1;
+  for (int i = 0; i < 3; i++)
+  {
+    int stride = 8 << i;
+    fill_branch(outputs[i], model_in_size / stride, model_in_size / stride, density_percent, zp, scale, &seed);
+  }
+  BOX_RECT pads;
+  memset(&pads, 0, sizeof(BOX_RECT));
+
+  YoloPostProcessor processor;
+  if (processor.Init(model_in_size, model_in_size) != 0)
+  {
+    return -1;
+  }
+  processor.SetPreNmsTopK(pre_nms_top_k);
+  if (processor.SetThreads(threads) != 0)
+  {
+    return -1;
+  }
+  printf("model input %dx%d, candidate density %.2f%%, workspace for %d candidates\n", model_in_size, model_in_size,
+         density_percent, processor.GetMaxCandidates());
+
+  detect_result_group_t group;
+  struct timeval start_time, stop_time;
+
+  // post_process()
+  post_process(outputs[0].data(), outputs[1].data(), outputs[2].data(), model_in_size, model_in_size, BOX_THRESH,
+               NMS_THRESH, pads, 1.0f, 1.0f, qnt_zps, qnt_scales, &group);
+  long alloc_start = g_alloc_count;
+  gettimeofday(&start_time, NULL);
+  for (int i = 0; i < loop_count; ++i)
+  {
+    post_process(outputs[0].data(), outputs[1].data(), outputs[2].data(), model_in_size, model_in_size, BOX_THRESH,
+                 NMS_THRESH, pads, 1.0f, 1.0f, qnt_zps, qnt_scales, &group);
+  }
+  gettimeofday(&stop_time, NULL);
+  printf("post_process:          %8.2f us/frame, %6.1f allocations/frame, %d objects\n",
+         (__get_us(stop_time) - __get_us(start_time)) / loop_count, (double)(g_alloc_count - alloc_start) / loop_count,
+         group.count);
+
+  // YoloPostProcessor, the first run is the warmup
+  processor.Run(outputs[0].data(), outputs[1].data(), outputs[2].data(), BOX_THRESH, NMS_THRESH, pads, 1.0f, 1.0f,
+                qnt_zps, qnt_scales, &group);
+  processor.ResetStats();
+  alloc_start = g_alloc_count;
+  gettimeofday(&start_time, NULL);
+  for (int i = 0; i < loop_count; ++i)
+  {
+    processor.Run(outputs[0].data(), outputs[1].data(), outputs[2].data(), BOX_THRESH, NMS_THRESH, pads, 1.0f, 1.0f,
+                  qnt_zps, qnt_scales, &group);
+  }
+  gettimeofday(&stop_time, NULL);
+  printf("YoloPostProcessor::Run %8.2f us/frame, %6.1f allocations/frame, %d objects\n",
+         (__get_us(stop_time) - __get_us(start_time)) / loop_count, (double)(g_alloc_count - alloc_start) / loop_count,
+         group.count);
+  const yolo_post_stats_t &stats = processor.GetStats();
+  printf("  %d threads, %d candidates: decode %.0f us, nms %.0f us (last frame), avg %.2f us, max %.0f us\n",
+         threads, stats.candidates, stats.decode_us, stats.nms_us, stats.total_us_sum / stats.frames,
+         stats.total_us_max);
+
+  deinitPostProcess();
+  return 0;
+}
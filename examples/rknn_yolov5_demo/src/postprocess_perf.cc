@@ -0,0 +1,432 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+  post-process micro-benchmark: decode, sort and NMS are timed separately on synthetic yolov5 outputs, for every
+  combination of input size, candidate density, output type and class distribution. results are written to stdout
+  as JSON, progress and errors to stderr.
+*/
+
+/*-------------------------------------------
+                Includes
+-------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "nms.h"
+#include "postprocess.h"
+#include "thread_pool.h"
+#include "yolo_decoder.h"
+
+enum
+{
+  STAGE_DECODE = 0,
+  STAGE_SORT,
+  STAGE_NMS,
+  STAGE_TOTAL,
+  STAGE_NUM
+};
+
+static const char *stage_names[STAGE_NUM] = {"decode", "sort", "nms", "total"};
+
+enum
+{
+  CLASSES_UNIFORM = 0, // every class equally likely
+  CLASSES_SKEWED,      // a few classes hold most of the candidates, like a street scene
+  CLASSES_SINGLE,      // all candidates in class 0, the worst case for the class buckets
+  CLASSES_NUM
+};
+
+static const char *class_dist_names[CLASSES_NUM] = {"uniform", "skewed", "single"};
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+static inline int64_t get_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline float rand_float(unsigned int *seed, float lo, float hi)
+{
+  return lo + (hi - lo) * (rand_r(seed) % 10000) / 10000.f;
+}
+
+/* logical (dequantized) values of one NCHW branch: density_percent of the anchors get a box, a confidence and a
+   class score over the threshold, the others a confidence under it. */
+static void fill_branch(std::vector<float> &data, int grid_h, int grid_w, float density_percent, int class_dist,
+                        unsigned int *seed)
+{
+  int grid_len = grid_h * grid_w;
+  data.assign(PROP_BOX_SIZE * 3 * grid_len, 0.f);
+  for (int a = 0; a < 3; a++)
+  {
+    float *in = data.data() + PROP_BOX_SIZE * a * grid_len;
+    for (int p = 0; p < grid_len; p++)
+    {
+      // a little class noise under the threshold everywhere, so the argmax is not trivial
+      in[(5 + rand_r(seed) % OBJ_CLASS_NUM) * grid_len + p] = rand_float(seed, 0.f, BOX_THRESH * 0.8f);
+      if (rand_r(seed) % 100000 >= density_percent * 1000)
+      {
+        in[4 * grid_len + p] = rand_float(seed, 0.f, BOX_THRESH * 0.8f);
+        continue;
+      }
+      for (int c = 0; c < 4; c++)
+      {
+        in[c * grid_len + p] = rand_float(seed, 0.3f, 0.7f);
+      }
+      in[4 * grid_len + p] = rand_float(seed, BOX_THRESH + 0.05f, 1.f);
+      int cls = 0;
+      if (class_dist == CLASSES_UNIFORM)
+      {
+        cls = rand_r(seed) % OBJ_CLASS_NUM;
+      }
+      else if (class_dist == CLASSES_SKEWED)
+      {
+        float r = rand_float(seed, 0.f, 1.f);
+        cls = (int)(r * r * r * OBJ_CLASS_NUM);
+      }
+      in[(5 + cls) * grid_len + p] = rand_float(seed, BOX_THRESH + 0.05f, 1.f);
+    }
+  }
+}
+
+static void percentiles(std::vector<int64_t> &samples, double *p50, double *p90, double *p99, double *max)
+{
+  std::sort(samples.begin(), samples.end());
+  int n = (int)samples.size();
+  *p50 = (double)samples[n * 50 / 100];
+  *p90 = (double)samples[n * 90 / 100];
+  *p99 = (double)samples[n * 99 / 100];
+  *max = (double)samples[n - 1];
+}
+
+static std::vector<std::string> split_list(const char *value)
+{
+  std::vector<std::string> items;
+  std::string s(value);
+  size_t begin = 0;
+  while (begin <= s.size())
+  {
+    size_t end = s.find(',', begin);
+    if (end == std::string::npos)
+    {
+      end = s.size();
+    }
+    if (end > begin)
+    {
+      items.push_back(s.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return items;
+}
+
+static int find_name(const char *const *names, int num, const std::string &name)
+{
+  for (int i = 0; i < num; i++)
+  {
+    if (name == names[i])
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void print_usage(const char *name)
+{
+  printf("Usage: %s [key=value ...]\n", name);
+  printf("  sizes=320,640,1280        model input sizes, multiples of 32\n");
+  printf("  densities=0.1,1,5,10      percent of the anchors over the threshold\n");
+  printf("  types=int8,fp16           output types\n");
+  printf("  classes=uniform,skewed,single\n");
+  printf("  frames=100                timed frames per case\n");
+  printf("  threads=1                 threads including the caller, for NMS\n");
+  printf("  top_k=0                   pre-NMS top-k, 0 keeps all\n");
+}
+
+/*-------------------------------------------
+                  Main Functions
+-------------------------------------------*/
+int main(int argc, char **argv)
+{
+  std::vector<int> sizes;
+  std::vector<float> densities;
+  std::vector<int> types;
+  std::vector<int> class_dists;
+  int frames = 100;
+  int threads = 1;
+  int top_k = 0;
+  const char *sizes_arg = "320,640,1280";
+  const char *densities_arg = "0.1,1,5,10";
+  const char *types_arg = "int8,fp16";
+  const char *classes_arg = "uniform,skewed,single";
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *eq = strchr(argv[i], '=');
+    if (eq == NULL)
+    {
+      print_usage(argv[0]);
+      return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : -1;
+    }
+    std::string key(argv[i], eq - argv[i]);
+    const char *value = eq + 1;
+    if (key == "sizes")
+      sizes_arg = value;
+    else if (key == "densities")
+      densities_arg = value;
+    else if (key == "types")
+      types_arg = value;
+    else if (key == "classes")
+      classes_arg = value;
+    else if (key == "frames")
+      frames = atoi(value);
+    else if (key == "threads")
+      threads = atoi(value);
+    else if (key == "top_k")
+      top_k = atoi(value);
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      print_usage(argv[0]);
+      return -1;
+    }
+  }
+
+  std::vector<std::string> items = split_list(sizes_arg);
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    int size = atoi(items[i].c_str());
+    if (size < 32 || size % 32 != 0)
+    {
+      fprintf(stderr, "size %s must be a multiple of 32\n", items[i].c_str());
+      return -1;
+    }
+    sizes.push_back(size);
+  }
+  items = split_list(densities_arg);
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    densities.push_back(atof(items[i].c_str()));
+  }
+  items = split_list(types_arg);
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    if (items[i] != "int8" && items[i] != "fp16")
+    {
+      fprintf(stderr, "unknown type %s, ref value: int8 or fp16\n", items[i].c_str());
+      return -1;
+    }
+    types.push_back(items[i] == "int8" ? RKNN_TENSOR_INT8 : RKNN_TENSOR_FLOAT16);
+  }
+  items = split_list(classes_arg);
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    int dist = find_name(class_dist_names, CLASSES_NUM, items[i]);
+    if (dist < 0)
+    {
+      fprintf(stderr, "unknown class distribution %s, ref value: uniform, skewed or single\n", items[i].c_str());
+      return -1;
+    }
+    class_dists.push_back(dist);
+  }
+  if (frames <= 0 || threads <= 0 || sizes.empty() || densities.empty() || types.empty() || class_dists.empty())
+  {
+    print_usage(argv[0]);
+    return -1;
+  }
+
+  ThreadPool pool;
+  if (threads > 1 && pool.Init(threads) != 0)
+  {
+    return -1;
+  }
+
+  const int anchors[3][6] = {{10, 13, 16, 30, 33, 23}, {30, 61, 62, 45, 59, 119}, {116, 90, 156, 198, 373, 326}};
+  const int32_t zp = -128;
+  const float scale = 1.f / 255;
+  int keep[OBJ_NUMB_MAX_SIZE];
+  bool first = true;
+
+  printf("{\n  \"frames\": %d,\n  \"threads\": %d,\n  \"top_k\": %d,\n  \"results\": [", frames, threads, top_k);
+  for (size_t si = 0; si < sizes.size(); si++)
+  {
+    int size = sizes[si];
+    int max_candidates = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      max_candidates += 3 * (size / (8 << i)) * (size / (8 << i));
+    }
+    std::vector<float> boxes, obj_probs;
+    std::vector<int> class_ids;
+    boxes.reserve(max_candidates * 4);
+    obj_probs.reserve(max_candidates);
+    class_ids.reserve(max_candidates);
+    NmsEngine nms;
+    if (nms.Init(max_candidates) != 0)
+    {
+      return -1;
+    }
+    nms.SetThreadPool(threads > 1 ? &pool : NULL);
+    std::vector<int64_t> samples[STAGE_NUM];
+    for (int s = 0; s < STAGE_NUM; s++)
+    {
+      samples[s].resize(frames);
+    }
+
+    for (size_t di = 0; di < densities.size(); di++)
+    {
+      for (size_t ti = 0; ti < types.size(); ti++)
+      {
+        for (size_t ci = 0; ci < class_dists.size(); ci++)
+        {
+          int type = types[ti];
+          unsigned int seed = 1;
+
+          // outputs in the type of the model, fp16 as NCHW attrs for yolo_decode_tensor()
+          std::vector<float> logical;
+          std::vector<int8_t> out_i8[3];
+          std::vector<uint16_t> out_f16[3];
+          rknn_tensor_attr attrs[3];
+          YoloQuantLut lut;
+          lut.Build(zp, scale, false);
+          for (int i = 0; i < 3; i++)
+          {
+            int grid = size / (8 << i);
+            fill_branch(logical, grid, grid, densities[di], class_dists[ci], &seed);
+            if (type == RKNN_TENSOR_INT8)
+            {
+              out_i8[i].resize(logical.size());
+              for (size_t k = 0; k < logical.size(); k++)
+              {
+                float q = logical[k] / scale + zp;
+                out_i8[i][k] = (int8_t)(q <= -128 ? -128 : (q >= 127 ? 127 : q));
+              }
+            }
+            else
+            {
+              out_f16[i].resize(logical.size());
+              rknn_convert_fp32_to_fp16(logical.data(), out_f16[i].data(), logical.size());
+            }
+            memset(&attrs[i], 0, sizeof(rknn_tensor_attr));
+            attrs[i].index = i;
+            attrs[i].n_dims = 4;
+            attrs[i].dims[0] = 1;
+            attrs[i].dims[1] = 3 * PROP_BOX_SIZE;
+            attrs[i].dims[2] = grid;
+            attrs[i].dims[3] = grid;
+            attrs[i].fmt = RKNN_TENSOR_NCHW;
+            attrs[i].type = RKNN_TENSOR_FLOAT16;
+          }
+
+          // one warmup frame, then the timed frames
+          int candidates = 0;
+          int objects = 0;
+          long allocs[STAGE_NUM] = {0};
+          for (int f = -1; f < frames; f++)
+          {
+            int64_t t[STAGE_NUM + 1];
+            long a[STAGE_NUM + 1];
+            a[0] = g_alloc_count;
+            t[0] = get_ns();
+            boxes.clear();
+            obj_probs.clear();
+            class_ids.clear();
+            int count = 0;
+            for (int i = 0; i < 3; i++)
+            {
+              int grid = size / (8 << i);
+              int stride = 8 << i;
+              int n;
+              if (type == RKNN_TENSOR_INT8)
+              {
+                n = process_i8(out_i8[i].data(), (int *)anchors[i], grid, grid, stride, boxes, obj_probs, class_ids,
+                               BOX_THRESH, lut);
+              }
+              else
+              {
+                n = yolo_decode_tensor(&attrs[i], out_f16[i].data(), anchors[i], grid, grid, stride, OBJ_CLASS_NUM,
+                                       BOX_THRESH, boxes, obj_probs, class_ids);
+              }
+              if (n < 0)
+              {
+                return -1;
+              }
+              count += n;
+            }
+            a[1] = g_alloc_count;
+            t[1] = get_ns();
+            if (nms.Sort(boxes.data(), obj_probs.data(), class_ids.data(), count, top_k) < 0)
+            {
+              return -1;
+            }
+            a[2] = g_alloc_count;
+            t[2] = get_ns();
+            objects = nms.Suppress(NMS_THRESH, keep, OBJ_NUMB_MAX_SIZE);
+            a[3] = g_alloc_count;
+            t[3] = get_ns();
+            if (f < 0)
+            {
+              continue;
+            }
+            for (int s = 0; s < STAGE_TOTAL; s++)
+            {
+              samples[s][f] = t[s + 1] - t[s];
+              allocs[s] += a[s + 1] - a[s];
+            }
+            samples[STAGE_TOTAL][f] = t[STAGE_TOTAL] - t[0];
+            allocs[STAGE_TOTAL] += a[STAGE_TOTAL] - a[0];
+            candidates = count;
+          }
+
+          fprintf(stderr, "size %d density %.2f%% %s %s: %d candidates, %d objects\n", size, densities[di],
+                  type == RKNN_TENSOR_INT8 ? "int8" : "fp16", class_dist_names[class_dists[ci]], candidates, objects);
+          printf("%s\n    {\"size\": %d, \"density_percent\": %g, \"type\": \"%s\", \"classes\": \"%s\", "
+                 "\"candidates\": %d, \"objects\": %d,",
+                 first ? "" : ",", size, densities[di], type == RKNN_TENSOR_INT8 ? "int8" : "fp16",
+                 class_dist_names[class_dists[ci]], candidates, objects);
+          first = false;
+          for (int s = 0; s < STAGE_NUM; s++)
+          {
+            double sum = 0;
+            for (int f = 0; f < frames; f++)
+            {
+              sum += samples[s][f];
+            }
+            double p50, p90, p99, max;
+            percentiles(samples[s], &p50, &p90, &p99, &max);
+            printf("\n     \"%s\": {\"ns_per_frame\": %.0f, \"p50\": %.0f, \"p90\": %.0f, \"p99\": %.0f, \"max\": %.0f, "
+                   "\"allocs_per_frame\": %g}%s",
+                   stage_names[s], sum / frames, p50, p90, p99, max, (double)allocs[s] / frames,
+                   s + 1 < STAGE_NUM ? "," : "}");
+          }
+        }
+      }
+    }
+  }
+  printf("\n  ]\n}\n");
+  return 0;
+}
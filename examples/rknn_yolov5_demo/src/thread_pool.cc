@@ -0,0 +1,137 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "thread_pool.h"
+
+#include <stdio.h>
+
+ThreadPool::ThreadPool() : next(0)
+{
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&start_cond, NULL);
+  pthread_cond_init(&done_cond, NULL);
+}
+
+ThreadPool::~ThreadPool()
+{
+  Stop();
+  pthread_cond_destroy(&done_cond);
+  pthread_cond_destroy(&start_cond);
+  pthread_mutex_destroy(&mutex);
+}
+
+int ThreadPool::Init(int num_threads)
+{
+  Stop();
+  // set before the workers exist: one starting after the next Run() has bumped generation must still take that job
+  start_generation = generation;
+  for (int i = 1; i < num_threads; i++)
+  {
+    pthread_t th;
+    if (pthread_create(&th, NULL, WorkerEntry, this) != 0)
+    {
+      printf("ThreadPool: create thread %d failed\n", i);
+      Stop();
+      return -1;
+    }
+    workers.push_back(th);
+  }
+  return 0;
+}
+
+void ThreadPool::Stop()
+{
+  pthread_mutex_lock(&mutex);
+  quit = true;
+  pthread_cond_broadcast(&start_cond);
+  pthread_mutex_unlock(&mutex);
+  for (size_t i = 0; i < workers.size(); i++)
+  {
+    pthread_join(workers[i], NULL);
+  }
+  workers.clear();
+  quit = false;
+}
+
+void *ThreadPool::WorkerEntry(void *arg)
+{
+  ((ThreadPool *)arg)->Work();
+  return NULL;
+}
+
+void ThreadPool::Work()
+{
+  pthread_mutex_lock(&mutex);
+  unsigned int seen = start_generation;
+  while (true)
+  {
+    while (!quit && generation == seen)
+    {
+      pthread_cond_wait(&start_cond, &mutex);
+    }
+    if (quit)
+    {
+      break;
+    }
+    seen = generation;
+    pthread_mutex_unlock(&mutex);
+
+    for (int i = next++; i < count; i = next++)
+    {
+      task(userdata, i);
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (--pending == 0)
+    {
+      pthread_cond_signal(&done_cond);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void ThreadPool::Run(ThreadPoolTask task, void *userdata, int count)
+{
+  if (workers.empty() || count <= 1)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      task(userdata, i);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  this->task = task;
+  this->userdata = userdata;
+  this->count = count;
+  next = 0;
+  pending = (int)workers.size();
+  generation++;
+  pthread_cond_broadcast(&start_cond);
+  pthread_mutex_unlock(&mutex);
+
+  for (int i = next++; i < count; i = next++)
+  {
+    task(userdata, i);
+  }
+
+  // every worker checks in, even one which wakes up when no index is left, so none can see the next job half set
+  pthread_mutex_lock(&mutex);
+  while (pending > 0)
+  {
+    pthread_cond_wait(&done_cond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
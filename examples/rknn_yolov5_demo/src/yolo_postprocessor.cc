@@ -0,0 +1,398 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "yolo_postprocessor.h"
+#include "yolo_decoder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static const int anchor0[6] = {10, 13, 16, 30, 33, 23};
+static const int anchor1[6] = {30, 61, 62, 45, 59, 119};
+static const int anchor2[6] = {116, 90, 156, 198, 373, 326};
+
+static const int strides[3] = {8, 16, 32};
+
+static double __get_us(struct timeval t) { return (t.tv_sec * 1000000 + t.tv_usec); }
+
+inline static int clamp(float val, int min, int max) { return val > min ? (val < max ? val : max) : min; }
+
+YoloPostProcessor::YoloPostProcessor()
+{
+  memset(labels, 0, sizeof(labels));
+  memset(&stats, 0, sizeof(stats));
+}
+
+YoloPostProcessor::~YoloPostProcessor()
+{
+  for (int i = 0; i < OBJ_CLASS_NUM; i++)
+  {
+    if (labels[i] != nullptr)
+    {
+      free(labels[i]);
+      labels[i] = nullptr;
+    }
+  }
+}
+
+int YoloPostProcessor::Init(int model_in_h, int model_in_w, const char *label_path)
+{
+  if (model_in_h < strides[2] || model_in_w < strides[2])
+  {
+    printf("invalid model input size %dx%d\n", model_in_w, model_in_h);
+    return -1;
+  }
+  if (labels[0] == nullptr)
+  {
+    loadLabelName(label_path, labels);
+    if (labels[0] == nullptr)
+    {
+      return -1;
+    }
+  }
+
+  this->model_in_h = model_in_h;
+  this->model_in_w = model_in_w;
+
+  // every anchor of every grid cell can become a candidate
+  max_candidates = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    max_candidates += 3 * (model_in_h / strides[i]) * (model_in_w / strides[i]);
+  }
+  workspaces.clear();
+  return SetMaxBatch(1);
+}
+
+int YoloPostProcessor::ReserveWorkspace(ImageWorkspace *ws)
+{
+  ws->filter_boxes.reserve(max_candidates * 4);
+  ws->obj_probs.reserve(max_candidates);
+  ws->class_ids.reserve(max_candidates);
+  for (int i = 0; i < 3; i++)
+  {
+    int branch_candidates = 3 * (model_in_h / strides[i]) * (model_in_w / strides[i]);
+    ws->branch_boxes[i].reserve(branch_candidates * 4);
+    ws->branch_probs[i].reserve(branch_candidates);
+    ws->branch_ids[i].reserve(branch_candidates);
+  }
+  ws->nms.SetThreadPool(pool.GetNumThreads() > 1 ? &pool : NULL);
+  return ws->nms.Init(max_candidates, OBJ_CLASS_NUM);
+}
+
+int YoloPostProcessor::SetMaxBatch(int max_batch)
+{
+  if (max_candidates == 0 || max_batch <= 0)
+  {
+    printf("YoloPostProcessor: invalid max batch %d\n", max_batch);
+    return -1;
+  }
+  int old_size = (int)workspaces.size();
+  if (max_batch <= old_size)
+  {
+    return 0;
+  }
+  workspaces.resize(max_batch);
+  for (int b = old_size; b < max_batch; b++)
+  {
+    if (ReserveWorkspace(&workspaces[b]) != 0)
+    {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int YoloPostProcessor::SetOutputs(const rknn_tensor_attr *output_attrs, bool apply_sigmoid)
+{
+  this->apply_sigmoid = apply_sigmoid;
+  for (int i = 0; i < 3; i++)
+  {
+    if (output_attrs[i].type == RKNN_TENSOR_INT8)
+    {
+      int32_t zp;
+      float scale;
+      yolo_tensor_qnt(&output_attrs[i], &zp, &scale);
+      luts[i].Build(zp, scale, apply_sigmoid);
+    }
+  }
+  return 0;
+}
+
+const YoloQuantLut &YoloPostProcessor::Lut(int i, int32_t zp, float scale)
+{
+  if (!luts[i].Matches(zp, scale, apply_sigmoid))
+  {
+    luts[i].Build(zp, scale, apply_sigmoid);
+  }
+  return luts[i];
+}
+
+int YoloPostProcessor::SetThreads(int num_threads)
+{
+  int ret = pool.Init(num_threads);
+  for (size_t b = 0; b < workspaces.size(); b++)
+  {
+    workspaces[b].nms.SetThreadPool(pool.GetNumThreads() > 1 ? &pool : NULL);
+  }
+  return ret;
+}
+
+void YoloPostProcessor::ResetStats() { memset(&stats, 0, sizeof(stats)); }
+
+int YoloPostProcessor::Run(int8_t *input0, int8_t *input1, int8_t *input2, float conf_threshold, float nms_threshold,
+                           BOX_RECT pads, float scale_w, float scale_h, const std::vector<int32_t> &qnt_zps,
+                           const std::vector<float> &qnt_scales, detect_result_group_t *group)
+{
+  int8_t *inputs[3] = {input0, input1, input2};
+  for (int i = 0; i < 3; i++)
+  {
+    frame_inputs[i] = inputs[i];
+    frame_image_bytes[i] = 0;
+    frame_zps[i] = qnt_zps[i];
+    frame_scales[i] = qnt_scales[i];
+  }
+  frame_attrs = NULL;
+  frame_threshold = conf_threshold;
+  return Process(1, nms_threshold, &pads, &scale_w, &scale_h, group);
+}
+
+int YoloPostProcessor::Run(const rknn_tensor_attr *output_attrs, void *const outputs[3], float conf_threshold,
+                           float nms_threshold, BOX_RECT pads, float scale_w, float scale_h,
+                           detect_result_group_t *group)
+{
+  return RunBatch(output_attrs, outputs, 1, conf_threshold, nms_threshold, &pads, &scale_w, &scale_h, group);
+}
+
+int YoloPostProcessor::RunBatch(const rknn_tensor_attr *output_attrs, void *const outputs[3], int batch,
+                                float conf_threshold, float nms_threshold, const BOX_RECT *pads, const float *scale_w,
+                                const float *scale_h, detect_result_group_t *groups)
+{
+  if (batch <= 0 || batch > (int)workspaces.size())
+  {
+    printf("YoloPostProcessor: batch %d, workspaces for %d\n", batch, (int)workspaces.size());
+    return -1;
+  }
+  for (int i = 0; i < 3; i++)
+  {
+    const rknn_tensor_attr *attr = &output_attrs[i];
+    if ((int)attr->dims[0] < batch)
+    {
+      printf("YoloPostProcessor: output %d has batch %d, need %d\n", i, attr->dims[0], batch);
+      return -1;
+    }
+    // the images follow each other, native outputs include their padding
+    int bytes = attr->size_with_stride > attr->size ? attr->size_with_stride : attr->size;
+    frame_inputs[i] = outputs[i];
+    frame_image_bytes[i] = bytes / attr->dims[0];
+  }
+  frame_attrs = output_attrs;
+  frame_threshold = conf_threshold;
+  return Process(batch, nms_threshold, pads, scale_w, scale_h, groups);
+}
+
+void YoloPostProcessor::DecodeTask(void *userdata, int index)
+{
+  ((YoloPostProcessor *)userdata)->DecodeBranch(index / 3, index % 3);
+}
+
+void YoloPostProcessor::OutputTask(void *userdata, int index)
+{
+  YoloPostProcessor *self = (YoloPostProcessor *)userdata;
+  self->workspaces[index].ret = self->Output(index);
+}
+
+void YoloPostProcessor::DecodeBranch(int image, int i)
+{
+  ImageWorkspace &ws = workspaces[image];
+  const int *anchors[3] = {anchor0, anchor1, anchor2};
+  int grid_h = model_in_h / strides[i];
+  int grid_w = model_in_w / strides[i];
+  void *input = (char *)frame_inputs[i] + (size_t)image * frame_image_bytes[i];
+  ws.branch_boxes[i].clear();
+  ws.branch_probs[i].clear();
+  ws.branch_ids[i].clear();
+
+  // the tables are prepared by Process(), they are only read here
+  if (frame_attrs == NULL)
+  {
+    ws.branch_counts[i] = process_i8((int8_t *)input, (int *)anchors[i], grid_h, grid_w, strides[i],
+                                     ws.branch_boxes[i], ws.branch_probs[i], ws.branch_ids[i], frame_threshold,
+                                     luts[i]);
+    return;
+  }
+
+  const rknn_tensor_attr *attr = &frame_attrs[i];
+  if (attr->fmt == RKNN_TENSOR_NCHW && attr->type == RKNN_TENSOR_INT8 &&
+      attr->qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && attr->n_dims == 4 &&
+      (int)(attr->dims[2] * attr->dims[3]) == grid_h * grid_w)
+  {
+    // dense int8 NCHW has the SIMD scan
+    ws.branch_counts[i] = process_i8((int8_t *)input, (int *)anchors[i], grid_h, grid_w, strides[i],
+                                     ws.branch_boxes[i], ws.branch_probs[i], ws.branch_ids[i], frame_threshold,
+                                     luts[i]);
+  }
+  else
+  {
+    ws.branch_counts[i] = yolo_decode_tensor(attr, input, anchors[i], grid_h, grid_w, strides[i], OBJ_CLASS_NUM,
+                                             frame_threshold, ws.branch_boxes[i], ws.branch_probs[i],
+                                             ws.branch_ids[i], apply_sigmoid, &luts[i]);
+  }
+}
+
+int YoloPostProcessor::Process(int batch, float nms_threshold, const BOX_RECT *pads, const float *scale_w,
+                               const float *scale_h, detect_result_group_t *groups)
+{
+  if (max_candidates == 0)
+  {
+    printf("YoloPostProcessor is not initialized\n");
+    return -1;
+  }
+  struct timeval start_time, decode_time, stop_time;
+  gettimeofday(&start_time, NULL);
+
+  for (int i = 0; i < 3; i++)
+  {
+    if (frame_attrs == NULL)
+    {
+      Lut(i, frame_zps[i], frame_scales[i]);
+    }
+    else if (frame_attrs[i].type == RKNN_TENSOR_INT8)
+    {
+      int32_t zp;
+      float scale;
+      yolo_tensor_qnt(&frame_attrs[i], &zp, &scale);
+      Lut(i, zp, scale);
+    }
+  }
+
+  // the branches of all images are independent, each one has its own candidate buffers
+  pool.Run(DecodeTask, this, batch * 3);
+
+  int total_candidates = 0;
+  for (int b = 0; b < batch; b++)
+  {
+    ImageWorkspace &ws = workspaces[b];
+    ws.filter_boxes.clear();
+    ws.obj_probs.clear();
+    ws.class_ids.clear();
+    for (int i = 0; i < 3; i++)
+    {
+      if (ws.branch_counts[i] < 0)
+      {
+        return -1;
+      }
+      ws.filter_boxes.insert(ws.filter_boxes.end(), ws.branch_boxes[i].begin(), ws.branch_boxes[i].end());
+      ws.obj_probs.insert(ws.obj_probs.end(), ws.branch_probs[i].begin(), ws.branch_probs[i].end());
+      ws.class_ids.insert(ws.class_ids.end(), ws.branch_ids[i].begin(), ws.branch_ids[i].end());
+      total_candidates += ws.branch_counts[i];
+    }
+  }
+  gettimeofday(&decode_time, NULL);
+
+  frame_nms_threshold = nms_threshold;
+  frame_pads = pads;
+  frame_scale_w = scale_w;
+  frame_scale_h = scale_h;
+  frame_groups = groups;
+  int ret = 0;
+  if (batch == 1)
+  {
+    // a single image spreads its classes over the pool instead
+    ret = Output(0);
+  }
+  else
+  {
+    // one image per task, the NMS of an image stays on its thread
+    for (int b = 0; b < batch; b++)
+    {
+      workspaces[b].nms.SetThreadPool(NULL);
+    }
+    pool.Run(OutputTask, this, batch);
+    for (int b = 0; b < batch; b++)
+    {
+      workspaces[b].nms.SetThreadPool(pool.GetNumThreads() > 1 ? &pool : NULL);
+      if (workspaces[b].ret != 0)
+      {
+        ret = -1;
+      }
+    }
+  }
+  gettimeofday(&stop_time, NULL);
+
+  stats.frames++;
+  stats.candidates = total_candidates;
+  stats.decode_us = __get_us(decode_time) - __get_us(start_time);
+  stats.nms_us = __get_us(stop_time) - __get_us(decode_time);
+  stats.total_us = __get_us(stop_time) - __get_us(start_time);
+  stats.total_us_sum += stats.total_us;
+  if (stats.total_us > stats.total_us_max)
+  {
+    stats.total_us_max = stats.total_us;
+  }
+  return ret;
+}
+
+int YoloPostProcessor::Output(int image)
+{
+  ImageWorkspace &ws = workspaces[image];
+  detect_result_group_t *group = &frame_groups[image];
+  BOX_RECT pads = frame_pads[image];
+  float scale_w = frame_scale_w[image];
+  float scale_h = frame_scale_h[image];
+  memset(group, 0, sizeof(detect_result_group_t));
+
+  int validCount = (int)ws.obj_probs.size();
+  // no object detect
+  if (validCount <= 0)
+  {
+    return 0;
+  }
+
+  int keep_count = ws.nms.Run(ws.filter_boxes.data(), ws.obj_probs.data(), ws.class_ids.data(), validCount,
+                              frame_nms_threshold, ws.keep, OBJ_NUMB_MAX_SIZE, pre_nms_top_k);
+  if (keep_count < 0)
+  {
+    return -1;
+  }
+
+  int last_count = 0;
+  /* box valid detect target */
+  for (int i = 0; i < keep_count; ++i)
+  {
+    int n = ws.keep[i];
+    float x1 = ws.filter_boxes[n * 4 + 0] - pads.left;
+    float y1 = ws.filter_boxes[n * 4 + 1] - pads.top;
+    float x2 = x1 + ws.filter_boxes[n * 4 + 2];
+    float y2 = y1 + ws.filter_boxes[n * 4 + 3];
+    int id = ws.class_ids[n];
+
+    group->results[last_count].box.left = (int)(clamp(x1, 0, model_in_w) / scale_w);
+    group->results[last_count].box.top = (int)(clamp(y1, 0, model_in_h) / scale_h);
+    group->results[last_count].box.right = (int)(clamp(x2, 0, model_in_w) / scale_w);
+    group->results[last_count].box.bottom = (int)(clamp(y2, 0, model_in_h) / scale_h);
+    group->results[last_count].prop = ws.obj_probs[n];
+    if (labels[id] != nullptr)
+    {
+      strncpy(group->results[last_count].name, labels[id], OBJ_NAME_MAX_SIZE - 1);
+    }
+    last_count++;
+  }
+  group->count = last_count;
+  group->id = image;
+
+  return 0;
+}
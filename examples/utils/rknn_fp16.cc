@@ -0,0 +1,88 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rknn_fp16.h"
+
+#if defined(__aarch64__) || ((defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__ARM_FP) && (__ARM_FP & 2))
+#include <arm_neon.h>
+#define FP16_NEON_CVT 1
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+// built for any x86 CPU, the F16C kernels are compiled for it alone and taken when the CPU has it
+#define FP16_F16C_CVT 1
+#endif
+
+#ifdef FP16_F16C_CVT
+static bool cpu_has_f16c()
+{
+  static const bool has = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return has;
+}
+
+__attribute__((target("avx,f16c"))) static size_t f16c_fp16_to_fp32(const uint16_t* src, float* dst, size_t count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+  }
+  return i;
+}
+
+__attribute__((target("avx,f16c"))) static size_t f16c_fp32_to_fp16(const float* src, uint16_t* dst, size_t count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+  return i;
+}
+#endif
+
+void rknn_convert_fp16_to_fp32(const uint16_t* src, float* dst, size_t count)
+{
+  size_t i = 0;
+#if defined(FP16_NEON_CVT)
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t h = vld1q_u16(src + i);
+    vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vget_low_u16(h))));
+    vst1q_f32(dst + i + 4, vcvt_f32_f16(vreinterpret_f16_u16(vget_high_u16(h))));
+  }
+#elif defined(FP16_F16C_CVT)
+  if (cpu_has_f16c()) {
+    i = f16c_fp16_to_fp32(src, dst, count);
+  }
+#endif
+  for (; i < count; ++i) {
+    dst[i] = rknn_fp16_to_fp32(src[i]);
+  }
+}
+
+void rknn_convert_fp32_to_fp16(const float* src, uint16_t* dst, size_t count)
+{
+  size_t i = 0;
+#if defined(FP16_NEON_CVT)
+  for (; i + 8 <= count; i += 8) {
+    float16x4_t lo = vcvt_f16_f32(vld1q_f32(src + i));
+    float16x4_t hi = vcvt_f16_f32(vld1q_f32(src + i + 4));
+    vst1q_u16(dst + i, vcombine_u16(vreinterpret_u16_f16(lo), vreinterpret_u16_f16(hi)));
+  }
+#elif defined(FP16_F16C_CVT)
+  if (cpu_has_f16c()) {
+    i = f16c_fp32_to_fp16(src, dst, count);
+  }
+#endif
+  for (; i < count; ++i) {
+    dst[i] = rknn_fp32_to_fp16(src[i]);
+  }
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_UTILS_FP16_H_
+#define _RKNN_UTILS_FP16_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+  IEEE half precision (RKNN_TENSOR_FLOAT16) to / from float, round to nearest even, subnormals, inf and NaN kept.
+  the array functions convert with NEON fcvt on ARM and F16C on x86 CPUs that have it, the per element code
+  otherwise; the single value ones are for the few elements of a strided read, e.g. a candidate of a yolo head.
+*/
+
+// one value, exact
+static inline float rknn_fp16_to_fp32(uint16_t h)
+{
+  // exponent rebiased by adding (127 - 15) << 23, subnormals normalized through a float subtraction
+  uint32_t bits = (uint32_t)(h & 0x7fff) << 13;
+  uint32_t exp  = bits & 0x0f800000;
+  bits += (127 - 15) << 23;
+  if (exp == 0x0f800000) {
+    bits += (128 - 16) << 23; // inf / NaN
+    if (h & 0x3ff) {
+      bits |= 0x400000; // quiet, as fcvt / vcvtph2ps do
+    }
+  }
+  float f;
+  if (exp == 0) {
+    const uint32_t magic_bits = 113 << 23;
+    float          magic;
+    memcpy(&magic, &magic_bits, sizeof(magic));
+    bits += 1 << 23;
+    memcpy(&f, &bits, sizeof(f));
+    f -= magic;
+    memcpy(&bits, &f, sizeof(bits));
+  }
+  bits |= (uint32_t)(h & 0x8000) << 16;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// one value, round to nearest even
+static inline uint16_t rknn_fp32_to_fp16(float f)
+{
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t mant = x & 0x7fffff;
+  int32_t  exp  = (int32_t)((x >> 23) & 0xff);
+  if (exp == 0xff) {
+    // NaNs quieted with the top of their payload, as the fcvt / vcvtps2ph of the array functions do
+    return (uint16_t)(sign | 0x7c00 | (mant ? 0x200 | (mant >> 13) : 0));
+  }
+  exp = exp - 127 + 15;
+  if (exp >= 31) {
+    return (uint16_t)(sign | 0x7c00);
+  }
+  uint32_t half, rem, mid;
+  if (exp <= 0) {
+    // subnormal
+    if (exp < -10) {
+      return (uint16_t)sign;
+    }
+    uint32_t shift = (uint32_t)(14 - exp);
+    mant |= 0x800000;
+    half = mant >> shift;
+    rem  = mant & ((1u << shift) - 1);
+    mid  = 1u << (shift - 1);
+  } else {
+    half = ((uint32_t)exp << 10) | (mant >> 13);
+    rem  = mant & 0x1fff;
+    mid  = 0x1000;
+  }
+  // a carry into the exponent is still right
+  if (rem > mid || (rem == mid && (half & 1))) {
+    half++;
+  }
+  return (uint16_t)(sign | half);
+}
+
+// count elements, src and dst must not overlap
+void rknn_convert_fp16_to_fp32(const uint16_t* src, float* dst, size_t count);
+void rknn_convert_fp32_to_fp16(const float* src, uint16_t* dst, size_t count);
+
+#endif //_RKNN_UTILS_FP16_H_
@@ -0,0 +1,511 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rknn_input_pack.h"
+#include "rknn_fp16.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define PACK_MAX_THREADS 16
+
+/*-------------------------------------------
+              Value tables
+-------------------------------------------*/
+/*
+  normalization and quantization only depend on the 8 bit channel value, so they are folded into one table of
+  256 output values per channel, built once per call.
+*/
+enum
+{
+  PACK_8BIT = 0,
+  PACK_FP16,
+  PACK_FP32,
+};
+
+struct PackLut
+{
+  union
+  {
+    uint8_t  u8[3][256];
+    uint16_t f16[3][256];
+    float    f32[3][256];
+  };
+  int     kind;
+  bool    shift; // 8 bit table of the form v + k[c], a plain add
+  uint8_t k[3];
+};
+
+static int build_lut(const rknn_tensor_attr* attr, const float* mean, const float* std, PackLut* lut)
+{
+  float qscale = 1.f;
+  float qzp    = 0.f;
+  if (attr->qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC) {
+    qscale = attr->scale;
+    qzp    = (float)attr->zp;
+  } else if (attr->qnt_type == RKNN_TENSOR_QNT_DFP) {
+    qscale = ldexpf(1.f, -attr->fl);
+  }
+
+  switch (attr->type) {
+  case RKNN_TENSOR_INT8:
+  case RKNN_TENSOR_UINT8:
+    lut->kind = PACK_8BIT;
+    break;
+  case RKNN_TENSOR_FLOAT16:
+    lut->kind = PACK_FP16;
+    break;
+  case RKNN_TENSOR_FLOAT32:
+    lut->kind = PACK_FP32;
+    break;
+  default:
+    printf("rknn_pack_input: input type %s is not supported\n", get_type_string(attr->type));
+    return -1;
+  }
+  if (qscale == 0.f) {
+    printf("rknn_pack_input: input scale is 0\n");
+    return -1;
+  }
+
+  float lo = attr->type == RKNN_TENSOR_INT8 ? -128.f : 0.f;
+  float hi = attr->type == RKNN_TENSOR_INT8 ? 127.f : 255.f;
+  lut->shift = lut->kind == PACK_8BIT;
+  for (int c = 0; c < 3; c++) {
+    float m = mean ? mean[c] : 0.f;
+    float s = std ? std[c] : 1.f;
+    if (s == 0.f) {
+      printf("rknn_pack_input: std of channel %d is 0\n", c);
+      return -1;
+    }
+    float vals[256];
+    for (int v = 0; v < 256; v++) {
+      float val = (v - m) / s;
+      if (lut->kind == PACK_FP32) {
+        lut->f32[c][v] = val;
+      } else if (lut->kind == PACK_FP16) {
+        vals[v] = val;
+      } else {
+        float q = roundf(val / qscale + qzp);
+        q       = q < lo ? lo : (q > hi ? hi : q);
+        // int8 values are stored as their two's complement byte
+        lut->u8[c][v] = (uint8_t)(int)q;
+      }
+    }
+    if (lut->kind == PACK_FP16) {
+      rknn_convert_fp32_to_fp16(vals, lut->f16[c], 256);
+    }
+    if (lut->shift) {
+      lut->k[c] = lut->u8[c][0];
+      for (int v = 1; v < 256 && lut->shift; v++) {
+        lut->shift = lut->u8[c][v] == (uint8_t)(v + lut->k[c]);
+      }
+    }
+  }
+  return 0;
+}
+
+/*-------------------------------------------
+              Row kernels
+-------------------------------------------*/
+// BT.601 limited range, 8 bit fixed point
+static inline uint8_t clamp_u8(int v)
+{
+  return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static void nv12_row_to_rgb(const uint8_t* y_row, const uint8_t* uv_row, uint32_t width, uint8_t* rgb)
+{
+  for (uint32_t x = 0; x < width; x++) {
+    int c = 298 * ((int)y_row[x] - 16) + 128;
+    int d = (int)uv_row[x & ~1u] - 128;
+    int e = (int)uv_row[(x & ~1u) + 1] - 128;
+    rgb[x * 3 + 0] = clamp_u8((c + 409 * e) >> 8);
+    rgb[x * 3 + 1] = clamp_u8((c - 100 * d - 208 * e) >> 8);
+    rgb[x * 3 + 2] = clamp_u8((c + 516 * d) >> 8);
+  }
+}
+
+// packed 3 channel 8 bit output where quantization is a plain add: the common uint8 / int8 pass through case
+static void shift_row(const uint8_t* src, bool swap, uint32_t width, const uint8_t* k, uint8_t* dst)
+{
+  uint32_t x = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  uint8x16_t k0 = vdupq_n_u8(k[0]);
+  uint8x16_t k1 = vdupq_n_u8(k[1]);
+  uint8x16_t k2 = vdupq_n_u8(k[2]);
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x3_t p = vld3q_u8(src + x * 3);
+    uint8x16x3_t o;
+    o.val[0] = vaddq_u8(p.val[swap ? 2 : 0], k0);
+    o.val[1] = vaddq_u8(p.val[1], k1);
+    o.val[2] = vaddq_u8(p.val[swap ? 0 : 2], k2);
+    vst3q_u8(dst + x * 3, o);
+  }
+#elif defined(__SSE2__)
+  if (!swap) {
+    // the offsets repeat every 48 bytes
+    uint8_t pattern[48];
+    for (int i = 0; i < 48; i++) {
+      pattern[i] = k[i % 3];
+    }
+    __m128i k0 = _mm_loadu_si128((const __m128i*)pattern);
+    __m128i k1 = _mm_loadu_si128((const __m128i*)(pattern + 16));
+    __m128i k2 = _mm_loadu_si128((const __m128i*)(pattern + 32));
+    for (; x + 16 <= width; x += 16) {
+      const uint8_t* s = src + x * 3;
+      uint8_t*       d = dst + x * 3;
+      _mm_storeu_si128((__m128i*)d, _mm_add_epi8(_mm_loadu_si128((const __m128i*)s), k0));
+      _mm_storeu_si128((__m128i*)(d + 16), _mm_add_epi8(_mm_loadu_si128((const __m128i*)(s + 16)), k1));
+      _mm_storeu_si128((__m128i*)(d + 32), _mm_add_epi8(_mm_loadu_si128((const __m128i*)(s + 32)), k2));
+    }
+  }
+#endif
+  for (; x < width; x++) {
+    const uint8_t* s = src + x * 3;
+    dst[x * 3 + 0]   = (uint8_t)(s[swap ? 2 : 0] + k[0]);
+    dst[x * 3 + 1]   = (uint8_t)(s[1] + k[1]);
+    dst[x * 3 + 2]   = (uint8_t)(s[swap ? 0 : 2] + k[2]);
+  }
+}
+
+template <typename T>
+static void lut_row(const uint8_t* src, bool swap, uint32_t width, const T (*lut)[256], const size_t* chan_off,
+                    size_t pixel_stride, T* dst)
+{
+  uint32_t s0 = swap ? 2 : 0;
+  uint32_t s2 = swap ? 0 : 2;
+  T*       d0 = dst + chan_off[0];
+  T*       d1 = dst + chan_off[1];
+  T*       d2 = dst + chan_off[2];
+  for (uint32_t x = 0; x < width; x++) {
+    const uint8_t* s       = src + x * 3;
+    size_t         o       = x * pixel_stride;
+    d0[o]                  = lut[0][s[s0]];
+    d1[o]                  = lut[1][s[1]];
+    d2[o]                  = lut[2][s[s2]];
+  }
+}
+
+/*-------------------------------------------
+                Row jobs
+-------------------------------------------*/
+/*
+  element (c, y, x) of the tensor is at chan_off[c] + y * row_stride + x * pixel_stride, in elements.
+  NHWC: one block, pixel_stride C, row_stride w_stride * C
+  NC1HWC2: C1 blocks of block_stride H * w_stride * C2, pixel_stride C2, row_stride w_stride * C2
+*/
+struct PackJob
+{
+  const rknn_pack_frame* frame;
+  const PackLut*         lut;
+  const uint8_t*         pixels;
+  const uint8_t*         uv;
+  uint32_t               src_stride;
+  uint8_t*               dst;
+  uint32_t               elem_bytes;
+  uint32_t               blocks;
+  size_t                 block_stride;
+  size_t                 row_stride;
+  size_t                 pixel_stride;
+  size_t                 chan_off[3];
+  size_t                 pad_begin; // first element of a block row to zero, row_stride for none
+  uint32_t               row_begin;
+  uint32_t               row_end;
+  uint8_t*               rgb_buf; // NV12 rows converted to RGB, the scratch row of the thread running the job
+};
+
+static void pack_row(const PackJob& job, uint32_t y)
+{
+  const rknn_pack_frame* f     = job.frame;
+  const PackLut*         lut   = job.lut;
+  bool                   swap  = f->fmt == RKNN_PACK_BGR888;
+  const uint8_t*         rgb   = job.pixels + (size_t)y * job.src_stride;
+  size_t                 eb    = job.elem_bytes;
+  uint8_t*               row   = job.dst + y * job.row_stride * eb;
+  if (f->fmt == RKNN_PACK_NV12) {
+    nv12_row_to_rgb(rgb, job.uv + (size_t)(y / 2) * job.src_stride, f->width, job.rgb_buf);
+    rgb = job.rgb_buf;
+  }
+
+  if (job.pad_begin < job.row_stride) {
+    for (uint32_t b = 0; b < job.blocks; b++) {
+      memset(row + (b * job.block_stride + job.pad_begin) * eb, 0, (job.row_stride - job.pad_begin) * eb);
+    }
+  }
+
+  if (lut->kind == PACK_8BIT && lut->shift && job.blocks == 1 && job.pixel_stride == 3) {
+    shift_row(rgb, swap, f->width, lut->k, row);
+  } else if (lut->kind == PACK_8BIT) {
+    lut_row<uint8_t>(rgb, swap, f->width, lut->u8, job.chan_off, job.pixel_stride, row);
+  } else if (lut->kind == PACK_FP16) {
+    lut_row<uint16_t>(rgb, swap, f->width, lut->f16, job.chan_off, job.pixel_stride, (uint16_t*)row);
+  } else {
+    lut_row<float>(rgb, swap, f->width, lut->f32, job.chan_off, job.pixel_stride, (float*)row);
+  }
+}
+
+static void pack_rows(const PackJob* job)
+{
+  for (uint32_t y = job->row_begin; y < job->row_end; y++) {
+    pack_row(*job, y);
+  }
+}
+
+/*-------------------------------------------
+                 Worker pool
+-------------------------------------------*/
+/*
+  the workers of a packer are started with it and wait for a new generation, jobs[0] is run by the caller and
+  jobs[i] by worker i. rgb_buf[i] is the scratch row of thread i, grown by the caller before a frame is handed out.
+*/
+struct PackWorker
+{
+  rknn_packer* packer;
+  int          index;
+};
+
+struct _rknn_packer
+{
+  pthread_mutex_t owner; // held by the call packing a frame
+  pthread_mutex_t mutex;
+  pthread_cond_t  work_cond;
+  pthread_cond_t  done_cond;
+  int             threads; // the caller and the workers started
+  uint64_t        generation; // bumped for every frame and for the exit, workers wait for a new one
+  bool            quit;
+  PackJob         jobs[PACK_MAX_THREADS];
+  int             active;
+  int             pending;
+  pthread_t       thread[PACK_MAX_THREADS];
+  PackWorker      worker[PACK_MAX_THREADS];
+  uint8_t*        rgb_buf[PACK_MAX_THREADS];
+  size_t          rgb_size[PACK_MAX_THREADS];
+};
+
+static void* pack_worker(void* arg)
+{
+  PackWorker*  w      = (PackWorker*)arg;
+  rknn_packer* packer = w->packer;
+  pthread_mutex_lock(&packer->mutex);
+  // started by rknn_packer_create(), before any frame
+  uint64_t seen = 0;
+  for (;;) {
+    while (packer->generation == seen) {
+      pthread_cond_wait(&packer->work_cond, &packer->mutex);
+    }
+    seen = packer->generation;
+    if (packer->quit) {
+      break;
+    }
+    if (w->index < packer->active) {
+      const PackJob* job = &packer->jobs[w->index];
+      pthread_mutex_unlock(&packer->mutex);
+      pack_rows(job);
+      pthread_mutex_lock(&packer->mutex);
+      if (--packer->pending == 0) {
+        pthread_cond_signal(&packer->done_cond);
+      }
+    }
+  }
+  pthread_mutex_unlock(&packer->mutex);
+  return NULL;
+}
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+int rknn_packer_create(int num_threads, rknn_packer** packer)
+{
+  if (packer == NULL) {
+    printf("rknn_packer_create: invalid param\n");
+    return -1;
+  }
+  rknn_packer* p = (rknn_packer*)calloc(1, sizeof(rknn_packer));
+  if (p == NULL) {
+    printf("rknn_packer_create: out of memory\n");
+    return -1;
+  }
+  pthread_mutex_init(&p->owner, NULL);
+  pthread_mutex_init(&p->mutex, NULL);
+  pthread_cond_init(&p->work_cond, NULL);
+  pthread_cond_init(&p->done_cond, NULL);
+  if (num_threads > PACK_MAX_THREADS) {
+    num_threads = PACK_MAX_THREADS;
+  }
+  // a worker that cannot be started leaves its rows to the others
+  p->threads = 1;
+  while (p->threads < num_threads) {
+    p->worker[p->threads].packer = p;
+    p->worker[p->threads].index  = p->threads;
+    if (pthread_create(&p->thread[p->threads], NULL, pack_worker, &p->worker[p->threads]) != 0) {
+      break;
+    }
+    p->threads++;
+  }
+  *packer = p;
+  return 0;
+}
+
+void rknn_packer_destroy(rknn_packer* packer)
+{
+  if (packer == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&packer->mutex);
+  packer->quit = true;
+  packer->generation++;
+  pthread_cond_broadcast(&packer->work_cond);
+  pthread_mutex_unlock(&packer->mutex);
+  for (int t = 1; t < packer->threads; t++) {
+    pthread_join(packer->thread[t], NULL);
+  }
+  for (int t = 0; t < PACK_MAX_THREADS; t++) {
+    free(packer->rgb_buf[t]);
+  }
+  pthread_cond_destroy(&packer->done_cond);
+  pthread_cond_destroy(&packer->work_cond);
+  pthread_mutex_destroy(&packer->mutex);
+  pthread_mutex_destroy(&packer->owner);
+  free(packer);
+}
+
+int rknn_pack_input(rknn_packer* packer, const rknn_tensor_attr* attr, const rknn_pack_frame* frame, const float* mean,
+                    const float* std, rknn_tensor_mem* mem)
+{
+  if (packer == NULL || attr == NULL || frame == NULL || frame->data == NULL || mem == NULL || mem->virt_addr == NULL) {
+    printf("rknn_pack_input: invalid param\n");
+    return -1;
+  }
+
+  PackJob job;
+  memset(&job, 0, sizeof(job));
+  uint32_t n, h, w, ws;
+  if (attr->fmt == RKNN_TENSOR_NHWC && attr->n_dims == 4 && attr->dims[3] >= 3) {
+    n                = attr->dims[0];
+    h                = attr->dims[1];
+    w                = attr->dims[2];
+    ws               = attr->w_stride > w ? attr->w_stride : w;
+    job.blocks       = 1;
+    job.pixel_stride = attr->dims[3];
+    job.row_stride   = (size_t)ws * attr->dims[3];
+    job.block_stride = h * job.row_stride;
+    for (int c = 0; c < 3; c++) {
+      job.chan_off[c] = c;
+    }
+  } else if (attr->fmt == RKNN_TENSOR_NC1HWC2 && attr->n_dims == 5 && attr->dims[1] * attr->dims[4] >= 3) {
+    uint32_t c2      = attr->dims[4];
+    n                = attr->dims[0];
+    h                = attr->dims[2];
+    w                = attr->dims[3];
+    ws               = attr->w_stride > w ? attr->w_stride : w;
+    job.blocks       = attr->dims[1];
+    job.pixel_stride = c2;
+    job.row_stride   = (size_t)ws * c2;
+    job.block_stride = h * job.row_stride;
+    for (int c = 0; c < 3; c++) {
+      job.chan_off[c] = (c / c2) * job.block_stride + c % c2;
+    }
+  } else {
+    printf("rknn_pack_input: %s input %s with %u dims is not supported\n", get_format_string(attr->fmt), attr->name,
+           attr->n_dims);
+    return -1;
+  }
+  if (n != 1 || frame->width != w || frame->height != h) {
+    printf("rknn_pack_input: frame %ux%u does not match input %s %ux%u batch %u\n", frame->width, frame->height,
+           attr->name, w, h, n);
+    return -1;
+  }
+
+  PackLut lut;
+  if (build_lut(attr, mean, std, &lut) != 0) {
+    return -1;
+  }
+  job.elem_bytes = lut.kind == PACK_8BIT ? 1 : (lut.kind == PACK_FP16 ? 2 : 4);
+
+  size_t need = job.blocks * job.block_stride * job.elem_bytes;
+  if (need > mem->size || (attr->size_with_stride != 0 && need > attr->size_with_stride)) {
+    printf("rknn_pack_input: input %s needs %zu bytes, mem has %u\n", attr->name, need, mem->size);
+    return -1;
+  }
+
+  uint32_t min_stride = frame->fmt == RKNN_PACK_NV12 ? frame->width : frame->width * 3;
+  job.src_stride      = frame->stride ? frame->stride : min_stride;
+  if (job.src_stride < min_stride || frame->fmt > RKNN_PACK_NV12) {
+    printf("rknn_pack_input: bad frame format %d or stride %u\n", frame->fmt, frame->stride);
+    return -1;
+  }
+  job.frame  = frame;
+  job.lut    = &lut;
+  job.pixels = (const uint8_t*)frame->data;
+  job.uv     = frame->uv ? (const uint8_t*)frame->uv : job.pixels + (size_t)job.src_stride * h;
+  job.dst    = (uint8_t*)mem->virt_addr;
+  // packed RGB rows only have the w_stride tail to clear, the other layouts have padding channels in every pixel
+  job.pad_begin = job.blocks == 1 && job.pixel_stride == 3 ? (size_t)w * 3 : 0;
+
+  // split the rows, the calling thread takes the first part
+  int parts = packer->threads < (int)h ? packer->threads : (int)h;
+  pthread_mutex_lock(&packer->owner);
+  if (frame->fmt == RKNN_PACK_NV12) {
+    size_t row_size = (size_t)frame->width * 3;
+    for (int t = 0; t < parts; t++) {
+      if (packer->rgb_size[t] < row_size) {
+        uint8_t* buf = (uint8_t*)realloc(packer->rgb_buf[t], row_size);
+        if (buf == NULL) {
+          pthread_mutex_unlock(&packer->owner);
+          printf("rknn_pack_input: out of memory\n");
+          return -1;
+        }
+        packer->rgb_buf[t]  = buf;
+        packer->rgb_size[t] = row_size;
+      }
+    }
+  }
+  for (int t = 0; t < parts; t++) {
+    packer->jobs[t]           = job;
+    packer->jobs[t].row_begin = (uint32_t)((uint64_t)h * t / parts);
+    packer->jobs[t].row_end   = (uint32_t)((uint64_t)h * (t + 1) / parts);
+    packer->jobs[t].rgb_buf   = packer->rgb_buf[t];
+  }
+  if (parts <= 1) {
+    pack_rows(&packer->jobs[0]);
+    pthread_mutex_unlock(&packer->owner);
+    return 0;
+  }
+
+  pthread_mutex_lock(&packer->mutex);
+  packer->active  = parts;
+  packer->pending = parts - 1;
+  packer->generation++;
+  pthread_cond_broadcast(&packer->work_cond);
+  pthread_mutex_unlock(&packer->mutex);
+
+  pack_rows(&packer->jobs[0]);
+
+  pthread_mutex_lock(&packer->mutex);
+  while (packer->pending > 0) {
+    pthread_cond_wait(&packer->done_cond, &packer->mutex);
+  }
+  pthread_mutex_unlock(&packer->mutex);
+  pthread_mutex_unlock(&packer->owner);
+  return 0;
+}
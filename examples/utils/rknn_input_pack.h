@@ -0,0 +1,64 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_UTILS_INPUT_PACK_H_
+#define _RKNN_UTILS_INPUT_PACK_H_
+
+#include <stdint.h>
+
+#include "rknn_api.h"
+
+/*
+  writes a camera frame straight into the native input tensor of a model, for memory bound with rknn_set_io_mem()
+  in pass through mode: the runtime then does no conversion of its own.
+  color conversion (NV12, BGR), mean / std normalization and quantization to the input type are done in the same
+  pass as the copy into the NHWC / NC1HWC2 layout with its w_stride padding.
+*/
+
+typedef enum _rknn_pack_pixel_format
+{
+  RKNN_PACK_RGB888 = 0,
+  RKNN_PACK_BGR888,
+  RKNN_PACK_NV12, // Y plane, then interleaved U / V at half resolution, BT.601 limited range
+} rknn_pack_pixel_format;
+
+typedef struct _rknn_pack_frame
+{
+  rknn_pack_pixel_format fmt;
+  uint32_t               width; // must be the W / H of the input, resize (e.g. with RGA) before packing
+  uint32_t               height;
+  uint32_t               stride; // bytes per row of data and of uv, 0: width * 3 for RGB888 / BGR888, width for NV12
+  const void*            data;   // pixels, or the Y plane of NV12
+  const void*            uv;     // UV plane of NV12, NULL: right after the Y plane
+} rknn_pack_frame;
+
+/* packs frames with num_threads threads (1 to 16): the caller and num_threads - 1 workers started here and kept
+   until rknn_packer_destroy(), each with its own scratch row for NV12, so that packing a frame starts no thread and
+   allocates nothing once the rows are sized. a packer packs one frame at a time, calls from several threads on the
+   same packer wait for each other. returns 0 or -1. */
+typedef struct _rknn_packer rknn_packer;
+
+int  rknn_packer_create(int num_threads, rknn_packer** packer);
+void rknn_packer_destroy(rknn_packer* packer);
+
+/* attr is the native input attr (RKNN_QUERY_NATIVE_INPUT_ATTR), NHWC or NC1HWC2 with 3 or more channels, batch 1.
+   channels 0, 1, 2 of the tensor get R, G, B (a BGR888 frame is swapped, pass an RGB frame as BGR888 for a model
+   taking BGR), the other channels and the w_stride padding are set to 0.
+   mean / std are per tensor channel, as the mean_values / std_values of the model config, NULL for 0 / 1.
+   the values are then quantized with the zp / scale (or fl) of attr for int8 / uint8 inputs.
+   set attr->pass_through = 1 before binding mem with rknn_set_io_mem(). returns 0 or -1. */
+int rknn_pack_input(rknn_packer* packer, const rknn_tensor_attr* attr, const rknn_pack_frame* frame, const float* mean,
+                    const float* std, rknn_tensor_mem* mem);
+
+#endif //_RKNN_UTILS_INPUT_PACK_H_
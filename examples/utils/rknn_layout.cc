@@ -0,0 +1,564 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rknn_layout.h"
+#include "rknn_fp16.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define LAYOUT_MAX_THREADS 16
+
+// pixels x channels of one transpose tile
+#define LAYOUT_TILE 16
+
+static uint32_t type_bytes(rknn_tensor_type type)
+{
+  switch (type) {
+  case RKNN_TENSOR_INT8:
+  case RKNN_TENSOR_UINT8:
+    return 1;
+  case RKNN_TENSOR_FLOAT16:
+    return 2;
+  case RKNN_TENSOR_FLOAT32:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+/*-------------------------------------------
+                  Geometry
+-------------------------------------------*/
+/*
+  all three layouts address channel c of pixel p = y * w + x of one image as
+    (c / block) * block_stride + c % block + p * pixel_stride
+  NCHW: block 1, block_stride h * w, pixel_stride 1
+  NHWC: one block of c_align channels, pixel_stride c_align
+  NC1HWC2: block C2, block_stride h * w * C2, pixel_stride C2
+*/
+struct LayoutGeom
+{
+  uint32_t block;
+  size_t   block_stride;
+  size_t   pixel_stride;
+  size_t   image;
+  uint32_t c_padded; // channels including the alignment
+  bool     channel_major;
+};
+
+static void layout_geom(const rknn_layout* l, LayoutGeom* g)
+{
+  size_t hw = (size_t)l->h * l->w;
+  if (l->fmt == RKNN_TENSOR_NCHW) {
+    g->block         = 1;
+    g->block_stride  = hw;
+    g->pixel_stride  = 1;
+    g->c_padded      = l->c;
+    g->channel_major = true;
+  } else if (l->fmt == RKNN_TENSOR_NHWC) {
+    uint32_t ca      = l->c_align ? l->c_align : l->c;
+    g->block         = ca;
+    g->block_stride  = 0;
+    g->pixel_stride  = ca;
+    g->c_padded      = ca;
+    g->channel_major = false;
+  } else {
+    uint32_t c2      = l->c_align ? l->c_align : rknn_layout_default_c2(l->type);
+    g->block         = c2;
+    g->block_stride  = hw * c2;
+    g->pixel_stride  = c2;
+    g->c_padded      = (l->c + c2 - 1) / c2 * c2;
+    g->channel_major = false;
+  }
+  g->image = (size_t)g->c_padded * hw;
+}
+
+static inline size_t geom_offset(const LayoutGeom& g, uint32_t c, size_t p)
+{
+  return (c / g.block) * g.block_stride + c % g.block + p * g.pixel_stride;
+}
+
+/*-------------------------------------------
+              Element conversion
+-------------------------------------------*/
+enum
+{
+  CONVERT_COPY = 0,
+  CONVERT_I8_F32,
+  CONVERT_U8_F32,
+  CONVERT_F16_F32,
+};
+
+static void convert_i8_f32(const int8_t* src, float* dst, uint32_t len, float zp, float scale)
+{
+  uint32_t i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  float32x4_t vzp    = vdupq_n_f32(zp);
+  float32x4_t vscale = vdupq_n_f32(scale);
+  for (; i + 16 <= len; i += 16) {
+    int8x16_t v  = vld1q_s8(src + i);
+    int16x8_t lo = vmovl_s8(vget_low_s8(v));
+    int16x8_t hi = vmovl_s8(vget_high_s8(v));
+    vst1q_f32(dst + i, vmulq_f32(vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))), vzp), vscale));
+    vst1q_f32(dst + i + 4, vmulq_f32(vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo))), vzp), vscale));
+    vst1q_f32(dst + i + 8, vmulq_f32(vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))), vzp), vscale));
+    vst1q_f32(dst + i + 12, vmulq_f32(vsubq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi))), vzp), vscale));
+  }
+#elif defined(__SSE2__)
+  __m128 vzp    = _mm_set1_ps(zp);
+  __m128 vscale = _mm_set1_ps(scale);
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    // sign extend by unpacking into the high byte and shifting back
+    __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+    __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+    __m128i q0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16);
+    __m128i q1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16);
+    __m128i q2 = _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16);
+    __m128i q3 = _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(q0), vzp), vscale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(q1), vzp), vscale));
+    _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(q2), vzp), vscale));
+    _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(q3), vzp), vscale));
+  }
+#endif
+  for (; i < len; i++) {
+    dst[i] = ((float)src[i] - zp) * scale;
+  }
+}
+
+static void convert_u8_f32(const uint8_t* src, float* dst, uint32_t len, float zp, float scale)
+{
+  uint32_t i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  float32x4_t vzp    = vdupq_n_f32(zp);
+  float32x4_t vscale = vdupq_n_f32(scale);
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t v  = vld1q_u8(src + i);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+    vst1q_f32(dst + i, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), vzp), vscale));
+    vst1q_f32(dst + i + 4, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), vzp), vscale));
+    vst1q_f32(dst + i + 8, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), vzp), vscale));
+    vst1q_f32(dst + i + 12, vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), vzp), vscale));
+  }
+#elif defined(__SSE2__)
+  __m128  vzp    = _mm_set1_ps(zp);
+  __m128  vscale = _mm_set1_ps(scale);
+  __m128i zero   = _mm_setzero_si128();
+  for (; i + 16 <= len; i += 16) {
+    __m128i v  = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), vzp), vscale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), vzp), vscale));
+    _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), vzp), vscale));
+    _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), vzp), vscale));
+  }
+#endif
+  for (; i < len; i++) {
+    dst[i] = ((float)src[i] - zp) * scale;
+  }
+}
+
+struct LayoutConverter
+{
+  int      kind;
+  uint32_t src_bytes;
+  uint32_t dst_bytes;
+  float    zp;
+  float    scale;
+
+  // len contiguous elements
+  inline void Run(const uint8_t* src, uint8_t* dst, uint32_t len) const
+  {
+    switch (kind) {
+    case CONVERT_I8_F32:
+      convert_i8_f32((const int8_t*)src, (float*)dst, len, zp, scale);
+      break;
+    case CONVERT_U8_F32:
+      convert_u8_f32(src, (float*)dst, len, zp, scale);
+      break;
+    case CONVERT_F16_F32:
+      rknn_convert_fp16_to_fp32((const uint16_t*)src, (float*)dst, len);
+      break;
+    default:
+      memcpy(dst, src, (size_t)len * src_bytes);
+      break;
+    }
+  }
+};
+
+/*-------------------------------------------
+                  Row kernels
+-------------------------------------------*/
+struct LayoutJob
+{
+  const rknn_layout* src;
+  const rknn_layout* dst;
+  LayoutGeom         sg;
+  LayoutGeom         dg;
+  LayoutConverter    conv;
+  const uint8_t*     src_data;
+  uint8_t*           dst_data;
+  uint32_t           row_begin;
+  uint32_t           row_end;
+};
+
+// scatter a tile of rows x cols elements, stored row by row, column by column
+template <typename T>
+static inline void tile_transpose(const uint8_t* tile, uint32_t rows, uint32_t cols, uint8_t* dst, size_t col_step,
+                                  size_t row_step)
+{
+  const T* t = (const T*)tile;
+  for (uint32_t c = 0; c < cols; c++) {
+    T* d = (T*)dst + c * col_step;
+    for (uint32_t r = 0; r < rows; r++) {
+      d[r * row_step] = t[r * cols + c];
+    }
+  }
+}
+
+static inline void tile_scatter(uint32_t bytes, const uint8_t* tile, uint32_t rows, uint32_t cols, uint8_t* dst,
+                                size_t col_step, size_t row_step)
+{
+  switch (bytes) {
+  case 1:
+    tile_transpose<uint8_t>(tile, rows, cols, dst, col_step, row_step);
+    break;
+  case 2:
+    tile_transpose<uint16_t>(tile, rows, cols, dst, col_step, row_step);
+    break;
+  default:
+    tile_transpose<uint32_t>(tile, rows, cols, dst, col_step, row_step);
+    break;
+  }
+}
+
+static void convert_row(const LayoutJob& job, uint32_t row)
+{
+  const LayoutGeom&      sg   = job.sg;
+  const LayoutGeom&      dg   = job.dg;
+  const LayoutConverter& conv = job.conv;
+  uint32_t               C    = job.src->c;
+  uint32_t               W    = job.src->w;
+  uint32_t               n    = row / job.src->h;
+  size_t                 p0   = (size_t)(row % job.src->h) * W;
+  const uint8_t*         src  = job.src_data + n * sg.image * conv.src_bytes;
+  uint8_t*               dst  = job.dst_data + n * dg.image * conv.dst_bytes;
+
+  if (sg.channel_major && dg.channel_major) {
+    // NCHW to NCHW: one run of pixels per channel
+    for (uint32_t c = 0; c < C; c++) {
+      conv.Run(src + geom_offset(sg, c, p0) * conv.src_bytes, dst + geom_offset(dg, c, p0) * conv.dst_bytes, W);
+    }
+    return;
+  }
+
+  if (!sg.channel_major && !dg.channel_major) {
+    // NHWC / NC1HWC2 to NHWC / NC1HWC2: runs of channels contiguous in both
+    for (uint32_t x = 0; x < W; x++) {
+      size_t   p = p0 + x;
+      uint32_t c = 0;
+      while (c < C) {
+        uint32_t len = C - c;
+        len          = sg.block - c % sg.block < len ? sg.block - c % sg.block : len;
+        len          = dg.block - c % dg.block < len ? dg.block - c % dg.block : len;
+        conv.Run(src + geom_offset(sg, c, p) * conv.src_bytes, dst + geom_offset(dg, c, p) * conv.dst_bytes, len);
+        c += len;
+      }
+      if (dg.c_padded > C) {
+        memset(dst + geom_offset(dg, C, p) * conv.dst_bytes, 0, (size_t)(dg.c_padded - C) * conv.dst_bytes);
+      }
+    }
+    return;
+  }
+
+  // transpose through tiles of LAYOUT_TILE pixels x LAYOUT_TILE channels, read and converted along the contiguous
+  // axis of src, written along the contiguous axis of dst
+  uint8_t tile[LAYOUT_TILE * LAYOUT_TILE * 4];
+  for (uint32_t x0 = 0; x0 < W; x0 += LAYOUT_TILE) {
+    uint32_t tw = W - x0 < LAYOUT_TILE ? W - x0 : LAYOUT_TILE;
+    size_t   p  = p0 + x0;
+    uint32_t c  = 0;
+    while (c < C) {
+      if (sg.channel_major) {
+        // NCHW to NHWC / NC1HWC2: channel rows of tw pixels, scattered to pixel rows of tc channels
+        uint32_t tc = C - c < LAYOUT_TILE ? C - c : LAYOUT_TILE;
+        tc          = dg.block - c % dg.block < tc ? dg.block - c % dg.block : tc;
+        for (uint32_t k = 0; k < tc; k++) {
+          conv.Run(src + geom_offset(sg, c + k, p) * conv.src_bytes, tile + k * tw * conv.dst_bytes, tw);
+        }
+        tile_scatter(conv.dst_bytes, tile, tc, tw, dst + geom_offset(dg, c, p) * conv.dst_bytes, dg.pixel_stride, 1);
+        c += tc;
+      } else {
+        // NHWC / NC1HWC2 to NCHW: pixel rows of tc channels, scattered to channel rows of tw pixels
+        uint32_t tc = C - c < LAYOUT_TILE ? C - c : LAYOUT_TILE;
+        tc          = sg.block - c % sg.block < tc ? sg.block - c % sg.block : tc;
+        for (uint32_t t = 0; t < tw; t++) {
+          conv.Run(src + geom_offset(sg, c, p + t) * conv.src_bytes, tile + t * tc * conv.dst_bytes, tc);
+        }
+        tile_scatter(conv.dst_bytes, tile, tw, tc, dst + geom_offset(dg, c, p) * conv.dst_bytes, dg.block_stride, 1);
+        c += tc;
+      }
+    }
+    if (!dg.channel_major && dg.c_padded > C) {
+      for (uint32_t t = 0; t < tw; t++) {
+        memset(dst + geom_offset(dg, C, p + t) * conv.dst_bytes, 0, (size_t)(dg.c_padded - C) * conv.dst_bytes);
+      }
+    }
+  }
+}
+
+static void convert_rows(const LayoutJob* job)
+{
+  for (uint32_t row = job->row_begin; row < job->row_end; row++) {
+    convert_row(*job, row);
+  }
+}
+
+/*-------------------------------------------
+                 Worker pool
+-------------------------------------------*/
+/*
+  workers started by the first call that asks for them and kept until the process exits, so that a call per output
+  per frame does not pay for pthread_create / join. one call uses them at a time, a call finding them busy converts
+  on its own thread.
+*/
+struct LayoutPool
+{
+  pthread_mutex_t owner; // held by the call using the workers
+  pthread_mutex_t mutex;
+  pthread_cond_t  work_cond;
+  pthread_cond_t  done_cond;
+  int             workers;
+  uint64_t        generation; // bumped for every call, workers wait for a new one
+  uint64_t        start_generation[LAYOUT_MAX_THREADS]; // the generation worker i was started in
+  LayoutJob*      jobs;       // jobs[0] is run by the caller, jobs[i] by worker i
+  int             active;
+  int             pending;
+};
+
+static LayoutPool g_pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                            PTHREAD_COND_INITIALIZER, 0, 0, {0}, NULL, 0, 0};
+
+static void* pool_worker(void* arg)
+{
+  int         index = (int)(intptr_t)arg;
+  LayoutPool* pool  = &g_pool;
+  pthread_mutex_lock(&pool->mutex);
+  // not the current generation, the thread may start after the call that created it has bumped it
+  uint64_t seen = pool->start_generation[index];
+  for (;;) {
+    while (pool->generation == seen) {
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    }
+    seen = pool->generation;
+    if (index < pool->active) {
+      const LayoutJob* job = &pool->jobs[index];
+      pthread_mutex_unlock(&pool->mutex);
+      convert_rows(job);
+      pthread_mutex_lock(&pool->mutex);
+      if (--pool->pending == 0) {
+        pthread_cond_signal(&pool->done_cond);
+      }
+    }
+  }
+  return NULL;
+}
+
+// called with pool->owner held, returns the workers available, up to wanted
+static int pool_reserve(LayoutPool* pool, int wanted)
+{
+  while (pool->workers < wanted) {
+    pthread_t thread;
+    pthread_mutex_lock(&pool->mutex);
+    pool->start_generation[pool->workers + 1] = pool->generation;
+    int ret = pthread_create(&thread, NULL, pool_worker, (void*)(intptr_t)(pool->workers + 1));
+    if (ret == 0) {
+      pthread_detach(thread);
+      pool->workers++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    if (ret != 0) {
+      break;
+    }
+  }
+  return pool->workers < wanted ? pool->workers : wanted;
+}
+
+static void split_rows(const LayoutJob& job, uint32_t rows, int parts, LayoutJob* jobs)
+{
+  for (int t = 0; t < parts; t++) {
+    jobs[t]           = job;
+    jobs[t].row_begin = (uint32_t)((uint64_t)rows * t / parts);
+    jobs[t].row_end   = (uint32_t)((uint64_t)rows * (t + 1) / parts);
+  }
+}
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+uint32_t rknn_layout_default_c2(rknn_tensor_type type)
+{
+  uint32_t bytes = type_bytes(type);
+  return bytes ? 16 / bytes : 0;
+}
+
+int rknn_layout_from_attr(const rknn_tensor_attr* attr, uint32_t channels, rknn_layout* layout)
+{
+  memset(layout, 0, sizeof(rknn_layout));
+  layout->type  = attr->type;
+  layout->scale = 1.f;
+  if (attr->qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC) {
+    layout->zp    = attr->zp;
+    layout->scale = attr->scale;
+  } else if (attr->qnt_type == RKNN_TENSOR_QNT_DFP) {
+    layout->scale = ldexpf(1.f, -attr->fl);
+  }
+
+  uint32_t capacity;
+  if (attr->fmt == RKNN_TENSOR_NHWC && attr->n_dims == 4) {
+    if (attr->w_stride != 0 && attr->w_stride != attr->dims[2]) {
+      printf("rknn_layout_from_attr: %s has a w_stride, not supported\n", attr->name);
+      return -1;
+    }
+    layout->fmt     = RKNN_TENSOR_NHWC;
+    layout->n       = attr->dims[0];
+    layout->h       = attr->dims[1];
+    layout->w       = attr->dims[2];
+    layout->c_align = attr->dims[3];
+    capacity        = attr->dims[3];
+  } else if (attr->fmt == RKNN_TENSOR_NC1HWC2 && attr->n_dims == 5) {
+    layout->fmt     = RKNN_TENSOR_NC1HWC2;
+    layout->n       = attr->dims[0];
+    layout->h       = attr->dims[2];
+    layout->w       = attr->dims[3];
+    layout->c_align = attr->dims[4];
+    capacity        = attr->dims[1] * attr->dims[4];
+  } else {
+    // NCHW, and the rest as N, C, H, W with the missing dims set to 1
+    layout->fmt = RKNN_TENSOR_NCHW;
+    layout->n   = attr->n_dims > 1 ? attr->dims[0] : 1;
+    capacity    = attr->n_dims > 1 ? attr->dims[1] : attr->n_elems;
+    layout->h   = attr->n_dims > 2 ? attr->dims[2] : 1;
+    layout->w   = attr->n_dims > 3 ? attr->dims[3] : 1;
+  }
+  layout->c = channels ? channels : capacity;
+  if (layout->c > capacity || type_bytes(layout->type) == 0) {
+    printf("rknn_layout_from_attr: %s with %u channels, type %s, not supported\n", attr->name, layout->c,
+           get_type_string(attr->type));
+    return -1;
+  }
+  return 0;
+}
+
+uint32_t rknn_layout_size(const rknn_layout* layout)
+{
+  LayoutGeom g;
+  layout_geom(layout, &g);
+  return (uint32_t)(layout->n * g.image * type_bytes(layout->type));
+}
+
+int rknn_convert_layout(const rknn_layout* src, const void* src_data, const rknn_layout* dst, void* dst_data,
+                        int num_threads)
+{
+  if (src->n != dst->n || src->c != dst->c || src->h != dst->h || src->w != dst->w) {
+    printf("rknn_convert_layout: shape mismatch\n");
+    return -1;
+  }
+  const rknn_layout* layouts[2] = {src, dst};
+  for (int i = 0; i < 2; i++) {
+    const rknn_layout* l = layouts[i];
+    if ((l->fmt != RKNN_TENSOR_NCHW && l->fmt != RKNN_TENSOR_NHWC && l->fmt != RKNN_TENSOR_NC1HWC2) ||
+        type_bytes(l->type) == 0 || (l->fmt == RKNN_TENSOR_NHWC && l->c_align != 0 && l->c_align < l->c) ||
+        (l->fmt == RKNN_TENSOR_NC1HWC2 && rknn_layout_default_c2(l->type) == 0)) {
+      printf("rknn_convert_layout: unsupported %s layout %s / %s\n", i == 0 ? "src" : "dst",
+             get_format_string(l->fmt), get_type_string(l->type));
+      return -1;
+    }
+  }
+
+  LayoutJob job;
+  job.src      = src;
+  job.dst      = dst;
+  job.src_data = (const uint8_t*)src_data;
+  job.dst_data = (uint8_t*)dst_data;
+  layout_geom(src, &job.sg);
+  layout_geom(dst, &job.dg);
+  job.conv.src_bytes = type_bytes(src->type);
+  job.conv.dst_bytes = type_bytes(dst->type);
+  job.conv.zp        = (float)src->zp;
+  job.conv.scale     = src->scale;
+  if (src->type == dst->type) {
+    job.conv.kind = CONVERT_COPY;
+  } else if (dst->type == RKNN_TENSOR_FLOAT32 && src->type == RKNN_TENSOR_INT8) {
+    job.conv.kind = CONVERT_I8_F32;
+  } else if (dst->type == RKNN_TENSOR_FLOAT32 && src->type == RKNN_TENSOR_UINT8) {
+    job.conv.kind = CONVERT_U8_F32;
+  } else if (dst->type == RKNN_TENSOR_FLOAT32 && src->type == RKNN_TENSOR_FLOAT16) {
+    job.conv.kind = CONVERT_F16_F32;
+  } else {
+    printf("rknn_convert_layout: %s to %s is not supported\n", get_type_string(src->type),
+           get_type_string(dst->type));
+    return -1;
+  }
+
+  // split the rows, the calling thread takes the first part
+  uint32_t rows = src->n * src->h;
+  if (num_threads > LAYOUT_MAX_THREADS) {
+    num_threads = LAYOUT_MAX_THREADS;
+  }
+  if (num_threads > (int)rows) {
+    num_threads = (int)rows;
+  }
+  LayoutPool* pool = &g_pool;
+  if (num_threads <= 1 || pthread_mutex_trylock(&pool->owner) != 0) {
+    job.row_begin = 0;
+    job.row_end   = rows;
+    convert_rows(&job);
+    return 0;
+  }
+
+  LayoutJob jobs[LAYOUT_MAX_THREADS];
+  int       parts = pool_reserve(pool, num_threads - 1) + 1;
+  split_rows(job, rows, parts, jobs);
+  pthread_mutex_lock(&pool->mutex);
+  pool->jobs    = jobs;
+  pool->active  = parts;
+  pool->pending = parts - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  convert_rows(&jobs[0]);
+
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->pending > 0) {
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+  pool->jobs = NULL;
+  pthread_mutex_unlock(&pool->mutex);
+  pthread_mutex_unlock(&pool->owner);
+  return 0;
+}
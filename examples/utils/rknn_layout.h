@@ -0,0 +1,59 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_UTILS_LAYOUT_H_
+#define _RKNN_UTILS_LAYOUT_H_
+
+#include <stdint.h>
+
+#include "rknn_api.h"
+
+/*
+  layout conversion between NCHW, NHWC and NC1HWC2 for int8 / uint8 / fp16 / fp32 tensors, e.g. to read native
+  outputs bound with rknn_set_io_mem() in the layout of the post-process.
+  converting int8 / uint8 / fp16 to fp32 dequantizes (int8 / uint8 with zp / scale) in the same pass, with NEON
+  kernels. the N * H rows are split over num_threads threads: the calling one and workers kept between calls.
+*/
+
+typedef struct _rknn_layout
+{
+  rknn_tensor_format fmt;  // RKNN_TENSOR_NCHW, RKNN_TENSOR_NHWC or RKNN_TENSOR_NC1HWC2
+  rknn_tensor_type   type; // RKNN_TENSOR_INT8, RKNN_TENSOR_UINT8, RKNN_TENSOR_FLOAT16 or RKNN_TENSOR_FLOAT32
+  uint32_t           n;    // logical shape, c is the real channel count
+  uint32_t           c;
+  uint32_t           h;
+  uint32_t           w;
+  uint32_t           c_align; // NHWC: channel stride (>= c), NC1HWC2: C2. 0 takes c / rknn_layout_default_c2()
+  int32_t            zp;      // quantization of int8 / uint8, used when converting to fp32
+  float              scale;
+} rknn_layout;
+
+// C2 of NC1HWC2 tensors of this type on RK3562 / RK356X / RK3588 / RV1106: one 16 byte block
+uint32_t rknn_layout_default_c2(rknn_tensor_type type);
+
+/* describe the tensor of attr (normal or native attr). native NHWC / NC1HWC2 tensors have their channels aligned,
+   channels is the real channel count (dims[1] of the normal attr), 0 takes it from attr. returns 0 or -1. */
+int rknn_layout_from_attr(const rknn_tensor_attr* attr, uint32_t channels, rknn_layout* layout);
+
+// bytes of a tensor in this layout
+uint32_t rknn_layout_size(const rknn_layout* layout);
+
+/* convert src_data into dst_data, the shapes must match. dst->type is src->type (only the layout changes), or
+   RKNN_TENSOR_FLOAT32 to dequantize int8 / uint8 / fp16 sources. aligned channels of an NHWC / NC1HWC2 dst are
+   set to 0. num_threads <= 1 runs on the calling thread, as does a call made while another one uses the workers.
+   returns 0 or -1. */
+int rknn_convert_layout(const rknn_layout* src, const void* src_data, const rknn_layout* dst, void* dst_data,
+                        int num_threads);
+
+#endif //_RKNN_UTILS_LAYOUT_H_
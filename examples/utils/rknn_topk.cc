@@ -0,0 +1,336 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rknn_topk.h"
+#include "rknn_fp16.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TOPK_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TOPK_SIMD 1
+#endif
+
+/*-------------------------------------------
+                  Element types
+-------------------------------------------*/
+/*
+  every element type maps to a key with the order of its value: int8 as is, uint8 with the sign bit flipped, fp16
+  sign-magnitude bits to two's complement. keys are compared without dequantizing and mapped back for the winners.
+  AnyGE() tells whether one 16 byte block has a key >= thres, the blocks without are skipped.
+*/
+struct TopKElemI8
+{
+  typedef int8_t Type;
+  typedef int8_t Key;
+  enum { LANES = 16 };
+
+  static inline Key ToKey(Type v) { return v; }
+  static inline float Value(Key k) { return (float)k; }
+#ifdef TOPK_SIMD
+  static inline bool AnyGE(const Type* p, Key thres)
+  {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16_t ge = vcgeq_s8(vld1q_s8(p), vdupq_n_s8(thres));
+    uint8x8_t  m  = vorr_u8(vget_low_u8(ge), vget_high_u8(ge));
+    return vget_lane_u64(vreinterpret_u64_u8(m), 0) != 0;
+#else
+    __m128i lt = _mm_cmpgt_epi8(_mm_set1_epi8(thres), _mm_loadu_si128((const __m128i*)p));
+    return _mm_movemask_epi8(lt) != 0xffff;
+#endif
+  }
+#endif
+};
+
+struct TopKElemU8
+{
+  typedef uint8_t Type;
+  typedef int8_t  Key;
+  enum { LANES = 16 };
+
+  static inline Key ToKey(Type v) { return (int8_t)(v ^ 0x80); }
+  static inline float Value(Key k) { return (float)(uint8_t)(k ^ 0x80); }
+#ifdef TOPK_SIMD
+  static inline bool AnyGE(const Type* p, Key thres)
+  {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16_t ge = vcgeq_u8(vld1q_u8(p), vdupq_n_u8((uint8_t)(thres ^ 0x80)));
+    uint8x8_t  m  = vorr_u8(vget_low_u8(ge), vget_high_u8(ge));
+    return vget_lane_u64(vreinterpret_u64_u8(m), 0) != 0;
+#else
+    __m128i v  = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8((char)0x80));
+    __m128i lt = _mm_cmpgt_epi8(_mm_set1_epi8(thres), v);
+    return _mm_movemask_epi8(lt) != 0xffff;
+#endif
+  }
+#endif
+};
+
+struct TopKElemF16
+{
+  typedef uint16_t Type;
+  typedef int16_t  Key;
+  enum { LANES = 8 };
+
+  // the mapping is its own inverse
+  static inline Key ToKey(Type v)
+  {
+    int16_t s = (int16_t)v;
+    return s ^ ((s >> 15) & 0x7fff);
+  }
+  static inline float Value(Key k)
+  {
+    return rknn_fp16_to_fp32((uint16_t)ToKey((uint16_t)k));
+  }
+#ifdef TOPK_SIMD
+  static inline bool AnyGE(const Type* p, Key thres)
+  {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    int16x8_t  s  = vreinterpretq_s16_u16(vld1q_u16(p));
+    int16x8_t  k  = veorq_s16(s, vandq_s16(vshrq_n_s16(s, 15), vdupq_n_s16(0x7fff)));
+    uint16x8_t ge = vcgeq_s16(k, vdupq_n_s16(thres));
+    uint16x4_t m  = vorr_u16(vget_low_u16(ge), vget_high_u16(ge));
+    return vget_lane_u64(vreinterpret_u64_u16(m), 0) != 0;
+#else
+    __m128i s  = _mm_loadu_si128((const __m128i*)p);
+    __m128i k  = _mm_xor_si128(s, _mm_and_si128(_mm_srai_epi16(s, 15), _mm_set1_epi16(0x7fff)));
+    __m128i lt = _mm_cmpgt_epi16(_mm_set1_epi16(thres), k);
+    return _mm_movemask_epi8(lt) != 0xffff;
+#endif
+  }
+#endif
+};
+
+struct TopKElemF32
+{
+  typedef float Type;
+  typedef float Key;
+  enum { LANES = 4 };
+
+  static inline Key ToKey(Type v) { return v; }
+  static inline float Value(Key k) { return k; }
+#ifdef TOPK_SIMD
+  static inline bool AnyGE(const Type* p, Key thres)
+  {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint32x4_t ge = vcgeq_f32(vld1q_f32(p), vdupq_n_f32(thres));
+    uint32x2_t m  = vorr_u32(vget_low_u32(ge), vget_high_u32(ge));
+    return vget_lane_u64(vreinterpret_u64_u32(m), 0) != 0;
+#else
+    return _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(p), _mm_set1_ps(thres))) != 0;
+#endif
+  }
+#endif
+};
+
+/*-------------------------------------------
+                  Top-K list
+-------------------------------------------*/
+// sorted best first, insertion is cheap for the small K of classification
+template <typename Key>
+struct TopKList
+{
+  Key      keys[RKNN_TOPK_MAX];
+  uint32_t indices[RKNN_TOPK_MAX];
+  uint32_t k;
+  uint32_t n;
+
+  inline bool Full() const { return n == k; }
+  inline Key  Last() const { return keys[n - 1]; }
+
+  inline void Offer(Key key, uint32_t index)
+  {
+    if (key != key) {
+      return; // NaN
+    }
+    if (n == k && (key < keys[n - 1] || (key == keys[n - 1] && index > indices[n - 1]))) {
+      return;
+    }
+    uint32_t p = n < k ? n++ : n - 1;
+    while (p > 0 && (keys[p - 1] < key || (keys[p - 1] == key && indices[p - 1] > index))) {
+      keys[p]    = keys[p - 1];
+      indices[p] = indices[p - 1];
+      p--;
+    }
+    keys[p]    = key;
+    indices[p] = index;
+  }
+};
+
+/* offer len elements, element i has the class index + i * step.
+   once the list is full, only the blocks holding a key >= its last one are looked at. */
+template <typename Elem>
+static void topk_scan(const typename Elem::Type* p, uint32_t len, uint32_t index, uint32_t step,
+                      TopKList<typename Elem::Key>* list)
+{
+  uint32_t i = 0;
+#ifdef TOPK_SIMD
+  for (; i < len && !list->Full(); i++) {
+    list->Offer(Elem::ToKey(p[i]), index + i * step);
+  }
+  for (; i + Elem::LANES <= len; i += Elem::LANES) {
+    if (!Elem::AnyGE(p + i, list->Last())) {
+      continue;
+    }
+    for (uint32_t l = i; l < i + Elem::LANES; l++) {
+      list->Offer(Elem::ToKey(p[l]), index + l * step);
+    }
+  }
+#endif
+  for (; i < len; i++) {
+    list->Offer(Elem::ToKey(p[i]), index + i * step);
+  }
+}
+
+/* walk the first image of the tensor as contiguous runs of channels.
+   with H * W == 1, the usual case for classification, every supported layout is one run. */
+template <typename Elem>
+static int topk_tensor(const rknn_tensor_attr* attr, const void* data, uint32_t num_channels,
+                       TopKList<typename Elem::Key>* list)
+{
+  typedef typename Elem::Type T;
+  const T* p = (const T*)data;
+
+  if (attr->fmt == RKNN_TENSOR_NHWC && attr->n_dims == 4) {
+    uint32_t hw       = attr->dims[1] * attr->dims[2];
+    uint32_t c_stride = attr->dims[3];
+    uint32_t c        = num_channels ? num_channels : c_stride;
+    if (c > c_stride) {
+      return -1;
+    }
+    for (uint32_t s = 0; s < hw; s++) {
+      topk_scan<Elem>(p + s * c_stride, c, s, hw, list);
+    }
+    return 0;
+  }
+
+  if (attr->fmt == RKNN_TENSOR_NC1HWC2 && attr->n_dims == 5) {
+    uint32_t c1 = attr->dims[1];
+    uint32_t hw = attr->dims[2] * attr->dims[3];
+    uint32_t c2 = attr->dims[4];
+    uint32_t c  = num_channels ? num_channels : c1 * c2;
+    if (c > c1 * c2) {
+      return -1;
+    }
+    if (hw == 1) {
+      topk_scan<Elem>(p, c, 0, 1, list);
+      return 0;
+    }
+    for (uint32_t i = 0; i * c2 < c; i++) {
+      uint32_t len = c - i * c2 < c2 ? c - i * c2 : c2;
+      for (uint32_t s = 0; s < hw; s++) {
+        topk_scan<Elem>(p + (i * hw + s) * c2, len, i * c2 * hw + s, hw, list);
+      }
+    }
+    return 0;
+  }
+
+  // NCHW and the rest are read as stored
+  uint32_t len = attr->n_elems;
+  if (attr->n_dims >= 2 && attr->dims[0] > 1) {
+    len /= attr->dims[0];
+  }
+  if (num_channels) {
+    uint32_t hw = 1;
+    for (uint32_t d = 2; d < attr->n_dims && attr->fmt == RKNN_TENSOR_NCHW; d++) {
+      hw *= attr->dims[d];
+    }
+    if (num_channels * hw > len) {
+      return -1;
+    }
+    len = num_channels * hw;
+  }
+  topk_scan<Elem>(p, len, 0, 1, list);
+  return 0;
+}
+
+template <typename Elem>
+static int topk_run(const rknn_tensor_attr* attr, const void* data, uint32_t num_channels, uint32_t top_k,
+                    rknn_topk_result* results)
+{
+  TopKList<typename Elem::Key> list;
+  list.k = top_k;
+  list.n = 0;
+  if (topk_tensor<Elem>(attr, data, num_channels, &list) != 0) {
+    printf("rknn_GetTopK: %u channels do not fit output %s\n", num_channels, attr->name);
+    return -1;
+  }
+
+  // dequantize the winners only
+  float zp    = 0.f;
+  float scale = 1.f;
+  if (attr->qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && attr->type != RKNN_TENSOR_FLOAT16 &&
+      attr->type != RKNN_TENSOR_FLOAT32) {
+    zp    = (float)attr->zp;
+    scale = attr->scale;
+  } else if (attr->qnt_type == RKNN_TENSOR_QNT_DFP) {
+    scale = ldexpf(1.f, -attr->fl);
+  }
+  for (uint32_t i = 0; i < list.n; i++) {
+    results[i].index = list.indices[i];
+    results[i].prob  = (Elem::Value(list.keys[i]) - zp) * scale;
+  }
+  return (int)list.n;
+}
+
+/*-------------------------------------------
+                  Functions
+-------------------------------------------*/
+int rknn_GetTopK(const rknn_tensor_attr* attr, const void* data, uint32_t num_channels, uint32_t top_k,
+                 rknn_topk_result* results)
+{
+  if (attr == NULL || data == NULL || results == NULL || top_k == 0 || top_k > RKNN_TOPK_MAX) {
+    printf("rknn_GetTopK: invalid argument, top_k must be in [1, %d]\n", RKNN_TOPK_MAX);
+    return -1;
+  }
+
+  switch (attr->type) {
+  case RKNN_TENSOR_INT8:
+    return topk_run<TopKElemI8>(attr, data, num_channels, top_k, results);
+  case RKNN_TENSOR_UINT8:
+    return topk_run<TopKElemU8>(attr, data, num_channels, top_k, results);
+  case RKNN_TENSOR_FLOAT16:
+    return topk_run<TopKElemF16>(attr, data, num_channels, top_k, results);
+  case RKNN_TENSOR_FLOAT32:
+    return topk_run<TopKElemF32>(attr, data, num_channels, top_k, results);
+  default:
+    printf("rknn_GetTopK: unsupported output type %s\n", get_type_string(attr->type));
+    return -1;
+  }
+}
+
+int rknn_GetTopN(float* pfProb, float* pfMaxProb, uint32_t* pMaxClass, uint32_t outputCount, uint32_t topNum)
+{
+  if (topNum > RKNN_TOPK_MAX) {
+    return 0;
+  }
+
+  TopKList<float> list;
+  list.k = topNum;
+  list.n = 0;
+  if (topNum > 0) {
+    topk_scan<TopKElemF32>(pfProb, outputCount, 0, 1, &list);
+  }
+  for (uint32_t i = 0; i < topNum; ++i) {
+    pfMaxProb[i] = i < list.n ? list.keys[i] : -FLT_MAX;
+    pMaxClass[i] = i < list.n ? list.indices[i] : -1;
+  }
+  return 1;
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2023 by Rockchip Electronics Co., Ltd. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _RKNN_UTILS_TOPK_H_
+#define _RKNN_UTILS_TOPK_H_
+
+#include <stdint.h>
+
+#include "rknn_api.h"
+
+/*
+  top-K of classification outputs, shared by the examples.
+  rknn_GetTopK() reads the output buffer in its own type (int8 / uint8 / fp16 / fp32) and layout (NCHW, NHWC or the
+  native NC1HWC2), compares the raw values and dequantizes only the K winners, so the output does not have to be
+  converted to float (want_float = 1 or RKNN_TENSOR_FLOAT32) first.
+*/
+
+#define RKNN_TOPK_MAX 64
+
+typedef struct _rknn_topk_result
+{
+  uint32_t index; // class, i.e. element index in the NCHW output
+  float    prob;  // dequantized value
+} rknn_topk_result;
+
+/* attr is the attr of data: the output attr, or the native output attr for memory bound with rknn_set_io_mem().
+   native NHWC / NC1HWC2 outputs have their channels aligned, num_channels is the real channel count (dims[1] of the
+   normal output attr), 0 takes the channels from attr. only the first image of a batch is searched.
+   results are written best first, ties keep the lower index. returns the number of results, or -1 on error. */
+int rknn_GetTopK(const rknn_tensor_attr* attr, const void* data, uint32_t num_channels, uint32_t top_k,
+                 rknn_topk_result* results);
+
+/* float version with the interface of the former per-example copies: pfMaxProb / pMaxClass get topNum entries,
+   the ones past outputCount are -FLT_MAX / -1. */
+int rknn_GetTopN(float* pfProb, float* pfMaxProb, uint32_t* pMaxClass, uint32_t outputCount, uint32_t topNum);
+
+#endif //_RKNN_UTILS_TOPK_H_